@@ -0,0 +1,814 @@
+// Non-interactive batch mode: streams records from a file (or stdin) through the calculator
+// modules and writes one machine-readable result per record, with no prompts.
+//
+//   main.out --module=units|resistor|network|tolerance|eseries|det|thermo [--input=FILE] [--output=FILE]
+//            [--format=csv|json] [--threads=N]
+//
+// Record formats (one per line, blank lines and lines starting with '#' are skipped):
+//   units     value from_unit [to] to_unit           e.g. "10 dbm to mw"
+//   resistor  series v1 v2 ...  |  parallel v1 v2 ...  |  mixed S2,P3 v1 ... v5
+//             expr (R1+(R2||R3))||R4 v1 ... v4   (expression without spaces, see rexpr.c)
+//   network   r node_a node_b ohms  |  eq node_a node_b  (nodes are integers 0 to 999999; "r"
+//             lines build up one network and only produce output on error, "eq" measures it)
+//   tolerance uniform|gaussian trials expression v1:tol1 ... (tolerances in percent, e.g.
+//             "gaussian 1000000 (R1+R2)||R3 100:5 200:5 300:1"; the histogram is interactive only)
+//   eseries   E12|E24|E96 target [max_parts [k]]          (defaults 3 parts, 5 matches; one output
+//             row per match, best first, with its relative error in rel_error)
+//   det       n a11 a12 ... ann                        (row-major)
+//   thermo    state P T mass molar_mass  |  change P1 T1 P2 T2 mass_flow
+//             carnot T_hot T_cold  |  brayton pressure_ratio
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+#include "funcs.h"
+
+#define BATCH_MAX_COLUMNS 16
+#define BATCH_VALUE_LEN 64
+#define ESERIES_MAX_K_BATCH 20
+#define BATCH_MAX_NODE 999999      // the solvers allocate per node up to the highest number
+
+typedef enum {
+    FORMAT_CSV,
+    FORMAT_JSON
+} OutputFormat;
+
+typedef struct {
+    FILE *out;
+    OutputFormat format;
+    const char *const *columns;           // CSV column order for the current module
+    int column_count;
+    char values[BATCH_MAX_COLUMNS][BATCH_VALUE_LEN];
+    int is_set[BATCH_MAX_COLUMNS];
+    int is_text[BATCH_MAX_COLUMNS];
+    int set_order[BATCH_MAX_COLUMNS];     // JSON keeps the order fields were added
+    int set_count;
+    long line_no;
+    long errors;
+} BatchContext;
+
+// Growable list of whitespace-separated tokens in one input line (points into the line)
+typedef struct {
+    char **items;
+    int count;
+    int capacity;
+} TokenList;
+
+typedef int (*record_fn)(BatchContext *ctx, TokenList *tokens);
+typedef int (*stream_fn)(BatchContext *ctx, int fd);
+
+static int column_index(const BatchContext *ctx, const char *key)
+{
+    for (int i = 0; i < ctx->column_count; i++) {
+        if (strcmp(ctx->columns[i], key) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void begin_record(BatchContext *ctx)
+{
+    memset(ctx->is_set, 0, sizeof(ctx->is_set));
+    ctx->set_count = 0;
+}
+
+static void set_field(BatchContext *ctx, const char *key, const char *value, int is_text)
+{
+    int i = column_index(ctx, key);
+    if (i < 0) {
+        return;
+    }
+    snprintf(ctx->values[i], BATCH_VALUE_LEN, "%s", value);
+    if (!ctx->is_set[i]) {
+        ctx->set_order[ctx->set_count++] = i;
+    }
+    ctx->is_set[i] = 1;
+    ctx->is_text[i] = is_text;
+}
+
+static void field_text(BatchContext *ctx, const char *key, const char *value)
+{
+    set_field(ctx, key, value, 1);
+}
+
+static void field_number(BatchContext *ctx, const char *key, double value)
+{
+    char buf[BATCH_VALUE_LEN];
+    if (isnan(value) || isinf(value)) {
+        // Not representable as a JSON number; CSV gets the usual spelling
+        set_field(ctx, key, ctx->format == FORMAT_JSON ? "null" : (isnan(value) ? "nan" : (value > 0 ? "inf" : "-inf")), 0);
+        return;
+    }
+    snprintf(buf, sizeof(buf), "%.17g", value);
+    set_field(ctx, key, buf, 0);
+}
+
+static void field_int(BatchContext *ctx, const char *key, long value)
+{
+    char buf[BATCH_VALUE_LEN];
+    snprintf(buf, sizeof(buf), "%ld", value);
+    set_field(ctx, key, buf, 0);
+}
+
+static void write_escaped(FILE *out, const char *s, OutputFormat format)
+{
+    if (format == FORMAT_JSON) {
+        fputc('"', out);
+        for (; *s; s++) {
+            unsigned char c = (unsigned char)*s;
+            if (c == '"' || c == '\\') {
+                fputc('\\', out);
+                fputc(c, out);
+            } else if (c < 0x20) {
+                fprintf(out, "\\u%04x", c);
+            } else {
+                fputc(c, out);
+            }
+        }
+        fputc('"', out);
+    } else if (strpbrk(s, ",\"\r\n")) {
+        fputc('"', out);
+        for (; *s; s++) {
+            if (*s == '"') fputc('"', out);
+            fputc(*s, out);
+        }
+        fputc('"', out);
+    } else {
+        fputs(s, out);
+    }
+}
+
+static void end_record(BatchContext *ctx)
+{
+    if (ctx->format == FORMAT_JSON) {
+        fputc('{', ctx->out);
+        for (int k = 0; k < ctx->set_count; k++) {
+            int i = ctx->set_order[k];
+            if (k > 0) fputc(',', ctx->out);
+            fprintf(ctx->out, "\"%s\":", ctx->columns[i]);
+            if (ctx->is_text[i]) {
+                write_escaped(ctx->out, ctx->values[i], FORMAT_JSON);
+            } else {
+                fputs(ctx->values[i], ctx->out);
+            }
+        }
+        fputs("}\n", ctx->out);
+    } else {
+        for (int i = 0; i < ctx->column_count; i++) {
+            if (i > 0) fputc(',', ctx->out);
+            if (ctx->is_set[i]) {
+                write_escaped(ctx->out, ctx->values[i], FORMAT_CSV);
+            }
+        }
+        fputc('\n', ctx->out);
+    }
+}
+
+// Emit an error row for the current line
+static int record_error(BatchContext *ctx, const char *message)
+{
+    begin_record(ctx);
+    field_int(ctx, "line", ctx->line_no);
+    field_text(ctx, "error", message);
+    end_record(ctx);
+    ctx->errors++;
+    return -1;
+}
+
+// Parse a whole token as a double; returns 0 on success
+static int parse_number(const char *token, double *value)
+{
+    char *end;
+    *value = strtod(token, &end);
+    return (end == token || *end != '\0') ? -1 : 0;
+}
+
+static int tokenize(char *line, TokenList *tokens)
+{
+    tokens->count = 0;
+    for (char *tok = strtok(line, " \t\r\n"); tok; tok = strtok(NULL, " \t\r\n")) {
+        if (tokens->count == tokens->capacity) {
+            int capacity = tokens->capacity ? tokens->capacity * 2 : 16;
+            char **grown = realloc(tokens->items, sizeof(char *) * capacity);
+            if (!grown) {
+                return -1;
+            }
+            tokens->items = grown;
+            tokens->capacity = capacity;
+        }
+        tokens->items[tokens->count++] = tok;
+    }
+    return 0;
+}
+
+// ---- units ----
+static const char *const unit_columns[] = { "line", "value", "from", "to", "result", "error" };
+
+// Units records go through the streaming tokenizer instead of the line reader
+static void units_emit(const UnitRecord *records, size_t count, void *arg)
+{
+    BatchContext *ctx = arg;
+    char from[BATCH_VALUE_LEN], to[BATCH_VALUE_LEN];
+
+    for (size_t i = 0; i < count; i++) {
+        const UnitRecord *r = &records[i];
+        ctx->line_no = r->line;
+        if (r->error) {
+            record_error(ctx, r->error);
+            continue;
+        }
+        snprintf(from, sizeof(from), "%.*s", r->request.from_len, r->request.from);
+        snprintf(to, sizeof(to), "%.*s", r->request.to_len, r->request.to);
+
+        begin_record(ctx);
+        field_int(ctx, "line", ctx->line_no);
+        field_number(ctx, "value", r->request.value);
+        field_text(ctx, "from", from);
+        field_text(ctx, "to", to);
+        field_number(ctx, "result", r->result);
+        end_record(ctx);
+    }
+}
+
+static int units_stream(BatchContext *ctx, int fd)
+{
+    return convert_units_stream(fd, units_emit, ctx) < 0 ? -1 : 0;
+}
+
+// ---- resistor ----
+static const char *const resistor_columns[] = { "line", "type", "count", "resistance", "error" };
+
+// Parse the group spec of a mixed record, e.g. "S2,P3" -> sizes {2,3}, types {1,2}
+static int parse_groups(const char *spec, int group_sizes[], int connection_types[], int *group_count)
+{
+    *group_count = 0;
+    while (*spec) {
+        if (*group_count == MAX_GROUPS) {
+            return -1;
+        }
+        char kind = *spec++;
+        if (kind != 'S' && kind != 's' && kind != 'P' && kind != 'p') {
+            return -1;
+        }
+        char *end;
+        long size = strtol(spec, &end, 10);
+        if (end == spec || size < 1) {
+            return -1;
+        }
+        group_sizes[*group_count] = (int)size;
+        connection_types[*group_count] = (kind == 'S' || kind == 's') ? 1 : 2;
+        (*group_count)++;
+        spec = end;
+        if (*spec == ',') spec++;
+    }
+    return *group_count > 0 ? 0 : -1;
+}
+
+// Compiled form of the last expression seen; batches tend to reuse one topology
+static RExpr last_expr;
+static char *last_expr_text = NULL;
+
+static int compile_cached(const char *text, char *error, size_t error_len)
+{
+    if (last_expr_text && strcmp(text, last_expr_text) == 0) {
+        return 0;
+    }
+    free(last_expr_text);
+    last_expr_text = NULL;
+    rexpr_free(&last_expr);
+    if (rexpr_compile(text, &last_expr, error, error_len) != 0) {
+        return -1;
+    }
+    last_expr_text = strdup(text);
+    return 0;
+}
+
+static int resistor_record(BatchContext *ctx, TokenList *t)
+{
+    static float *values = NULL;
+    static int values_capacity = 0;
+
+    if (t->count < 2) {
+        return record_error(ctx, "expected: series|parallel|mixed|expr ...");
+    }
+
+    const char *type = t->items[0];
+    int first_value = 1;
+    int group_sizes[MAX_GROUPS], connection_types[MAX_GROUPS], group_count = 0;
+    int is_expr = strcmp(type, "expr") == 0;
+
+    if (is_expr) {
+        char error[BATCH_VALUE_LEN];
+        if (compile_cached(t->items[1], error, sizeof(error)) != 0) {
+            return record_error(ctx, error);
+        }
+        first_value = 2;
+    } else if (strcmp(type, "mixed") == 0) {
+        if (parse_groups(t->items[1], group_sizes, connection_types, &group_count) != 0) {
+            return record_error(ctx, "bad group spec, expected e.g. S2,P3");
+        }
+        first_value = 2;
+    } else if (strcmp(type, "series") != 0 && strcmp(type, "parallel") != 0) {
+        return record_error(ctx, "unknown connection type");
+    }
+
+    int n = t->count - first_value;
+    if (n < 1 && !is_expr) {
+        return record_error(ctx, "no resistor values");
+    }
+    if (is_expr && n != last_expr.value_count) {
+        return record_error(ctx, "value count does not match the expression");
+    }
+    if (n > values_capacity) {
+        float *grown = realloc(values, sizeof(float) * n);
+        if (!grown) {
+            return record_error(ctx, "out of memory");
+        }
+        values = grown;
+        values_capacity = n;
+    }
+
+    for (int i = 0; i < n; i++) {
+        double v;
+        if (parse_number(t->items[first_value + i], &v) != 0 || v <= 0) {
+            return record_error(ctx, "resistances must be positive numbers");
+        }
+        values[i] = (float)v;
+    }
+
+    double total;
+    if (is_expr) {
+        total = rexpr_eval(&last_expr, values);
+    } else if (group_count > 0) {
+        int used = 0;
+        for (int i = 0; i < group_count; i++) used += group_sizes[i];
+        if (used != n) {
+            return record_error(ctx, "group sizes do not match the number of values");
+        }
+        total = calc_mixed_resistance(values, n, group_sizes, connection_types, group_count);
+    } else if (strcmp(type, "series") == 0) {
+        total = calc_series(values, n);
+    } else {
+        total = calc_parallel(values, n);
+    }
+
+    begin_record(ctx);
+    field_int(ctx, "line", ctx->line_no);
+    field_text(ctx, "type", type);
+    field_int(ctx, "count", n);
+    field_number(ctx, "resistance", total);
+    end_record(ctx);
+    return 0;
+}
+
+// ---- network ----
+static const char *const network_columns[] = { "line", "node_a", "node_b", "resistance", "error" };
+
+static int network_record(BatchContext *ctx, TokenList *t)
+{
+    static ResistorNetwork net;     // grows for the whole input
+    double v[3];
+
+    const char *kind = t->items[0];
+    int is_resistor = strcmp(kind, "r") == 0;
+    if (!is_resistor && strcmp(kind, "eq") != 0) {
+        return record_error(ctx, "unknown record, expected r|eq");
+    }
+    int args = is_resistor ? 3 : 2;
+    if (t->count != args + 1) {
+        return record_error(ctx, is_resistor ? "expected: r node_a node_b ohms" : "expected: eq node_a node_b");
+    }
+    for (int i = 0; i < args; i++) {
+        if (parse_number(t->items[i + 1], &v[i]) != 0) {
+            return record_error(ctx, "values must be numbers");
+        }
+    }
+    for (int i = 0; i < 2; i++) {
+        if (v[i] < 0 || v[i] != floor(v[i]) || v[i] > BATCH_MAX_NODE) {
+            return record_error(ctx, "nodes must be integers from 0 to 999999");
+        }
+    }
+
+    if (is_resistor) {
+        if (!(v[2] > 0) || network_add_resistor(&net, (int)v[0], (int)v[1], v[2]) != 0) {
+            return record_error(ctx, "resistance must be positive");
+        }
+        return 0;
+    }
+
+    double r = network_equivalent_resistance(&net, (int)v[0], (int)v[1]);
+    if (isnan(r)) {
+        return record_error(ctx, "unknown node or solver failure");
+    }
+    begin_record(ctx);
+    field_int(ctx, "line", ctx->line_no);
+    field_int(ctx, "node_a", (long)v[0]);
+    field_int(ctx, "node_b", (long)v[1]);
+    field_number(ctx, "resistance", r);
+    end_record(ctx);
+    return 0;
+}
+
+// ---- tolerance ----
+static const char *const tolerance_columns[] = {
+    "line", "distribution", "trials", "nominal", "mean", "std", "p1", "p50", "p99", "min", "max", "error"
+};
+
+static int tolerance_record(BatchContext *ctx, TokenList *t)
+{
+    static float *values = NULL;
+    static int values_capacity = 0;
+    double trials;
+    char error[BATCH_VALUE_LEN];
+
+    if (t->count < 3) {
+        return record_error(ctx, "expected: uniform|gaussian trials expression v1:tol1 ...");
+    }
+    int gaussian = strcmp(t->items[0], "gaussian") == 0;
+    if (!gaussian && strcmp(t->items[0], "uniform") != 0) {
+        return record_error(ctx, "distribution must be uniform or gaussian");
+    }
+    if (parse_number(t->items[1], &trials) != 0 || trials < 1 || trials > 1e10 || trials != floor(trials)) {
+        return record_error(ctx, "trials must be a positive integer");
+    }
+    if (compile_cached(t->items[2], error, sizeof(error)) != 0) {
+        return record_error(ctx, error);
+    }
+    int n = t->count - 3;
+    if (n != last_expr.value_count) {
+        return record_error(ctx, "value count does not match the expression");
+    }
+    if (2 * n > values_capacity) {
+        float *grown = realloc(values, sizeof(float) * 2 * n);
+        if (!grown) {
+            return record_error(ctx, "out of memory");
+        }
+        values = grown;
+        values_capacity = 2 * n;
+    }
+
+    // Each part is "ohms:percent"
+    for (int i = 0; i < n; i++) {
+        char *item = t->items[3 + i];
+        char *colon = strchr(item, ':');
+        double v, tol;
+        if (!colon) {
+            return record_error(ctx, "parts must be written ohms:percent");
+        }
+        *colon = '\0';
+        int bad = parse_number(item, &v) != 0 || parse_number(colon + 1, &tol) != 0;
+        *colon = ':';
+        if (bad || v <= 0 || tol < 0) {
+            return record_error(ctx, "parts must be written ohms:percent");
+        }
+        values[i] = (float)v;
+        values[n + i] = (float)tol;
+    }
+
+    ToleranceResult r;
+    if (tolerance_analysis(&last_expr, values, values + n, gaussian ? TOLERANCE_GAUSSIAN : TOLERANCE_UNIFORM,
+                           (long)trials, 12345, &r) != 0) {
+        return record_error(ctx, "tolerance too large or out of memory");
+    }
+    begin_record(ctx);
+    field_int(ctx, "line", ctx->line_no);
+    field_text(ctx, "distribution", t->items[0]);
+    field_int(ctx, "trials", r.trials);
+    field_number(ctx, "nominal", r.nominal);
+    field_number(ctx, "mean", r.mean);
+    field_number(ctx, "std", r.std);
+    field_number(ctx, "p1", r.percentile[1]);
+    field_number(ctx, "p50", r.percentile[3]);
+    field_number(ctx, "p99", r.percentile[5]);
+    field_number(ctx, "min", r.min);
+    field_number(ctx, "max", r.max);
+    end_record(ctx);
+    return 0;
+}
+
+// ---- eseries ----
+static const char *const eseries_columns[] = {
+    "line", "target", "rank", "combination", "resistance", "rel_error", "error"
+};
+
+static int eseries_record(BatchContext *ctx, TokenList *t)
+{
+    static const char *const names[] = { "E12", "E24", "E96" };
+    EMatch matches[ESERIES_MAX_K_BATCH];
+    double v[3] = { 0, 3, 5 };
+    int series = -1;
+
+    if (t->count < 2 || t->count > 4) {
+        return record_error(ctx, "expected: E12|E24|E96 target [max_parts [k]]");
+    }
+    for (int i = 0; i < 3; i++) {
+        if (strcasecmp(t->items[0], names[i]) == 0) series = i;
+    }
+    if (series < 0) {
+        return record_error(ctx, "series must be E12, E24 or E96");
+    }
+    for (int i = 1; i < t->count; i++) {
+        if (parse_number(t->items[i], &v[i - 1]) != 0) {
+            return record_error(ctx, "values must be numbers");
+        }
+    }
+    if (!(v[0] > 0) || v[1] < 1 || v[1] > ESERIES_MAX_PARTS || v[1] != floor(v[1]) ||
+        v[2] < 1 || v[2] > ESERIES_MAX_K_BATCH || v[2] != floor(v[2])) {
+        return record_error(ctx, "target must be positive, max_parts 1-4 and k 1-20");
+    }
+
+    int found = eseries_search((ESeries)series, v[0], (int)v[1], (int)v[2], matches);
+    if (found <= 0) {
+        return record_error(ctx, "no combination found");
+    }
+    for (int i = 0; i < found; i++) {
+        char text[BATCH_VALUE_LEN];
+        eseries_format(&matches[i], text, sizeof(text));
+        begin_record(ctx);
+        field_int(ctx, "line", ctx->line_no);
+        field_number(ctx, "target", v[0]);
+        field_int(ctx, "rank", i + 1);
+        field_text(ctx, "combination", text);
+        field_number(ctx, "resistance", matches[i].value);
+        field_number(ctx, "rel_error", matches[i].error);
+        end_record(ctx);
+    }
+    return 0;
+}
+
+// ---- det ----
+static const char *const det_columns[] = { "line", "n", "determinant", "error" };
+
+static int det_record(BatchContext *ctx, TokenList *t)
+{
+    static DMatrix mat = { NULL, 0, 0, 0, 0 };   // reused while the size stays the same
+    double nv;
+
+    if (t->count < 1 || parse_number(t->items[0], &nv) != 0 || nv < 1 || nv != floor(nv)) {
+        return record_error(ctx, "expected: n followed by n*n values");
+    }
+    int n = (int)nv;
+    if ((long)t->count - 1 != (long)n * n) {
+        return record_error(ctx, "expected n*n matrix values");
+    }
+
+    if (mat.rows != n) {
+        dmatrix_free(&mat);
+        if (dmatrix_create(&mat, n, n) != 0) {
+            return record_error(ctx, "out of memory");
+        }
+    }
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            if (parse_number(t->items[1 + i * n + j], &DMAT(&mat, i, j)) != 0) {
+                return record_error(ctx, "matrix values must be numbers");
+            }
+        }
+    }
+
+    begin_record(ctx);
+    field_int(ctx, "line", ctx->line_no);
+    field_int(ctx, "n", n);
+    field_number(ctx, "determinant", dmatrix_determinant(&mat));
+    end_record(ctx);
+    return 0;
+}
+
+// ---- thermo ----
+static const char *const thermo_columns[] = {
+    "line", "record", "fluid", "volume", "internal_energy", "enthalpy", "entropy", "Z",
+    "delta_H", "delta_S", "efficiency", "error"
+};
+
+// Parse t->items[1..count] into values[]; all must be positive
+static int parse_positive_args(TokenList *t, int count, double values[])
+{
+    if (t->count != count + 1) {
+        return -1;
+    }
+    for (int i = 0; i < count; i++) {
+        if (parse_number(t->items[i + 1], &values[i]) != 0 || values[i] <= 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int thermo_record(BatchContext *ctx, TokenList *t)
+{
+    double v[5];
+    const char *kind = t->count > 0 ? t->items[0] : "";
+
+    if (strcmp(kind, "state") == 0) {
+        if (parse_positive_args(t, 4, v) != 0) {
+            return record_error(ctx, "expected: state P T mass molar_mass (all positive)");
+        }
+        StatePoint state;
+        state.pressure = v[0];
+        state.temperature = v[1];
+        state.mass = v[2];
+        const char *fluid = compute_ideal_gas_state(&state, v[3]);
+
+        begin_record(ctx);
+        field_int(ctx, "line", ctx->line_no);
+        field_text(ctx, "record", kind);
+        field_text(ctx, "fluid", fluid);
+        field_number(ctx, "volume", state.volume);
+        field_number(ctx, "internal_energy", state.internal_energy);
+        field_number(ctx, "enthalpy", state.enthalpy);
+        field_number(ctx, "entropy", state.entropy);
+        field_number(ctx, "Z", calculate_compressibility_factor(state.pressure, state.temperature,
+                                                                 state.volume, FLUID_AIR));
+        end_record(ctx);
+    } else if (strcmp(kind, "change") == 0) {
+        if (parse_positive_args(t, 5, v) != 0) {
+            return record_error(ctx, "expected: change P1 T1 P2 T2 mass_flow (all positive)");
+        }
+        StatePoint s1, s2;
+        double delta_H, delta_S;
+        s1.pressure = v[0];
+        s1.temperature = v[1];
+        s2.pressure = v[2];
+        s2.temperature = v[3];
+        compute_enthalpy_entropy_change(&s1, &s2, v[4], &delta_H, &delta_S);
+
+        begin_record(ctx);
+        field_int(ctx, "line", ctx->line_no);
+        field_text(ctx, "record", kind);
+        field_number(ctx, "delta_H", delta_H);
+        field_number(ctx, "delta_S", delta_S);
+        end_record(ctx);
+    } else if (strcmp(kind, "carnot") == 0 || strcmp(kind, "brayton") == 0) {
+        int is_carnot = (kind[0] == 'c');
+        if (parse_positive_args(t, is_carnot ? 2 : 1, v) != 0) {
+            return record_error(ctx, is_carnot ? "expected: carnot T_hot T_cold" : "expected: brayton pressure_ratio");
+        }
+
+        begin_record(ctx);
+        field_int(ctx, "line", ctx->line_no);
+        field_text(ctx, "record", kind);
+        field_number(ctx, "efficiency", is_carnot ? carnot_efficiency(v[0], v[1]) : brayton_efficiency(v[0]));
+        end_record(ctx);
+    } else {
+        return record_error(ctx, "unknown record, expected state|change|carnot|brayton");
+    }
+    return 0;
+}
+
+typedef struct {
+    const char *name;
+    record_fn handler;      // called per tokenized line...
+    stream_fn stream;       // ...or given the whole input
+    const char *const *columns;
+    int column_count;
+} BatchModule;
+
+#define MODULE(name, fn, stream, cols) { name, fn, stream, cols, (int)(sizeof(cols) / sizeof(cols[0])) }
+
+static const BatchModule batch_modules[] = {
+    MODULE("units", NULL, units_stream, unit_columns),
+    MODULE("resistor", resistor_record, NULL, resistor_columns),
+    MODULE("network", network_record, NULL, network_columns),
+    MODULE("tolerance", tolerance_record, NULL, tolerance_columns),
+    MODULE("eseries", eseries_record, NULL, eseries_columns),
+    MODULE("det", det_record, NULL, det_columns),
+    MODULE("thermo", thermo_record, NULL, thermo_columns),
+};
+
+static void print_usage(const char *program)
+{
+    fprintf(stderr,
+            "Usage: %s --module=units|resistor|network|tolerance|eseries|det|thermo [--input=FILE] [--output=FILE]\n"
+            "          [--format=csv|json] [--threads=N]\n"
+            "Reads one record per line from FILE (default: stdin) and writes one result per record.\n",
+            program);
+}
+
+// Returns the value of "--name=value" if arg matches, otherwise NULL
+static const char *option_value(const char *arg, const char *name)
+{
+    size_t len = strlen(name);
+    if (strncmp(arg, name, len) == 0 && arg[len] == '=') {
+        return arg + len + 1;
+    }
+    return NULL;
+}
+
+// Entry point for command line use. Exit status: 0 all records ok, 1 some records failed,
+// 2 bad usage or unreadable input.
+int run_batch(int argc, char *argv[])
+{
+    const char *module_name = NULL;
+    const char *input_path = NULL;
+    const char *output_path = NULL;
+    OutputFormat format = FORMAT_CSV;
+    const char *v;
+
+    for (int i = 1; i < argc; i++) {
+        if ((v = option_value(argv[i], "--module"))) {
+            module_name = v;
+        } else if ((v = option_value(argv[i], "--input"))) {
+            input_path = v;
+        } else if ((v = option_value(argv[i], "--output"))) {
+            output_path = v;
+        } else if ((v = option_value(argv[i], "--format"))) {
+            if (strcmp(v, "csv") == 0) {
+                format = FORMAT_CSV;
+            } else if (strcmp(v, "json") == 0) {
+                format = FORMAT_JSON;
+            } else {
+                fprintf(stderr, "Unknown format '%s'\n", v);
+                return 2;
+            }
+        } else if ((v = option_value(argv[i], "--threads"))) {
+            if (atoi(v) < 1 || threadpool_init(atoi(v)) != 0) {
+                fprintf(stderr, "Invalid thread count '%s'\n", v);
+                return 2;
+            }
+        } else {
+            print_usage(argv[0]);
+            return 2;
+        }
+    }
+
+    const BatchModule *module = NULL;
+    for (size_t i = 0; module_name && i < sizeof(batch_modules) / sizeof(batch_modules[0]); i++) {
+        if (strcmp(batch_modules[i].name, module_name) == 0) {
+            module = &batch_modules[i];
+        }
+    }
+    if (!module) {
+        print_usage(argv[0]);
+        return 2;
+    }
+
+    FILE *in = stdin;
+    if (input_path && strcmp(input_path, "-") != 0) {
+        in = fopen(input_path, "r");
+        if (!in) {
+            fprintf(stderr, "Cannot open input '%s'\n", input_path);
+            return 2;
+        }
+    }
+
+    FILE *out = stdout;
+    if (output_path && strcmp(output_path, "-") != 0) {
+        out = fopen(output_path, "w");
+        if (!out) {
+            fprintf(stderr, "Cannot open output '%s'\n", output_path);
+            if (in != stdin) fclose(in);
+            return 2;
+        }
+    }
+    setvbuf(out, NULL, _IOFBF, 1 << 16);
+
+    BatchContext ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.out = out;
+    ctx.format = format;
+    ctx.columns = module->columns;
+    ctx.column_count = module->column_count;
+
+    if (format == FORMAT_CSV) {
+        for (int i = 0; i < ctx.column_count; i++) {
+            fprintf(out, i ? ",%s" : "%s", ctx.columns[i]);
+        }
+        fputc('\n', out);
+    }
+
+    if (module->stream) {
+        int status = 0;
+        if (module->stream(&ctx, fileno(in)) != 0) {
+            fprintf(stderr, "Error reading input\n");
+            status = 2;
+        }
+        if (in != stdin) fclose(in);
+        if (out != stdout) fclose(out);
+        return status ? status : (ctx.errors ? 1 : 0);
+    }
+
+    char *line = NULL;
+    size_t line_capacity = 0;
+    TokenList tokens = { NULL, 0, 0 };
+
+    while (getline(&line, &line_capacity, in) != -1) {
+        ctx.line_no++;
+        if (tokenize(line, &tokens) != 0) {
+            record_error(&ctx, "out of memory");
+            continue;
+        }
+        if (tokens.count == 0 || tokens.items[0][0] == '#') {
+            continue;
+        }
+        module->handler(&ctx, &tokens);
+    }
+
+    free(line);
+    free(tokens.items);
+    if (in != stdin) fclose(in);
+    if (out != stdout) fclose(out);
+    return ctx.errors ? 1 : 0;
+}
@@ -0,0 +1,1209 @@
+// Throughput benchmarks for the calculator engines (not part of main.out).
+// Build with "make bench.out", then run "./bench.out <name>" or "./bench.out all".
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "funcs.h"
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void report(const char *label, double seconds, double items)
+{
+    printf("  %-34s %10.3f ms  %12.1f M items/s\n", label, seconds * 1e3, items / seconds / 1e6);
+}
+
+static double uniform(double lo, double hi)
+{
+    return lo + (hi - lo) * (rand() / (double)RAND_MAX);
+}
+
+// Per-line path (sscanf + convert_units, as in unit_converter) against the bulk kernels
+static void bench_units(void)
+{
+    const int lines = 1000000;
+    const size_t n = 4000000;
+    double *in = malloc(sizeof(double) * n);
+    double *out = malloc(sizeof(double) * n);
+    char (*text)[48] = malloc(sizeof(*text) * lines);
+    if (!in || !out || !text) {
+        printf("units: out of memory\n");
+        free(in); free(out); free(text);
+        return;
+    }
+
+    printf("units (kernel: %s)\n", convert_kernel_name());
+
+    for (int i = 0; i < lines; i++) {
+        snprintf(text[i], sizeof(text[i]), "%.6f w to mw", uniform(0.001, 100.0));
+    }
+    double checksum = 0;
+    double t0 = now_seconds();
+    for (int i = 0; i < lines; i++) {
+        double value;
+        char from_unit[20], to_unit[20];
+        if (sscanf(text[i], "%lf %19s to %19s", &value, from_unit, to_unit) == 3) {
+            checksum += convert_units(value, from_unit, to_unit);
+        }
+    }
+    report("per-line sscanf + convert_units", now_seconds() - t0, lines);
+
+    for (size_t i = 0; i < n; i++) in[i] = uniform(0.001, 100.0);
+    t0 = now_seconds();
+    for (size_t i = 0; i < n; i++) {
+        out[i] = convert_units(in[i], "w", "mw");
+    }
+    report("convert_units per value", now_seconds() - t0, n);
+
+    t0 = now_seconds();
+    convert_units_bulk("w", "mw", in, out, n);
+    report("bulk w -> mw", now_seconds() - t0, n);
+
+    for (size_t i = 0; i < n; i++) in[i] = uniform(-200.0, 1000.0);
+    t0 = now_seconds();
+    convert_units_bulk("c", "f", in, out, n);
+    report("bulk c -> f", now_seconds() - t0, n);
+
+    for (size_t i = 0; i < n; i++) in[i] = uniform(-300.0, 300.0);
+    t0 = now_seconds();
+    convert_units_bulk("dbm", "mw", in, out, n);
+    report("bulk dbm -> mw", now_seconds() - t0, n);
+    double max_rel = 0;
+    for (size_t i = 0; i < n; i++) {
+        double exact = pow(10.0, in[i] / 10.0);
+        double rel = fabs(out[i] - exact) / exact;
+        if (rel > max_rel) max_rel = rel;
+    }
+    printf("    max relative error vs pow(): %.3g\n", max_rel);
+
+    for (size_t i = 0; i < n; i++) in[i] = pow(10.0, uniform(-300.0, 300.0));
+    t0 = now_seconds();
+    convert_units_bulk("mw", "dbm", in, out, n);
+    report("bulk mw -> dbm", now_seconds() - t0, n);
+    double max_abs = 0;
+    for (size_t i = 0; i < n; i++) {
+        double err = fabs(out[i] - 10.0 * log10(in[i]));
+        if (err > max_abs) max_abs = err;
+    }
+    printf("    max absolute error vs log10(): %.3g dB\n", max_abs);
+
+    printf("  (checksum %g)\n", checksum);
+    free(in);
+    free(out);
+    free(text);
+}
+
+static void sum_results(const UnitRecord *records, size_t count, void *arg)
+{
+    double *sum = arg;
+    for (size_t i = 0; i < count; i++) {
+        if (!records[i].error) *sum += records[i].result;
+    }
+}
+
+// Streaming tokenizer over a generated request file, mapped and through a pipe-style read
+static void bench_units_stream(void)
+{
+    const long lines = 4000000;
+    static const char *const pairs[][2] = {
+        { "w", "mw" }, { "dbm", "mw" }, { "c", "f" }, { "mhz", "khz" }, { "mb", "kb" }
+    };
+    char path[] = "/tmp/bench_units_XXXXXX";
+    int fd = mkstemp(path);
+    FILE *f = fd >= 0 ? fdopen(fd, "w+") : NULL;
+    if (!f) {
+        printf("units_stream: cannot create temporary file\n");
+        return;
+    }
+    unlink(path);
+
+    // Runs of the same unit pair, as a log or sweep would produce
+    for (long i = 0; i < lines; i++) {
+        const char *const *pair = pairs[(i / 64) % 5];
+        fprintf(f, "%.6f %s to %s\n", uniform(-50.0, 50.0), pair[0], pair[1]);
+    }
+    fflush(f);
+    double mb = ftell(f) / 1e6;
+    printf("units_stream (%.1f MB, %ld requests)\n", mb, lines);
+
+    double sum = 0;
+    lseek(fd, 0, SEEK_SET);
+    double t0 = now_seconds();
+    long records = convert_units_stream(fd, sum_results, &sum);
+    double elapsed = now_seconds() - t0;
+    report("mapped file", elapsed, records);
+    printf("    %.0f MB/s\n", mb / elapsed);
+
+    // Same input through getline + strtok + strtod + convert_units, as the line reader does
+    rewind(f);
+    char *line = NULL;
+    size_t capacity = 0;
+    double check = 0;
+    t0 = now_seconds();
+    while (getline(&line, &capacity, f) != -1) {
+        char *value = strtok(line, " \t\r\n");
+        char *from = strtok(NULL, " \t\r\n");
+        strtok(NULL, " \t\r\n");
+        char *to = strtok(NULL, " \t\r\n");
+        if (value && from && to) check += convert_units(strtod(value, NULL), from, to);
+    }
+    elapsed = now_seconds() - t0;
+    report("getline + strtok + strtod", elapsed, lines);
+    printf("    %.0f MB/s  (sums %.6g / %.6g)\n", mb / elapsed, sum, check);
+
+    free(line);
+    fclose(f);
+}
+
+// Equivalent resistance across square resistor meshes with random values
+static void bench_network(void)
+{
+    static const int sides[] = { 100, 300, 700 };
+    printf("network (nodal analysis, %d threads)\n", threadpool_size());
+
+    for (size_t s = 0; s < sizeof(sides) / sizeof(sides[0]); s++) {
+        int w = sides[s];
+        ResistorNetwork net;
+        network_init(&net);
+        for (int i = 0; i < w; i++) {
+            for (int j = 0; j < w; j++) {
+                int id = i * w + j;
+                if (j + 1 < w) network_add_resistor(&net, id, id + 1, uniform(10.0, 1000.0));
+                if (i + 1 < w) network_add_resistor(&net, id, id + w, uniform(10.0, 1000.0));
+            }
+        }
+        double t0 = now_seconds();
+        double r = network_equivalent_resistance(&net, 0, w * w - 1);
+        char label[64];
+        snprintf(label, sizeof(label), "%dx%d mesh, %d resistors", w, w, net.count);
+        report(label, now_seconds() - t0, net.count);
+        printf("    corner to corner: %.6f ohms\n", r);
+        network_free(&net);
+    }
+}
+
+// Netlist loading against just reading the same file
+static void bench_netlist(void)
+{
+    const int lines = 1000000;
+    static const char *const suffixes[] = { "", "k", "M", "R" };
+    char path[] = "/tmp/bench_netlist_XXXXXX";
+    int fd = mkstemp(path);
+    FILE *f = fd >= 0 ? fdopen(fd, "w") : NULL;
+    if (!f) {
+        printf("netlist: cannot create temporary file\n");
+        return;
+    }
+    fprintf(f, "* generated mesh\n");
+    for (int i = 0; i < lines; i++) {
+        int a = rand() % (lines / 2);
+        fprintf(f, "R%d n%d n%d %d%s%d\n", i, a, a + 1 + rand() % 1000, 1 + rand() % 99,
+                suffixes[i % 4], rand() % 10);
+    }
+    fclose(f);
+
+    printf("netlist (%d resistor lines)\n", lines);
+
+    double t0 = now_seconds();
+    FILE *in = fopen(path, "r");
+    char block[1 << 16];
+    size_t bytes = 0, n;
+    while (in && (n = fread(block, 1, sizeof(block), in)) > 0) bytes += n;
+    if (in) fclose(in);
+    report("read file", now_seconds() - t0, lines);
+
+    Netlist nl;
+    char error[160];
+    netlist_init(&nl);
+    t0 = now_seconds();
+    int status = netlist_load(path, &nl, error, sizeof(error));
+    double elapsed = now_seconds() - t0;
+    report("netlist_load", elapsed, lines);
+    if (status == 0) {
+        printf("    %.0f MB/s, %d resistors, %d nodes\n", bytes / elapsed / 1e6, nl.count, nl.node_count);
+    } else {
+        printf("    %s\n", error);
+    }
+    netlist_free(&nl);
+    unlink(path);
+}
+
+// Compiled series/parallel expressions over many candidate value sets, against hand-written C
+static void bench_rexpr(void)
+{
+    static const char *const texts[] = {
+        "(R1 + (R2 || R3)) || R4",
+        "((R1 || R2) + (R3 || R4 || R5) + R6) || (R7 + (R8 || (R9 + R10)))",
+    };
+    const int sets = 1 << 16;
+    const int reps = 64;
+    float *values = malloc(sizeof(float) * sets * 10);
+    if (!values) {
+        return;
+    }
+    for (int i = 0; i < sets * 10; i++) values[i] = (float)uniform(10, 10000);
+
+    printf("rexpr (%d value sets x %d)\n", sets, reps);
+    double t0 = now_seconds();
+    volatile float sink = 0;
+    for (int r = 0; r < reps; r++) {
+        for (int i = 0; i < sets; i++) {
+            const float *v = values + (size_t)i * 10;
+            float p = 1.0f / (1.0f / v[1] + 1.0f / v[2]);
+            sink += 1.0f / (1.0f / (v[0] + p) + 1.0f / v[3]);
+        }
+    }
+    report("hand-written, 4 resistors", now_seconds() - t0, (double)sets * reps);
+
+    for (size_t k = 0; k < sizeof(texts) / sizeof(texts[0]); k++) {
+        RExpr expr;
+        char error[128];
+        if (rexpr_compile(texts[k], &expr, error, sizeof(error)) != 0) {
+            printf("  %s: %s\n", texts[k], error);
+            continue;
+        }
+        char label[64];
+        snprintf(label, sizeof(label), "rexpr_eval, %d resistors, %d ops", expr.value_count, expr.length);
+        t0 = now_seconds();
+        for (int r = 0; r < reps; r++) {
+            for (int i = 0; i < sets; i++) {
+                sink += rexpr_eval(&expr, values + (size_t)i * 10);
+            }
+        }
+        report(label, now_seconds() - t0, (double)sets * reps);
+        rexpr_free(&expr);
+    }
+    (void)sink;
+    free(values);
+}
+
+// Monte Carlo trials per second for a 10-part expression, both distributions
+static void bench_tolerance(void)
+{
+    const long trials = 10000000;
+    float nominal[10], tolerance[10];
+    RExpr expr;
+    char error[128];
+    if (rexpr_compile("((R1 || R2) + (R3 || R4 || R5) + R6) || (R7 + (R8 || (R9 + R10)))",
+                      &expr, error, sizeof(error)) != 0) {
+        printf("tolerance: %s\n", error);
+        return;
+    }
+    for (int i = 0; i < 10; i++) {
+        nominal[i] = (float)uniform(100, 10000);
+        tolerance[i] = i % 2 ? 1.0f : 5.0f;
+    }
+
+    printf("tolerance (%ld trials, 10 parts, %d threads)\n", trials, threadpool_size());
+    ToleranceResult r;
+    double t0 = now_seconds();
+    tolerance_analysis(&expr, nominal, tolerance, TOLERANCE_UNIFORM, trials, 1, &r);
+    report("uniform", now_seconds() - t0, trials);
+    t0 = now_seconds();
+    tolerance_analysis(&expr, nominal, tolerance, TOLERANCE_GAUSSIAN, trials, 1, &r);
+    report("gaussian", now_seconds() - t0, trials);
+    printf("    mean %.3f, std %.3f ohms\n", r.mean, r.std);
+    rexpr_free(&expr);
+}
+
+// Standard-value search: table build once, then searches by part count
+static void bench_eseries(void)
+{
+    static const char *const names[] = { "E12", "E24", "E96" };
+    EMatch matches[10];
+    char label[64];
+
+    printf("eseries (top 10 matches, %d threads)\n", threadpool_size());
+    for (int series = ESERIES_E12; series <= ESERIES_E96; series++) {
+        double t0 = now_seconds();
+        eseries_search((ESeries)series, 1000, 1, 1, matches);
+        snprintf(label, sizeof(label), "%s tables", names[series]);
+        report(label, now_seconds() - t0, 1);
+
+        for (int parts = 2; parts <= ESERIES_MAX_PARTS; parts++) {
+            const int searches = parts < 4 ? 20 : 3;
+            t0 = now_seconds();
+            for (int i = 0; i < searches; i++) {
+                eseries_search((ESeries)series, uniform(10, 1e6), parts, 10, matches);
+            }
+            snprintf(label, sizeof(label), "%s, up to %d parts", names[series], parts);
+            report(label, (now_seconds() - t0) / searches, 1);
+        }
+    }
+}
+
+// Largest relative error of out[] against a long double reference of series or parallel sums
+static double batch_error(const float *values, size_t stride, int rows, size_t count, int parallel,
+                          const double *out)
+{
+    double worst = 0;
+    for (size_t k = 0; k < count; k++) {
+        long double sum = 0;
+        for (int i = 0; i < rows; i++) {
+            long double x = values[(size_t)i * stride + k];
+            sum += parallel ? 1.0L / x : x;
+        }
+        long double exact = parallel ? 1.0L / sum : sum;
+        double e = (double)fabsl((out[k] - exact) / exact);
+        worst = e > worst ? e : worst;
+    }
+    return worst;
+}
+
+// SoA batch kernels against the one-configuration-per-call functions, plus accuracy on
+// values spread over nine decades
+static void bench_resistor_batch(void)
+{
+    static const char *const modes[] = { "float", "double", "compensated" };
+    const size_t count = 1 << 20;
+    const int n = 5;
+    int group_sizes[] = { 2, 3 }, connection_types[] = { 1, 2 };
+    float *soa = malloc(sizeof(float) * count * n);
+    float *aos = malloc(sizeof(float) * count * n);
+    double *out = malloc(sizeof(double) * count);
+    if (!soa || !aos || !out) {
+        free(soa);
+        free(aos);
+        free(out);
+        return;
+    }
+    for (size_t k = 0; k < count; k++) {
+        for (int i = 0; i < n; i++) {
+            float v = (float)uniform(1, 100000);
+            soa[(size_t)i * count + k] = v;
+            aos[k * n + i] = v;
+        }
+    }
+
+    memset(out, 0, sizeof(double) * count);
+    printf("resistor_batch (%zu configurations of %d resistors, %s kernels)\n", count, n, batch_kernel_name());
+    volatile float sink = 0;
+    double t0 = now_seconds();
+    for (size_t k = 0; k < count; k++) sink += calc_series(aos + k * n, n);
+    report("calc_series, one per call", now_seconds() - t0, count);
+    t0 = now_seconds();
+    for (size_t k = 0; k < count; k++) sink += calc_parallel(aos + k * n, n);
+    report("calc_parallel, one per call", now_seconds() - t0, count);
+    t0 = now_seconds();
+    for (size_t k = 0; k < count; k++) sink += calc_mixed_resistance(aos + k * n, n, group_sizes, connection_types, 2);
+    report("calc_mixed_resistance, one per call", now_seconds() - t0, count);
+    (void)sink;
+
+    char label[64];
+    for (int m = RBATCH_FLOAT; m <= RBATCH_COMPENSATED; m++) {
+        t0 = now_seconds();
+        batch_series(soa, count, n, count, (RBatchPrecision)m, out);
+        snprintf(label, sizeof(label), "batch_series, %s", modes[m]);
+        report(label, now_seconds() - t0, count);
+        t0 = now_seconds();
+        batch_parallel(soa, count, n, count, (RBatchPrecision)m, out);
+        snprintf(label, sizeof(label), "batch_parallel, %s", modes[m]);
+        report(label, now_seconds() - t0, count);
+        t0 = now_seconds();
+        batch_mixed(soa, count, n, group_sizes, connection_types, 2, count, (RBatchPrecision)m, out);
+        snprintf(label, sizeof(label), "batch_mixed, %s", modes[m]);
+        report(label, now_seconds() - t0, count);
+    }
+
+    // Accuracy: 64 resistors log-uniform over 10 mohm .. 10 Mohm
+    const int rows = 64;
+    const size_t configs = 4096;
+    float *wide = malloc(sizeof(float) * rows * configs);
+    double *scalar = malloc(sizeof(double) * configs);
+    float *one = malloc(sizeof(float) * rows);
+    if (wide && scalar && one) {
+        for (size_t j = 0; j < rows * configs; j++) wide[j] = (float)pow(10, uniform(-2, 7));
+        printf("  max relative error, %d resistors from 0.01 to 1e7 ohms:\n", rows);
+        for (int parallel = 0; parallel <= 1; parallel++) {
+            for (size_t k = 0; k < configs; k++) {
+                for (int i = 0; i < rows; i++) one[i] = wide[(size_t)i * configs + k];
+                scalar[k] = parallel ? calc_parallel(one, rows) : calc_series(one, rows);
+            }
+            printf("    %-8s scalar %.2e", parallel ? "parallel" : "series",
+                   batch_error(wide, configs, rows, configs, parallel, scalar));
+            for (int m = RBATCH_FLOAT; m <= RBATCH_COMPENSATED; m++) {
+                if (parallel) batch_parallel(wide, configs, rows, configs, (RBatchPrecision)m, out);
+                else batch_series(wide, configs, rows, configs, (RBatchPrecision)m, out);
+                printf("  %s %.2e", modes[m], batch_error(wide, configs, rows, configs, parallel, out));
+            }
+            printf("\n");
+        }
+    }
+    free(wide);
+    free(scalar);
+    free(one);
+    free(soa);
+    free(aos);
+    free(out);
+}
+
+// Random series/parallel tree of the given number of resistors, alternating the operator by level
+static void random_tree(DiagramBuffer *text, int leaves, int parallel, int *next)
+{
+    char name[16];
+    if (leaves == 1) {
+        int len = snprintf(name, sizeof(name), "R%d", ++*next);
+        diagram_append(text, name, (size_t)len);
+        return;
+    }
+    int parts = 2 + rand() % 3;
+    parts = parts > leaves ? leaves : parts;
+    diagram_append(text, "(", 1);
+    for (int p = 0; p < parts; p++) {
+        int share = leaves / (parts - p);
+        if (p > 0) diagram_append(text, parallel ? "||" : "+", parallel ? 2 : 1);
+        random_tree(text, share, !parallel, next);
+        leaves -= share;
+    }
+    diagram_append(text, ")", 1);
+}
+
+// Layout and rendering of diagrams with hundreds to thousands of resistors
+static void bench_diagram(void)
+{
+    static const int sizes[] = { 5, 200, 1000, 5000 };
+    printf("diagram (layout + render, items are resistors)\n");
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        DiagramBuffer text, out;
+        RExpr expr;
+        char error[128];
+        int next = 0;
+        diagram_init(&text);
+        diagram_init(&out);
+        random_tree(&text, sizes[s], 0, &next);
+        if (rexpr_compile(text.data, &expr, error, sizeof(error)) != 0) {
+            printf("  %d resistors: %s\n", sizes[s], error);
+            diagram_free(&text);
+            continue;
+        }
+        int reps = 20000 / sizes[s] + 1;
+        double t0 = now_seconds();
+        for (int r = 0; r < reps; r++) {
+            out.length = 0;
+            diagram_render(&expr, &out);
+        }
+        double seconds = now_seconds() - t0;
+        char label[96];
+        snprintf(label, sizeof(label), "%d resistors, %zu bytes", sizes[s], out.length);
+        report(label, seconds, (double)reps * sizes[s]);
+
+        int fd = open("/dev/null", O_WRONLY);
+        if (fd >= 0) {
+            t0 = now_seconds();
+            diagram_export(fd, &expr, NULL, DIAGRAM_SVG);
+            snprintf(label, sizeof(label), "  SVG export, %d resistors", sizes[s]);
+            report(label, now_seconds() - t0, sizes[s]);
+            close(fd);
+        }
+        rexpr_free(&expr);
+        diagram_free(&text);
+        diagram_free(&out);
+    }
+}
+
+#define CONTEXT_CIRCUITS 100000
+#define CONTEXT_CHUNKS 64
+
+typedef struct {
+    int group_sizes[CONTEXT_CIRCUITS][2];
+    int connection_types[CONTEXT_CIRCUITS][2];
+    float values[CONTEXT_CIRCUITS][MAX_RESISTORS];
+    double resistance[CONTEXT_CHUNKS];    // per-chunk sums, so no locking
+    size_t bytes[CONTEXT_CHUNKS];
+} ContextJob;
+
+// Each chunk evaluates and draws its circuits with its own ResistorContext
+static void context_chunk(int begin, int end, void *arg)
+{
+    ContextJob *job = arg;
+    for (int chunk = begin; chunk < end; chunk++) {
+        ResistorContext ctx;
+        resistor_context_init(&ctx);
+        int first = (int)((long)CONTEXT_CIRCUITS * chunk / CONTEXT_CHUNKS);
+        int last = (int)((long)CONTEXT_CIRCUITS * (chunk + 1) / CONTEXT_CHUNKS);
+        job->resistance[chunk] = 0;
+        job->bytes[chunk] = 0;
+        for (int i = first; i < last; i++) {
+            int n = job->group_sizes[i][0] + job->group_sizes[i][1];
+            job->resistance[chunk] += calc_mixed_resistance(job->values[i], n, job->group_sizes[i],
+                                                            job->connection_types[i], 2);
+            if (save_mixed_diagram(&ctx, job->group_sizes[i], job->connection_types[i], 2) == 0) {
+                job->bytes[chunk] += ctx.diagram.length;
+            }
+        }
+        resistor_context_free(&ctx);
+    }
+}
+
+// Many small mixed circuits evaluated and drawn on one thread, then across the pool
+static void bench_resistor_context(void)
+{
+    ContextJob *job = malloc(sizeof(ContextJob));
+    if (!job) {
+        return;
+    }
+    for (int i = 0; i < CONTEXT_CIRCUITS; i++) {
+        job->group_sizes[i][0] = 1 + rand() % 2;
+        job->group_sizes[i][1] = 2 + rand() % 2;
+        job->connection_types[i][0] = 1 + rand() % 2;
+        job->connection_types[i][1] = 2;
+        for (int k = 0; k < MAX_RESISTORS; k++) job->values[i][k] = (float)uniform(10, 10000);
+    }
+
+    printf("resistor_context (%d mixed circuits, evaluated and drawn)\n", CONTEXT_CIRCUITS);
+    double totals[2];
+    size_t bytes[2];
+    for (int pass = 0; pass < 2; pass++) {
+        double t0 = now_seconds();
+        if (pass == 0) {
+            context_chunk(0, CONTEXT_CHUNKS, job);
+        } else {
+            parallel_for(0, CONTEXT_CHUNKS, 1, context_chunk, job);
+        }
+        double seconds = now_seconds() - t0;
+        totals[pass] = 0;
+        bytes[pass] = 0;
+        for (int c = 0; c < CONTEXT_CHUNKS; c++) {
+            totals[pass] += job->resistance[c];
+            bytes[pass] += job->bytes[c];
+        }
+        char label[64];
+        snprintf(label, sizeof(label), pass == 0 ? "one thread" : "thread pool, %d threads", threadpool_size());
+        report(label, seconds, CONTEXT_CIRCUITS);
+    }
+    printf("    results %s (%zu diagram bytes)\n",
+           totals[0] == totals[1] && bytes[0] == bytes[1] ? "match" : "DIFFER", bytes[1]);
+    free(job);
+}
+
+// One value changed at a time: full re-evaluation against the incremental engines
+static void bench_incremental(void)
+{
+    const int updates = 1000000;
+    printf("incremental (one resistor changed per step)\n");
+
+    // Mixed circuit as in the menu, and a 1000-resistor expression
+    for (int shape = 0; shape < 2; shape++) {
+        RExpr expr;
+        DiagramBuffer text;
+        char error[128];
+        int next = 0;
+        diagram_init(&text);
+        if (shape == 0) {
+            int group_sizes[] = { 2, 3 }, connection_types[] = { 1, 2 };
+            rexpr_from_groups(group_sizes, connection_types, 2, &expr);
+        } else {
+            random_tree(&text, 1000, 0, &next);
+            if (rexpr_compile(text.data, &expr, error, sizeof(error)) != 0) {
+                printf("  %s\n", error);
+                diagram_free(&text);
+                continue;
+            }
+        }
+        int n = expr.value_count;
+        float *values = malloc(sizeof(float) * n);
+        int *which = malloc(sizeof(int) * updates);
+        float *ohms = malloc(sizeof(float) * updates);
+        RIncremental inc;
+        if (values) {
+            for (int i = 0; i < n; i++) values[i] = (float)uniform(10, 10000);
+        }
+        if (!values || !which || !ohms || rinc_init(&inc, &expr, values) != 0) {
+            free(values); free(which); free(ohms);
+            rexpr_free(&expr);
+            diagram_free(&text);
+            continue;
+        }
+        for (int u = 0; u < updates; u++) {
+            which[u] = rand() % n;
+            ohms[u] = (float)uniform(10, 10000);
+        }
+
+        int full_updates = shape == 0 ? updates : updates / 100;
+        volatile double sink = 0;
+        double t0 = now_seconds();
+        for (int u = 0; u < full_updates; u++) {
+            values[which[u]] = ohms[u];
+            sink += rexpr_eval(&expr, values);
+        }
+        char label[64];
+        snprintf(label, sizeof(label), "%d resistors, full rexpr_eval", n);
+        report(label, now_seconds() - t0, full_updates);
+
+        t0 = now_seconds();
+        for (int u = 0; u < updates; u++) {
+            sink += rinc_update(&inc, which[u], ohms[u]);
+        }
+        snprintf(label, sizeof(label), "%d resistors, rinc_update", n);
+        report(label, now_seconds() - t0, updates);
+        for (int u = full_updates; u < updates; u++) values[which[u]] = ohms[u];
+        printf("    totals %.9g / %.9g\n", rinc_total(&inc), rexpr_eval(&expr, values));
+        (void)sink;
+
+        rinc_free(&inc);
+        free(values);
+        free(which);
+        free(ohms);
+        rexpr_free(&expr);
+        diagram_free(&text);
+    }
+
+    // Nodal solver: tune 8 resistors of a mesh in turn
+    const int w = 200, steps = 100000;
+    ResistorNetwork net;
+    network_init(&net);
+    for (int i = 0; i < w; i++) {
+        for (int j = 0; j < w; j++) {
+            int id = i * w + j;
+            if (j + 1 < w) network_add_resistor(&net, id, id + 1, uniform(10.0, 1000.0));
+            if (i + 1 < w) network_add_resistor(&net, id, id + w, uniform(10.0, 1000.0));
+        }
+    }
+    int tuned[8];
+    for (int k = 0; k < 8; k++) tuned[k] = rand() % net.count;
+
+    double t0 = now_seconds();
+    double full = 0;
+    for (int s = 0; s < 4; s++) {
+        net.conductance[tuned[s % 8]] = 1.0 / uniform(10.0, 1000.0);
+        full = network_equivalent_resistance(&net, 0, w * w - 1);
+    }
+    char label[64];
+    snprintf(label, sizeof(label), "%dx%d mesh, full solve", w, w);
+    report(label, (now_seconds() - t0) / 4, 1);
+
+    NetworkIncremental inc;
+    t0 = now_seconds();
+    network_inc_init(&inc, &net, 0, w * w - 1);
+    report("  network_inc_init", now_seconds() - t0, 1);
+    t0 = now_seconds();
+    for (int s = 0; s < 8; s++) {
+        network_inc_update(&inc, tuned[s], uniform(10.0, 1000.0));
+    }
+    report("  first change of each (one solve)", (now_seconds() - t0) / 8, 1);
+    t0 = now_seconds();
+    for (int s = 8; s < steps; s++) {
+        network_inc_update(&inc, tuned[s % 8], uniform(10.0, 1000.0));
+    }
+    snprintf(label, sizeof(label), "  %d further updates", steps - 8);
+    report(label, now_seconds() - t0, steps - 8);
+    full = network_equivalent_resistance(&net, 0, w * w - 1);
+    printf("    resistance %.12g, full solve %.12g (%d tracked, %ld full solves)\n",
+           network_inc_resistance(&inc), full, inc.rank, inc.rebases);
+    network_inc_free(&inc);
+    network_free(&net);
+}
+
+// max |A X - B| / (|A| |X|) over all entries, from one GEMM
+static double solve_error(const DMatrix *A, const DMatrix *X, const DMatrix *B)
+{
+    DMatrix R;
+    dmatrix_copy(&R, B);
+    dgemm(A->rows, X->cols, A->cols, 1.0, A->data, A->stride, X->data, X->stride, -1.0, R.data, R.stride);
+    double worst = 0, a_max = 0, x_max = 0;
+    for (int i = 0; i < R.rows; i++) {
+        for (int j = 0; j < R.cols; j++) worst = fmax(worst, fabs(DMAT(&R, i, j)));
+    }
+    for (int i = 0; i < A->rows; i++) {
+        for (int j = 0; j < A->cols; j++) a_max = fmax(a_max, fabs(DMAT(A, i, j)));
+    }
+    for (int i = 0; i < X->rows; i++) {
+        for (int j = 0; j < X->cols; j++) x_max = fmax(x_max, fabs(DMAT(X, i, j)));
+    }
+    dmatrix_free(&R);
+    return worst / (a_max * x_max * A->cols);
+}
+
+static void random_dmatrix(DMatrix *m, int rows, int cols)
+{
+    dmatrix_create(m, rows, cols);
+    for (int i = 0; i < rows; i++) {
+        for (int j = 0; j < cols; j++) DMAT(m, i, j) = uniform(-1.0, 1.0);
+    }
+}
+
+// Dense solve, inverse and least squares; items are floating-point operations
+static void bench_linalg(void)
+{
+    static const int rhs_counts[] = { 1, 16, 256 };
+    const int n = 2000;
+    printf("linalg (dense solvers, %s kernel, %d threads)\n", gemm_kernel_name(), threadpool_size());
+
+    DMatrix A, B, X;
+    random_dmatrix(&A, n, n);
+    for (size_t r = 0; r < sizeof(rhs_counts) / sizeof(rhs_counts[0]); r++) {
+        int nrhs = rhs_counts[r];
+        random_dmatrix(&B, n, nrhs);
+        dmatrix_create(&X, n, nrhs);
+        double t0 = now_seconds();
+        int status = dmatrix_solve(&A, &B, &X);
+        double elapsed = now_seconds() - t0;
+        char label[64];
+        snprintf(label, sizeof(label), "solve %dx%d, %d rhs", n, n, nrhs);
+        report(label, elapsed, 2.0 / 3.0 * n * n * n + 2.0 * n * n * nrhs);
+        printf("    status %d, scaled residual %.2e\n", status, solve_error(&A, &X, &B));
+        dmatrix_free(&B);
+        dmatrix_free(&X);
+    }
+
+    // Factor once, then solve one right-hand side at a time
+    LUDecomp lu;
+    lu_decompose(&A, &lu);
+    random_dmatrix(&B, n, 1);
+    double t0 = now_seconds();
+    for (int k = 0; k < 16; k++) lu_solve(&lu, &B);
+    report("lu_solve reusing factors, 1 rhs", (now_seconds() - t0) / 16, 2.0 * n * n);
+    lu_free(&lu);
+    dmatrix_free(&B);
+    dmatrix_free(&A);
+
+    const int ni = 1000;
+    random_dmatrix(&A, ni, ni);
+    dmatrix_create(&X, ni, ni);
+    t0 = now_seconds();
+    int status = dmatrix_inverse(&A, &X);
+    char label[64];
+    snprintf(label, sizeof(label), "inverse %dx%d", ni, ni);
+    report(label, now_seconds() - t0, 2.0 * ni * ni * ni);
+    DMatrix I;
+    dmatrix_create(&I, ni, ni);
+    dmatrix_fill(&I, 0.0);
+    for (int i = 0; i < ni; i++) DMAT(&I, i, i) = 1.0;
+    printf("    status %d, scaled residual %.2e\n", status, solve_error(&A, &X, &I));
+    dmatrix_free(&I);
+    dmatrix_free(&X);
+    dmatrix_free(&A);
+
+    const int m = 4000, nc = 1000, nrhs = 4;
+    random_dmatrix(&A, m, nc);
+    random_dmatrix(&B, m, nrhs);
+    dmatrix_create(&X, nc, nrhs);
+    double residual;
+    t0 = now_seconds();
+    status = dmatrix_least_squares(&A, &B, &X, &residual);
+    snprintf(label, sizeof(label), "least squares %dx%d, %d rhs", m, nc, nrhs);
+    report(label, now_seconds() - t0, 2.0 * nc * nc * (m - nc / 3.0));
+
+    // At the optimum the residual is orthogonal to the columns of A: check A^T (A X - B) ~ 0
+    DMatrix R, At, G;
+    dmatrix_copy(&R, &B);
+    dgemm(m, nrhs, nc, 1.0, A.data, A.stride, X.data, X.stride, -1.0, R.data, R.stride);
+    double r2 = 0;
+    for (int i = 0; i < m; i++) {
+        for (int j = 0; j < nrhs; j++) r2 += DMAT(&R, i, j) * DMAT(&R, i, j);
+    }
+    dmatrix_create(&At, nc, m);
+    for (int i = 0; i < m; i++) {
+        for (int j = 0; j < nc; j++) DMAT(&At, j, i) = DMAT(&A, i, j);
+    }
+    dmatrix_create(&G, nc, nrhs);
+    dmatrix_multiply(&At, &R, &G);
+    double ortho = 0;
+    for (int i = 0; i < nc; i++) {
+        for (int j = 0; j < nrhs; j++) ortho = fmax(ortho, fabs(DMAT(&G, i, j)));
+    }
+    printf("    status %d, residual %.6g (direct %.6g), max |A^T r| %.2e\n",
+           status, residual, sqrt(r2), ortho);
+    dmatrix_free(&R);
+    dmatrix_free(&At);
+    dmatrix_free(&G);
+    dmatrix_free(&X);
+    dmatrix_free(&B);
+    dmatrix_free(&A);
+}
+
+// Conductance matrix of a w x w resistor mesh with one corner grounded, nodes numbered at
+// random so the loader and the ordering see no structure; written as a Matrix Market file
+static int write_mesh_matrix(const char *path, int w)
+{
+    int n = w * w;
+    int *label = malloc(sizeof(int) * n);
+    for (int i = 0; i < n; i++) label[i] = i;
+    for (int i = n - 1; i > 0; i--) {
+        int j = rand() % (i + 1), tmp = label[i];
+        label[i] = label[j];
+        label[j] = tmp;
+    }
+    double *diag = calloc(n, sizeof(double));
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        free(label);
+        free(diag);
+        return -1;
+    }
+    fprintf(f, "%%%%MatrixMarket matrix coordinate real symmetric\n%% %dx%d resistor mesh\n", w, w);
+    fprintf(f, "%d %d %d\n", n, n, n + 2 * w * (w - 1));
+    for (int i = 0; i < w; i++) {
+        for (int j = 0; j < w; j++) {
+            int id = i * w + j;
+            for (int d = 0; d < 2; d++) {
+                int other = d == 0 ? (j + 1 < w ? id + 1 : -1) : (i + 1 < w ? id + w : -1);
+                if (other < 0) continue;
+                double g = 1.0 / uniform(10.0, 1000.0);
+                diag[id] += g;
+                diag[other] += g;
+                int a = label[id], b = label[other];
+                fprintf(f, "%d %d %.17g\n", (a > b ? a : b) + 1, (a > b ? b : a) + 1, -g);
+            }
+        }
+    }
+    diag[0] += 1.0;     // ground node 0 through 1 ohm so the matrix is nonsingular
+    for (int i = 0; i < n; i++) fprintf(f, "%d %d %.17g\n", label[i] + 1, label[i] + 1, diag[i]);
+    fclose(f);
+    free(label);
+    free(diag);
+    return 0;
+}
+
+// Sparse loader, products and the RCM band solve on mesh conductance matrices
+static void bench_sparse(void)
+{
+    static const int sides[] = { 60, 150 };
+    printf("sparse (CSR/CSC, %d threads)\n", threadpool_size());
+
+    for (size_t s = 0; s < sizeof(sides) / sizeof(sides[0]); s++) {
+        int w = sides[s], n = w * w;
+        char path[] = "/tmp/bench_sparse_XXXXXX";
+        int fd = mkstemp(path);
+        if (fd < 0 || (close(fd), write_mesh_matrix(path, w)) != 0) {
+            printf("sparse: cannot create temporary file\n");
+            return;
+        }
+
+        SparseMatrix S, T, P;
+        char error[160], label[64];
+        double t0 = now_seconds();
+        int status = sparse_load(path, &S, error, sizeof(error));
+        unlink(path);
+        if (status != 0) {
+            printf("    %s\n", error);
+            return;
+        }
+        snprintf(label, sizeof(label), "sparse_load %dx%d mesh, %d nnz", w, w, S.nnz);
+        report(label, now_seconds() - t0, S.nnz);
+
+        double *x = malloc(sizeof(double) * n), *y = malloc(sizeof(double) * n);
+        for (int i = 0; i < n; i++) x[i] = uniform(-1.0, 1.0);
+        const int reps = 200;
+        t0 = now_seconds();
+        for (int r = 0; r < reps; r++) sparse_matvec(&S, x, y);
+        report("sparse_matvec (CSR)", (now_seconds() - t0) / reps, S.nnz);
+        sparse_convert(&S, SPARSE_CSC, &T);
+        t0 = now_seconds();
+        for (int r = 0; r < reps; r++) sparse_matvec(&T, x, y);
+        report("sparse_matvec (CSC)", (now_seconds() - t0) / reps, S.nnz);
+        sparse_free(&T);
+
+        t0 = now_seconds();
+        sparse_multiply(&S, &S, &P);
+        report("sparse_multiply A*A", now_seconds() - t0, P.nnz);
+        printf("    A*A has %d nonzeros\n", P.nnz);
+        sparse_free(&P);
+
+        int lower, upper;
+        sparse_bandwidth(&S, NULL, &lower, &upper);
+        SparseLU lu;
+        t0 = now_seconds();
+        status = sparse_lu_factor(&S, &lu);
+        double factor = now_seconds() - t0;
+        if (status != 0) {
+            printf("    band factorisation does not fit in memory\n");
+        } else {
+            report("RCM + band LU", factor, n);
+            sparse_matvec(&S, x, y);
+            t0 = now_seconds();
+            sparse_lu_solve(&lu, y);
+            report("band solve, 1 rhs", now_seconds() - t0, n);
+            double err = 0;
+            for (int i = 0; i < n; i++) err = fmax(err, fabs(y[i] - x[i]));
+            // The determinant itself underflows for large meshes, so compare logarithms
+            double log_det = 0;
+            for (int i = 0; i < n; i++) log_det += log10(fabs(lu.band[(size_t)i * lu.width + lu.kl]));
+            printf("    bandwidth %d -> %d (RCM), log10|det| %.4f, max error %.2e\n", lower, lu.kl,
+                   log_det, err);
+            sparse_lu_free(&lu);
+        }
+
+        // Dense LU of the same matrix, where it still fits comfortably
+        if (n <= 4000) {
+            DMatrix D;
+            sparse_to_dense(&S, &D);
+            LUDecomp dense;
+            t0 = now_seconds();
+            lu_decompose(&D, &dense);
+            report("dense LU (same matrix)", now_seconds() - t0, n);
+            double log_det = 0;
+            for (int i = 0; i < n; i++) log_det += log10(fabs(DMAT(&dense.factors, i, i)));
+            printf("    log10|det| %.4f\n", log_det);
+            lu_free(&dense);
+            dmatrix_free(&D);
+        }
+        free(x);
+        free(y);
+        sparse_free(&S);
+    }
+}
+
+// Elementwise chains: one fused pass against pairwise dmatrix_add / scaling with temporaries
+static void bench_mexpr(void)
+{
+    const int n = 2000, reps = 5;
+    const double elements = (double)n * n;
+    printf("mexpr (%dx%d elementwise chains, %d threads)\n", n, n, threadpool_size());
+
+    DMatrix A, B, C, R, T;
+    random_dmatrix(&A, n, n);
+    random_dmatrix(&B, n, n);
+    random_dmatrix(&C, n, n);
+    dmatrix_create(&R, n, n);
+    const DMatrix *operands[] = { &A, &B, &C };
+    char error[160];
+    MExpr e;
+
+    double t0 = now_seconds();
+    for (int r = 0; r < reps; r++) {
+        dmatrix_create(&T, n, n);
+        dmatrix_add(&A, &B, &T);
+        dmatrix_add(&T, &C, &R);
+        dmatrix_free(&T);
+    }
+    report("A + B + C, pairwise with temporary", (now_seconds() - t0) / reps, elements);
+    double check = DMAT(&R, n - 1, n - 1);
+
+    mexpr_compile("A + B + C", operands, 3, &e, error, sizeof(error));
+    t0 = now_seconds();
+    for (int r = 0; r < reps; r++) mexpr_eval(&e, &R);
+    report("A + B + C, fused", (now_seconds() - t0) / reps, elements);
+    printf("    %d steps, results %s\n", e.length, DMAT(&R, n - 1, n - 1) == check ? "agree" : "DIFFER");
+
+    t0 = now_seconds();
+    for (int r = 0; r < reps; r++) {
+        dmatrix_copy(&T, &A);
+        for (int i = 0; i < n; i++) {
+            for (int j = 0; j < n; j++) DMAT(&T, i, j) *= 2.5;
+        }
+        dmatrix_add(&T, &B, &R);
+        dmatrix_free(&T);
+    }
+    report("2.5*A + B, scaled copy then add", (now_seconds() - t0) / reps, elements);
+    mexpr_compile("2.5*A + B", operands, 3, &e, error, sizeof(error));
+    t0 = now_seconds();
+    for (int r = 0; r < reps; r++) mexpr_eval(&e, &R);
+    report("2.5*A + B, fused", (now_seconds() - t0) / reps, elements);
+
+    mexpr_compile("(A - B) .* (A + C) / 2 + 1", operands, 3, &e, error, sizeof(error));
+    t0 = now_seconds();
+    for (int r = 0; r < reps; r++) mexpr_eval(&e, &R);
+    report("(A - B) .* (A + C) / 2 + 1, fused", (now_seconds() - t0) / reps, elements);
+
+    t0 = now_seconds();
+    for (int r = 0; r < reps; r++) dmatrix_axpby(0.5, &B, 1.0, &A);
+    report("A = A + 0.5*B in place (axpby)", (now_seconds() - t0) / reps, elements);
+
+    dmatrix_free(&A);
+    dmatrix_free(&B);
+    dmatrix_free(&C);
+    dmatrix_free(&R);
+}
+
+// Classic blocked dgemm against one Strassen-Winograd level over the blocked kernel, to find
+// the size where the split starts paying off on this host; items are classic flops (2n^3)
+static void bench_strassen(void)
+{
+    static const int sizes[] = { 256, 512, 768, 1024, 1536, 2048, 3072 };
+    const int count = sizeof(sizes) / sizeof(sizes[0]);
+    int saved = strassen_crossover(), crossover = 0;
+    char label[64];
+    printf("strassen (%s kernel, %d threads, crossover now %d)\n", gemm_kernel_name(), threadpool_size(), saved);
+
+    for (int s = 0; s < count; s++) {
+        int n = sizes[s], reps = n <= 1024 ? 3 : 1;
+        double flops = 2.0 * n * n * n, classic = 1e30, split = 1e30;
+        DMatrix A, B, C;
+        random_dmatrix(&A, n, n);
+        random_dmatrix(&B, n, n);
+        dmatrix_create(&C, n, n);
+
+        // Best of reps for each, so one slow run does not decide the crossover
+        for (int r = 0; r < reps; r++) {
+            double t0 = now_seconds();
+            dgemm(n, n, n, 1.0, A.data, A.stride, B.data, B.stride, 0.0, C.data, C.stride);
+            double t = now_seconds() - t0;
+            if (t < classic) classic = t;
+        }
+        strassen_set_crossover(n - 1);      // exactly one level
+        for (int r = 0; r < reps; r++) {
+            double t0 = now_seconds();
+            dgemm_strassen(n, n, n, A.data, A.stride, B.data, B.stride, C.data, C.stride);
+            double t = now_seconds() - t0;
+            if (t < split) split = t;
+        }
+        snprintf(label, sizeof(label), "n = %d, classic", n);
+        report(label, classic, flops);
+        snprintf(label, sizeof(label), "n = %d, one Strassen level", n);
+        report(label, split, flops);
+        if (split >= classic) {
+            crossover = n;                  // classic still wins here: keep it at this size
+        }
+        dmatrix_free(&A);
+        dmatrix_free(&B);
+        dmatrix_free(&C);
+    }
+    if (crossover == sizes[count - 1]) {
+        printf("    classic product won at every size; the crossover is above %d\n", crossover);
+    } else {
+        int suggested = crossover > 0 ? crossover : sizes[0];
+        printf("    suggested crossover: %d (LAC_STRASSEN_CROSSOVER=%d)\n", suggested, suggested);
+    }
+
+    // Full recursion at the largest size with the measured crossover, checked against dgemm
+    int n = sizes[count - 1];
+    strassen_set_crossover(crossover > 0 && crossover < n ? crossover : n / 4);
+    DMatrix A, B, C;
+    random_dmatrix(&A, n, n);
+    random_dmatrix(&B, n, n);
+    dmatrix_create(&C, n, n);
+    double t0 = now_seconds();
+    dgemm_strassen(n, n, n, A.data, A.stride, B.data, B.stride, C.data, C.stride);
+    snprintf(label, sizeof(label), "n = %d, %d levels from %d", n, strassen_levels(n, n, n), strassen_crossover());
+    report(label, now_seconds() - t0, 2.0 * n * n * n);
+    double error, bound;
+    int within = strassen_check(&A, &B, &C, &error, &bound);
+    printf("    max |C - AB| = %.3g, bound %.3g: %s\n", error, bound, within == 0 ? "within bound" : "EXCEEDS BOUND");
+    dmatrix_free(&A);
+    dmatrix_free(&B);
+    dmatrix_free(&C);
+    strassen_set_crossover(saved);
+}
+
+// Millions of small determinants and products: one call per Matrix struct against the
+// interleaved batches (one matrix per SIMD lane); items are matrices
+static void bench_mbatch(void)
+{
+    const size_t count = 1 << 18, checked = 20000;
+    printf("mbatch (%zu matrices per size, %s kernels, %d threads)\n", count, mbatch_kernel_name(), threadpool_size());
+    printf("  per-matrix calls run on the first %zu\n", checked);
+
+    Matrix *mats = malloc(sizeof(Matrix) * checked);
+    double *det = malloc(sizeof(double) * count);
+    char label[64];
+    for (int n = 2; n <= MBATCH_MAX_SIZE; n++) {
+        double *a = malloc(sizeof(double) * n * n * count);
+        double *b = malloc(sizeof(double) * n * n * count);
+        double *c = malloc(sizeof(double) * n * n * count);
+        for (size_t e = 0; e < (size_t)n * n * count; e++) {
+            a[e] = uniform(-1.0, 1.0);
+            b[e] = uniform(-1.0, 1.0);
+        }
+        memset(c, 0, sizeof(double) * n * n * count);      // fault the pages in outside the timing
+        memset(det, 0, sizeof(double) * count);
+        mbatch_unpack(n, a, count, checked, mats);
+
+        volatile double sink = 0;
+        double t0 = now_seconds();
+        for (size_t k = 0; k < checked; k++) sink += calculate_determinant(&mats[k]);
+        snprintf(label, sizeof(label), "%dx%d det, Laplace per matrix", n, n);
+        report(label, now_seconds() - t0, checked);
+
+        t0 = now_seconds();
+        for (size_t k = 0; k < checked; k++) sink += determinant_lu(&mats[k]);
+        snprintf(label, sizeof(label), "%dx%d det, LU per matrix", n, n);
+        report(label, now_seconds() - t0, checked);
+
+        t0 = now_seconds();
+        mbatch_determinant(n, a, count, count, det);
+        snprintf(label, sizeof(label), "%dx%d det, batched", n, n);
+        report(label, now_seconds() - t0, count);
+
+        double worst = 0;
+        for (size_t k = 0; k < checked; k++) {
+            double ref = determinant_lu(&mats[k]);
+            double diff = fabs(det[k] - ref) / (fabs(ref) > 1e-3 ? fabs(ref) : 1e-3);
+            if (diff > worst) worst = diff;
+        }
+
+        // Per-matrix product on the structs, as a caller without the batch API would write it
+        t0 = now_seconds();
+        for (size_t k = 0; k + 1 < checked; k++) {
+            Matrix p = { .rows = n, .cols = n };
+            for (int i = 0; i < n; i++) {
+                for (int j = 0; j < n; j++) {
+                    for (int q = 0; q < n; q++) p.data[i][j] += mats[k].data[i][q] * mats[k + 1].data[q][j];
+                }
+            }
+            sink += p.data[n - 1][n - 1];
+        }
+        snprintf(label, sizeof(label), "%dx%d product, per matrix", n, n);
+        report(label, now_seconds() - t0, checked - 1);
+
+        t0 = now_seconds();
+        mbatch_multiply(n, a, b, count, count, c);
+        snprintf(label, sizeof(label), "%dx%d product, batched", n, n);
+        report(label, now_seconds() - t0, count);
+        printf("    largest relative det difference from LU %.2g\n", worst);
+        (void)sink;
+
+        free(a);
+        free(b);
+        free(c);
+    }
+    free(mats);
+    free(det);
+}
+
+typedef struct {
+    const char *name;
+    void (*run)(void);
+} Benchmark;
+
+static const Benchmark benchmarks[] = {
+    { "units", bench_units },
+    { "units_stream", bench_units_stream },
+    { "network", bench_network },
+    { "netlist", bench_netlist },
+    { "rexpr", bench_rexpr },
+    { "tolerance", bench_tolerance },
+    { "eseries", bench_eseries },
+    { "resistor_batch", bench_resistor_batch },
+    { "diagram", bench_diagram },
+    { "resistor_context", bench_resistor_context },
+    { "incremental", bench_incremental },
+    { "linalg", bench_linalg },
+    { "sparse", bench_sparse },
+    { "mexpr", bench_mexpr },
+    { "strassen", bench_strassen },
+    { "mbatch", bench_mbatch },
+};
+
+int main(int argc, char *argv[])
+{
+    const char *which = argc > 1 ? argv[1] : "all";
+    int ran = 0;
+
+    srand(12345);
+    for (size_t i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); i++) {
+        if (strcmp(which, "all") == 0 || strcmp(which, benchmarks[i].name) == 0) {
+            benchmarks[i].run();
+            ran = 1;
+        }
+    }
+
+    if (!ran) {
+        fprintf(stderr, "Usage: %s [all", argv[0]);
+        for (size_t i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); i++) {
+            fprintf(stderr, "|%s", benchmarks[i].name);
+        }
+        fprintf(stderr, "]\n");
+        return 2;
+    }
+    return 0;
+}
@@ -0,0 +1,678 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <unistd.h>
+#include "funcs.h"
+
+// Text layout of series/parallel circuits.
+// The circuit is taken as compiled expression bytecode (see rexpr.c), turned into a tree, and
+// every subtree is laid out as a rectangle of character cells with a "rail" row where the wire
+// enters on the left and leaves on the right:
+//
+//   resistor    /\/\/\                        1 row, rail 0
+//   series      A──B──C                       children side by side, rails lined up
+//   parallel    ┌──A──────┐                   children stacked with a gap row, padded with
+//               │         │                   wire to the widest, joined by a bus each side;
+//               ●──B──────●                   the rail is in the middle of the bus
+//               │         │
+//               └──C──────┘
+//
+// Sizes are computed bottom-up and positions top-down, both in one pass over the nodes. The
+// drawing itself goes through a small set of primitives (DiagramSink): the text renderer
+// writes them into a cell grid that is printed with a single write, the SVG exporter turns
+// each one into an element and streams it out as soon as it is placed.
+
+#define RESISTOR_GLYPH "/\\/\\/\\"
+#define RESISTOR_WIDTH 6
+#define WIRE_WIDTH 2
+
+#define EXPORT_FLUSH 65536      // exporters write out whenever this much is pending
+
+// SVG geometry: one layout cell is SVG_CELL_W x SVG_CELL_H pixels
+#define SVG_CELL_W 8
+#define SVG_CELL_H 16
+#define SVG_MARGIN 16
+#define SVG_NODE_PITCH 96       // netlist export: distance between node rails
+#define SVG_ROW_PITCH 28        // netlist export: distance between resistors
+
+// Cell codes below 32 stand for box-drawing characters; anything else is the ASCII byte itself
+enum { CELL_SPACE = ' ', CELL_WIRE = 1, CELL_VERT, CELL_NODE, CELL_TOP_LEFT, CELL_TEE_LEFT,
+       CELL_BOTTOM_LEFT, CELL_TOP_RIGHT, CELL_TEE_RIGHT, CELL_BOTTOM_RIGHT };
+
+static const char *const cell_utf8[] = {
+    "", "─", "│", "●", "┌", "├", "└", "┐", "┤", "┘"
+};
+
+typedef struct {
+    int op;                 // REXPR_*
+    int arg;                // value or constant index for leaves
+    int first_child;        // into children[]
+    int child_count;
+    int width;
+    int height;
+    int rail;
+    int x;
+    int y;
+} LayoutNode;
+
+typedef struct {
+    LayoutNode *nodes;
+    int *children;
+    int count;
+    int root;
+    int width;              // whole picture, lead-in and lead-out wires included
+    int height;
+} Layout;
+
+// Drawing primitives, in cell coordinates. A bus is the vertical bar on one side of a
+// parallel block; taps are where its branches join it, node the junction on its rail.
+typedef struct DiagramSink DiagramSink;
+struct DiagramSink {
+    void (*resistor)(DiagramSink *sink, int x, int y, const LayoutNode *leaf);
+    void (*wire)(DiagramSink *sink, int x, int y, int len);
+    void (*bus)(DiagramSink *sink, int x, int top, int bottom, int right);
+    void (*tap)(DiagramSink *sink, int x, int y, int right);
+    void (*node)(DiagramSink *sink, int x, int y);
+};
+
+// Buffered output for the exporters: a DiagramBuffer flushed to fd every EXPORT_FLUSH bytes
+typedef struct {
+    DiagramBuffer buf;
+    int fd;
+    int failed;
+} Exporter;
+
+void diagram_init(DiagramBuffer *buf)
+{
+    buf->data = NULL;
+    buf->length = 0;
+    buf->capacity = 0;
+}
+
+void diagram_free(DiagramBuffer *buf)
+{
+    free(buf->data);
+    diagram_init(buf);
+}
+
+// Make room for extra more bytes (plus a terminating NUL); capacity doubles so appends are O(1)
+int diagram_reserve(DiagramBuffer *buf, size_t extra)
+{
+    size_t need = buf->length + extra + 1;
+    if (need <= buf->capacity) {
+        return 0;
+    }
+    size_t capacity = buf->capacity ? buf->capacity : 256;
+    while (capacity < need) capacity *= 2;
+    char *data = realloc(buf->data, capacity);
+    if (!data) {
+        return -1;
+    }
+    buf->data = data;
+    buf->capacity = capacity;
+    return 0;
+}
+
+int diagram_append(DiagramBuffer *buf, const char *text, size_t len)
+{
+    if (diagram_reserve(buf, len) != 0) {
+        return -1;
+    }
+    memcpy(buf->data + buf->length, text, len);
+    buf->length += len;
+    buf->data[buf->length] = '\0';
+    return 0;
+}
+
+// Write the whole buffer to fd, normally in one call (retried only on a partial write)
+int diagram_write(int fd, const DiagramBuffer *buf)
+{
+    size_t done = 0;
+    while (done < buf->length) {
+        ssize_t n = write(fd, buf->data + done, buf->length - done);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        done += (size_t)n;
+    }
+    return 0;
+}
+
+// ---- layout ----
+
+// Rebuild the tree from the postorder code: each operator owns the top arg nodes of the stack
+static int build_tree(const RExpr *expr, Layout *lay)
+{
+    memset(lay, 0, sizeof(*lay));
+    lay->nodes = malloc(sizeof(LayoutNode) * (expr->length > 0 ? expr->length : 1));
+    lay->children = malloc(sizeof(int) * (expr->length > 0 ? expr->length : 1));
+    int *stack = malloc(sizeof(int) * (expr->max_stack > 0 ? expr->max_stack : 1));
+    if (!lay->nodes || !lay->children || !stack) {
+        free(stack);
+        return -1;
+    }
+
+    int sp = 0, used = 0;
+    for (int i = 0; i < expr->length; i++) {
+        LayoutNode *node = &lay->nodes[i];
+        node->op = expr->code[i].op;
+        node->arg = expr->code[i].arg;
+        node->first_child = used;
+        node->child_count = 0;
+        if (node->op == REXPR_SERIES || node->op == REXPR_PARALLEL) {
+            int arg = expr->code[i].arg;
+            sp -= arg;
+            memcpy(lay->children + used, stack + sp, sizeof(int) * arg);
+            node->child_count = arg;
+            used += arg;
+        }
+        stack[sp++] = i;
+    }
+    lay->count = expr->length;
+    lay->root = expr->length - 1;
+    free(stack);
+    return 0;
+}
+
+static void free_layout(Layout *lay)
+{
+    free(lay->nodes);
+    free(lay->children);
+}
+
+// Children come before their parent in postorder, so one forward pass sizes every node
+static void measure(Layout *lay)
+{
+    for (int i = 0; i < lay->count; i++) {
+        LayoutNode *node = &lay->nodes[i];
+        const int *child = lay->children + node->first_child;
+
+        if (node->child_count == 0) {
+            node->width = RESISTOR_WIDTH;
+            node->height = 1;
+            node->rail = 0;
+        } else if (node->op == REXPR_SERIES) {
+            int above = 0, below = 0, width = 0;
+            for (int c = 0; c < node->child_count; c++) {
+                const LayoutNode *k = &lay->nodes[child[c]];
+                width += k->width + (c > 0 ? WIRE_WIDTH : 0);
+                above = k->rail > above ? k->rail : above;
+                below = k->height - k->rail > below ? k->height - k->rail : below;
+            }
+            node->width = width;
+            node->rail = above;
+            node->height = above + below;
+        } else {
+            int widest = 0, height = 0;
+            for (int c = 0; c < node->child_count; c++) {
+                const LayoutNode *k = &lay->nodes[child[c]];
+                widest = k->width > widest ? k->width : widest;
+                height += k->height + (c > 0 ? 1 : 0);
+            }
+            const LayoutNode *first = &lay->nodes[child[0]];
+            const LayoutNode *last = &lay->nodes[child[node->child_count - 1]];
+            node->width = widest + 2 * (1 + WIRE_WIDTH);
+            node->height = height;
+            node->rail = (first->rail + (height - last->height + last->rail)) / 2;
+        }
+    }
+
+    LayoutNode *root = &lay->nodes[lay->root];
+    lay->width = root->width + 2 * WIRE_WIDTH;
+    lay->height = root->height;
+    root->x = WIRE_WIDTH;
+    root->y = 0;
+}
+
+// Parents come after their children, so a backward pass places every node and draws it
+static void place_and_draw(Layout *lay, DiagramSink *sink)
+{
+    const LayoutNode *root = &lay->nodes[lay->root];
+    sink->wire(sink, 0, root->rail, WIRE_WIDTH);
+    sink->wire(sink, WIRE_WIDTH + root->width, root->rail, WIRE_WIDTH);
+
+    for (int i = lay->count - 1; i >= 0; i--) {
+        LayoutNode *node = &lay->nodes[i];
+        const int *child = lay->children + node->first_child;
+
+        if (node->child_count == 0) {
+            sink->resistor(sink, node->x, node->y, node);
+        } else if (node->op == REXPR_SERIES) {
+            int x = node->x;
+            for (int c = 0; c < node->child_count; c++) {
+                LayoutNode *k = &lay->nodes[child[c]];
+                if (c > 0) {
+                    sink->wire(sink, x, node->y + node->rail, WIRE_WIDTH);
+                    x += WIRE_WIDTH;
+                }
+                k->x = x;
+                k->y = node->y + node->rail - k->rail;
+                x += k->width;
+            }
+        } else {
+            int left = node->x, right = node->x + node->width - 1;
+            int y = node->y, first_rail = 0, last_rail = 0;
+            for (int c = 0; c < node->child_count; c++) {
+                LayoutNode *k = &lay->nodes[child[c]];
+                int rail = y + k->rail;
+                k->x = left + 1 + WIRE_WIDTH;
+                k->y = y;
+                sink->wire(sink, left + 1, rail, WIRE_WIDTH);
+                sink->wire(sink, k->x + k->width, rail, right - (k->x + k->width));
+                if (c == 0) first_rail = rail;
+                last_rail = rail;
+                y += k->height + 1;
+            }
+            sink->bus(sink, left, first_rail, last_rail, 0);
+            sink->bus(sink, right, first_rail, last_rail, 1);
+            y = node->y;
+            for (int c = 0; c < node->child_count; c++) {
+                const LayoutNode *k = &lay->nodes[child[c]];
+                sink->tap(sink, left, y + k->rail, 0);
+                sink->tap(sink, right, y + k->rail, 1);
+                y += k->height + 1;
+            }
+            sink->node(sink, left, node->y + node->rail);
+            sink->node(sink, right, node->y + node->rail);
+        }
+    }
+}
+
+// ---- text: a cell grid printed in one piece ----
+
+typedef struct {
+    DiagramSink base;
+    unsigned char *cells;   // width * height
+    int width;
+} TextSink;
+
+static inline void put(TextSink *t, int x, int y, unsigned char cell)
+{
+    t->cells[(size_t)y * t->width + x] = cell;
+}
+
+static inline unsigned char get(const TextSink *t, int x, int y)
+{
+    return t->cells[(size_t)y * t->width + x];
+}
+
+static void text_resistor(DiagramSink *sink, int x, int y, const LayoutNode *leaf)
+{
+    (void)leaf;
+    for (const char *p = RESISTOR_GLYPH; *p; p++, x++) put((TextSink *)sink, x, y, (unsigned char)*p);
+}
+
+static void text_wire(DiagramSink *sink, int x, int y, int len)
+{
+    for (int i = 0; i < len; i++) put((TextSink *)sink, x + i, y, CELL_WIRE);
+}
+
+static void text_bus(DiagramSink *sink, int x, int top, int bottom, int right)
+{
+    TextSink *t = (TextSink *)sink;
+    put(t, x, top, right ? CELL_TOP_RIGHT : CELL_TOP_LEFT);
+    for (int y = top + 1; y < bottom; y++) put(t, x, y, CELL_VERT);
+    put(t, x, bottom, right ? CELL_BOTTOM_RIGHT : CELL_BOTTOM_LEFT);
+}
+
+// Branches at the ends of the bus already meet it at a corner
+static void text_tap(DiagramSink *sink, int x, int y, int right)
+{
+    TextSink *t = (TextSink *)sink;
+    if (get(t, x, y) == CELL_VERT) {
+        put(t, x, y, right ? CELL_TEE_RIGHT : CELL_TEE_LEFT);
+    }
+}
+
+static void text_node(DiagramSink *sink, int x, int y)
+{
+    put((TextSink *)sink, x, y, CELL_NODE);
+}
+
+// Lay out expr and append it to out, one line per row with trailing blanks trimmed.
+// Returns 0, or -1 when memory runs out.
+int diagram_render(const RExpr *expr, DiagramBuffer *out)
+{
+    Layout lay;
+    if (expr->length == 0) {
+        return 0;
+    }
+    if (build_tree(expr, &lay) != 0) {
+        free_layout(&lay);
+        return -1;
+    }
+    measure(&lay);
+
+    TextSink t = { { text_resistor, text_wire, text_bus, text_tap, text_node }, NULL, lay.width };
+    t.cells = malloc((size_t)lay.width * lay.height);
+    // Every cell is at most 3 bytes of UTF-8, plus a newline per row
+    if (!t.cells || diagram_reserve(out, (size_t)lay.width * lay.height * 3 + lay.height) != 0) {
+        free(t.cells);
+        free_layout(&lay);
+        return -1;
+    }
+    memset(t.cells, CELL_SPACE, (size_t)lay.width * lay.height);
+    place_and_draw(&lay, &t.base);
+
+    char *p = out->data + out->length;
+    for (int y = 0; y < lay.height; y++) {
+        const unsigned char *row = t.cells + (size_t)y * lay.width;
+        int end = lay.width;
+        while (end > 0 && row[end - 1] == CELL_SPACE) end--;
+        for (int x = 0; x < end; x++) {
+            if (row[x] < 32) {
+                size_t n = strlen(cell_utf8[row[x]]);
+                memcpy(p, cell_utf8[row[x]], n);
+                p += n;
+            } else {
+                *p++ = (char)row[x];
+            }
+        }
+        *p++ = '\n';
+    }
+    out->length = (size_t)(p - out->data);
+    out->data[out->length] = '\0';
+
+    free(t.cells);
+    free_layout(&lay);
+    return 0;
+}
+
+// ---- streaming export ----
+
+static void export_flush(Exporter *ex)
+{
+    if (!ex->failed && diagram_write(ex->fd, &ex->buf) != 0) {
+        ex->failed = 1;
+    }
+    ex->buf.length = 0;
+}
+
+static void export_text(Exporter *ex, const char *text, size_t len)
+{
+    if (diagram_append(&ex->buf, text, len) != 0) {
+        ex->failed = 1;
+    }
+    if (ex->buf.length >= EXPORT_FLUSH) {
+        export_flush(ex);
+    }
+}
+
+static void export_printf(Exporter *ex, const char *format, ...)
+{
+    char line[512];
+    va_list ap;
+    va_start(ap, format);
+    int n = vsnprintf(line, sizeof(line), format, ap);
+    va_end(ap);
+    if (n > 0) {
+        export_text(ex, line, (size_t)n < sizeof(line) ? (size_t)n : sizeof(line) - 1);
+    }
+}
+
+// Node names come from the netlist file, so they are escaped for XML
+static void export_escaped(Exporter *ex, const char *s)
+{
+    for (; *s; s++) {
+        switch (*s) {
+        case '<': export_text(ex, "&lt;", 4); break;
+        case '>': export_text(ex, "&gt;", 4); break;
+        case '&': export_text(ex, "&amp;", 5); break;
+        case '"': export_text(ex, "&quot;", 6); break;
+        default: export_text(ex, s, 1); break;
+        }
+    }
+}
+
+static int export_finish(Exporter *ex)
+{
+    export_flush(ex);
+    diagram_free(&ex->buf);
+    return ex->failed ? -1 : 0;
+}
+
+static void format_ohms(double ohms, char *buf, size_t len)
+{
+    const char *suffix = "";
+    if (ohms >= 1e6) { ohms /= 1e6; suffix = "M"; }
+    else if (ohms >= 1e3) { ohms /= 1e3; suffix = "k"; }
+    snprintf(buf, len, "%.4g%s", ohms, suffix);
+}
+
+static void svg_header(Exporter *ex, int width, int height)
+{
+    export_printf(ex, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                      "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"%d\" height=\"%d\" "
+                      "viewBox=\"0 0 %d %d\">\n"
+                      "<rect width=\"100%%\" height=\"100%%\" fill=\"white\"/>\n"
+                      "<g stroke=\"black\" stroke-width=\"1.5\" fill=\"none\" "
+                      "font-family=\"monospace\" font-size=\"10\">\n",
+                  width, height, width, height);
+}
+
+static void svg_footer(Exporter *ex)
+{
+    export_text(ex, "</g>\n</svg>\n", 12);
+}
+
+// Zigzag of length len (pixels) starting at (x, y), leads included
+static void svg_zigzag(Exporter *ex, double x, double y, double len)
+{
+    double lead = len / 8, step = (len - 2 * lead) / 6;
+    export_printf(ex, "<polyline points=\"%.1f,%.1f %.1f,%.1f", x, y, x + lead, y);
+    for (int i = 0; i < 6; i++) {
+        export_printf(ex, " %.1f,%.1f", x + lead + step * (i + 0.5), y + (i % 2 ? 5.0 : -5.0));
+    }
+    export_printf(ex, " %.1f,%.1f %.1f,%.1f\"/>\n", x + len - lead, y, x + len, y);
+}
+
+typedef struct {
+    DiagramSink base;
+    Exporter *ex;
+    const RExpr *expr;
+    const float *values;
+} SvgSink;
+
+static inline double svg_x(int x) { return SVG_MARGIN + x * SVG_CELL_W; }
+static inline double svg_y(int y) { return SVG_MARGIN + y * SVG_CELL_H + SVG_CELL_H / 2.0; }
+
+static void svg_resistor(DiagramSink *sink, int x, int y, const LayoutNode *leaf)
+{
+    SvgSink *s = (SvgSink *)sink;
+    char value[32] = "";
+    svg_zigzag(s->ex, svg_x(x), svg_y(y), RESISTOR_WIDTH * SVG_CELL_W);
+    if (leaf->op == REXPR_CONST) {
+        format_ohms(s->expr->constants[leaf->arg], value, sizeof(value));
+        export_printf(s->ex, "<text x=\"%.1f\" y=\"%.1f\" text-anchor=\"middle\" stroke=\"none\" "
+                             "fill=\"black\">%s</text>\n",
+                      svg_x(x) + RESISTOR_WIDTH * SVG_CELL_W / 2.0, svg_y(y) - 7, value);
+        return;
+    }
+    if (s->values) {
+        format_ohms(s->values[leaf->arg], value, sizeof(value));
+    }
+    export_printf(s->ex, "<text x=\"%.1f\" y=\"%.1f\" text-anchor=\"middle\" stroke=\"none\" "
+                         "fill=\"black\">R%d%s%s</text>\n",
+                  svg_x(x) + RESISTOR_WIDTH * SVG_CELL_W / 2.0, svg_y(y) - 7, leaf->arg + 1,
+                  value[0] ? " " : "", value);
+}
+
+static void svg_wire(DiagramSink *sink, int x, int y, int len)
+{
+    export_printf(((SvgSink *)sink)->ex, "<line x1=\"%.1f\" y1=\"%.1f\" x2=\"%.1f\" y2=\"%.1f\"/>\n",
+                  svg_x(x), svg_y(y), svg_x(x + len), svg_y(y));
+}
+
+static void svg_bus(DiagramSink *sink, int x, int top, int bottom, int right)
+{
+    (void)right;
+    double cx = svg_x(x) + SVG_CELL_W / 2.0;
+    export_printf(((SvgSink *)sink)->ex, "<line x1=\"%.1f\" y1=\"%.1f\" x2=\"%.1f\" y2=\"%.1f\"/>\n",
+                  cx, svg_y(top), cx, svg_y(bottom));
+}
+
+// The half cell between the bus and the branch wire
+static void svg_tap(DiagramSink *sink, int x, int y, int right)
+{
+    double cx = svg_x(x) + SVG_CELL_W / 2.0;
+    export_printf(((SvgSink *)sink)->ex, "<line x1=\"%.1f\" y1=\"%.1f\" x2=\"%.1f\" y2=\"%.1f\"/>\n",
+                  cx, svg_y(y), right ? svg_x(x) : svg_x(x + 1), svg_y(y));
+}
+
+// Junction dot plus the half cell out to the wire on the far side
+static void svg_node(DiagramSink *sink, int x, int y)
+{
+    SvgSink *s = (SvgSink *)sink;
+    double cx = svg_x(x) + SVG_CELL_W / 2.0;
+    export_printf(s->ex, "<line x1=\"%.1f\" y1=\"%.1f\" x2=\"%.1f\" y2=\"%.1f\"/>\n"
+                         "<circle cx=\"%.1f\" cy=\"%.1f\" r=\"2.5\" fill=\"black\"/>\n",
+                  svg_x(x), svg_y(y), svg_x(x + 1), svg_y(y), cx, svg_y(y));
+}
+
+// Subtree resistances for the text outline, children before parents
+static void subtree_values(const Layout *lay, const RExpr *expr, const float values[], double *ohms)
+{
+    for (int i = 0; i < lay->count; i++) {
+        const LayoutNode *node = &lay->nodes[i];
+        const int *child = lay->children + node->first_child;
+        if (node->op == REXPR_VALUE) {
+            ohms[i] = values[node->arg];
+        } else if (node->op == REXPR_CONST) {
+            ohms[i] = expr->constants[node->arg];
+        } else {
+            double sum = 0;
+            for (int c = 0; c < node->child_count; c++) {
+                sum += node->op == REXPR_SERIES ? ohms[child[c]] : 1.0 / ohms[child[c]];
+            }
+            ohms[i] = node->op == REXPR_SERIES ? sum : 1.0 / sum;
+        }
+    }
+}
+
+// One line per node, preorder, with the usual tree-drawing prefix
+static void outline(Exporter *ex, const Layout *lay, const RExpr *expr, const double *ohms, int i,
+                    DiagramBuffer *prefix)
+{
+    const LayoutNode *node = &lay->nodes[i];
+    char value[32] = "";
+    if (ohms) {
+        format_ohms(ohms[i], value, sizeof(value));
+    }
+    if (node->child_count > 0) {
+        export_printf(ex, "%s (%d)%s%s%s\n", node->op == REXPR_SERIES ? "series" : "parallel",
+                      node->child_count, ohms ? "  " : "", value, ohms ? " ohms" : "");
+    } else if (node->op == REXPR_VALUE) {
+        export_printf(ex, "R%d%s%s%s\n", node->arg + 1, ohms ? "  " : "", value, ohms ? " ohms" : "");
+    } else {
+        format_ohms(expr->constants[node->arg], value, sizeof(value));
+        export_printf(ex, "%s ohms\n", value);
+    }
+
+    size_t depth = prefix->length;
+    for (int c = 0; c < node->child_count; c++) {
+        int last = c == node->child_count - 1;
+        export_text(ex, prefix->data ? prefix->data : "", depth);
+        export_text(ex, last ? "└── " : "├── ", strlen(last ? "└── " : "├── "));
+        prefix->length = depth;
+        diagram_append(prefix, last ? "    " : "│   ", strlen(last ? "    " : "│   "));
+        outline(ex, lay, expr, ohms, lay->children[node->first_child + c], prefix);
+    }
+    prefix->length = depth;
+}
+
+// Stream a diagram of expr to fd: an SVG drawing with the same layout as diagram_render,
+// or a UTF-8 tree outline with the resistance of every subtree (values may be NULL when
+// only the structure is known). Output goes out in EXPORT_FLUSH-sized writes as it is
+// produced; only the tree itself is held in memory. Returns 0, or -1 on a write or memory error.
+int diagram_export(int fd, const RExpr *expr, const float values[], DiagramFormat format)
+{
+    Exporter ex = { { NULL, 0, 0 }, fd, 0 };
+    Layout lay;
+    if (expr->length == 0) {
+        return 0;
+    }
+    if (build_tree(expr, &lay) != 0) {
+        free_layout(&lay);
+        return -1;
+    }
+
+    if (format == DIAGRAM_SVG) {
+        measure(&lay);
+        SvgSink s = { { svg_resistor, svg_wire, svg_bus, svg_tap, svg_node }, &ex, expr, values };
+        svg_header(&ex, lay.width * SVG_CELL_W + 2 * SVG_MARGIN, lay.height * SVG_CELL_H + 2 * SVG_MARGIN);
+        place_and_draw(&lay, &s.base);
+        svg_footer(&ex);
+    } else {
+        double *ohms = values ? malloc(sizeof(double) * lay.count) : NULL;
+        DiagramBuffer prefix;
+        diagram_init(&prefix);
+        if (ohms) {
+            subtree_values(&lay, expr, values, ohms);
+        }
+        outline(&ex, &lay, expr, ohms, lay.root, &prefix);
+        diagram_free(&prefix);
+        free(ohms);
+    }
+
+    free_layout(&lay);
+    return export_finish(&ex);
+}
+
+// Stream a netlist to fd in one pass over its resistors. SVG draws every node as a vertical
+// rail (in order of first appearance) and every resistor as a rung between its two rails;
+// text gives one line per resistor. Returns 0, or -1 on a write error.
+int diagram_export_netlist(int fd, const Netlist *nl, DiagramFormat format)
+{
+    Exporter ex = { { NULL, 0, 0 }, fd, 0 };
+    char value[32];
+
+    if (format == DIAGRAM_SVG) {
+        int top = SVG_MARGIN + 20;
+        int bottom = top + (nl->count > 0 ? nl->count : 1) * SVG_ROW_PITCH;
+        svg_header(&ex, 2 * SVG_MARGIN + (nl->node_count > 0 ? nl->node_count : 1) * SVG_NODE_PITCH,
+                   bottom + SVG_MARGIN);
+        for (int n = 0; n < nl->node_count; n++) {
+            int x = SVG_MARGIN + SVG_NODE_PITCH / 2 + n * SVG_NODE_PITCH;
+            export_printf(&ex, "<line x1=\"%d\" y1=\"%d\" x2=\"%d\" y2=\"%d\" stroke=\"#999\"/>\n"
+                               "<text x=\"%d\" y=\"%d\" text-anchor=\"middle\" stroke=\"none\" fill=\"black\">",
+                          x, top, x, bottom, x, top - 8);
+            export_escaped(&ex, netlist_node_name(nl, n));
+            export_text(&ex, "</text>\n", 8);
+        }
+        for (int i = 0; i < nl->count; i++) {
+            int a = nl->node_a[i] < nl->node_b[i] ? nl->node_a[i] : nl->node_b[i];
+            int b = nl->node_a[i] < nl->node_b[i] ? nl->node_b[i] : nl->node_a[i];
+            double xa = SVG_MARGIN + SVG_NODE_PITCH / 2.0 + a * SVG_NODE_PITCH;
+            double xb = SVG_MARGIN + SVG_NODE_PITCH / 2.0 + b * SVG_NODE_PITCH;
+            double y = top + (i + 0.5) * SVG_ROW_PITCH;
+            double len = RESISTOR_WIDTH * SVG_CELL_W;
+            double mid = a == b ? xa + len / 2 + 8 : (xa + xb) / 2;
+            format_ohms(nl->ohms[i], value, sizeof(value));
+            export_printf(&ex, "<line x1=\"%.1f\" y1=\"%.1f\" x2=\"%.1f\" y2=\"%.1f\"/>\n",
+                          xa, y, mid - len / 2, y);
+            svg_zigzag(&ex, mid - len / 2, y, len);
+            export_printf(&ex, "<line x1=\"%.1f\" y1=\"%.1f\" x2=\"%.1f\" y2=\"%.1f\"/>\n"
+                               "<circle cx=\"%.1f\" cy=\"%.1f\" r=\"2.5\" fill=\"black\"/>\n"
+                               "<circle cx=\"%.1f\" cy=\"%.1f\" r=\"2.5\" fill=\"black\"/>\n"
+                               "<text x=\"%.1f\" y=\"%.1f\" text-anchor=\"middle\" stroke=\"none\" "
+                               "fill=\"black\">%s</text>\n",
+                          mid + len / 2, y, a == b ? mid + len / 2 : xb, y, xa, y, xb, y,
+                          mid, y - 7, value);
+        }
+        svg_footer(&ex);
+    } else {
+        export_printf(&ex, "%d resistors on %d nodes\n", nl->count, nl->node_count);
+        for (int i = 0; i < nl->count; i++) {
+            format_ohms(nl->ohms[i], value, sizeof(value));
+            export_printf(&ex, "%8d  ", i + 1);
+            export_text(&ex, netlist_node_name(nl, nl->node_a[i]), strlen(netlist_node_name(nl, nl->node_a[i])));
+            export_text(&ex, " ──" RESISTOR_GLYPH "── ", strlen(" ──" RESISTOR_GLYPH "── "));
+            export_text(&ex, netlist_node_name(nl, nl->node_b[i]), strlen(netlist_node_name(nl, nl->node_b[i])));
+            export_printf(&ex, "  %s ohms\n", value);
+        }
+    }
+    return export_finish(&ex);
+}
@@ -0,0 +1,421 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include "funcs.h"
+
+// Search for standard-value (E12/E24/E96) combinations that hit a target resistance.
+//
+// Every series/parallel arrangement of up to four parts is written as known single parts
+// wrapped around one unknown, where the unknown is either a single part or a two-part
+// series or parallel pair:
+//
+//   a                       a + u,  a || u               (u single)
+//   a + u,  a || u                                       (u a pair: 3 parts)
+//   (a op b) op u,  a op (b op u)                        (u a pair: 4 parts)
+//
+// For each choice of the known parts the exact u that would hit the target follows from
+// inverting the two operators, and a binary search in the sorted table of singles or pairs
+// finds the entries either side of it. Moving away from that point only increases the error,
+// so each side is walked just until it can no longer beat the current k-th best. The pair
+// tables are built once per series and are the only large allocation (under 8 MB for E96),
+// so memory stays bounded for four parts.
+
+#define ESERIES_DECADES 7           // 1 ohm up to 10 Mohm
+#define ESERIES_MAX_K 100
+
+static const double e12_values[] = { 1.0, 1.2, 1.5, 1.8, 2.2, 2.7, 3.3, 3.9, 4.7, 5.6, 6.8, 8.2 };
+
+static const double e24_values[] = {
+    1.0, 1.1, 1.2, 1.3, 1.5, 1.6, 1.8, 2.0, 2.2, 2.4, 2.7, 3.0,
+    3.3, 3.6, 3.9, 4.3, 4.7, 5.1, 5.6, 6.2, 6.8, 7.5, 8.2, 9.1
+};
+
+static const double e96_values[] = {
+    1.00, 1.02, 1.05, 1.07, 1.10, 1.13, 1.15, 1.18, 1.21, 1.24, 1.27, 1.30,
+    1.33, 1.37, 1.40, 1.43, 1.47, 1.50, 1.54, 1.58, 1.62, 1.65, 1.69, 1.74,
+    1.78, 1.82, 1.87, 1.91, 1.96, 2.00, 2.05, 2.10, 2.15, 2.21, 2.26, 2.32,
+    2.37, 2.43, 2.49, 2.55, 2.61, 2.67, 2.74, 2.80, 2.87, 2.94, 3.01, 3.09,
+    3.16, 3.24, 3.32, 3.40, 3.48, 3.57, 3.65, 3.74, 3.83, 3.92, 4.02, 4.12,
+    4.22, 4.32, 4.42, 4.53, 4.64, 4.75, 4.87, 4.99, 5.11, 5.23, 5.36, 5.49,
+    5.62, 5.76, 5.90, 6.04, 6.19, 6.34, 6.49, 6.65, 6.81, 6.98, 7.15, 7.32,
+    7.50, 7.68, 7.87, 8.06, 8.25, 8.45, 8.66, 8.87, 9.09, 9.31, 9.53, 9.76
+};
+
+typedef enum { TABLE_SINGLE, TABLE_SERIES_PAIR, TABLE_PARALLEL_PAIR } TableKind;
+typedef enum { SHAPE_SINGLE, SHAPE_OUTER, SHAPE_FLAT, SHAPE_NESTED } Shape;
+
+enum { OP_SERIES, OP_PARALLEL };
+
+// value = u (SINGLE), a out u (OUTER), (a in b) out u (FLAT) or a out (b in u) (NESTED)
+typedef struct {
+    int parts;
+    Shape shape;
+    int out;
+    int in;
+    TableKind table;
+    const char *format;     // A, B are the known parts; C (and D) come from u
+} Topology;
+
+static const Topology topologies[] = {
+    { 1, SHAPE_SINGLE, 0, 0, TABLE_SINGLE, "C" },
+    { 2, SHAPE_OUTER, OP_SERIES, 0, TABLE_SINGLE, "A + C" },
+    { 2, SHAPE_OUTER, OP_PARALLEL, 0, TABLE_SINGLE, "A || C" },
+    { 3, SHAPE_OUTER, OP_SERIES, 0, TABLE_SERIES_PAIR, "A + C + D" },
+    { 3, SHAPE_OUTER, OP_SERIES, 0, TABLE_PARALLEL_PAIR, "A + (C || D)" },
+    { 3, SHAPE_OUTER, OP_PARALLEL, 0, TABLE_SERIES_PAIR, "A || (C + D)" },
+    { 3, SHAPE_OUTER, OP_PARALLEL, 0, TABLE_PARALLEL_PAIR, "A || C || D" },
+    { 4, SHAPE_FLAT, OP_SERIES, OP_SERIES, TABLE_SERIES_PAIR, "A + B + C + D" },
+    { 4, SHAPE_FLAT, OP_SERIES, OP_SERIES, TABLE_PARALLEL_PAIR, "A + B + (C || D)" },
+    { 4, SHAPE_FLAT, OP_SERIES, OP_PARALLEL, TABLE_PARALLEL_PAIR, "(A || B) + (C || D)" },
+    { 4, SHAPE_FLAT, OP_PARALLEL, OP_SERIES, TABLE_SERIES_PAIR, "(A + B) || (C + D)" },
+    { 4, SHAPE_FLAT, OP_PARALLEL, OP_SERIES, TABLE_PARALLEL_PAIR, "(A + B) || C || D" },
+    { 4, SHAPE_FLAT, OP_PARALLEL, OP_PARALLEL, TABLE_PARALLEL_PAIR, "A || B || C || D" },
+    { 4, SHAPE_NESTED, OP_SERIES, OP_PARALLEL, TABLE_SERIES_PAIR, "A + (B || (C + D))" },
+    { 4, SHAPE_NESTED, OP_SERIES, OP_PARALLEL, TABLE_PARALLEL_PAIR, "A + (B || C || D)" },
+    { 4, SHAPE_NESTED, OP_PARALLEL, OP_SERIES, TABLE_SERIES_PAIR, "A || (B + C + D)" },
+    { 4, SHAPE_NESTED, OP_PARALLEL, OP_SERIES, TABLE_PARALLEL_PAIR, "A || (B + (C || D))" },
+};
+
+#define TOPOLOGY_COUNT ((int)(sizeof(topologies) / sizeof(topologies[0])))
+
+typedef struct {
+    double value;
+    unsigned short i, j;    // indices into the singles, i <= j
+} PairEntry;
+
+typedef struct {
+    int ready;
+    int count;              // singles
+    double *single;         // ascending
+    PairEntry *series;      // both ascending by value, count * (count + 1) / 2 each
+    PairEntry *parallel;
+    int pair_count;
+} ESeriesTables;
+
+static ESeriesTables tables[3];
+static pthread_mutex_t tables_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int compare_pairs(const void *a, const void *b)
+{
+    double x = ((const PairEntry *)a)->value, y = ((const PairEntry *)b)->value;
+    return (x > y) - (x < y);
+}
+
+static inline double combine(int op, double x, double y)
+{
+    return op == OP_SERIES ? x + y : x * y / (x + y);
+}
+
+// The y with combine(op, x, y) == target; 0 if too small to reach, INFINITY if unreachable above
+static inline double solve_for(int op, double x, double target)
+{
+    if (op == OP_SERIES) {
+        return target > x ? target - x : 0;
+    }
+    return target < x ? x * target / (x - target) : INFINITY;
+}
+
+static const ESeriesTables *get_tables(ESeries series)
+{
+    ESeriesTables *t = &tables[series];
+    pthread_mutex_lock(&tables_lock);
+    if (!t->ready) {
+        const double *base = series == ESERIES_E12 ? e12_values : (series == ESERIES_E24 ? e24_values : e96_values);
+        int per_decade = series == ESERIES_E12 ? 12 : (series == ESERIES_E24 ? 24 : 96);
+        int n = per_decade * ESERIES_DECADES;
+        int pairs = n * (n + 1) / 2;
+        t->single = malloc(sizeof(double) * n);
+        t->series = malloc(sizeof(PairEntry) * pairs);
+        t->parallel = malloc(sizeof(PairEntry) * pairs);
+        if (!t->single || !t->series || !t->parallel) {
+            free(t->single);
+            free(t->series);
+            free(t->parallel);
+            pthread_mutex_unlock(&tables_lock);
+            return NULL;
+        }
+
+        double decade = 1;
+        for (int d = 0; d < ESERIES_DECADES; d++, decade *= 10) {
+            for (int i = 0; i < per_decade; i++) {
+                t->single[d * per_decade + i] = base[i] * decade;
+            }
+        }
+        int k = 0;
+        for (int i = 0; i < n; i++) {
+            for (int j = i; j < n; j++, k++) {
+                t->series[k].value = t->single[i] + t->single[j];
+                t->parallel[k].value = combine(OP_PARALLEL, t->single[i], t->single[j]);
+                t->series[k].i = t->parallel[k].i = (unsigned short)i;
+                t->series[k].j = t->parallel[k].j = (unsigned short)j;
+            }
+        }
+        qsort(t->series, pairs, sizeof(PairEntry), compare_pairs);
+        qsort(t->parallel, pairs, sizeof(PairEntry), compare_pairs);
+        t->count = n;
+        t->pair_count = pairs;
+        t->ready = 1;
+    }
+    pthread_mutex_unlock(&tables_lock);
+    return t;
+}
+
+// Bounded best-k list, kept sorted by error (worst last)
+typedef struct {
+    EMatch items[ESERIES_MAX_K];
+    int count;
+    int k;
+} TopK;
+
+static double topk_bound(const TopK *top)
+{
+    return top->count < top->k ? INFINITY : top->items[top->count - 1].error;
+}
+
+static int same_match(const EMatch *a, const EMatch *b)
+{
+    if (a->topology != b->topology || a->value != b->value) {
+        return 0;
+    }
+    double x[ESERIES_MAX_PARTS], y[ESERIES_MAX_PARTS];
+    memcpy(x, a->part, sizeof(x));
+    memcpy(y, b->part, sizeof(y));
+    // Same multiset of parts: sort both (at most four) and compare
+    for (int i = 1; i < a->parts; i++) {
+        for (int j = i; j > 0 && x[j] < x[j - 1]; j--) { double s = x[j]; x[j] = x[j - 1]; x[j - 1] = s; }
+        for (int j = i; j > 0 && y[j] < y[j - 1]; j--) { double s = y[j]; y[j] = y[j - 1]; y[j - 1] = s; }
+    }
+    return memcmp(x, y, sizeof(double) * a->parts) == 0;
+}
+
+// Order: smaller error, then fewer parts, then topology, then parts, so results are deterministic
+static int match_before(const EMatch *a, const EMatch *b)
+{
+    if (a->error != b->error) return a->error < b->error;
+    if (a->parts != b->parts) return a->parts < b->parts;
+    if (a->topology != b->topology) return a->topology < b->topology;
+    return memcmp(a->part, b->part, sizeof(a->part)) < 0;
+}
+
+static void topk_insert(TopK *top, const EMatch *m)
+{
+    if (top->count == top->k && !match_before(m, &top->items[top->count - 1])) {
+        return;
+    }
+    for (int i = 0; i < top->count; i++) {
+        if (same_match(&top->items[i], m)) {
+            return;
+        }
+    }
+    int pos = top->count < top->k ? top->count++ : top->count - 1;
+    while (pos > 0 && match_before(m, &top->items[pos - 1])) {
+        top->items[pos] = top->items[pos - 1];
+        pos--;
+    }
+    top->items[pos] = *m;
+}
+
+typedef struct {
+    const ESeriesTables *t;
+    double target;
+    int max_parts;
+    int k;
+    TopK best;              // merged results
+    pthread_mutex_t lock;
+} SearchJob;
+
+static inline double table_value(const ESeriesTables *t, TableKind kind, int index)
+{
+    return kind == TABLE_SINGLE ? t->single[index] :
+           (kind == TABLE_SERIES_PAIR ? t->series[index].value : t->parallel[index].value);
+}
+
+// First index whose value is >= x
+static int lower_bound(const ESeriesTables *t, TableKind kind, double x)
+{
+    int lo = 0, hi = kind == TABLE_SINGLE ? t->count : t->pair_count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (table_value(t, kind, mid) < x) lo = mid + 1; else hi = mid;
+    }
+    return lo;
+}
+
+static double topology_value(const Topology *top, double a, double b, double u)
+{
+    switch (top->shape) {
+        case SHAPE_SINGLE: return u;
+        case SHAPE_OUTER:  return combine(top->out, a, u);
+        case SHAPE_FLAT:   return combine(top->out, combine(top->in, a, b), u);
+        default:           return combine(top->out, a, combine(top->in, b, u));
+    }
+}
+
+// Try the table entries either side of the ideal u for known parts a and b
+static void search_around(SearchJob *job, TopK *top, int topology, int ia, int ib)
+{
+    const Topology *tp = &topologies[topology];
+    const ESeriesTables *t = job->t;
+    double a = ia >= 0 ? t->single[ia] : 0;
+    double b = ib >= 0 ? t->single[ib] : 0;
+    double need;
+    switch (tp->shape) {
+        case SHAPE_SINGLE: need = job->target; break;
+        case SHAPE_OUTER:  need = solve_for(tp->out, a, job->target); break;
+        case SHAPE_FLAT:   need = solve_for(tp->out, combine(tp->in, a, b), job->target); break;
+        default:           need = solve_for(tp->in, b, solve_for(tp->out, a, job->target)); break;
+    }
+
+    int size = tp->table == TABLE_SINGLE ? t->count : t->pair_count;
+    int split = lower_bound(t, tp->table, need);
+    for (int dir = -1; dir <= 1; dir += 2) {
+        for (int idx = dir < 0 ? split - 1 : split; idx >= 0 && idx < size; idx += dir) {
+            double u = table_value(t, tp->table, idx);
+            EMatch m;
+            m.value = topology_value(tp, a, b, u);
+            m.error = fabs(m.value - job->target) / job->target;
+            if (m.error > topk_bound(top)) {
+                break;      // only gets worse further out
+            }
+            m.topology = topology;
+            m.parts = tp->parts;
+            memset(m.part, 0, sizeof(m.part));
+            int p = 0;
+            if (ia >= 0) m.part[p++] = a;
+            if (ib >= 0) m.part[p++] = b;
+            if (tp->table == TABLE_SINGLE) {
+                m.part[p++] = u;
+            } else {
+                const PairEntry *e = tp->table == TABLE_SERIES_PAIR ? &t->series[idx] : &t->parallel[idx];
+                m.part[p++] = t->single[e->i];
+                m.part[p++] = t->single[e->j];
+            }
+            topk_insert(top, &m);
+        }
+    }
+}
+
+// Each index is one choice of the first known part a
+static void search_range(int first, int last, void *arg)
+{
+    SearchJob *job = arg;
+    const ESeriesTables *t = job->t;
+    TopK *top = malloc(sizeof(TopK));
+    if (!top) {
+        return;
+    }
+    top->count = 0;
+    top->k = job->k;
+
+    for (int ia = first; ia < last; ia++) {
+        double a = t->single[ia];
+        for (int tp = 0; tp < TOPOLOGY_COUNT; tp++) {
+            const Topology *topo = &topologies[tp];
+            if (topo->parts > job->max_parts) {
+                continue;
+            }
+            if (topo->shape == SHAPE_SINGLE) {
+                if (ia == first && first == 0) search_around(job, top, tp, -1, -1);
+                continue;
+            }
+            if (topo->shape == SHAPE_OUTER) {
+                search_around(job, top, tp, ia, -1);
+                continue;
+            }
+            // Four parts: a op b is symmetric in FLAT, so b starts at a there
+            for (int ib = topo->shape == SHAPE_FLAT ? ia : 0; ib < t->count; ib++) {
+                double b = t->single[ib];
+                double known = topo->shape == SHAPE_FLAT ? combine(topo->in, a, b) : a;
+                // A series total is at least known, which only grows with b: once it is too far
+                // above the target, so is the rest of the row. A nested parallel total stays
+                // below a, so the row is hopeless once a is too far below the target.
+                if (topo->out == OP_SERIES && (known - job->target) / job->target > topk_bound(top)) {
+                    break;
+                }
+                if (topo->out == OP_PARALLEL && topo->shape == SHAPE_NESTED &&
+                    (job->target - a) / job->target > topk_bound(top)) {
+                    break;
+                }
+                search_around(job, top, tp, ia, ib);
+            }
+        }
+    }
+
+    pthread_mutex_lock(&job->lock);
+    for (int i = 0; i < top->count; i++) topk_insert(&job->best, &top->items[i]);
+    pthread_mutex_unlock(&job->lock);
+    free(top);
+}
+
+// Find the k closest combinations of at most max_parts (1-4) parts from the series.
+// Matches are written best first; returns how many were found, or -1 for bad arguments.
+int eseries_search(ESeries series, double target, int max_parts, int k, EMatch matches[])
+{
+    if (!(target > 0) || !isfinite(target) || max_parts < 1 || max_parts > ESERIES_MAX_PARTS ||
+        k < 1 || k > ESERIES_MAX_K || series < ESERIES_E12 || series > ESERIES_E96) {
+        return -1;
+    }
+    const ESeriesTables *t = get_tables(series);
+    if (!t) {
+        return -1;
+    }
+
+    SearchJob *job = malloc(sizeof(SearchJob));
+    if (!job) {
+        return -1;
+    }
+    job->t = t;
+    job->target = target;
+    job->max_parts = max_parts;
+    job->k = k;
+    job->best.count = 0;
+    job->best.k = k;
+    pthread_mutex_init(&job->lock, NULL);
+
+    parallel_for(0, t->count, 4, search_range, job);
+
+    int found = job->best.count;
+    memcpy(matches, job->best.items, sizeof(EMatch) * found);
+    pthread_mutex_destroy(&job->lock);
+    free(job);
+    return found;
+}
+
+// Resistance with an engineering suffix: 4.7, 470, 4.7k, 1.5M
+static void format_ohms(double ohms, char *buf, size_t len)
+{
+    const char *suffix = "";
+    if (ohms >= 1e6) { ohms /= 1e6; suffix = "M"; }
+    else if (ohms >= 1e3) { ohms /= 1e3; suffix = "k"; }
+    snprintf(buf, len, "%.3g%s", ohms, suffix);
+}
+
+// Write a match as an expression, e.g. "1k || (2.2k + 470)"
+void eseries_format(const EMatch *m, char *buf, size_t len)
+{
+    const Topology *tp = &topologies[m->topology];
+    // Parts are stored known-first: A (B) then C (D)
+    int known = tp->shape == SHAPE_SINGLE ? 0 : (tp->shape == SHAPE_OUTER ? 1 : 2);
+    size_t used = 0;
+    buf[0] = '\0';
+    for (const char *f = tp->format; *f && used + 1 < len; f++) {
+        int slot = -1;
+        if (*f == 'A') slot = 0;
+        else if (*f == 'B') slot = 1;
+        else if (*f == 'C') slot = known;
+        else if (*f == 'D') slot = known + 1;
+        if (slot < 0) {
+            buf[used++] = *f;
+            buf[used] = '\0';
+            continue;
+        }
+        char value[32];
+        format_ohms(m->part[slot], value, sizeof(value));
+        used += (size_t)snprintf(buf + used, len - used, "%s", value);
+        if (used >= len) {
+            used = len - 1;
+        }
+    }
+}
@@ -1,20 +1,13 @@
 #include <stdio.h>
 #include "funcs.h"
+#include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 #include <math.h>
-
-#define RESISTOR "/\\/\\/\\"
-#define WIRE "──"
-#define NODE "●"
-#define PARALLEL_VERT "│"       // Circuit diagram elements
-
-#define MAX_CIRCUIT_LINES 10
-#define MAX_LINE_LENGTH 100         // For circuit diagram storage array
-#define MAX_GROUPS 5
-
-char circuit_diagram[MAX_CIRCUIT_LINES][MAX_LINE_LENGTH];
-int diagram_line_count = 0;
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <strings.h>
 
 // Unit classification
 typedef enum {
@@ -23,20 +16,30 @@ typedef enum {
     UNIT_TIME,       // Time
     UNIT_STORAGE,    // Storage
     UNIT_ANGLE,      // Angle
+    UNIT_TEMPERATURE, // Temperature
     UNIT_UNKNOWN     // Unknown
 } UnitType;
+// How a unit maps onto its base unit
+typedef enum {
+    UNIT_LINEAR,     // base = value * to_base
+    UNIT_AFFINE,     // base = value * to_base + offset
+    UNIT_LOG         // base = to_base * 10^(value/10)  (decibels relative to to_base)
+} UnitKind;
 // Unit information structure
 typedef struct {
     const char* name;      // Unit name
     UnitType type;         // Unit type
-    double to_base;        // Conversion factor to base unit
+    double to_base;        // Conversion factor to base unit (reference level for UNIT_LOG)
     const char* base_unit; // Base unit name
+    UnitKind kind;         // Linear unless stated
+    double offset;         // Base-unit offset of affine units
 } UnitInfo;
 // Unit database (easily extensible)
 static UnitInfo unit_database[] = 
 {
     // Power units (base: mW)
-    {"dbm", UNIT_POWER, 1.0, "mw"},        // dBm directly corresponds to mW
+    {"dbm", UNIT_POWER, 1.0, "mw", UNIT_LOG},     // 0 dBm = 1mW
+    {"dbw", UNIT_POWER, 1000.0, "mw", UNIT_LOG},  // 0 dBW = 1W
     {"mw",  UNIT_POWER, 1.0, "mw"},        // Base unit
     {"w",   UNIT_POWER, 1000.0, "mw"},     // 1W = 1000mW
     
@@ -64,6 +67,11 @@ static UnitInfo unit_database[] =
     {"deg", UNIT_ANGLE, 3.1415926535/180.0, "rad"}, // 180° = π rad
     {"grad", UNIT_ANGLE, 3.1415926535/200.0, "rad"}, // 200grad = π rad
     
+    // Temperature units (base: kelvin)
+    {"k", UNIT_TEMPERATURE, 1.0, "k"},     // Base unit
+    {"c", UNIT_TEMPERATURE, 1.0, "k", UNIT_AFFINE, 273.15}, // 0°C = 273.15K
+    {"f", UNIT_TEMPERATURE, 5.0/9.0, "k", UNIT_AFFINE, 459.67 * 5.0/9.0}, // 32°F = 273.15K
+    
     {NULL, UNIT_UNKNOWN, 0, NULL}  // End marker
 };
 
@@ -74,9 +82,20 @@ void menu_item_1(void) {
     printf("=====================================\n");
     int n;
     printf("Please enter the number of resistors you want in the calculation, and it should between 2 and 5.\n");
+    printf("(Or enter 0 to load a netlist file, or 1 to find standard-value parts for a target.)\n");
     scanf("%d", &n);
     int c;
     while ((c = getchar()) != '\n' && c != EOF); //Clear buffer
+    if (n == 0)
+    {
+        handle_netlist_file();
+        return;
+    }
+    if (n == 1)
+    {
+        handle_eseries_search();
+        return;
+    }
     while(n<2||n>5)
     {
         printf("You have enter an invalid number, please enter again, it should between 2 and 5.\n");
@@ -109,10 +128,12 @@ void menu_item_1(void) {
     float total_resistance;
     int group_number;
     int k=0;
+    ResistorContext ctx;
+    resistor_context_init(&ctx);
     do
     {
         printf("\nPlease select the connection method of the resistors:\n");
-        printf("\nMethod 1: Completely in Series.\nMethod 2: Completely in Parallel.\nMethod 3. Mixed Connection.\n");
+        printf("\nMethod 1: Completely in Series.\nMethod 2: Completely in Parallel.\nMethod 3. Mixed Connection.\nMethod 4. General Network (any topology, by node numbers).\nMethod 5. Expression, e.g. (R1 + (R2 || R3)) || R4.\nMethod 6. Tolerance Analysis (Monte Carlo) of an expression.\n");
         scanf("%d",&connection_method);
         while ((c = getchar()) != '\n' && c != EOF);
         switch(connection_method)
@@ -120,13 +141,13 @@ void menu_item_1(void) {
             case 1:
                 total_resistance=calc_series(r,n);
                 printf("\nThe circuit diagram is shown below:\n\n");
-                draw_series_group(n);
+                draw_series_group(&ctx, n);
                 printf("\nThe total resistance is: %fohms\n",total_resistance);
                 break;
             case 2:
                 total_resistance=calc_parallel(r,n);
                 printf("\nThe circuit diagram is shown below:\n\n");
-                draw_parallel_group(n);
+                draw_parallel_group(&ctx, n);
                 printf("\nThe total resistance is: %fohms\n",total_resistance);
                 break;
             case 3:
@@ -137,18 +158,420 @@ void menu_item_1(void) {
                 } 
                 else 
                 {
-                    handle_mixed_connection(r, n);
+                    handle_mixed_connection(&ctx, r, n);
                 }
                 break;
             }
+            case 4:
+                handle_network_connection(r, n, o);
+                break;
+            case 5:
+                handle_expression_connection(&ctx, r, n);
+                break;
+            case 6:
+                handle_tolerance_analysis(r, n);
+                break;
             default:
-            printf("Invalid connection method! Please enter 1 or 2.\n\n");
+            printf("Invalid connection method! Please enter 1 to 6.\n\n");
+            break;
+        }
+    }
+    while(connection_method<1||connection_method>6);
+    resistor_context_free(&ctx);
+}
+
+// Ask for a file to archive a diagram in; ".svg" selects SVG, anything else UTF-8 text.
+// Returns an open descriptor, or -1 when the user skips it or the file cannot be created.
+static int open_export_file(DiagramFormat *format)
+{
+    char *line = NULL;
+    size_t capacity = 0;
+    int fd = -1;
+    
+    printf("\nSave a diagram to a file? Enter a path (.svg for a drawing, else a text outline), or press Enter to skip: ");
+    if (getline(&line, &capacity, stdin) > 0)
+    {
+        line[strcspn(line, "\r\n")] = 0;
+        size_t len = strlen(line);
+        if (len > 0)
+        {
+            *format = (len > 4 && strcasecmp(line + len - 4, ".svg") == 0) ? DIAGRAM_SVG : DIAGRAM_TEXT;
+            fd = open(line, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (fd < 0)
+            {
+                printf("Cannot create %s.\n", line);
+            }
+        }
+    }
+    free(line);
+    return fd;
+}
+
+// Load a SPICE-style netlist and run it through the series, parallel or nodal calculators
+void handle_netlist_file(void)
+{
+    char *line = NULL;
+    size_t capacity = 0;
+    char error[160];
+    Netlist nl;
+    netlist_init(&nl);
+    
+    printf("\n=== Netlist File ===\n");
+    printf("Lines look like: R1 in out 4k7   (values may use f p n u m k M meg g t)\n");
+    printf("Netlist file path: ");
+    if (getline(&line, &capacity, stdin) < 0)
+    {
+        free(line);
+        return;
+    }
+    line[strcspn(line, "\r\n")] = 0;
+    
+    if (netlist_load(line, &nl, error, sizeof(error)) != 0)
+    {
+        printf("Error: %s\n", error);
+    }
+    else if (nl.count == 0)
+    {
+        printf("The netlist has no resistors.\n");
+    }
+    else
+    {
+        printf("Loaded %d resistors on %d nodes", nl.count, nl.node_count);
+        if (nl.skipped > 0)
+        {
+            printf(" (%ld other elements skipped)", nl.skipped);
+        }
+        printf(".\n");
+        
+        int method;
+        do
+        {
+            printf("\nMethod 1: All resistors in Series.\nMethod 2: All resistors in Parallel.\nMethod 3: Between two nodes of the circuit.\nMethod 4: Export a diagram of the netlist to a file.\n");
+            if (scanf("%d", &method) != 1)
+            {
+                method = 0;
+            }
+            int c;
+            while ((c = getchar()) != '\n' && c != EOF);
+            if (c == EOF && method == 0)
+            {
+                break;
+            }
+        }
+        while (method < 1 || method > 4);
+        
+        if (method == 1 || method == 2)
+        {
+            float *values = malloc(sizeof(float) * nl.count);
+            if (values)
+            {
+                for (int i = 0; i < nl.count; i++)
+                {
+                    values[i] = (float)nl.ohms[i];
+                }
+                float total = method == 1 ? calc_series(values, nl.count) : calc_parallel(values, nl.count);
+                printf("\nThe total resistance is: %fohms\n", total);
+                free(values);
+            }
+        }
+        else if (method == 3)
+        {
+            char name_a[64], name_b[64];
+            printf("Measure between which two nodes (names as in the file)? ");
+            if (scanf("%63s %63s", name_a, name_b) == 2)
+            {
+                int c;
+                while ((c = getchar()) != '\n' && c != EOF);
+                int a = netlist_node(&nl, name_a);
+                int b = netlist_node(&nl, name_b);
+                ResistorNetwork net;
+                if (a < 0 || b < 0)
+                {
+                    printf("Unknown node name.\n");
+                }
+                else if (netlist_to_network(&nl, &net) == 0)
+                {
+                    double total = network_equivalent_resistance(&net, a, b);
+                    if (isinf(total))
+                    {
+                        printf("\nNodes %s and %s are not connected (open circuit).\n", name_a, name_b);
+                    }
+                    else
+                    {
+                        printf("\nThe total resistance between %s and %s is: %fohms\n", name_a, name_b, total);
+                    }
+                    network_free(&net);
+                }
+            }
+        }
+        else if (method == 4)
+        {
+            DiagramFormat format;
+            int fd = open_export_file(&format);
+            if (fd >= 0)
+            {
+                printf(diagram_export_netlist(fd, &nl, format) == 0 ? "Diagram saved.\n" : "Error writing the diagram.\n");
+                close(fd);
+            }
+        }
+    }
+    
+    netlist_free(&nl);
+    free(line);
+}
+
+// Each resistor joins two numbered nodes; the equivalent resistance between any two nodes
+// is found by nodal analysis, so bridges and meshes work too
+void handle_network_connection(float resistors[], int n, char *names[])
+{
+    ResistorNetwork net;
+    int c;
+    network_init(&net);
+    
+    printf("\n=== General Network Configuration ===\n");
+    printf("Number the circuit's nodes from 0, then give the two nodes each resistor connects.\n");
+    for (int i = 0; i < n; i++)
+    {
+        int a, b;
+        while (1)
+        {
+            printf("Nodes of the %s resistor (%.2f ohms), e.g. 0 1: ", names[i], resistors[i]);
+            int read = scanf("%d %d", &a, &b);
+            while ((c = getchar()) != '\n' && c != EOF);
+            if (read == 2 && a >= 0 && b >= 0 && a != b && a < 1000 && b < 1000)
+            {
+                break;
+            }
+            if (read == EOF)
+            {
+                network_free(&net);
+                return;
+            }
+            printf("Please enter two different node numbers between 0 and 999.\n");
+        }
+        network_add_resistor(&net, a, b, resistors[i]);
+    }
+    
+    int a, b;
+    while (1)
+    {
+        printf("Measure between which two nodes? ");
+        int read = scanf("%d %d", &a, &b);
+        while ((c = getchar()) != '\n' && c != EOF);
+        if (read == 2 && a >= 0 && b >= 0 && a < net.node_count && b < net.node_count)
+        {
             break;
         }
+        if (read == EOF)
+        {
+            network_free(&net);
+            return;
+        }
+        printf("Please enter two node numbers used above.\n");
+    }
+    
+    double total = network_equivalent_resistance(&net, a, b);
+    if (isinf(total))
+    {
+        printf("\nNodes %d and %d are not connected (open circuit).\n", a, b);
+    }
+    else
+    {
+        printf("\nThe total resistance between nodes %d and %d is: %fohms\n", a, b, total);
+    }
+    network_free(&net);
+}
+
+// Read an expression over R1..Rn from stdin until it compiles; returns -1 on end of input
+static int read_expression(RExpr *expr, int n)
+{
+    char *line = NULL;
+    size_t cap = 0;
+    char error[128];
+    
+    printf("Use R1 to R%d, '+' for series, '||' for parallel and brackets for grouping.\n", n);
+    while (1)
+    {
+        printf("Expression: ");
+        if (getline(&line, &cap, stdin) < 0)
+        {
+            free(line);
+            return -1;
+        }
+        line[strcspn(line, "\r\n")] = '\0';
+        if (rexpr_compile(line, expr, error, sizeof(error)) != 0)
+        {
+            printf("Invalid expression: %s\n", error);
+            continue;
+        }
+        if (expr->value_count > n)
+        {
+            printf("Only R1 to R%d are defined.\n", n);
+            rexpr_free(expr);
+            continue;
+        }
+        free(line);
+        return 0;
+    }
+}
+
+// The connection is typed as an expression over R1..Rn: '+' is series, '||' is parallel
+// (binding tighter than '+'), brackets nest, and plain values such as 4k7 may appear too
+void handle_expression_connection(ResistorContext *ctx, float resistors[], int n)
+{
+    RExpr expr;
+    
+    printf("\n=== Expression Configuration ===\n");
+    if (read_expression(&expr, n) != 0)
+    {
+        return;
     }
-    while(connection_method<1||connection_method>3);
+    printf("\nThe total resistance is: %fohms\n", rexpr_eval(&expr, resistors));
+    printf("\nThe circuit diagram is shown below:\n\n");
+    ctx->diagram.length = 0;
+    if (diagram_render(&expr, &ctx->diagram) == 0)
+    {
+        display_diagram(ctx);
+    }
+    
+    DiagramFormat format;
+    int fd = open_export_file(&format);
+    if (fd >= 0)
+    {
+        printf(diagram_export(fd, &expr, resistors, format) == 0 ? "Diagram saved.\n" : "Error writing the diagram.\n");
+        close(fd);
+    }
+    rexpr_free(&expr);
 }
-void handle_mixed_connection(float resistors[], int n)
+
+// Each part gets a tolerance in percent; the expression is then evaluated for many random
+// draws and the spread of the total resistance reported
+void handle_tolerance_analysis(float resistors[], int n)
+{
+    RExpr expr;
+    float tolerance[MAX_RESISTORS];
+    int c;
+    
+    printf("\n=== Tolerance Analysis ===\n");
+    if (read_expression(&expr, n) != 0)
+    {
+        return;
+    }
+    for (int i = 0; i < expr.value_count; i++)
+    {
+        while (1)
+        {
+            printf("Tolerance of R%d (%.2f ohms) in %%, e.g. 5: ", i + 1, resistors[i]);
+            int read = scanf("%f", &tolerance[i]);
+            while ((c = getchar()) != '\n' && c != EOF);
+            if (read == 1 && tolerance[i] >= 0 && tolerance[i] < 50)
+            {
+                break;
+            }
+            if (read == EOF)
+            {
+                rexpr_free(&expr);
+                return;
+            }
+            printf("Please enter a tolerance from 0 to 50 percent.\n");
+        }
+    }
+    
+    int dist;
+    long trials;
+    do
+    {
+        printf("Distribution: 1 = uniform, 2 = Gaussian (tolerance = 3 sigma): ");
+        if (scanf("%d", &dist) == EOF)
+        {
+            rexpr_free(&expr);
+            return;
+        }
+        while ((c = getchar()) != '\n' && c != EOF);
+    }
+    while (dist < 1 || dist > 2);
+    do
+    {
+        printf("Number of trials (e.g. 1000000): ");
+        if (scanf("%ld", &trials) == EOF)
+        {
+            rexpr_free(&expr);
+            return;
+        }
+        while ((c = getchar()) != '\n' && c != EOF);
+    }
+    while (trials < 1 || trials > 1000000000L);
+    
+    ToleranceResult result;
+    if (tolerance_analysis(&expr, resistors, tolerance, dist == 1 ? TOLERANCE_UNIFORM : TOLERANCE_GAUSSIAN,
+                           trials, 12345, &result) != 0)
+    {
+        printf("The analysis could not be run (out of memory?).\n");
+    }
+    else
+    {
+        print_tolerance_result(&result);
+    }
+    rexpr_free(&expr);
+}
+
+// Suggest combinations of E12/E24/E96 parts that come closest to a target resistance
+void handle_eseries_search(void)
+{
+    static const char *const names[] = { "E12", "E24", "E96" };
+    double target;
+    int series, parts, c;
+    EMatch matches[10];
+    
+    printf("\n=== Standard-Value Search ===\n");
+    do
+    {
+        printf("Target resistance in ohms: ");
+        if (scanf("%lf", &target) == EOF)
+        {
+            return;
+        }
+        while ((c = getchar()) != '\n' && c != EOF);
+    }
+    while (!is_positive((float)target, "the target resistance"));
+    do
+    {
+        printf("Series: 1 = E12, 2 = E24, 3 = E96: ");
+        if (scanf("%d", &series) == EOF)
+        {
+            return;
+        }
+        while ((c = getchar()) != '\n' && c != EOF);
+    }
+    while (series < 1 || series > 3);
+    do
+    {
+        printf("Use at most how many parts? (1-%d): ", ESERIES_MAX_PARTS);
+        if (scanf("%d", &parts) == EOF)
+        {
+            return;
+        }
+        while ((c = getchar()) != '\n' && c != EOF);
+    }
+    while (parts < 1 || parts > ESERIES_MAX_PARTS);
+    
+    int found = eseries_search((ESeries)(series - 1), target, parts, 10, matches);
+    if (found <= 0)
+    {
+        printf("No combination found.\n");
+        return;
+    }
+    printf("\nClosest %s combinations for %g ohms:\n\n", names[series - 1], target);
+    for (int i = 0; i < found; i++)
+    {
+        char text[96];
+        eseries_format(&matches[i], text, sizeof(text));
+        printf("%2d. %-28s = %12.4f ohms  (%+.4f%%)\n", i + 1, text, matches[i].value,
+               100 * (matches[i].value - target) / target);
+    }
+}
+
+void handle_mixed_connection(ResistorContext *ctx, float resistors[], int n)
 {
     printf("\n=== Mixed Connection Configuration ===\n");
     
@@ -238,7 +661,7 @@ void handle_mixed_connection(float resistors[], int n)
     
     printf("\nGroups connected in series.\n");
     printf("The circuit diagram is shown below:\n\n");
-    draw_mixed_circuit(group_sizes, connection_types, group_count);
+    draw_mixed_circuit(ctx, group_sizes, connection_types, group_count);
     printf("\nTotal Resistance: %.4f ohms\n", total_resistance);
 }
 
@@ -273,252 +696,30 @@ float calc_mixed_resistance(float resistors[], int resistor_count, int group_siz
     return total_resistance;
 }
 
-void draw_mixed_circuit(int group_sizes[], int connection_types[], int group_count) {
-    save_mixed_diagram(group_sizes, connection_types, group_count);
-    display_diagram();
+void resistor_context_init(ResistorContext *ctx) {
+    diagram_init(&ctx->diagram);
 }
 
-void save_mixed_diagram(int group_sizes[], int connection_types[], int group_count) {
-    diagram_line_count = 0;
+void resistor_context_free(ResistorContext *ctx) {
+    diagram_free(&ctx->diagram);
+}
 
-    int parallel_group_idx = -1;
-    int series_before = 0;
-    
-    for(int i = 0; i < group_count; i++) 
-    {
-        if(connection_types[i] == 2) 
-        {
-            parallel_group_idx = i;
-            break;
-        }
-        series_before += group_sizes[i];
-    }
-    
-    if(parallel_group_idx == -1) 
-    {
-        int total_resistors = 0;
-        for(int i = 0; i < group_count; i++) {
-            total_resistors += group_sizes[i];
-        }
-        save_series_diagram(total_resistors);
-        return;
+void draw_mixed_circuit(ResistorContext *ctx, const int group_sizes[], const int connection_types[], int group_count) {
+    if (save_mixed_diagram(ctx, group_sizes, connection_types, group_count) == 0) {
+        display_diagram(ctx);
     }
-    
-    int parallel_size = group_sizes[parallel_group_idx];
+}
 
-    int spaces_before = 8 * series_before;
-    char space_str[100] = "";
-    for(int i = 0; i < spaces_before; i++) 
-    {
-        strcat(space_str, " ");
-    }
-    
-    if(parallel_size == 2)
-    {
-        char line[MAX_LINE_LENGTH];
-
-        strcpy(line, space_str);
-        strcat(line, "   ");
-        strcat(line, WIRE);
-        strcat(line, RESISTOR);
-        strcat(line, WIRE);
-        strcat(line, "   ");
-        strcpy(circuit_diagram[diagram_line_count++], line);
-
-        strcpy(line, space_str);
-        strcat(line, "  ");
-        strcat(line, PARALLEL_VERT);
-        strcat(line, "          ");
-        strcat(line, PARALLEL_VERT);
-        strcpy(circuit_diagram[diagram_line_count++], line);
-
-        strcpy(line, "");
-        for(int i = 0; i < parallel_group_idx; i++) 
-        {
-            for(int j = 0; j < group_sizes[i]; j++) 
-            {
-                strcat(line, WIRE);
-                strcat(line, RESISTOR);
-            }
-        }
-        strcat(line, WIRE);
-        strcat(line, NODE);
-        strcat(line, WIRE);
-        strcat(line, RESISTOR);
-        strcat(line, WIRE);
-        strcat(line, NODE);
-        strcat(line, WIRE);
-
-        for(int i = parallel_group_idx + 1; i < group_count; i++) 
-        {
-            for(int j = 0; j < group_sizes[i]; j++) 
-            {
-                strcat(line, WIRE);
-                strcat(line, RESISTOR);
-            }
-        }
-        strcat(line, WIRE);
-        strcpy(circuit_diagram[diagram_line_count++], line);
-
-        strcpy(line, space_str);
-        strcat(line, "  ");
-        strcat(line, PARALLEL_VERT);
-        strcat(line, "          ");
-        strcat(line, PARALLEL_VERT);
-        strcpy(circuit_diagram[diagram_line_count++], line);
-
-        strcpy(line, space_str);
-        strcat(line, "   ");
-        strcat(line, WIRE);
-        strcat(line, RESISTOR);
-        strcat(line, WIRE);
-        strcat(line, "   ");
-        strcpy(circuit_diagram[diagram_line_count++], line);
-    }
-    else if(parallel_size == 3) 
-    {
-        char line[MAX_LINE_LENGTH];
-
-        strcpy(line, space_str);
-        strcat(line, "   ");
-        strcat(line, WIRE);
-        strcat(line, RESISTOR);
-        strcat(line, WIRE);
-        strcat(line, "   ");
-        strcpy(circuit_diagram[diagram_line_count++], line);
-
-        strcpy(line, space_str);
-        strcat(line, "  ");
-        strcat(line, PARALLEL_VERT);
-        strcat(line, "          ");
-        strcat(line, PARALLEL_VERT);
-        strcpy(circuit_diagram[diagram_line_count++], line);
-
-        strcpy(line, "");
-        for(int i = 0; i < parallel_group_idx; i++) {
-            for(int j = 0; j < group_sizes[i]; j++) {
-                strcat(line, WIRE);
-                strcat(line, RESISTOR);
-            }
-        }
-        strcat(line, WIRE);
-        strcat(line, NODE);
-        strcat(line, WIRE);
-        strcat(line, RESISTOR);
-        strcat(line, WIRE);
-        strcat(line, NODE);
-        
-        for(int i = parallel_group_idx + 1; i < group_count; i++) {
-            for(int j = 0; j < group_sizes[i]; j++) {
-                strcat(line, WIRE);
-                strcat(line, RESISTOR);
-            }
-        }
-        strcat(line, WIRE);
-        strcpy(circuit_diagram[diagram_line_count++], line);
-
-        strcpy(line, space_str);
-        strcat(line, "  ");
-        strcat(line, PARALLEL_VERT);
-        strcat(line, "          ");
-        strcat(line, PARALLEL_VERT);
-        strcpy(circuit_diagram[diagram_line_count++], line);
-        
-        strcpy(line, space_str);
-        strcat(line, "   ");
-        strcat(line, WIRE);
-        strcat(line, RESISTOR);
-        strcat(line, WIRE);
-        strcat(line, "   ");
-        strcpy(circuit_diagram[diagram_line_count++], line);
-    }
-    else 
-    {
-        char line[MAX_LINE_LENGTH];
-
-        strcpy(line, space_str);
-        strcat(line, "   ");
-        strcat(line, WIRE);
-        strcat(line, RESISTOR);
-        strcat(line, WIRE);
-        strcat(line, "   ");
-        strcpy(circuit_diagram[diagram_line_count++], line);
-
-        strcpy(line, space_str);
-        strcat(line, "  ");
-        strcat(line, PARALLEL_VERT);
-        strcat(line, "          ");
-        strcat(line, PARALLEL_VERT);
-        strcpy(circuit_diagram[diagram_line_count++], line);
-
-        strcpy(line, space_str);
-        strcat(line, "   ");
-        strcat(line, WIRE);
-        strcat(line, RESISTOR);
-        strcat(line, WIRE);
-        strcat(line, "   ");
-        strcpy(circuit_diagram[diagram_line_count++], line);
-
-        strcpy(line, space_str);
-        strcat(line, "  ");
-        strcat(line, PARALLEL_VERT);
-        strcat(line, "          ");
-        strcat(line, PARALLEL_VERT);
-        strcpy(circuit_diagram[diagram_line_count++], line);
-        
-        strcpy(line, "");
-        for(int i = 0; i < parallel_group_idx; i++) {
-            for(int j = 0; j < group_sizes[i]; j++) {
-                strcat(line, WIRE);
-                strcat(line, RESISTOR);
-            }
-        }
-        strcat(line, WIRE);
-        strcat(line, NODE);
-        strcat(line, WIRE);
-        strcat(line, RESISTOR);
-        strcat(line, WIRE);
-        strcat(line, NODE);
-        
-        for(int i = parallel_group_idx + 1; i < group_count; i++) {
-            for(int j = 0; j < group_sizes[i]; j++) {
-                strcat(line, WIRE);
-                strcat(line, RESISTOR);
-            }
-        }
-        strcat(line, WIRE);
-        strcpy(circuit_diagram[diagram_line_count++], line);
-        
-        strcpy(line, space_str);
-        strcat(line, "  ");
-        strcat(line, PARALLEL_VERT);
-        strcat(line, "          ");
-        strcat(line, PARALLEL_VERT);
-        strcpy(circuit_diagram[diagram_line_count++], line);
-        
-        strcpy(line, space_str);
-        strcat(line, "   ");
-        strcat(line, WIRE);
-        strcat(line, RESISTOR);
-        strcat(line, WIRE);
-        strcat(line, "   ");
-        strcpy(circuit_diagram[diagram_line_count++], line);
-        
-        strcpy(line, space_str);
-        strcat(line, "  ");
-        strcat(line, PARALLEL_VERT);
-        strcat(line, "          ");
-        strcat(line, PARALLEL_VERT);
-        strcpy(circuit_diagram[diagram_line_count++], line);
-        
-        strcpy(line, space_str);
-        strcat(line, "   ");
-        strcat(line, WIRE);
-        strcat(line, RESISTOR);
-        strcat(line, WIRE);
-        strcat(line, "   ");
-        strcpy(circuit_diagram[diagram_line_count++], line);
+// Replace ctx->diagram with the drawing of the groups. Returns 0, or -1 on a bad group or out of memory.
+int save_mixed_diagram(ResistorContext *ctx, const int group_sizes[], const int connection_types[], int group_count) {
+    RExpr expr;
+    ctx->diagram.length = 0;
+    if (rexpr_from_groups(group_sizes, connection_types, group_count, &expr) != 0) {
+        return -1;
     }
+    int status = diagram_render(&expr, &ctx->diagram);
+    rexpr_free(&expr);
+    return status;
 }
 
 int is_positive(float val, const char *param_name) 
@@ -538,188 +739,316 @@ float calc_series(float resistors[], int resistor_count)
     for (int i = 0; i < resistor_count; i++) {
         total += resistors[i];
     }
-    return total;
+    return total;
+}
+
+float calc_parallel(float resistors[], int resistor_count) 
+{
+    float reciprocal_sum = 0.0;
+    //Iterate through all resistors and sum the reciprocals of each resistor (the reciprocal of the total parallel resistance equals the sum of the reciprocals of each resistor)
+    for (int i = 0; i < resistor_count; i++) {
+        reciprocal_sum += 1.0 / resistors[i];
+    }
+    return 1.0 / reciprocal_sum;
+}
+
+// Draw a single group circuit (parameters: number of resistors in the group, connection mode, group serial number)
+void draw_group(ResistorContext *ctx, int group_size, int conn_type, int group_idx) 
+{
+    printf("\nResistor Group %d:\n", group_idx);
+    if (conn_type == 1) 
+    {  // series
+        draw_series_group(ctx, group_size);
+    } 
+    else if (conn_type == 2) 
+    {  // parallel
+        draw_parallel_group(ctx, group_size);
+    }
+    printf("\n");
+}
+
+// Draw a single group circuit
+void draw_series_group(ResistorContext *ctx, int group_size) 
+{
+    if (save_series_diagram(ctx, group_size) == 0)
+    {
+        display_diagram(ctx);
+    }
+}
+
+// Draw a parallel circuit group
+void draw_parallel_group(ResistorContext *ctx, int group_size) 
+{
+    if (save_parallel_diagram(ctx, group_size) == 0)
+    {
+        display_diagram(ctx);
+    }
+}
+
+void display_diagram(const ResistorContext *ctx) // To display ctx->diagram in one write
+{
+    fflush(stdout);
+    diagram_write(STDOUT_FILENO, &ctx->diagram);
+}
+
+int save_series_diagram(ResistorContext *ctx, int group_size) // To save the diagram into ctx->diagram
+{
+    int conn_type = 1;
+    return save_mixed_diagram(ctx, &group_size, &conn_type, 1);
+}
+
+int save_parallel_diagram(ResistorContext *ctx, int group_size) // To save the diagram into ctx->diagram
+{
+    int conn_type = 2;
+    return save_mixed_diagram(ctx, &group_size, &conn_type, 1);
+}
+// End of menu 1
+
+void menu_item_2(void) 
+{
+    unit_converter(); 
+}
+
+// Perfect hash over unit_database names (case-insensitive).
+// Built once: a seed is searched so every name lands in its own slot, so a lookup is one
+// hash, one probe and one compare, with no allocation or copying of the input.
+#define UNIT_HASH_SIZE 64   // power of two, comfortably larger than the database
+#define UNIT_HASH_MAX_SEEDS (1u << 20)
+
+// Entries other than the NULL terminator; the slots and unit_local_id are indexed by them
+_Static_assert(sizeof(unit_database) / sizeof(unit_database[0]) - 1 <= UNIT_HASH_SIZE / 2,
+               "unit_database has outgrown UNIT_HASH_SIZE");
+
+static signed char unit_hash_slots[UNIT_HASH_SIZE];  // index into unit_database, -1 = empty
+static unsigned unit_hash_seed;
+static pthread_once_t unit_tables_once = PTHREAD_ONCE_INIT;
+
+// ASCII lowercase without the locale lookup of tolower()
+static inline unsigned char unit_fold(char c)
+{
+    return (c >= 'A' && c <= 'Z') ? (unsigned char)(c + ('a' - 'A')) : (unsigned char)c;
+}
+
+// FNV-1a over the first len characters of the name, lowercased
+static unsigned unit_name_hash(const char *name, size_t len, unsigned seed)
+{
+    unsigned h = 2166136261u ^ seed;
+    for (size_t i = 0; i < len; i++) {
+        h ^= unit_fold(name[i]);
+        h *= 16777619u;
+    }
+    return h ^ (h >> 15);
+}
+
+// Aborts if no seed in UNIT_HASH_MAX_SEEDS works, rather than looking units up wrongly
+static void build_unit_hash(void)
+{
+    for (unsigned seed = 0; seed < UNIT_HASH_MAX_SEEDS; seed++) {
+        int collision = 0;
+        memset(unit_hash_slots, -1, sizeof(unit_hash_slots));
+        for (int i = 0; unit_database[i].name != NULL && !collision; i++) {
+            const char *name = unit_database[i].name;
+            unsigned slot = unit_name_hash(name, strlen(name), seed) & (UNIT_HASH_SIZE - 1);
+            if (unit_hash_slots[slot] >= 0) {
+                collision = 1;
+            } else {
+                unit_hash_slots[slot] = (signed char)i;
+            }
+        }
+        if (!collision) {
+            unit_hash_seed = seed;
+            return;
+        }
+    }
+    fprintf(stderr, "unit table: no collision-free hash seed for %d slots; raise UNIT_HASH_SIZE\n",
+            UNIT_HASH_SIZE);
+    abort();
+}
+
+// Dense per-category tables: unit a converts to unit b as value * unit_factor + unit_offset
+// on the linear side (a, b are the units' positions within their category). Filled once with the hash.
+// For two log units the offset is the dB difference of their reference levels.
+#define UNIT_MAX_PER_CATEGORY 32
+
+static double unit_factor[UNIT_UNKNOWN][UNIT_MAX_PER_CATEGORY][UNIT_MAX_PER_CATEGORY];
+static double unit_offset[UNIT_UNKNOWN][UNIT_MAX_PER_CATEGORY][UNIT_MAX_PER_CATEGORY];
+static int unit_local_id[UNIT_HASH_SIZE];   // database index -> position within its category
+static int unit_count;
+
+static void build_factor_tables(void)
+{
+    int per_category[UNIT_UNKNOWN] = {0};
+
+    for (unit_count = 0; unit_database[unit_count].name != NULL; unit_count++) {
+        UnitType type = unit_database[unit_count].type;
+        unit_local_id[unit_count] = per_category[type]++;
+    }
+
+    for (int a = 0; a < unit_count; a++) {
+        for (int b = 0; b < unit_count; b++) {
+            const UnitInfo *from = &unit_database[a];
+            const UnitInfo *to = &unit_database[b];
+            if (from->type != to->type) {
+                continue;
+            }
+            double *factor = &unit_factor[from->type][unit_local_id[a]][unit_local_id[b]];
+            double *offset = &unit_offset[from->type][unit_local_id[a]][unit_local_id[b]];
+            if (from->kind == UNIT_LOG && to->kind == UNIT_LOG) {
+                *factor = 1.0;
+                *offset = 10.0 * log10(from->to_base / to->to_base);
+            } else {
+                *factor = from->to_base / to->to_base;
+                *offset = (from->offset - to->offset) / to->to_base;
+            }
+        }
+    }
 }
 
-float calc_parallel(float resistors[], int resistor_count) 
+static void build_unit_tables(void)
 {
-    float reciprocal_sum = 0.0;
-    //Iterate through all resistors and sum the reciprocals of each resistor (the reciprocal of the total parallel resistance equals the sum of the reciprocals of each resistor)
-    for (int i = 0; i < resistor_count; i++) {
-        reciprocal_sum += 1.0 / resistors[i];
-    }
-    return 1.0 / reciprocal_sum;
+    build_unit_hash();
+    build_factor_tables();
 }
 
-// Draw a single group circuit (parameters: number of resistors in the group, connection mode, group serial number)
-void draw_group(int group_size, int conn_type, int group_idx) 
-{
-    printf("\nResistor Group %d:\n", group_idx);
-    if (conn_type == 1) 
-    {  // series
-        draw_series_group(group_size);
-    } 
-    else if (conn_type == 2) 
-    {  // parallel
-        draw_parallel_group(group_size);
+// Find unit information by a name that need not be NUL-terminated; NULL for unknown units
+static const UnitInfo* find_unit_info_n(const char* unit_name, size_t len) {
+    pthread_once(&unit_tables_once, build_unit_tables);
+
+    unsigned slot = unit_name_hash(unit_name, len, unit_hash_seed) & (UNIT_HASH_SIZE - 1);
+    int index = unit_hash_slots[slot];
+    if (index < 0) {
+        return NULL;
     }
-    printf("\n");
+
+    // Database names are stored lowercase, so compare the input folded to lowercase
+    const char *name = unit_database[index].name;
+    for (size_t i = 0; i < len; i++) {
+        if (unit_fold(unit_name[i]) != (unsigned char)name[i]) {
+            return NULL;
+        }
+    }
+    return name[len] == '\0' ? &unit_database[index] : NULL;
 }
 
-// Draw a single group circuit
-void draw_series_group(int group_size) 
-{
-    save_series_diagram(group_size);
-    display_diagram();
+// Find unit information; returns NULL for unknown units
+const UnitInfo* find_unit_info(const char* unit_name) {
+    return find_unit_info_n(unit_name, strlen(unit_name));
 }
 
-// Draw a parallel circuit group
-void draw_parallel_group(int group_size) 
+// Small integer ID of a unit (its database position), or -1 if unknown
+int unit_id(const char *unit_name)
 {
-    save_parallel_diagram(group_size);
-    display_diagram();
+    const UnitInfo *info = find_unit_info(unit_name);
+    return info ? (int)(info - unit_database) : -1;
 }
 
-void display_diagram(void) // To display each line of circuit_diagram[]
+// unit_id() for a name given by pointer and length, e.g. a token inside an input buffer
+int unit_id_n(const char *unit_name, size_t len)
 {
-    for (int i = 0; i < diagram_line_count; i++) 
-    {
-        printf("%s\n", circuit_diagram[i]);
-    }
+    const UnitInfo *info = find_unit_info_n(unit_name, len);
+    return info ? (int)(info - unit_database) : -1;
 }
 
-void save_series_diagram(int group_size) // To save the diagram into circuit_diagram[]
+// Resolve a pair of unit IDs into a reusable conversion handle.
+// Returns 0 on success, -1 for unknown IDs or units of different types.
+int resolve_conversion_ids(int from_id, int to_id, UnitConversion *conv)
 {
-    diagram_line_count = 0;
-    char line[MAX_LINE_LENGTH];
-    snprintf(line, MAX_LINE_LENGTH, "%s", WIRE);
-    
-    for (int i = 0; i < group_size; i++) 
-    {
-        strcat(line, RESISTOR);
-        strcat(line, WIRE);
+    pthread_once(&unit_tables_once, build_unit_tables);
+
+    if (from_id < 0 || to_id < 0 || from_id >= unit_count || to_id >= unit_count) {
+        return -1;
+    }
+    UnitType type = unit_database[from_id].type;
+    if (type != unit_database[to_id].type) {
+        return -1;  // Unit type mismatch
     }
-    strcpy(circuit_diagram[diagram_line_count++], line);
-}
 
-void save_parallel_diagram(int group_size) // To save the diagram into circuit_diagram[]
-{
-    diagram_line_count = 0;
-    switch(group_size) 
-    {
-        case 2:
-        {
-            snprintf(circuit_diagram[diagram_line_count++], MAX_LINE_LENGTH,"   %s%s%s   ", WIRE, RESISTOR, WIRE);
-            snprintf(circuit_diagram[diagram_line_count++], MAX_LINE_LENGTH,"  %s          %s",PARALLEL_VERT,PARALLEL_VERT);
-            snprintf(circuit_diagram[diagram_line_count++], MAX_LINE_LENGTH, "%s%s          %s%s", WIRE, NODE, NODE, WIRE);
-            snprintf(circuit_diagram[diagram_line_count++], MAX_LINE_LENGTH,"  %s          %s", PARALLEL_VERT, PARALLEL_VERT);
-            snprintf(circuit_diagram[diagram_line_count++], MAX_LINE_LENGTH,"   %s%s%s   ", WIRE, RESISTOR, WIRE);
-            break;
-        }
-        case 3:
-        {
-            snprintf(circuit_diagram[diagram_line_count++], MAX_LINE_LENGTH,"   %s%s%s   ", WIRE, RESISTOR, WIRE);
-            snprintf(circuit_diagram[diagram_line_count++], MAX_LINE_LENGTH,"  %s          %s",PARALLEL_VERT,PARALLEL_VERT);
-            snprintf(circuit_diagram[diagram_line_count++], MAX_LINE_LENGTH,"%s%s%s%s%s%s%s", WIRE, NODE, WIRE, RESISTOR, WIRE, NODE, WIRE);
-            snprintf(circuit_diagram[diagram_line_count++], MAX_LINE_LENGTH,"  %s          %s",PARALLEL_VERT,PARALLEL_VERT);
-            snprintf(circuit_diagram[diagram_line_count++], MAX_LINE_LENGTH,"   %s%s%s   ", WIRE, RESISTOR, WIRE);
-            break;
-        }
-        case 4:
-        {
-            snprintf(circuit_diagram[diagram_line_count++], MAX_LINE_LENGTH,"   %s%s%s   ", WIRE, RESISTOR, WIRE);
-            snprintf(circuit_diagram[diagram_line_count++], MAX_LINE_LENGTH,"  %s          %s",PARALLEL_VERT,PARALLEL_VERT);
-            snprintf(circuit_diagram[diagram_line_count++], MAX_LINE_LENGTH,"   %s%s%s   ", WIRE, RESISTOR, WIRE);
-            snprintf(circuit_diagram[diagram_line_count++], MAX_LINE_LENGTH,"  %s          %s",PARALLEL_VERT,PARALLEL_VERT);
-            snprintf(circuit_diagram[diagram_line_count++], MAX_LINE_LENGTH, "%s%s          %s%s", WIRE, NODE, NODE, WIRE);
-            snprintf(circuit_diagram[diagram_line_count++], MAX_LINE_LENGTH,"  %s          %s",PARALLEL_VERT,PARALLEL_VERT);
-            snprintf(circuit_diagram[diagram_line_count++], MAX_LINE_LENGTH,"   %s%s%s   ", WIRE, RESISTOR, WIRE);
-            snprintf(circuit_diagram[diagram_line_count++], MAX_LINE_LENGTH,"  %s          %s",PARALLEL_VERT,PARALLEL_VERT);
-            snprintf(circuit_diagram[diagram_line_count++], MAX_LINE_LENGTH,"   %s%s%s   ", WIRE, RESISTOR, WIRE);
-            break;
-        }
-        case 5:
-        {
-            snprintf(circuit_diagram[diagram_line_count++], MAX_LINE_LENGTH,"   %s%s%s   ", WIRE, RESISTOR, WIRE);
-            snprintf(circuit_diagram[diagram_line_count++], MAX_LINE_LENGTH,"  %s          %s",PARALLEL_VERT,PARALLEL_VERT);
-            snprintf(circuit_diagram[diagram_line_count++], MAX_LINE_LENGTH,"   %s%s%s   ", WIRE, RESISTOR, WIRE);
-            snprintf(circuit_diagram[diagram_line_count++], MAX_LINE_LENGTH,"  %s          %s",PARALLEL_VERT,PARALLEL_VERT);
-            snprintf(circuit_diagram[diagram_line_count++], MAX_LINE_LENGTH,"%s%s%s%s%s%s%s", WIRE, NODE, WIRE, RESISTOR, WIRE, NODE, WIRE);
-            snprintf(circuit_diagram[diagram_line_count++], MAX_LINE_LENGTH,"  %s          %s",PARALLEL_VERT,PARALLEL_VERT);
-            snprintf(circuit_diagram[diagram_line_count++], MAX_LINE_LENGTH,"   %s%s%s   ", WIRE, RESISTOR, WIRE);
-            snprintf(circuit_diagram[diagram_line_count++], MAX_LINE_LENGTH,"  %s          %s",PARALLEL_VERT,PARALLEL_VERT);
-            snprintf(circuit_diagram[diagram_line_count++], MAX_LINE_LENGTH,"   %s%s%s   ", WIRE, RESISTOR, WIRE);
-            break;
-        }
+    conv->factor = unit_factor[type][unit_local_id[from_id]][unit_local_id[to_id]];
+    conv->offset = unit_offset[type][unit_local_id[from_id]][unit_local_id[to_id]];
+    conv->from_id = from_id;
+    conv->to_id = to_id;
+
+    // Pick the code path: log units go through the linear base on the way in or out
+    UnitKind from_kind = unit_database[from_id].kind;
+    UnitKind to_kind = unit_database[to_id].kind;
+    if (from_kind == UNIT_LOG && to_kind != UNIT_LOG) {
+        conv->kind = CONV_FROM_DB;
+    } else if (to_kind == UNIT_LOG && from_kind != UNIT_LOG) {
+        conv->kind = CONV_TO_DB;
+    } else if (conv->offset != 0.0) {
+        conv->kind = CONV_AFFINE;
+    } else {
+        conv->kind = CONV_LINEAR;
     }
+    return 0;
 }
-// End of menu 1
 
-void menu_item_2(void) 
+int resolve_conversion(const char *from_unit, const char *to_unit, UnitConversion *conv)
 {
-    unit_converter(); 
+    return resolve_conversion_ids(unit_id(from_unit), unit_id(to_unit), conv);
 }
 
-// Find unit information
-const UnitInfo* find_unit_info(const char* unit_name) {
-    char lower_unit[20];
-    strcpy(lower_unit, unit_name);
-    for (char *p = lower_unit; *p; p++) *p = tolower(*p);
-    
-    for (int i = 0; unit_database[i].name != NULL; i++) {
-        if (strcmp(lower_unit, unit_database[i].name) == 0) {
-            return &unit_database[i];
-        }
+// Convert one value with a resolved handle
+double apply_conversion(const UnitConversion *conv, double value)
+{
+    switch (conv->kind) {
+        case CONV_AFFINE:  return value * conv->factor + conv->offset;
+        case CONV_FROM_DB: return pow(10.0, value / 10.0) * conv->factor;
+        case CONV_TO_DB:   return 10.0 * log10(value * conv->factor);
+        default:           return value * conv->factor;
     }
-    return NULL;
 }
 
 // Generic conversion function
 double convert_units(double value, const char* from_unit, const char* to_unit) {
-    const UnitInfo* from_info = find_unit_info(from_unit);
-    const UnitInfo* to_info = find_unit_info(to_unit);
-    
-    if (!from_info || !to_info) {
-        return NAN;  // Unit not found
+    UnitConversion conv;
+    if (resolve_conversion(from_unit, to_unit, &conv) != 0) {
+        return NAN;  // Unit not found or type mismatch
     }
-    
-    if (from_info->type != to_info->type) {
-        return NAN;  // Unit type mismatch
+    return apply_conversion(&conv, value);
+}
+
+// Formula text for a resolved conversion
+static void describe_conversion(const UnitConversion *handle, char *explanation) {
+    const UnitConversion conv = *handle;
+    const char *from = unit_database[conv.from_id].name;
+    const char *to = unit_database[conv.to_id].name;
+    
+    // Generate explanation text for the conversion's code path
+    switch (conv.kind) {
+        case CONV_AFFINE:
+            if (conv.factor == 1.0) {
+                sprintf(explanation, "%s = %s %+.6g", to, from, conv.offset);
+            } else {
+                sprintf(explanation, "%s = %s x %.6g %+.6g", to, from, conv.factor, conv.offset);
+            }
+            break;
+        case CONV_FROM_DB:
+            sprintf(explanation, "%s = 10^(%s/10) x %.6g", to, from, conv.factor);
+            break;
+        case CONV_TO_DB:
+            sprintf(explanation, "%s = 10 x log10(%s x %.6g)", to, from, conv.factor);
+            break;
+        default:
+            sprintf(explanation, "1 %s = %.6g %s", from, conv.factor, to);
+            break;
     }
-    
-    // Generic conversion formula: value * (from→base) / (to→base)
-    double value_in_base = value * from_info->to_base;
-    return value_in_base / to_info->to_base;
 }
 
 // Get conversion explanation
 void get_conversion_explanation(const char* from_unit, const char* to_unit, char* explanation) {
-    const UnitInfo* from_info = find_unit_info(from_unit);
-    const UnitInfo* to_info = find_unit_info(to_unit);
+    UnitConversion conv;
     
-    if (!from_info || !to_info || from_info->type != to_info->type) {
+    if (resolve_conversion(from_unit, to_unit, &conv) != 0) {
         strcpy(explanation, "Unsupported conversion");
         return;
     }
-    
-    // Generate explanation text
-    if (from_info->to_base == 1.0) {
-        // Converting from base unit
-        sprintf(explanation, "1 %s = %.6g %s", 
-                to_info->base_unit, to_info->to_base, to_info->name);
-    } else if (to_info->to_base == 1.0) {
-        // Converting to base unit
-        sprintf(explanation, "1 %s = %.6g %s", 
-                from_info->name, 1.0/from_info->to_base, from_info->base_unit);
-    } else {
-        // Cross-unit conversion
-        sprintf(explanation, "1 %s = %.6g %s", 
-                from_info->name, to_info->to_base/from_info->to_base, to_info->name);
-    }
+    describe_conversion(&conv, explanation);
 }
 
 void unit_converter(void) {
-    char input[100];
+    char *input = NULL;
+    size_t input_capacity = 0;
     
     printf("\n=====================================\n");
     printf("        Unit Converter\n");
@@ -738,6 +1067,7 @@ void unit_converter(void) {
                 case UNIT_TIME: printf("Time: "); break;
                 case UNIT_STORAGE: printf("Storage: "); break;
                 case UNIT_ANGLE: printf("Angle: "); break;
+                case UNIT_TEMPERATURE: printf("Temperature: "); break;
                 default: break;
             }
         }
@@ -745,13 +1075,16 @@ void unit_converter(void) {
     }
     
     printf("\n\nInput format: value unit to target_unit");
-    printf("\nExample: 1 MB to Byte, 10 dBm to mW, 60 RPM to Hz");
+    printf("\nExample: 1 MB to Byte, 10 dBm to mW, 60 RPM to Hz, 100 C to F");
     printf("\nEnter 'back' to return to main menu");
     printf("\n=====================================\n");
     
     while (1) {
         printf("\n> ");
-        fgets(input, sizeof(input), stdin);
+        ssize_t len = getline(&input, &input_capacity, stdin);
+        if (len < 0) {
+            break;  // End of input
+        }
         input[strcspn(input, "\n")] = 0;
         
         if (strcmp(input, "back") == 0) {
@@ -759,18 +1092,17 @@ void unit_converter(void) {
             break;
         }
         
-        // Parse input
-        double value;
-        char from_unit[20], to_unit[20];
+        // Parse input in place (any token length, no copies)
+        UnitRequest req;
+        UnitConversion conv;
         
-        if (sscanf(input, "%lf %s to %s", &value, from_unit, to_unit) == 3) {
-            double result = convert_units(value, from_unit, to_unit);
-            
-            if (!isnan(result)) {
+        if (parse_unit_request(input, strlen(input), &req) == 0) {
+            if (resolve_conversion_ids(unit_id_n(req.from, req.from_len),
+                                       unit_id_n(req.to, req.to_len), &conv) == 0) {
                 char explanation[100];
-                get_conversion_explanation(from_unit, to_unit, explanation);
+                describe_conversion(&conv, explanation);
                 
-                printf("Conversion result: %.6g %s\n", result, to_unit);
+                printf("Conversion result: %.6g %.*s\n", apply_conversion(&conv, req.value), req.to_len, req.to);
                 printf("Conversion formula: %s\n", explanation);
             } else {
                 printf("Error: Unsupported unit conversion\n");
@@ -783,6 +1115,7 @@ void unit_converter(void) {
             printf("Example: 10 dBm to mW\n");
         }
     }
+    free(input);
 }
 
 //End of menu 2
@@ -805,11 +1138,16 @@ void linear_algebra_library(void) {
         printf("1. Matrix Addition\n");
         printf("2. Matrix Multiplication\n");
         printf("3. Determinant Calculation\n");
-        printf("4. Return to Main Menu\n");
-        printf("Enter your choice (1-4): ");
+        printf("4. Solve Linear System (A X = B)\n");
+        printf("5. Matrix Inverse\n");
+        printf("6. Least Squares Fit (QR)\n");
+        printf("7. Sparse Matrix File (Matrix Market)\n");
+        printf("8. Elementwise Expression (e.g. 2*A + B - C)\n");
+        printf("9. Return to Main Menu\n");
+        printf("Enter your choice (1-9): ");
         
         if (scanf("%d", &choice) != 1) {
-            printf("Invalid input! Please enter a number 1-4.\n");
+            printf("Invalid input! Please enter a number 1-9.\n");
             while (getchar() != '\n');
             continue;
         }
@@ -825,75 +1163,50 @@ void linear_algebra_library(void) {
                 matrix_determinant();
                 break;
             case 4:
+                matrix_solve();
+                break;
+            case 5:
+                matrix_inverse();
+                break;
+            case 6:
+                matrix_least_squares();
+                break;
+            case 7:
+                sparse_matrix_file();
+                break;
+            case 8:
+                matrix_expression();
+                break;
+            case 9:
                 printf("Returning to main menu...\n");
                 while (getchar() != '\n');
                 return;
             default:
-                printf("Invalid choice! Please select 1-4.\n");
-        }
-    }
-}
-
-// Input matrix from user
-void input_matrix(Matrix *mat, const char *name) {
-    printf("\n=== Input Matrix %s ===\n", name);
-    
-    printf("Enter number of rows (1-%d): ", MAX_SIZE);
-    while (scanf("%d", &mat->rows) != 1 || mat->rows < 1 || mat->rows > MAX_SIZE) {
-        printf("Invalid input! Enter number of rows (1-%d): ", MAX_SIZE);
-        while (getchar() != '\n');
-    }
-    
-    printf("Enter number of columns (1-%d): ", MAX_SIZE);
-    while (scanf("%d", &mat->cols) != 1 || mat->cols < 1 || mat->cols > MAX_SIZE) {
-        printf("Invalid input! Enter number of columns (1-%d): ", MAX_SIZE);
-        while (getchar() != '\n');
-    }
-    
-    printf("Enter matrix elements row by row:\n");
-    for (int i = 0; i < mat->rows; i++) {
-        printf("Row %d: ", i + 1);
-        for (int j = 0; j < mat->cols; j++) {
-            while (scanf("%lf", &mat->data[i][j]) != 1) {
-                printf("Invalid input! Enter a valid number: ");
-                while (getchar() != '\n');
-            }
-        }
-    }
-}
-
-// Print matrix in formatted way
-void print_matrix(Matrix mat) {
-    printf("\nMatrix (%dx%d):\n", mat.rows, mat.cols);
-    for (int i = 0; i < mat.rows; i++) {
-        printf("| ");
-        for (int j = 0; j < mat.cols; j++) {
-            printf("%8.2f ", mat.data[i][j]);
+                printf("Invalid choice! Please select 1-9.\n");
         }
-        printf("|\n");
     }
 }
 
 // Check if matrix is square
-int is_square_matrix(Matrix mat) {
-    return mat.rows == mat.cols;
+int is_square_matrix(const Matrix *mat) {
+    return mat->rows == mat->cols;
 }
 
 // Create submatrix for determinant calculation
-Matrix create_submatrix(Matrix mat, int exclude_row, int exclude_col) {
+Matrix create_submatrix(const Matrix *mat, int exclude_row, int exclude_col) {
     Matrix submat;
-    submat.rows = mat.rows - 1;
-    submat.cols = mat.cols - 1;
+    submat.rows = mat->rows - 1;
+    submat.cols = mat->cols - 1;
     
     int sub_i = 0;
-    for (int i = 0; i < mat.rows; i++) {
+    for (int i = 0; i < mat->rows; i++) {
         if (i == exclude_row) continue;
         
         int sub_j = 0;
-        for (int j = 0; j < mat.cols; j++) {
+        for (int j = 0; j < mat->cols; j++) {
             if (j == exclude_col) continue;
             
-            submat.data[sub_i][sub_j] = mat.data[i][j];
+            submat.data[sub_i][sub_j] = mat->data[i][j];
             sub_j++;
         }
         sub_i++;
@@ -902,24 +1215,25 @@ Matrix create_submatrix(Matrix mat, int exclude_row, int exclude_col) {
     return submat;
 }
 
-// Recursive determinant calculation
-double calculate_determinant(Matrix mat) {
+// Recursive determinant calculation (Laplace expansion, O(n!)).
+// Kept as a reference oracle for checking determinant_lu(); the menu uses the LU path.
+double calculate_determinant(const Matrix *mat) {
     // Base case: 1x1 matrix
-    if (mat.rows == 1) {
-        return mat.data[0][0];
+    if (mat->rows == 1) {
+        return mat->data[0][0];
     }
     
     // Base case: 2x2 matrix
-    if (mat.rows == 2) {
-        return mat.data[0][0] * mat.data[1][1] - mat.data[0][1] * mat.data[1][0];
+    if (mat->rows == 2) {
+        return mat->data[0][0] * mat->data[1][1] - mat->data[0][1] * mat->data[1][0];
     }
     
     double det = 0;
     
     // Laplace expansion along first row
-    for (int col = 0; col < mat.cols; col++) {
+    for (int col = 0; col < mat->cols; col++) {
         Matrix submat = create_submatrix(mat, 0, col);
-        double cofactor = pow(-1, col) * mat.data[0][col] * calculate_determinant(submat);
+        double cofactor = pow(-1, col) * mat->data[0][col] * calculate_determinant(&submat);
         det += cofactor;
     }
     
@@ -930,99 +1244,369 @@ double calculate_determinant(Matrix mat) {
 void matrix_addition(void) {
     printf("\n=== Matrix Addition ===\n");
     
-    Matrix A, B, result;
+    DMatrix A, B;
     
-    input_matrix(&A, "A");
-    input_matrix(&B, "B");
+    if (input_dmatrix(&A, "A") != 0) return;
+    if (input_dmatrix(&B, "B") != 0) {
+        dmatrix_free(&A);
+        return;
+    }
     
     // Validate dimensions
     if (A.rows != B.rows || A.cols != B.cols) {
         printf("Error: Matrix dimensions must be equal for addition!\n");
         printf("Matrix A: %dx%d, Matrix B: %dx%d\n", A.rows, A.cols, B.rows, B.cols);
+        dmatrix_free(&A);
+        dmatrix_free(&B);
         return;
     }
     
-    // Perform addition
-    result.rows = A.rows;
-    result.cols = A.cols;
-    
-    for (int i = 0; i < A.rows; i++) {
-        for (int j = 0; j < A.cols; j++) {
-            result.data[i][j] = A.data[i][j] + B.data[i][j];
-        }
-    }
-    
-    // Display results
+    // Display inputs
     printf("\nMatrix A:");
-    print_matrix(A);
+    dmatrix_print(&A);
     
     printf("\nMatrix B:");
-    print_matrix(B);
+    dmatrix_print(&B);
     
+    // Perform addition in place (B is not needed afterwards), so no third matrix is allocated
+    dmatrix_add(&A, &B, &B);
     printf("\nAddition Result (A + B):");
-    print_matrix(result);
+    dmatrix_print(&B);
+
+    dmatrix_free(&A);
+    dmatrix_free(&B);
 }
 
 // Matrix Multiplication: C[i][j] = sum(A[i][k] * B[k][j])
 void matrix_multiplication(void) {
     printf("\n=== Matrix Multiplication ===\n");
     
-    Matrix A, B, result;
+    DMatrix A, B, result;
     
-    input_matrix(&A, "A");
-    input_matrix(&B, "B");
+    if (input_dmatrix(&A, "A") != 0) return;
+    if (input_dmatrix(&B, "B") != 0) {
+        dmatrix_free(&A);
+        return;
+    }
     
     // Validate dimensions
     if (A.cols != B.rows) {
         printf("Error: Incompatible dimensions for multiplication!\n");
         printf("Columns of A (%d) must equal rows of B (%d)\n", A.cols, B.rows);
+        dmatrix_free(&A);
+        dmatrix_free(&B);
         return;
     }
     
     // Perform multiplication
-    result.rows = A.rows;
-    result.cols = B.cols;
-    
-    for (int i = 0; i < A.rows; i++) {
-        for (int j = 0; j < B.cols; j++) {
-            result.data[i][j] = 0;
-            for (int k = 0; k < A.cols; k++) {
-                result.data[i][j] += A.data[i][k] * B.data[k][j];
-            }
-        }
+    if (dmatrix_create(&result, A.rows, B.cols) != 0) {
+        printf("Error: Not enough memory for the result!\n");
+        dmatrix_free(&A);
+        dmatrix_free(&B);
+        return;
     }
+    dmatrix_multiply(&A, &B, &result);
     
     // Display results
     printf("\nMatrix A:");
-    print_matrix(A);
+    dmatrix_print(&A);
     
     printf("\nMatrix B:");
-    print_matrix(B);
+    dmatrix_print(&B);
     
     printf("\nMultiplication Result (A × B):");
-    print_matrix(result);
+    dmatrix_print(&result);
+
+    dmatrix_free(&A);
+    dmatrix_free(&B);
+    dmatrix_free(&result);
 }
 
 // Determinant Calculation
 void matrix_determinant(void) {
     printf("\n=== Determinant Calculation ===\n");
     
-    Matrix mat;
-    input_matrix(&mat, "");
+    DMatrix mat;
+    if (input_dmatrix(&mat, "") != 0) return;
     
     // Check if matrix is square
-    if (!is_square_matrix(mat)) {
+    if (mat.rows != mat.cols) {
         printf("Error: Determinant is only defined for square matrices!\n");
         printf("Your matrix is %dx%d\n", mat.rows, mat.cols);
+        dmatrix_free(&mat);
         return;
     }
     
     // Calculate determinant
-    double det = calculate_determinant(mat);
+    double det = dmatrix_determinant(&mat);
     
     printf("\nInput Matrix:");
-    print_matrix(mat);
+    dmatrix_print(&mat);
     printf("\nDeterminant = %.2f\n", det);
+    dmatrix_free(&mat);
+}
+
+// Linear System: solve A X = B for every column of B at once
+void matrix_solve(void) {
+    printf("\n=== Solve Linear System (A X = B) ===\n");
+    printf("Each column of B is one right-hand side.\n");
+    
+    DMatrix A, B;
+    
+    if (input_dmatrix(&A, "A") != 0) return;
+    if (input_dmatrix(&B, "B") != 0) {
+        dmatrix_free(&A);
+        return;
+    }
+    
+    // Validate dimensions
+    if (A.rows != A.cols || B.rows != A.rows) {
+        printf("Error: A must be square and B must have as many rows as A!\n");
+        printf("Matrix A: %dx%d, Matrix B: %dx%d\n", A.rows, A.cols, B.rows, B.cols);
+        dmatrix_free(&A);
+        dmatrix_free(&B);
+        return;
+    }
+    
+    printf("\nMatrix A:");
+    dmatrix_print(&A);
+    printf("\nMatrix B:");
+    dmatrix_print(&B);
+    
+    // Solve in place: B becomes X
+    int status = dmatrix_solve(&A, &B, &B);
+    if (status == 1) {
+        printf("\nError: A is singular to working precision, the system has no unique solution!\n");
+    } else if (status != 0) {
+        printf("\nError: Not enough memory to solve the system!\n");
+    } else {
+        printf("\nSolution X:");
+        dmatrix_print(&B);
+    }
+    
+    dmatrix_free(&A);
+    dmatrix_free(&B);
+}
+
+// Matrix Inverse through the LU factorisation
+void matrix_inverse(void) {
+    printf("\n=== Matrix Inverse ===\n");
+    
+    DMatrix mat, inverse;
+    if (input_dmatrix(&mat, "") != 0) return;
+    
+    // Check if matrix is square
+    if (mat.rows != mat.cols) {
+        printf("Error: Only square matrices have an inverse!\n");
+        printf("Your matrix is %dx%d\n", mat.rows, mat.cols);
+        dmatrix_free(&mat);
+        return;
+    }
+    
+    if (dmatrix_create(&inverse, mat.rows, mat.cols) != 0) {
+        printf("Error: Not enough memory for the result!\n");
+        dmatrix_free(&mat);
+        return;
+    }
+    
+    printf("\nInput Matrix:");
+    dmatrix_print(&mat);
+    
+    int status = dmatrix_inverse(&mat, &inverse);
+    if (status == 1) {
+        printf("\nError: Matrix is singular to working precision, no inverse exists!\n");
+    } else if (status != 0) {
+        printf("\nError: Not enough memory to invert the matrix!\n");
+    } else {
+        printf("\nInverse Matrix:");
+        dmatrix_print(&inverse);
+    }
+    
+    dmatrix_free(&mat);
+    dmatrix_free(&inverse);
+}
+
+// Least Squares: X minimising ||A X - B|| for an overdetermined A (more rows than columns)
+void matrix_least_squares(void) {
+    printf("\n=== Least Squares Fit (QR) ===\n");
+    printf("Each column of B is one right-hand side.\n");
+    
+    DMatrix A, B, X;
+    
+    if (input_dmatrix(&A, "A") != 0) return;
+    if (input_dmatrix(&B, "B") != 0) {
+        dmatrix_free(&A);
+        return;
+    }
+    
+    // Validate dimensions
+    if (A.rows < A.cols || B.rows != A.rows) {
+        printf("Error: A needs at least as many rows as columns and B as many rows as A!\n");
+        printf("Matrix A: %dx%d, Matrix B: %dx%d\n", A.rows, A.cols, B.rows, B.cols);
+        dmatrix_free(&A);
+        dmatrix_free(&B);
+        return;
+    }
+    
+    if (dmatrix_create(&X, A.cols, B.cols) != 0) {
+        printf("Error: Not enough memory for the result!\n");
+        dmatrix_free(&A);
+        dmatrix_free(&B);
+        return;
+    }
+    
+    printf("\nMatrix A:");
+    dmatrix_print(&A);
+    printf("\nMatrix B:");
+    dmatrix_print(&B);
+    
+    double residual;
+    int status = dmatrix_least_squares(&A, &B, &X, &residual);
+    if (status == 1) {
+        printf("\nError: Columns of A are linearly dependent, no unique fit!\n");
+    } else if (status != 0) {
+        printf("\nError: Not enough memory for the fit!\n");
+    } else {
+        printf("\nLeast Squares Solution X:");
+        dmatrix_print(&X);
+        printf("\nResidual ||A X - B|| = %.6g\n", residual);
+    }
+    
+    dmatrix_free(&A);
+    dmatrix_free(&B);
+    dmatrix_free(&X);
+}
+// Elementwise Expression: any chain of + - .* ./ and scalings over same-size matrices,
+// evaluated in one fused pass into a single result matrix
+void matrix_expression(void) {
+    printf("\n=== Elementwise Expression ===\n");
+    
+    int count, read, c;
+    printf("How many matrices (1-%d)? ", MEXPR_MAX_OPERANDS);
+    while ((read = scanf("%d", &count)) != 1 || count < 1 || count > MEXPR_MAX_OPERANDS) {
+        if (read == EOF) {
+            return;
+        }
+        printf("Invalid input! Enter a number 1-%d: ", MEXPR_MAX_OPERANDS);
+        while ((c = getchar()) != '\n' && c != EOF);
+    }
+    
+    DMatrix mats[MEXPR_MAX_OPERANDS];
+    const DMatrix *operands[MEXPR_MAX_OPERANDS];
+    int loaded = 0;
+    for (; loaded < count; loaded++) {
+        char name[2] = { (char)('A' + loaded), '\0' };
+        if (input_dmatrix(&mats[loaded], name) != 0) {
+            break;
+        }
+        operands[loaded] = &mats[loaded];
+    }
+    
+    while ((c = getchar()) != '\n' && c != EOF); // Clear buffer
+    
+    char *line = NULL;
+    size_t capacity = 0;
+    if (loaded == count) {
+        if (count == 1) {
+            printf("Expression (matrix A, numbers, + - * / and elementwise .* ./): ");
+        } else {
+            printf("Expression (matrices A-%c, numbers, + - * / and elementwise .* ./): ", 'A' + count - 1);
+        }
+    }
+    if (loaded == count && getline(&line, &capacity, stdin) >= 0) {
+        line[strcspn(line, "\r\n")] = 0;
+        
+        MExpr expr;
+        DMatrix result;
+        char error[160];
+        if (mexpr_compile(line, operands, count, &expr, error, sizeof(error)) != 0) {
+            printf("Error: %s\n", error);
+        } else if (dmatrix_create(&result, expr.rows, expr.cols) != 0) {
+            printf("Error: Not enough memory for the result!\n");
+        } else {
+            mexpr_eval(&expr, &result);
+            printf("\nResult of %s (%d fused steps):", line, expr.length);
+            dmatrix_print(&result);
+            dmatrix_free(&result);
+        }
+    }
+    free(line);
+    for (int i = 0; i < loaded; i++) {
+        dmatrix_free(&mats[i]);
+    }
+}
+
+// Sparse Matrix File: load a Matrix Market file, then determinant and a self-check solve
+void sparse_matrix_file(void) {
+    printf("\n=== Sparse Matrix File (Matrix Market) ===\n");
+    
+    int c;
+    while ((c = getchar()) != '\n' && c != EOF); // Clear buffer
+    
+    char *line = NULL;
+    size_t capacity = 0;
+    char error[160];
+    printf("Matrix Market file path: ");
+    if (getline(&line, &capacity, stdin) < 0) {
+        free(line);
+        return;
+    }
+    line[strcspn(line, "\r\n")] = 0;
+    
+    SparseMatrix S;
+    int status = sparse_load(line, &S, error, sizeof(error));
+    free(line);
+    if (status != 0) {
+        printf("Error: %s\n", error);
+        return;
+    }
+    
+    printf("Loaded a %dx%d matrix with %d nonzero entries (%.4f%% dense).\n",
+           S.rows, S.cols, S.nnz, 100.0 * S.nnz / ((double)S.rows * S.cols));
+    if (S.rows <= MAX_SIZE && S.cols <= MAX_SIZE) {
+        DMatrix dense;
+        if (sparse_to_dense(&S, &dense) == 0) {
+            dmatrix_print(&dense);
+            dmatrix_free(&dense);
+        }
+    }
+    if (S.rows != S.cols) {
+        printf("Determinant and solve need a square matrix.\n");
+        sparse_free(&S);
+        return;
+    }
+    
+    // Reorder to a narrow band, factorise, then solve A x = A * ones, whose answer is all ones
+    int lower, upper;
+    SparseLU lu;
+    sparse_bandwidth(&S, NULL, &lower, &upper);
+    printf("Bandwidth as stored: %d below, %d above the diagonal\n", lower, upper);
+    if (sparse_lu_factor(&S, &lu) != 0) {
+        printf("Error: Not enough memory to factorise the matrix!\n");
+        sparse_free(&S);
+        return;
+    }
+    printf("Bandwidth after RCM reordering: %d below, %d above the diagonal\n", lu.kl, lu.ku);
+    printf("Determinant = %.6g\n", sparse_lu_determinant(&lu));
+    
+    double *x = malloc(sizeof(double) * S.rows);
+    double *ones = malloc(sizeof(double) * S.rows);
+    if (x && ones) {
+        for (int i = 0; i < S.rows; i++) ones[i] = 1.0;
+        sparse_matvec(&S, ones, x);
+        status = sparse_lu_solve(&lu, x);
+        if (status == 1) {
+            printf("Matrix is singular, so A x = b has no unique solution.\n");
+        } else if (status == 0) {
+            double worst = 0;
+            for (int i = 0; i < S.rows; i++) worst = fmax(worst, fabs(x[i] - 1.0));
+            printf("Check solve of A x = A * ones: max error %.3g\n", worst);
+        }
+    }
+    free(x);
+    free(ones);
+    sparse_lu_free(&lu);
+    sparse_free(&S);
 }
 //End of menu 3
 
@@ -1079,6 +1663,41 @@ void thermodynamic_properties_calculator(void)
     }
 }
 
+// Fill in volume, energies and entropy of an ideal-gas state from its pressure, temperature,
+// mass and molar mass [g/mol]. Returns the fluid whose specific heats were used.
+const char *compute_ideal_gas_state(StatePoint *state, double molar_mass)
+{
+    double P_pa = state->pressure * 1000; // Convert to Pa
+    double n = state->mass / (molar_mass / 1000); // Number of moles
+    state->volume = (n * R_UNIVERSAL * state->temperature) / P_pa / state->mass; // Specific volume
+    
+    // Determine specific heats based on fluid type
+    double cp, cv;
+    const char *fluid;
+    if (fabs(molar_mass - 28.97) < 0.1) 
+    {
+        cp = CP_AIR;
+        cv = CV_AIR;
+        fluid = "Air";
+    } else if (fabs(molar_mass - 18.02) < 0.1) 
+    {
+        cp = 4.18; // Water specific heat
+        cv = 4.18;
+        fluid = "Water";
+    } else 
+    {
+        cp = 1.0; // Default values
+        cv = 0.718;
+        fluid = "Custom";
+    }
+    
+    // Calculate energy properties
+    state->internal_energy = cv * state->temperature;
+    state->enthalpy = cp * state->temperature;
+    state->entropy = cp * log(state->temperature / 298.15) - R_AIR * log(state->pressure / 101.325);
+    return fluid;
+}
+
 // Advanced Ideal Gas Law Analyzer
 void advanced_ideal_gas_analyzer(void) 
 {
@@ -1120,35 +1739,16 @@ void advanced_ideal_gas_analyzer(void)
     }
     
     // Calculate thermodynamic properties
-    double P_pa = state.pressure * 1000; // Convert to Pa
-    double n = mass / (molar_mass / 1000); // Number of moles
-    state.volume = (n * R_UNIVERSAL * state.temperature) / P_pa / mass; // Specific volume
-    
-    // Determine specific heats based on fluid type
-    double cp, cv;
-    if (fabs(molar_mass - 28.97) < 0.1) 
-    {
-        cp = CP_AIR;
-        cv = CV_AIR;
-        printf("Fluid type: Air detected\n");
-    } else if (fabs(molar_mass - 18.02) < 0.1) 
+    state.mass = mass;
+    const char *fluid = compute_ideal_gas_state(&state, molar_mass);
+    if (strcmp(fluid, "Custom") == 0) 
     {
-        cp = 4.18; // Water specific heat
-        cv = 4.18;
-        printf("Fluid type: Water detected\n");
+        printf("Fluid type: Custom (using default values)\n");
     } else 
     {
-        cp = 1.0; // Default values
-        cv = 0.718;
-        printf("Fluid type: Custom (using default values)\n");
+        printf("Fluid type: %s detected\n", fluid);
     }
     
-    // Calculate energy properties
-    state.internal_energy = cv * state.temperature;
-    state.enthalpy = cp * state.temperature;
-    state.entropy = cp * log(state.temperature / 298.15) - R_AIR * log(state.pressure / 101.325);
-    state.mass = mass;
-    
     // Display comprehensive analysis
     print_comprehensive_analysis(state);
     
@@ -1187,6 +1787,16 @@ void advanced_ideal_gas_analyzer(void)
     }
 }
 
+// Enthalpy and entropy change of an air stream between two states (no I/O)
+void compute_enthalpy_entropy_change(const StatePoint *state1, const StatePoint *state2, double mass_flow,
+                                     double *delta_H, double *delta_S)
+{
+    double cp = CP_AIR; // Using air properties
+    *delta_H = mass_flow * cp * (state2->temperature - state1->temperature);
+    *delta_S = mass_flow * cp * log(state2->temperature / state1->temperature) 
+             - mass_flow * R_AIR * log(state2->pressure / state1->pressure);
+}
+
 // Enthalpy and Entropy Deep Analysis
 void enthalpy_entropy_analyzer(void) 
 {
@@ -1212,10 +1822,8 @@ void enthalpy_entropy_analyzer(void)
     scanf("%lf", &mass_flow);
     
     // Calculate enthalpy and entropy changes
-    double cp = CP_AIR; // Using air properties
-    double delta_H = mass_flow * cp * (state2.temperature - state1.temperature);
-    double delta_S = mass_flow * cp * log(state2.temperature / state1.temperature) 
-                   - mass_flow * R_AIR * log(state2.pressure / state1.pressure);
+    double delta_H, delta_S;
+    compute_enthalpy_entropy_change(&state1, &state2, mass_flow, &delta_H, &delta_S);
     
     // Second law analysis
     double T0 = 298.15; // Reference temperature
@@ -1245,6 +1853,17 @@ void enthalpy_entropy_analyzer(void)
     }
 }
 
+// Ideal cycle efficiencies (fractions, not percent)
+double carnot_efficiency(double T_hot, double T_cold)
+{
+    return 1 - T_cold / T_hot;
+}
+
+double brayton_efficiency(double pressure_ratio)
+{
+    return 1 - 1 / pow(pressure_ratio, (GAMMA_AIR - 1) / GAMMA_AIR);
+}
+
 // Thermodynamic Cycle Analysis
 void thermodynamic_cycle_analyzer(void) 
 {
@@ -1272,7 +1891,7 @@ void thermodynamic_cycle_analyzer(void)
             printf("Enter cold reservoir temperature [K]: ");
             scanf("%lf", &T_cold);
             
-            efficiency = 1 - T_cold / T_hot;
+            efficiency = carnot_efficiency(T_hot, T_cold);
             printf("\n=== CARNOT CYCLE ANALYSIS ===\n");
             printf("Theoretical Maximum Efficiency: %.2f%%\n", efficiency * 100);
             printf("This represents the absolute maximum possible efficiency\n");
@@ -1287,7 +1906,7 @@ void thermodynamic_cycle_analyzer(void)
             printf("Enter turbine inlet temperature [K]: ");
             scanf("%lf", &T_max);
             
-            efficiency = 1 - 1 / pow(pressure_ratio, (GAMMA_AIR - 1) / GAMMA_AIR);
+            efficiency = brayton_efficiency(pressure_ratio);
             printf("\n=== BRAYTON CYCLE ANALYSIS ===\n");
             printf("Thermal Efficiency: %.2f%%\n", efficiency * 100);
             printf("Typical for modern gas turbines: 35-45%%\n");
@@ -1,63 +1,520 @@
 #ifndef FUNCS_H
 #define FUNCS_H
 
+#include <stddef.h>
+
 void menu_item_1(void);
 void menu_item_2(void);
 void menu_item_3(void);
 void menu_item_4(void);
 
+// Shared work-stealing thread pool (threadpool.c).
+// Thread count: threadpool_init(n), else the LAC_THREADS environment variable, else one per core.
+typedef void (*parallel_fn)(int begin, int end, void *arg);
+int threadpool_init(int num_threads);
+void threadpool_shutdown(void);
+int threadpool_size(void);
+void parallel_for(int begin, int end, int grain, parallel_fn fn, void *arg);
+
 //menu 1
 #define MAX_RESISTORS 5
-#define MAX_CIRCUIT_LINES 10
-#define MAX_LINE_LENGTH 100
+#define MAX_GROUPS 5
+
 
+// Growable text buffer; diagrams are laid out into one (diagram.c)
+typedef struct {
+    char *data;             // NUL-terminated
+    size_t length;
+    size_t capacity;
+} DiagramBuffer;
+
+// Caller-owned state of the resistor module. The save_*_diagram functions render into
+// ctx->diagram and keep nothing else, so each thread can work with its own context.
+typedef struct {
+    DiagramBuffer diagram;
+} ResistorContext;
 
-extern char circuit_diagram[MAX_CIRCUIT_LINES][MAX_LINE_LENGTH];
-extern int diagram_line_count;
+void resistor_context_init(ResistorContext *ctx);
+void resistor_context_free(ResistorContext *ctx);
 
 // Function declarations
 int is_positive(float val, const char *param_name);
 float calc_series(float resistor[], int resistor_count);
 float calc_parallel(float resistor[], int resistor_count);
 float calc_mixed_connection(float resistors[], int resistor_count, int group_sizes[], int connection_types[], int group_count);
-void draw_series_group(int group_size);
-void draw_parallel_group(int group_size);
-void draw_mixed_circuit(int group_sizes[], int connection_types[], int group_count);
-void save_series_diagram(int group_size);
-void save_parallel_diagram(int group_size);
-void save_mixed_diagram(int group_sizes[], int connection_types[], int group_count);
-void display_diagram(void);
+void draw_group(ResistorContext *ctx, int group_size, int conn_type, int group_idx);
+void draw_series_group(ResistorContext *ctx, int group_size);
+void draw_parallel_group(ResistorContext *ctx, int group_size);
+void draw_mixed_circuit(ResistorContext *ctx, const int group_sizes[], const int connection_types[], int group_count);
+int save_series_diagram(ResistorContext *ctx, int group_size);
+int save_parallel_diagram(ResistorContext *ctx, int group_size);
+int save_mixed_diagram(ResistorContext *ctx, const int group_sizes[], const int connection_types[], int group_count);
+void display_diagram(const ResistorContext *ctx);
 void menu_item_1(void);
-void handle_mixed_connection(float resistors[], int n);
+void handle_mixed_connection(ResistorContext *ctx, float resistors[], int n);
 float calc_mixed_resistance(float resistors[], int resistor_count, int group_sizes[], int connection_types[], int group_count);
-void draw_mixed_circuit(int group_sizes[], int connection_types[], int group_count);
-void save_mixed_diagram(int group_sizes[], int connection_types[], int group_count);
+
+// Many same-shape configurations at once (resistor_batch.c). Structure-of-arrays: resistor i
+// of configuration k is values[i * stride + k].
+typedef enum {
+    RBATCH_FLOAT,           // fastest: float sums, approximate reciprocals
+    RBATCH_DOUBLE,          // double sums, exact reciprocals
+    RBATCH_COMPENSATED      // float lanes with compensated summation
+} RBatchPrecision;
+
+void batch_series(const float *values, size_t stride, int resistor_count, size_t count,
+                  RBatchPrecision precision, double *out);
+void batch_parallel(const float *values, size_t stride, int resistor_count, size_t count,
+                    RBatchPrecision precision, double *out);
+int batch_mixed(const float *values, size_t stride, int resistor_count, const int group_sizes[],
+                const int connection_types[], int group_count, size_t count,
+                RBatchPrecision precision, double *out);
+const char *batch_kernel_name(void);
+
+// Arbitrary resistor networks solved by nodal analysis (network.c)
+typedef struct {
+    int node_count;         // nodes are numbered 0 .. node_count-1
+    int count;              // resistors
+    int capacity;
+    int *node_a;
+    int *node_b;
+    double *conductance;    // siemens
+} ResistorNetwork;
+
+void network_init(ResistorNetwork *net);
+void network_free(ResistorNetwork *net);
+int network_add_resistor(ResistorNetwork *net, int a, int b, double ohms);
+double network_equivalent_resistance(const ResistorNetwork *net, int a, int b);
+void handle_network_connection(float resistors[], int n, char *names[]);
+
+// Resistance between two nodes kept up to date while resistor values change (network.c)
+#define NETWORK_MAX_RANK 16     // changed resistors tracked before the base is re-solved
+
+typedef struct NetworkBase NetworkBase;
+
+typedef struct {
+    ResistorNetwork *net;
+    int a, b;
+    double base_resistance; // at the last full solve
+    double resistance;      // with the tracked changes applied
+    NetworkBase *base;      // cached solver state
+    int failed;             // last full solve failed: resistance is NAN until one succeeds
+    int rank;               // resistors changed since the last full solve
+    int resistor[NETWORK_MAX_RANK];
+    int row_p[NETWORK_MAX_RANK];
+    int row_q[NETWORK_MAX_RANK];
+    double base_conductance[NETWORK_MAX_RANK];
+    double delta[NETWORK_MAX_RANK];                     // current minus base conductance
+    double c[NETWORK_MAX_RANK];                         // u_j . L^-1 e_a
+    double coupling[NETWORK_MAX_RANK][NETWORK_MAX_RANK];// u_i . L^-1 u_j
+    long rebases;
+} NetworkIncremental;
+
+int network_inc_init(NetworkIncremental *inc, ResistorNetwork *net, int a, int b);
+void network_inc_free(NetworkIncremental *inc);
+double network_inc_update(NetworkIncremental *inc, int resistor, double ohms);
+double network_inc_resistance(const NetworkIncremental *inc);
+
+// SPICE-style netlists (netlist.c): resistors as flat arrays over interned node IDs
+typedef struct {
+    unsigned hash;
+    int id;                 // -1 = empty
+    unsigned long long key; // case-folded name if it fits in 8 bytes, else 0
+} NodeSlot;
+
+typedef struct {
+    int count;              // resistors
+    int capacity;
+    int *node_a;
+    int *node_b;
+    double *ohms;
+    int node_count;
+    int node_capacity;
+    char *name_pool;        // node names, NUL-separated
+    size_t name_used;
+    size_t name_capacity;
+    size_t *name_offset;    // node ID -> offset of its name in name_pool
+    NodeSlot *hash;         // open addressing over node IDs
+    int hash_size;
+    long skipped;           // non-resistor element lines
+} Netlist;
+
+void netlist_init(Netlist *nl);
+void netlist_free(Netlist *nl);
+int netlist_parse(const char *data, size_t len, Netlist *nl, char *error, size_t error_len);
+int netlist_load(const char *path, Netlist *nl, char *error, size_t error_len);
+
+// Whole-file text loading shared by the file readers: returns parse's result, or -1 with a message
+typedef int (*text_parse_fn)(const char *data, size_t len, void *arg, char *error, size_t error_len);
+int parse_text_file(const char *path, text_parse_fn parse, void *arg, char *error, size_t error_len);
+int netlist_node(const Netlist *nl, const char *name);
+const char *netlist_node_name(const Netlist *nl, int id);
+int netlist_to_network(const Netlist *nl, ResistorNetwork *net);
+int parse_spice_value(const char *token, size_t len, double *value);
+void handle_netlist_file(void);
+
+// Series/parallel expressions such as "(R1 + (R2 || R3)) || R4" (rexpr.c)
+#define REXPR_MAX_NESTING 256   // brackets inside brackets
+#define REXPR_MAX_STACK 256     // built-in evaluation stack; long flat chains use a heap one
+#define REXPR_BLOCK 64          // lanes per step of rexpr_eval_block
+
+enum { REXPR_VALUE, REXPR_CONST, REXPR_SERIES, REXPR_PARALLEL };
+
+typedef struct {
+    int op;
+    int arg;                // value index, constant index, or operand count
+} RExprInstr;
+
+typedef struct {
+    RExprInstr *code;       // postorder
+    int length;
+    float *constants;
+    int constant_count;
+    int value_count;        // highest R<n> used
+    int max_stack;
+} RExpr;
+
+int rexpr_compile(const char *text, RExpr *expr, char *error, size_t error_len);
+void rexpr_free(RExpr *expr);
+float rexpr_eval(const RExpr *expr, const float values[]);
+void rexpr_eval_block(const RExpr *expr, const float *values, size_t stride, int count, float *out);
+int rexpr_from_groups(const int group_sizes[], const int connection_types[], int group_count, RExpr *expr);
+void handle_expression_connection(ResistorContext *ctx, float resistors[], int n);
+
+// Incremental re-evaluation of an expression when single values change (incremental.c)
+typedef struct {
+    int count;              // tree nodes, in postorder
+    int root;
+    int *parent;            // -1 at the root
+    unsigned char *op;      // REXPR_*
+    double *value;          // resistance of every subtree
+    double *sum;            // operators: sum of child values (series) or reciprocals (parallel)
+    int *special;           // operators: open children (series) or shorted ones (parallel)
+    int *child_start;       // children of node i: children[child_start[i] .. child_start[i + 1])
+    int *children;
+    int *leaf_start;        // leaves of value v: leaves[leaf_start[v] .. leaf_start[v + 1])
+    int *leaves;
+    int value_count;
+    long updates;           // since the last full refresh
+    long refresh_interval;
+} RIncremental;
+
+int rinc_init(RIncremental *inc, const RExpr *expr, const float values[]);
+void rinc_free(RIncremental *inc);
+double rinc_update(RIncremental *inc, int index, double ohms);
+double rinc_total(const RIncremental *inc);
+
+// Circuit diagrams of series/parallel trees, laid out into a DiagramBuffer (diagram.c)
+void diagram_init(DiagramBuffer *buf);
+void diagram_free(DiagramBuffer *buf);
+int diagram_reserve(DiagramBuffer *buf, size_t extra);
+int diagram_append(DiagramBuffer *buf, const char *text, size_t len);
+int diagram_render(const RExpr *expr, DiagramBuffer *out);
+int diagram_write(int fd, const DiagramBuffer *buf);
+
+// Streaming export to a file descriptor, for archiving large networks
+typedef enum { DIAGRAM_TEXT, DIAGRAM_SVG } DiagramFormat;
+
+int diagram_export(int fd, const RExpr *expr, const float values[], DiagramFormat format);
+int diagram_export_netlist(int fd, const Netlist *nl, DiagramFormat format);
+
+// Monte Carlo tolerance analysis of an expression (tolerance.c)
+#define TOLERANCE_BINS 20
+#define TOLERANCE_PERCENTILES 7
+
+typedef enum {
+    TOLERANCE_UNIFORM,      // evenly spread over +-tolerance
+    TOLERANCE_GAUSSIAN      // tolerance = 3 sigma, cut off at 6 sigma
+} ToleranceDistribution;
+
+typedef struct {
+    long trials;
+    double nominal;
+    double mean;
+    double std;
+    double min;
+    double max;
+    double quantile[TOLERANCE_PERCENTILES];     // 0.001 0.01 0.05 0.5 0.95 0.99 0.999
+    double percentile[TOLERANCE_PERCENTILES];
+    double hist_lo;                             // histogram spans [hist_lo, hist_hi]
+    double hist_hi;
+    long histogram[TOLERANCE_BINS];
+} ToleranceResult;
+
+int tolerance_analysis(const RExpr *expr, const float nominal[], const float tolerance_pct[],
+                       ToleranceDistribution dist, long trials, unsigned long long seed,
+                       ToleranceResult *result);
+void print_tolerance_result(const ToleranceResult *result);
+void handle_tolerance_analysis(float resistors[], int n);
+
+// Standard-value combination search (eseries.c)
+#define ESERIES_MAX_PARTS 4
+
+typedef enum { ESERIES_E12, ESERIES_E24, ESERIES_E96 } ESeries;
+
+typedef struct {
+    double value;           // ohms
+    double error;           // relative to the target
+    int topology;
+    int parts;
+    double part[ESERIES_MAX_PARTS];
+} EMatch;
+
+int eseries_search(ESeries series, double target, int max_parts, int k, EMatch matches[]);
+void eseries_format(const EMatch *match, char *buf, size_t len);
+void handle_eseries_search(void);
 //menu 2
 void unit_converter(void);
+double convert_units(double value, const char* from_unit, const char* to_unit);
+
+// How a resolved conversion maps values
+typedef enum {
+    CONV_LINEAR,     // out = in * factor
+    CONV_AFFINE,     // out = in * factor + offset     (temperatures, dB -> dB)
+    CONV_FROM_DB,    // out = 10^(in/10) * factor      (dBm -> linear power)
+    CONV_TO_DB       // out = 10 * log10(in * factor)  (linear power -> dBm)
+} ConversionKind;
+
+// Resolved from->to conversion; reuse it to convert many values without further lookups
+typedef struct {
+    ConversionKind kind;
+    double factor;   // Linear factor (applied on the linear side for dB conversions)
+    double offset;   // Added after scaling by CONV_AFFINE
+    int from_id;     // Small integer unit IDs (see unit_id())
+    int to_id;
+} UnitConversion;
+
+int unit_id(const char *unit_name);
+int unit_id_n(const char *unit_name, size_t len);
+int resolve_conversion_ids(int from_id, int to_id, UnitConversion *conv);
+int resolve_conversion(const char *from_unit, const char *to_unit, UnitConversion *conv);
+double apply_conversion(const UnitConversion *conv, double value);
+
+// Bulk conversion over arrays (units_bulk.c); in == out converts in place
+void convert_with(const UnitConversion *conv, const double *in, double *out, size_t count);
+int convert_units_bulk(const char *from_unit, const char *to_unit, const double *in, double *out, size_t count);
+void fast_pow10_db(const double *in, double *out, size_t count, double scale);
+void fast_log10_db(const double *in, double *out, size_t count, double scale);
+const char *convert_kernel_name(void);
+
+// Streaming conversion requests (units_stream.c). Tokens point into the caller's buffer and
+// are not NUL-terminated.
+typedef struct {
+    double value;
+    const char *from;
+    const char *to;
+    int from_len;
+    int to_len;
+} UnitRequest;
+
+typedef struct {
+    long line;              // 1-based input line
+    UnitRequest request;
+    double result;
+    const char *error;      // NULL on success
+} UnitRecord;
+
+// Receives parsed and converted records in input order; they are only valid during the call
+typedef void (*unit_stream_fn)(const UnitRecord *records, size_t count, void *arg);
+
+int parse_double_token(const char *token, size_t len, double *value);
+int parse_unit_request(const char *line, size_t len, UnitRequest *req);
+long convert_units_stream(int fd, unit_stream_fn emit, void *arg);
 
 //menu 3
 #define MAX_SIZE 10
 
-// Matrix structure
+// Matrix structure (fixed size, used by the reference determinant)
 typedef struct {
     double data[MAX_SIZE][MAX_SIZE];
     int rows;
     int cols;
 } Matrix;
 
+// Heap-backed matrix of any size: one aligned, contiguous row-major block.
+// A view shares its parent's buffer and only differs in origin, size and owner flag.
+typedef struct {
+    double *data;   // Element (i,j) lives at data[i * stride + j]
+    int rows;
+    int cols;
+    int stride;     // Row stride in elements (>= cols, padded to a cache line)
+    int owner;      // 1 if data came from dmatrix_create() and must be freed
+} DMatrix;
+
+#define DMAT(m, i, j) ((m)->data[(size_t)(i) * (m)->stride + (j)])
+
 // Linear Algebra Library functions
 void menu_item_3(void);
 void linear_algebra_library(void);
 void matrix_addition(void);
 void matrix_multiplication(void);
 void matrix_determinant(void);
+void matrix_solve(void);
+void matrix_inverse(void);
+void matrix_least_squares(void);
+void sparse_matrix_file(void);
+void matrix_expression(void);
 
 // Utility functions for matrix operations
-void input_matrix(Matrix *mat, const char *name);
-void print_matrix(Matrix mat);
-double calculate_determinant(Matrix mat);
-int is_square_matrix(Matrix mat);
-Matrix create_submatrix(Matrix mat, int exclude_row, int exclude_col);
+double calculate_determinant(const Matrix *mat);
+int is_square_matrix(const Matrix *mat);
+Matrix create_submatrix(const Matrix *mat, int exclude_row, int exclude_col);
+
+// Dynamic matrix functions (return 0 on success, -1 on bad dimensions or allocation failure)
+int dmatrix_create(DMatrix *m, int rows, int cols);
+void dmatrix_free(DMatrix *m);
+DMatrix dmatrix_view(const DMatrix *m, int row, int col, int rows, int cols);
+void dmatrix_fill(DMatrix *m, double value);
+int dmatrix_copy(DMatrix *dst, const DMatrix *src);
+int dmatrix_from_matrix(DMatrix *dst, const Matrix *src);
+int dmatrix_add(const DMatrix *A, const DMatrix *B, DMatrix *C);
+int dmatrix_multiply(const DMatrix *A, const DMatrix *B, DMatrix *C);
+double dmatrix_determinant(const DMatrix *A);
+int input_dmatrix(DMatrix *m, const char *name);
+void dmatrix_print(const DMatrix *m);
+
+// Cache-blocked GEMM: C = alpha*A*B + beta*C on row-major buffers (AVX2/FMA kernel when available)
+int dgemm(int m, int n, int k, double alpha, const double *A, int lda,
+          const double *B, int ldb, double beta, double *C, int ldc);
+const char *gemm_kernel_name(void);
+
+// Strassen-Winograd C = A*B for large products, falling back to dgemm at or below the
+// crossover size (LAC_STRASSEN_CROSSOVER or strassen_set_crossover; "./bench.out strassen"
+// measures it). strassen_check compares a product with dgemm's against the rounding-error bound.
+int dgemm_strassen(int m, int n, int k, const double *A, int lda, const double *B, int ldb,
+                   double *C, int ldc);
+int strassen_crossover(void);
+void strassen_set_crossover(int n);
+int strassen_levels(int m, int n, int k);
+int strassen_check(const DMatrix *A, const DMatrix *B, const DMatrix *C, double *error, double *bound);
+
+// Many same-size small matrices at once (matrix_batch.c). Interleaved storage: element (i, j)
+// of matrix b is data[(i * n + j) * stride + b], so each SIMD lane works on its own matrix.
+// Sizes 2 to MBATCH_MAX_SIZE, each with its own fully unrolled kernels.
+#define MBATCH_MAX_SIZE 6
+
+int mbatch_determinant(int n, const double *a, size_t stride, size_t count, double *det);
+int mbatch_multiply(int n, const double *a, const double *b, size_t stride, size_t count, double *c);
+int mbatch_pack(const Matrix mats[], size_t count, double *data, size_t stride);
+void mbatch_unpack(int n, const double *data, size_t stride, size_t count, Matrix mats[]);
+const char *mbatch_kernel_name(void);
+
+// LU factorisation (partial pivoting), shared by determinant and later solver code
+typedef struct {
+    DMatrix factors;      // L below the diagonal (unit diagonal implied), U on and above
+    int *perm;            // perm[i] = original row stored in row i
+    int sign;             // Parity of the row permutation (+1 or -1)
+    int singular;         // 1 if a zero pivot column was met
+} LUDecomp;
+
+int lu_factor_inplace(double *a, int n, int lda, int *perm, int *sign);
+int lu_decompose(const DMatrix *A, LUDecomp *lu);
+void lu_free(LUDecomp *lu);
+double lu_determinant(const LUDecomp *lu);
+double determinant_lu(const Matrix *mat);
+
+// Dense solvers (blocked; every right-hand side column is solved in the same pass).
+// Return 0 on success, 1 if the matrix is singular (to working precision) / rank deficient,
+// -1 on bad dimensions or allocation failure.
+int lu_solve(const LUDecomp *lu, DMatrix *B);
+int dmatrix_solve(const DMatrix *A, const DMatrix *B, DMatrix *X);
+int dmatrix_inverse(const DMatrix *A, DMatrix *Ainv);
+
+// Householder QR (m >= n) for least squares
+typedef struct {
+    DMatrix factors;      // R on and above the diagonal, reflector vectors below (leading 1 implied)
+    double *tau;          // Reflector scales, one per column
+    int rank_deficient;   // 1 if R has a negligible diagonal entry
+} QRDecomp;
+
+int qr_decompose(const DMatrix *A, QRDecomp *qr);
+void qr_free(QRDecomp *qr);
+int qr_solve(const QRDecomp *qr, const DMatrix *B, DMatrix *X, double *residual);
+int dmatrix_least_squares(const DMatrix *A, const DMatrix *B, DMatrix *X, double *residual);
+
+// Lazy elementwise expressions over same-shape matrices, e.g. "2*A + B - C" (mexpr.c)
+#define MEXPR_MAX_CODE 64
+#define MEXPR_MAX_OPERANDS 26       // A to Z
+#define MEXPR_MAX_STACK 8
+#define MEXPR_MAX_NESTING 256       // brackets and unary signs inside each other
+#define MEXPR_BLOCK 256             // Row elements per step of the fused evaluation
+
+enum { MEXPR_LOAD, MEXPR_AXPY, MEXPR_ADD, MEXPR_SUB, MEXPR_MUL, MEXPR_DIV,
+       MEXPR_SCALE, MEXPR_OFFSET, MEXPR_RDIV };
+
+typedef struct {
+    int op;
+    int arg;                // operand index for LOAD and AXPY
+    double scalar;          // LOAD: scale; AXPY: top += scalar * operand; SCALE, OFFSET, RDIV (s / top)
+} MExprInstr;
+
+typedef struct {
+    MExprInstr code[MEXPR_MAX_CODE];    // postorder; fixed size, so nothing is allocated
+    int length;
+    const DMatrix *operands[MEXPR_MAX_OPERANDS];
+    int operand_count;
+    int rows;
+    int cols;
+    int max_stack;
+} MExpr;
+
+int mexpr_compile(const char *text, const DMatrix *const operands[], int count, MExpr *expr,
+                  char *error, size_t error_len);
+int mexpr_eval(const MExpr *expr, DMatrix *out);
+int dmatrix_axpby(double alpha, const DMatrix *X, double beta, DMatrix *Y);
+
+// Sparse matrices (CSR or CSC). Slice i (row i in CSR, column i in CSC) holds entries
+// ptr[i] .. ptr[i+1]-1, idx being the other index; indices in a slice are sorted and unique.
+typedef enum {
+    SPARSE_CSR,
+    SPARSE_CSC
+} SparseFormat;
+
+typedef struct {
+    SparseFormat format;
+    int rows;
+    int cols;
+    int nnz;
+    int *ptr;       // rows + 1 (CSR) or cols + 1 (CSC) slice starts
+    int *idx;
+    double *val;
+} SparseMatrix;
+
+// Band LU of a sparse matrix after a reverse Cuthill-McKee reordering
+typedef struct {
+    int n;
+    int kl;           // Lower bandwidth of the reordered matrix
+    int ku;           // Upper bandwidth (pivoting may add up to kl more)
+    int width;        // Band entries stored per row, 2 * kl + ku + 1
+    double *band;     // U, row i holding columns i - kl .. i + ku + kl
+    double *lower;    // kl multipliers per column of L
+    int *pivot;       // Row swapped with row k at elimination step k
+    int *reach;       // Last column of U's row i that may be nonzero
+    int *perm;        // perm[new] = original row/column index
+    int sign;         // Parity of the row swaps (+1 or -1)
+    int singular;     // 1 if a zero pivot column was met
+} SparseLU;
+
+// Return 0 on success, -1 on bad dimensions/input or allocation failure (solves: 1 if singular)
+int sparse_create(SparseMatrix *S, SparseFormat format, int rows, int cols, int nnz);
+void sparse_free(SparseMatrix *S);
+int sparse_from_triplets(SparseMatrix *S, SparseFormat format, int rows, int cols, int count,
+                         const int *row, const int *col, const double *val);
+int sparse_convert(const SparseMatrix *S, SparseFormat format, SparseMatrix *T);
+int sparse_from_dense(SparseMatrix *S, SparseFormat format, const DMatrix *A);
+int sparse_to_dense(const SparseMatrix *S, DMatrix *A);
+int sparse_parse(const char *data, size_t len, SparseMatrix *S, char *error, size_t error_len);
+int sparse_load(const char *path, SparseMatrix *S, char *error, size_t error_len);
+void sparse_matvec(const SparseMatrix *S, const double *x, double *y);
+int sparse_multiply(const SparseMatrix *A, const SparseMatrix *B, SparseMatrix *C);
+int sparse_rcm(const SparseMatrix *S, int *perm);
+int sparse_bandwidth(const SparseMatrix *S, const int *perm, int *lower, int *upper);
+int sparse_lu_factor(const SparseMatrix *S, SparseLU *lu);
+void sparse_lu_free(SparseLU *lu);
+double sparse_lu_determinant(const SparseLU *lu);
+int sparse_lu_solve(const SparseLU *lu, double *b);
+double sparse_determinant(const SparseMatrix *S);
+int sparse_solve(const SparseMatrix *S, const double *b, double *x);
 
 // menu 4
 // Thermodynamic constants
@@ -107,4 +564,14 @@ void input_thermodynamic_state(StatePoint* state, const char* label);
 void print_comprehensive_analysis(StatePoint state);
 double calculate_compressibility_factor(double P, double T, double v, FluidType fluid);
 void perform_process_analysis(StatePoint initial, StatePoint final, ProcessType process);
+
+// Pure calculations shared by the menus and batch mode
+const char *compute_ideal_gas_state(StatePoint *state, double molar_mass);
+void compute_enthalpy_entropy_change(const StatePoint *state1, const StatePoint *state2, double mass_flow,
+                                     double *delta_H, double *delta_S);
+double carnot_efficiency(double T_hot, double T_cold);
+double brayton_efficiency(double pressure_ratio);
+
+// Batch / command line mode (batch.c)
+int run_batch(int argc, char *argv[]);
 #endif
\ No newline at end of file
@@ -0,0 +1,322 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "funcs.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define GEMM_HAVE_X86 1
+#endif
+
+// Blocking parameters for the packed GEMM (doubles).
+// MR x NR is the register tile, KC x NR B-panels stay in L1, MC x KC A-blocks in L2.
+#define GEMM_MR 6
+#define GEMM_NR 8
+#define GEMM_MC 96      // multiple of GEMM_MR
+#define GEMM_KC 256
+#define GEMM_NC 2048    // multiple of GEMM_NR
+#define GEMM_SMALL 32768 // below m*n*k this many flops the plain loop wins
+
+typedef void (*gemm_kernel_fn)(int kc, const double *a, const double *b, double *c, int ldc);
+
+static gemm_kernel_fn gemm_kernel = NULL;
+static const char *gemm_kernel_label = "scalar";
+static pthread_once_t gemm_kernel_once = PTHREAD_ONCE_INIT;
+
+// Portable micro-kernel: C[MR x NR] += A-panel * B-panel
+static void gemm_kernel_scalar(int kc, const double *a, const double *b, double *c, int ldc)
+{
+    double acc[GEMM_MR][GEMM_NR] = {{0}};
+
+    for (int p = 0; p < kc; p++) {
+        for (int i = 0; i < GEMM_MR; i++) {
+            double a_ip = a[i];
+            for (int j = 0; j < GEMM_NR; j++) {
+                acc[i][j] += a_ip * b[j];
+            }
+        }
+        a += GEMM_MR;
+        b += GEMM_NR;
+    }
+
+    for (int i = 0; i < GEMM_MR; i++) {
+        for (int j = 0; j < GEMM_NR; j++) {
+            c[i * ldc + j] += acc[i][j];
+        }
+    }
+}
+
+#ifdef GEMM_HAVE_X86
+// AVX2/FMA micro-kernel: 6 rows x 2 ymm columns = 12 accumulators kept in registers
+__attribute__((target("avx2,fma")))
+static void gemm_kernel_avx2(int kc, const double *a, const double *b, double *c, int ldc)
+{
+    __m256d c00 = _mm256_setzero_pd(), c01 = _mm256_setzero_pd();
+    __m256d c10 = _mm256_setzero_pd(), c11 = _mm256_setzero_pd();
+    __m256d c20 = _mm256_setzero_pd(), c21 = _mm256_setzero_pd();
+    __m256d c30 = _mm256_setzero_pd(), c31 = _mm256_setzero_pd();
+    __m256d c40 = _mm256_setzero_pd(), c41 = _mm256_setzero_pd();
+    __m256d c50 = _mm256_setzero_pd(), c51 = _mm256_setzero_pd();
+
+    for (int p = 0; p < kc; p++) {
+        __m256d b0 = _mm256_load_pd(b);
+        __m256d b1 = _mm256_load_pd(b + 4);
+        __m256d ai;
+
+        ai = _mm256_broadcast_sd(a + 0);
+        c00 = _mm256_fmadd_pd(ai, b0, c00); c01 = _mm256_fmadd_pd(ai, b1, c01);
+        ai = _mm256_broadcast_sd(a + 1);
+        c10 = _mm256_fmadd_pd(ai, b0, c10); c11 = _mm256_fmadd_pd(ai, b1, c11);
+        ai = _mm256_broadcast_sd(a + 2);
+        c20 = _mm256_fmadd_pd(ai, b0, c20); c21 = _mm256_fmadd_pd(ai, b1, c21);
+        ai = _mm256_broadcast_sd(a + 3);
+        c30 = _mm256_fmadd_pd(ai, b0, c30); c31 = _mm256_fmadd_pd(ai, b1, c31);
+        ai = _mm256_broadcast_sd(a + 4);
+        c40 = _mm256_fmadd_pd(ai, b0, c40); c41 = _mm256_fmadd_pd(ai, b1, c41);
+        ai = _mm256_broadcast_sd(a + 5);
+        c50 = _mm256_fmadd_pd(ai, b0, c50); c51 = _mm256_fmadd_pd(ai, b1, c51);
+
+        a += GEMM_MR;
+        b += GEMM_NR;
+    }
+
+#define GEMM_STORE_ROW(r, lo, hi) \
+    _mm256_storeu_pd(c + (r) * ldc,     _mm256_add_pd(_mm256_loadu_pd(c + (r) * ldc), lo)); \
+    _mm256_storeu_pd(c + (r) * ldc + 4, _mm256_add_pd(_mm256_loadu_pd(c + (r) * ldc + 4), hi))
+    GEMM_STORE_ROW(0, c00, c01);
+    GEMM_STORE_ROW(1, c10, c11);
+    GEMM_STORE_ROW(2, c20, c21);
+    GEMM_STORE_ROW(3, c30, c31);
+    GEMM_STORE_ROW(4, c40, c41);
+    GEMM_STORE_ROW(5, c50, c51);
+#undef GEMM_STORE_ROW
+}
+#endif
+
+// Pick the best micro-kernel for this CPU; run once through gemm_kernel_once
+static void gemm_select_kernel(void)
+{
+#ifdef GEMM_HAVE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        gemm_kernel_label = "avx2-fma";
+        gemm_kernel = gemm_kernel_avx2;
+        return;
+    }
+#endif
+    gemm_kernel_label = "scalar";
+    gemm_kernel = gemm_kernel_scalar;
+}
+
+const char *gemm_kernel_name(void)
+{
+    pthread_once(&gemm_kernel_once, gemm_select_kernel);
+    return gemm_kernel_label;
+}
+
+// Pack an mc x kc block of A (scaled by alpha) into MR-row panels, k-major, zero padded
+static void pack_a(int mc, int kc, const double *A, int lda, double alpha, double *buf)
+{
+    for (int i0 = 0; i0 < mc; i0 += GEMM_MR) {
+        int rows = mc - i0 < GEMM_MR ? mc - i0 : GEMM_MR;
+        for (int p = 0; p < kc; p++) {
+            int i = 0;
+            for (; i < rows; i++) {
+                buf[i] = alpha * A[(size_t)(i0 + i) * lda + p];
+            }
+            for (; i < GEMM_MR; i++) {
+                buf[i] = 0.0;
+            }
+            buf += GEMM_MR;
+        }
+    }
+}
+
+// Pack a kc x nc block of B into NR-column panels, k-major, zero padded
+static void pack_b(int kc, int nc, const double *B, int ldb, double *buf)
+{
+    for (int j0 = 0; j0 < nc; j0 += GEMM_NR) {
+        int cols = nc - j0 < GEMM_NR ? nc - j0 : GEMM_NR;
+        for (int p = 0; p < kc; p++) {
+            const double *src = &B[(size_t)p * ldb + j0];
+            int j = 0;
+            for (; j < cols; j++) {
+                buf[j] = src[j];
+            }
+            for (; j < GEMM_NR; j++) {
+                buf[j] = 0.0;
+            }
+            buf += GEMM_NR;
+        }
+    }
+}
+
+// Multiply one packed mc x kc A-block by one packed kc x nc B-block into C
+static void gemm_macro_kernel(int mc, int nc, int kc, const double *a_pack, const double *b_pack,
+                              double *C, int ldc)
+{
+    double edge[GEMM_MR * GEMM_NR];
+
+    for (int j0 = 0; j0 < nc; j0 += GEMM_NR) {
+        int cols = nc - j0 < GEMM_NR ? nc - j0 : GEMM_NR;
+        const double *b = &b_pack[(size_t)(j0 / GEMM_NR) * kc * GEMM_NR];
+
+        for (int i0 = 0; i0 < mc; i0 += GEMM_MR) {
+            int rows = mc - i0 < GEMM_MR ? mc - i0 : GEMM_MR;
+            const double *a = &a_pack[(size_t)(i0 / GEMM_MR) * kc * GEMM_MR];
+            double *c = &C[(size_t)i0 * ldc + j0];
+
+            if (rows == GEMM_MR && cols == GEMM_NR) {
+                gemm_kernel(kc, a, b, c, ldc);
+            } else {
+                // Partial tile: run the kernel on a scratch tile and add back the valid part
+                memset(edge, 0, sizeof(edge));
+                gemm_kernel(kc, a, b, edge, GEMM_NR);
+                for (int i = 0; i < rows; i++) {
+                    for (int j = 0; j < cols; j++) {
+                        c[(size_t)i * ldc + j] += edge[i * GEMM_NR + j];
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Shared state for one (jc, pc) step of the parallel GEMM
+typedef struct {
+    const double *A;
+    const double *B;            // top-left of the current kc x nc block of B
+    double *C;
+    int lda, ldb, ldc;
+    int m, jc, pc, nc, kc;
+    double alpha;
+    double *b_pack;
+    double *a_pack;             // one MC x KC buffer per slot
+    int blocks, slots;          // A-blocks of MC rows, shared out over slots
+} GemmBlockArgs;
+
+// Pool task: pack NR-column panels [first, last) of the current B block
+static void gemm_pack_b_range(int first, int last, void *arg)
+{
+    GemmBlockArgs *g = arg;
+    int j0 = first * GEMM_NR;
+    int cols = last * GEMM_NR < g->nc ? last * GEMM_NR - j0 : g->nc - j0;
+    pack_b(g->kc, cols, &g->B[j0], g->ldb, &g->b_pack[(size_t)first * g->kc * GEMM_NR]);
+}
+
+// Pool task: for each slot in [first, last), multiply its contiguous run of A-blocks
+// (MC rows each) with the packed B block, packing A into the slot's own buffer
+static void gemm_block_range(int first, int last, void *arg)
+{
+    GemmBlockArgs *g = arg;
+    for (int slot = first; slot < last; slot++) {
+        double *a_pack = &g->a_pack[(size_t)slot * GEMM_MC * GEMM_KC];
+        int blk_begin = (int)((long)g->blocks * slot / g->slots);
+        int blk_end = (int)((long)g->blocks * (slot + 1) / g->slots);
+
+        for (int blk = blk_begin; blk < blk_end; blk++) {
+            int ic = blk * GEMM_MC;
+            int mc = g->m - ic < GEMM_MC ? g->m - ic : GEMM_MC;
+            pack_a(mc, g->kc, &g->A[(size_t)ic * g->lda + g->pc], g->lda, g->alpha, a_pack);
+            gemm_macro_kernel(mc, g->nc, g->kc, a_pack, g->b_pack, &g->C[(size_t)ic * g->ldc + g->jc], g->ldc);
+        }
+    }
+}
+
+// Scale C by beta before accumulating (beta == 0 clears, so NaNs in C are not propagated)
+static void scale_c(int m, int n, double beta, double *C, int ldc)
+{
+    if (beta == 1.0) {
+        return;
+    }
+    for (int i = 0; i < m; i++) {
+        double *c = &C[(size_t)i * ldc];
+        if (beta == 0.0) {
+            memset(c, 0, (size_t)n * sizeof(double));
+        } else {
+            for (int j = 0; j < n; j++) {
+                c[j] *= beta;
+            }
+        }
+    }
+}
+
+// C = alpha * A * B + beta * C for row-major A (m x k), B (k x n), C (m x n).
+// Returns 0 on success, -1 if the packing buffers could not be allocated; C is left
+// untouched in that case, since every buffer is allocated before C is written.
+int dgemm(int m, int n, int k, double alpha, const double *A, int lda,
+          const double *B, int ldb, double beta, double *C, int ldc)
+{
+    if (m <= 0 || n <= 0) {
+        return 0;
+    }
+    if (k <= 0 || alpha == 0.0) {
+        scale_c(m, n, beta, C, ldc);
+        return 0;
+    }
+
+    // Tiny products: packing costs more than it saves
+    if ((double)m * n * k < GEMM_SMALL) {
+        scale_c(m, n, beta, C, ldc);
+        for (int i = 0; i < m; i++) {
+            double *c = &C[(size_t)i * ldc];
+            for (int p = 0; p < k; p++) {
+                double a_ip = alpha * A[(size_t)i * lda + p];
+                const double *b = &B[(size_t)p * ldb];
+                for (int j = 0; j < n; j++) {
+                    c[j] += a_ip * b[j];
+                }
+            }
+        }
+        return 0;
+    }
+
+    pthread_once(&gemm_kernel_once, gemm_select_kernel);
+
+    // One A buffer per pool thread: each takes a contiguous run of A-blocks
+    int blocks = (m + GEMM_MC - 1) / GEMM_MC;
+    int slots = threadpool_size() < blocks ? threadpool_size() : blocks;
+    double *b_pack = aligned_alloc(64, sizeof(double) * GEMM_KC * GEMM_NC);
+    double *a_pack = aligned_alloc(64, sizeof(double) * GEMM_MC * GEMM_KC * slots);
+    if (!b_pack || !a_pack) {
+        free(b_pack);
+        free(a_pack);
+        return -1;
+    }
+    scale_c(m, n, beta, C, ldc);
+
+    GemmBlockArgs args;
+    args.A = A;
+    args.lda = lda;
+    args.C = C;
+    args.ldc = ldc;
+    args.m = m;
+    args.alpha = alpha;
+    args.b_pack = b_pack;
+    args.a_pack = a_pack;
+    args.blocks = blocks;
+    args.slots = slots;
+
+    // Loop order jc -> pc -> ic: each packed B-block is reused by every A-block of the column.
+    // B is packed cooperatively, then the A-blocks (rows of C) are shared out over the pool.
+    for (int jc = 0; jc < n; jc += GEMM_NC) {
+        int nc = n - jc < GEMM_NC ? n - jc : GEMM_NC;
+        for (int pc = 0; pc < k; pc += GEMM_KC) {
+            int kc = k - pc < GEMM_KC ? k - pc : GEMM_KC;
+
+            args.B = &B[(size_t)pc * ldb + jc];
+            args.ldb = ldb;
+            args.jc = jc;
+            args.pc = pc;
+            args.nc = nc;
+            args.kc = kc;
+            parallel_for(0, (nc + GEMM_NR - 1) / GEMM_NR, 16, gemm_pack_b_range, &args);
+            parallel_for(0, slots, 1, gemm_block_range, &args);
+        }
+    }
+
+    free(b_pack);
+    free(a_pack);
+    return 0;
+}
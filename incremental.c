@@ -0,0 +1,194 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "funcs.h"
+
+// Incremental evaluation of a series/parallel expression under single-value changes.
+// Every operator node caches the sum over its children of their resistance (series) or of
+// their reciprocal (parallel), so its own resistance is that sum or one over it. Changing
+// one resistor swaps its old contribution for the new one in its parent, which changes the
+// parent's resistance, and so on up to the root: O(depth) per update, and the walk stops
+// early as soon as a node's resistance comes out unchanged.
+//
+// Open (infinite) children of a series node and shorted (zero) children of a parallel node
+// are counted apart from the sum, so they can come and go without turning it into inf or NaN.
+// When removing a contribution cancels most of a sum, that node is summed afresh from its
+// children, and the whole tree is refreshed every so often, so rounding does not build up.
+
+#define RINC_CANCEL 1e-6        // re-sum a node when its sum drops below this * removed term
+#define RINC_REFRESH 65536      // full re-evaluation after this many updates (at least)
+
+static inline double contribution(int op, double v)
+{
+    return op == REXPR_SERIES ? v : 1.0 / v;
+}
+
+static inline int is_special(int op, double v)
+{
+    return op == REXPR_SERIES ? isinf(v) : v == 0;
+}
+
+static inline double node_value(int op, double sum, int special)
+{
+    if (op == REXPR_SERIES) {
+        return special ? INFINITY : sum;
+    }
+    return special ? 0.0 : 1.0 / sum;
+}
+
+// Sum node i afresh from its children
+static void resum(RIncremental *inc, int i)
+{
+    int op = inc->op[i];
+    double sum = 0;
+    int special = 0;
+    for (int c = inc->child_start[i]; c < inc->child_start[i + 1]; c++) {
+        double v = inc->value[inc->children[c]];
+        if (is_special(op, v)) {
+            special++;
+        } else {
+            sum += contribution(op, v);
+        }
+    }
+    inc->sum[i] = sum;
+    inc->special[i] = special;
+    inc->value[i] = node_value(op, sum, special);
+}
+
+// Children precede their parent in postorder, so one forward pass re-evaluates everything
+static void refresh(RIncremental *inc)
+{
+    for (int i = 0; i < inc->count; i++) {
+        if (inc->child_start[i + 1] > inc->child_start[i]) {
+            resum(inc, i);
+        }
+    }
+    inc->updates = 0;
+}
+
+// Build the engine for expr with values[0] standing for R1 (expr->value_count entries).
+// Returns 0, or -1 on an empty expression or out of memory.
+int rinc_init(RIncremental *inc, const RExpr *expr, const float values[])
+{
+    memset(inc, 0, sizeof(*inc));
+    int n = expr->length;
+    if (n == 0) {
+        return -1;
+    }
+    inc->count = n;
+    inc->value_count = expr->value_count;
+    inc->parent = malloc(sizeof(int) * n);
+    inc->op = malloc(sizeof(unsigned char) * n);
+    inc->value = malloc(sizeof(double) * n);
+    inc->sum = calloc(n, sizeof(double));
+    inc->special = calloc(n, sizeof(int));
+    inc->child_start = calloc((size_t)n + 1, sizeof(int));
+    inc->children = malloc(sizeof(int) * n);
+    inc->leaf_start = calloc((size_t)expr->value_count + 1, sizeof(int));
+    inc->leaves = malloc(sizeof(int) * n);
+    int *stack = malloc(sizeof(int) * (expr->max_stack > 0 ? expr->max_stack : 1));
+    if (!inc->parent || !inc->op || !inc->value || !inc->sum || !inc->special || !inc->child_start ||
+        !inc->children || !inc->leaf_start || !inc->leaves || !stack) {
+        free(stack);
+        rinc_free(inc);
+        return -1;
+    }
+
+    // Postorder: an operator's children are the top arg entries of the stack
+    int sp = 0, used = 0;
+    for (int i = 0; i < n; i++) {
+        int op = expr->code[i].op, arg = expr->code[i].arg;
+        inc->op[i] = (unsigned char)op;
+        inc->parent[i] = -1;
+        if (op == REXPR_SERIES || op == REXPR_PARALLEL) {
+            sp -= arg;
+            for (int c = 0; c < arg; c++) {
+                inc->children[used++] = stack[sp + c];
+                inc->parent[stack[sp + c]] = i;
+            }
+        } else if (op == REXPR_VALUE) {
+            inc->value[i] = values[arg];
+            inc->leaf_start[arg + 1]++;
+        } else {
+            inc->value[i] = expr->constants[arg];
+        }
+        inc->child_start[i + 1] = used;
+        stack[sp++] = i;
+    }
+    free(stack);
+    inc->root = n - 1;
+
+    // Leaves by value index; one value may appear more than once
+    for (int v = 0; v < inc->value_count; v++) inc->leaf_start[v + 1] += inc->leaf_start[v];
+    for (int i = 0; i < n; i++) {
+        if (inc->op[i] == REXPR_VALUE) {
+            inc->leaves[inc->leaf_start[expr->code[i].arg]++] = i;
+        }
+    }
+    for (int v = inc->value_count; v > 0; v--) inc->leaf_start[v] = inc->leaf_start[v - 1];
+    inc->leaf_start[0] = 0;
+
+    inc->refresh_interval = n > RINC_REFRESH ? n : RINC_REFRESH;
+    refresh(inc);
+    return 0;
+}
+
+void rinc_free(RIncremental *inc)
+{
+    free(inc->parent);
+    free(inc->op);
+    free(inc->value);
+    free(inc->sum);
+    free(inc->special);
+    free(inc->child_start);
+    free(inc->children);
+    free(inc->leaf_start);
+    free(inc->leaves);
+    memset(inc, 0, sizeof(*inc));
+}
+
+// Set R<index + 1> to ohms and return the new total resistance (NAN for a bad index)
+double rinc_update(RIncremental *inc, int index, double ohms)
+{
+    if (index < 0 || index >= inc->value_count) {
+        return NAN;
+    }
+    for (int k = inc->leaf_start[index]; k < inc->leaf_start[index + 1]; k++) {
+        int node = inc->leaves[k];
+        double old = inc->value[node];
+        inc->value[node] = ohms;
+
+        while (inc->parent[node] >= 0 && inc->value[node] != old) {
+            int p = inc->parent[node], op = inc->op[p];
+            double removed = 0, old_parent = inc->value[p];
+            if (is_special(op, old)) {
+                inc->special[p]--;
+            } else {
+                removed = contribution(op, old);
+                inc->sum[p] -= removed;
+            }
+            if (is_special(op, inc->value[node])) {
+                inc->special[p]++;
+            } else {
+                inc->sum[p] += contribution(op, inc->value[node]);
+            }
+            if (fabs(inc->sum[p]) < fabs(removed) * RINC_CANCEL) {
+                resum(inc, p);
+            } else {
+                inc->value[p] = node_value(op, inc->sum[p], inc->special[p]);
+            }
+            old = old_parent;
+            node = p;
+        }
+    }
+    if (++inc->updates >= inc->refresh_interval) {
+        refresh(inc);
+    }
+    return inc->value[inc->root];
+}
+
+double rinc_total(const RIncremental *inc)
+{
+    return inc->value[inc->root];
+}
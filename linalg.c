@@ -0,0 +1,385 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "funcs.h"
+
+#define DMATRIX_ALIGN 64            // Bytes; one cache line, also enough for AVX loads
+#define DMATRIX_PRINT_LIMIT 10      // Larger matrices are printed as their top-left corner
+#define LU_BLOCK 64                 // Panel width of the blocked LU
+#define LINALG_PAR_ELEMENTS 16384   // Minimum elements per parallel chunk of elementwise work
+
+// Allocate an uninitialised rows x cols matrix with cache-line aligned rows
+int dmatrix_create(DMatrix *m, int rows, int cols)
+{
+    m->data = NULL;
+    m->rows = 0;
+    m->cols = 0;
+    m->stride = 0;
+    m->owner = 0;
+    if (rows < 1 || cols < 1) {
+        return -1;
+    }
+
+    int per_line = DMATRIX_ALIGN / (int)sizeof(double);
+    int stride = (cols + per_line - 1) / per_line * per_line;
+    size_t bytes = (size_t)rows * stride * sizeof(double);
+
+    double *data = aligned_alloc(DMATRIX_ALIGN, bytes);
+    if (!data) {
+        return -1;
+    }
+
+    m->data = data;
+    m->rows = rows;
+    m->cols = cols;
+    m->stride = stride;
+    m->owner = 1;
+    return 0;
+}
+
+// Release a matrix created by dmatrix_create(); views are left untouched
+void dmatrix_free(DMatrix *m)
+{
+    if (m->owner) {
+        free(m->data);
+    }
+    m->data = NULL;
+    m->rows = m->cols = m->stride = 0;
+    m->owner = 0;
+}
+
+// Sub-matrix view sharing the parent's storage (no copy)
+DMatrix dmatrix_view(const DMatrix *m, int row, int col, int rows, int cols)
+{
+    DMatrix v;
+    v.data = &DMAT(m, row, col);
+    v.rows = rows;
+    v.cols = cols;
+    v.stride = m->stride;
+    v.owner = 0;
+    return v;
+}
+
+void dmatrix_fill(DMatrix *m, double value)
+{
+    for (int i = 0; i < m->rows; i++) {
+        double *row = &DMAT(m, i, 0);
+        for (int j = 0; j < m->cols; j++) {
+            row[j] = value;
+        }
+    }
+}
+
+// Copy src into dst, allocating dst with the same shape
+int dmatrix_copy(DMatrix *dst, const DMatrix *src)
+{
+    if (dmatrix_create(dst, src->rows, src->cols) != 0) {
+        return -1;
+    }
+    for (int i = 0; i < src->rows; i++) {
+        memcpy(&DMAT(dst, i, 0), &DMAT(src, i, 0), (size_t)src->cols * sizeof(double));
+    }
+    return 0;
+}
+
+int dmatrix_from_matrix(DMatrix *dst, const Matrix *src)
+{
+    if (dmatrix_create(dst, src->rows, src->cols) != 0) {
+        return -1;
+    }
+    for (int i = 0; i < src->rows; i++) {
+        memcpy(&DMAT(dst, i, 0), src->data[i], (size_t)src->cols * sizeof(double));
+    }
+    return 0;
+}
+
+typedef struct {
+    const DMatrix *A;
+    const DMatrix *B;
+    DMatrix *C;
+} AddArgs;
+
+// Pool task: add rows [first, last)
+static void add_rows(int first, int last, void *arg)
+{
+    AddArgs *t = arg;
+    for (int i = first; i < last; i++) {
+        const double *a = &DMAT(t->A, i, 0);
+        const double *b = &DMAT(t->B, i, 0);
+        double *c = &DMAT(t->C, i, 0);
+        for (int j = 0; j < t->A->cols; j++) {
+            c[j] = a[j] + b[j];
+        }
+    }
+}
+
+// C = A + B; C must already have A's shape (it may alias A or B)
+int dmatrix_add(const DMatrix *A, const DMatrix *B, DMatrix *C)
+{
+    if (A->rows != B->rows || A->cols != B->cols || C->rows != A->rows || C->cols != A->cols) {
+        return -1;
+    }
+
+    AddArgs args = { A, B, C };
+    int grain = LINALG_PAR_ELEMENTS / A->cols + 1;   // keep chunks worth a thread hand-off
+    parallel_for(0, A->rows, grain, add_rows, &args);
+    return 0;
+}
+
+// C = A * B; C must be A->rows x B->cols and must not alias A or B
+int dmatrix_multiply(const DMatrix *A, const DMatrix *B, DMatrix *C)
+{
+    if (A->cols != B->rows || C->rows != A->rows || C->cols != B->cols) {
+        return -1;
+    }
+
+    // Large products take the Strassen-Winograd path; it is plain dgemm below the crossover
+    return dgemm_strassen(A->rows, B->cols, A->cols, A->data, A->stride,
+                          B->data, B->stride, C->data, C->stride);
+}
+
+// Print a matrix; large ones are cut down to their top-left corner
+void dmatrix_print(const DMatrix *m)
+{
+    int show_rows = m->rows < DMATRIX_PRINT_LIMIT ? m->rows : DMATRIX_PRINT_LIMIT;
+    int show_cols = m->cols < DMATRIX_PRINT_LIMIT ? m->cols : DMATRIX_PRINT_LIMIT;
+
+    printf("\nMatrix (%dx%d):\n", m->rows, m->cols);
+    for (int i = 0; i < show_rows; i++) {
+        printf("| ");
+        for (int j = 0; j < show_cols; j++) {
+            printf("%8.2f ", DMAT(m, i, j));
+        }
+        printf(show_cols < m->cols ? "... |\n" : "|\n");
+    }
+    if (show_rows < m->rows) {
+        printf("| ... (%d more rows)\n", m->rows - show_rows);
+    }
+}
+
+// Input matrix of any size from user; returns 0 on success, -1 if allocation failed
+int input_dmatrix(DMatrix *m, const char *name)
+{
+    int rows, cols;
+
+    printf("\n=== Input Matrix %s ===\n", name);
+
+    printf("Enter number of rows: ");
+    while (scanf("%d", &rows) != 1 || rows < 1) {
+        printf("Invalid input! Enter number of rows (at least 1): ");
+        while (getchar() != '\n');
+    }
+
+    printf("Enter number of columns: ");
+    while (scanf("%d", &cols) != 1 || cols < 1) {
+        printf("Invalid input! Enter number of columns (at least 1): ");
+        while (getchar() != '\n');
+    }
+
+    if (dmatrix_create(m, rows, cols) != 0) {
+        printf("Error: Not enough memory for a %dx%d matrix!\n", rows, cols);
+        return -1;
+    }
+
+    printf("Enter matrix elements row by row:\n");
+    for (int i = 0; i < rows; i++) {
+        printf("Row %d: ", i + 1);
+        for (int j = 0; j < cols; j++) {
+            while (scanf("%lf", &DMAT(m, i, j)) != 1) {
+                printf("Invalid input! Enter a valid number: ");
+                while (getchar() != '\n');
+            }
+        }
+    }
+    return 0;
+}
+
+static void swap_rows(double *a, int lda, int n, int r1, int r2)
+{
+    double *x = &a[(size_t)r1 * lda];
+    double *y = &a[(size_t)r2 * lda];
+    for (int j = 0; j < n; j++) {
+        double tmp = x[j];
+        x[j] = y[j];
+        y[j] = tmp;
+    }
+}
+
+// Unblocked right-looking factorisation of the column panel [k0, k0+kb) over rows k0..n-1.
+// Row swaps are applied across the full width so the rest of the matrix stays consistent.
+static int lu_factor_panel(double *a, int n, int lda, int k0, int kb, int *perm, int *sign)
+{
+    int singular = 0;
+
+    for (int k = k0; k < k0 + kb; k++) {
+        // Choose the largest remaining entry in column k as the pivot
+        int pivot = k;
+        double best = fabs(a[(size_t)k * lda + k]);
+        for (int i = k + 1; i < n; i++) {
+            double v = fabs(a[(size_t)i * lda + k]);
+            if (v > best) {
+                best = v;
+                pivot = i;
+            }
+        }
+
+        if (best == 0.0) {
+            singular = 1;   // Whole column is zero, nothing to eliminate
+            continue;
+        }
+
+        if (pivot != k) {
+            swap_rows(a, lda, n, k, pivot);
+            int tmp = perm[k];
+            perm[k] = perm[pivot];
+            perm[pivot] = tmp;
+            *sign = -*sign;
+        }
+
+        // Eliminate below the pivot, only inside the panel (row-oriented, contiguous inner loop)
+        const double *row_k = &a[(size_t)k * lda];
+        double inv_pivot = 1.0 / row_k[k];
+        for (int i = k + 1; i < n; i++) {
+            double *row_i = &a[(size_t)i * lda];
+            double factor = row_i[k] * inv_pivot;
+            row_i[k] = factor;
+            for (int j = k + 1; j < k0 + kb; j++) {
+                row_i[j] -= factor * row_k[j];
+            }
+        }
+    }
+    return singular;
+}
+
+typedef struct {
+    double *a;
+    int lda;
+    int k0;
+    int kb;
+} TrsmArgs;
+
+// Pool task: U12 = L11^-1 * A12 for columns [first, last) (forward substitution, unit diagonal)
+static void lu_trsm_columns(int first, int last, void *arg)
+{
+    TrsmArgs *t = arg;
+    for (int i = t->k0 + 1; i < t->k0 + t->kb; i++) {
+        double *row_i = &t->a[(size_t)i * t->lda];
+        for (int p = t->k0; p < i; p++) {
+            double l_ip = row_i[p];
+            const double *row_p = &t->a[(size_t)p * t->lda];
+            for (int j = first; j < last; j++) {
+                row_i[j] -= l_ip * row_p[j];
+            }
+        }
+    }
+}
+
+// LU factorisation with partial pivoting, done in place on an n x n row-major buffer.
+// Afterwards the strict lower part holds L (unit diagonal implied) and the upper part holds U.
+// perm[i] is the original row index now stored in row i and *sign the permutation parity.
+// Blocked: each LU_BLOCK-wide panel is factorised, then U12 comes from a triangular solve and
+// the trailing matrix is updated with one GEMM, so most of the work runs on the thread pool.
+// Returns 1 if a zero pivot column was found (singular matrix), otherwise 0.
+int lu_factor_inplace(double *a, int n, int lda, int *perm, int *sign)
+{
+    int singular = 0;
+
+    *sign = 1;
+    for (int i = 0; i < n; i++) {
+        perm[i] = i;
+    }
+
+    for (int k0 = 0; k0 < n; k0 += LU_BLOCK) {
+        int kb = n - k0 < LU_BLOCK ? n - k0 : LU_BLOCK;
+        int rest = n - k0 - kb;
+
+        singular |= lu_factor_panel(a, n, lda, k0, kb, perm, sign);
+        if (rest == 0) {
+            break;
+        }
+
+        TrsmArgs trsm = { a, lda, k0, kb };
+        parallel_for(k0 + kb, n, 64, lu_trsm_columns, &trsm);
+
+        // A22 -= L21 * U12
+        dgemm(rest, rest, kb, -1.0, &a[(size_t)(k0 + kb) * lda + k0], lda,
+              &a[(size_t)k0 * lda + k0 + kb], lda, 1.0,
+              &a[(size_t)(k0 + kb) * lda + k0 + kb], lda);
+    }
+
+    return singular;
+}
+
+// Factorise a square matrix into lu (a private copy); returns 0 on success,
+// -1 if the matrix is not square or memory ran out. Release with lu_free().
+int lu_decompose(const DMatrix *A, LUDecomp *lu)
+{
+    lu->perm = NULL;
+    if (A->rows != A->cols || dmatrix_copy(&lu->factors, A) != 0) {
+        return -1;
+    }
+
+    lu->perm = malloc((size_t)A->rows * sizeof(int));
+    if (!lu->perm) {
+        dmatrix_free(&lu->factors);
+        return -1;
+    }
+
+    lu->singular = lu_factor_inplace(lu->factors.data, A->rows, lu->factors.stride, lu->perm, &lu->sign);
+    return 0;
+}
+
+void lu_free(LUDecomp *lu)
+{
+    dmatrix_free(&lu->factors);
+    free(lu->perm);
+    lu->perm = NULL;
+}
+
+// Determinant from an existing factorisation: sign * product of U's diagonal
+double lu_determinant(const LUDecomp *lu)
+{
+    if (lu->singular) {
+        return 0.0;
+    }
+
+    double det = lu->sign;
+    for (int i = 0; i < lu->factors.rows; i++) {
+        det *= DMAT(&lu->factors, i, i);
+    }
+    return det;
+}
+
+// O(n^3) determinant of a dynamic matrix; NAN if it is not square
+double dmatrix_determinant(const DMatrix *A)
+{
+    LUDecomp lu;
+    if (lu_decompose(A, &lu) != 0) {
+        return NAN;
+    }
+    double det = lu_determinant(&lu);
+    lu_free(&lu);
+    return det;
+}
+
+// O(n^3) determinant of a fixed-size matrix, factorised on a stack copy
+double determinant_lu(const Matrix *mat)
+{
+    if (!is_square_matrix(mat)) {
+        return NAN;
+    }
+
+    Matrix work = *mat;
+    int perm[MAX_SIZE];
+    int sign;
+    if (lu_factor_inplace(&work.data[0][0], mat->rows, MAX_SIZE, perm, &sign)) {
+        return 0.0;
+    }
+
+    double det = sign;
+    for (int i = 0; i < mat->rows; i++) {
+        det *= work.data[i][i];
+    }
+    return det;
+}
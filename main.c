@@ -23,8 +23,13 @@ int is_positive(float val, const char *param_name);
 float calc_series(float resistor[], int resistor_count);
 float calc_parallel(float resistor[], int resistor_count);
 
-int main(void)
+int main(int argc, char *argv[])
 {
+    /* any command line arguments select the non-interactive batch mode */
+    if (argc > 1) {
+        return run_batch(argc, argv);
+    }
+
     /* this will run forever until we call 
     exit(0) in select_menu_item() */
     for(;;) {
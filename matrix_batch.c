@@ -0,0 +1,348 @@
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include "funcs.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define MBATCH_HAVE_X86 1
+#endif
+
+// Batched determinants and products of many same-size small matrices (2x2 to 6x6).
+// Storage is interleaved (structure-of-arrays) like the resistor batches: element (i, j) of
+// matrix b is data[(i * n + j) * stride + b], so one vector load picks up the same element of
+// MBATCH_LANES consecutive matrices and every lane works on its own matrix, with no shuffles.
+//
+// Each size has its own kernels: the shared lane kernels below are always inlined with n a
+// constant, so every loop is fully unrolled and there is no branching inside a matrix. They are
+// built twice, once for the baseline ISA (SSE2 on x86-64) and once for AVX2/FMA, picked at run
+// time. A count that is not a multiple of MBATCH_LANES finishes on a padded copy of the last group.
+
+#define MBATCH_LANES 4
+#define MBATCH_PAR_MATRICES 8192    // Minimum matrices per parallel chunk
+#define MBATCH_TILE 64              // matrices gathered per kernel step (multiple of MBATCH_LANES)
+
+typedef double vec4 __attribute__((vector_size(MBATCH_LANES * sizeof(double))));
+typedef long long vec4i __attribute__((vector_size(MBATCH_LANES * sizeof(long long))));
+
+#define ALWAYS_INLINE static inline __attribute__((always_inline))
+
+typedef void (*mbatch_det_fn)(const double *a, size_t stride, size_t first, size_t last, double *det);
+typedef void (*mbatch_mul_fn)(const double *a, const double *b, size_t stride, size_t first,
+                              size_t last, double *c);
+
+static mbatch_det_fn det_kernels[MBATCH_MAX_SIZE + 1];
+static mbatch_mul_fn mul_kernels[MBATCH_MAX_SIZE + 1];
+static const char *mbatch_label = "generic";
+static pthread_once_t mbatch_once = PTHREAD_ONCE_INIT;
+
+// Per lane: mask ? x : y, and |x| (vectors pass through macros, never through call boundaries)
+#define SELECT4(mask, x, y) ((vec4)(((vec4i)(x) & (mask)) | ((vec4i)(y) & ~(mask))))
+#define ABS4(x) ((vec4)((vec4i)(x) & magnitude_mask))
+
+static const vec4i magnitude_mask = { 0x7fffffffffffffffLL, 0x7fffffffffffffffLL,
+                                      0x7fffffffffffffffLL, 0x7fffffffffffffffLL };
+
+// Copy matrices [k, k + width) of a batch into a tile with stride MBATCH_TILE. Every element
+// is its own stream through memory (108 of them for 6x6 products), so reading them a short
+// contiguous run at a time keeps the hardware prefetcher useful, and the unrolled kernels then
+// address the tile at constant offsets instead of keeping a pointer per element.
+ALWAYS_INLINE void gather_tile(int n, const double *src, size_t stride, size_t k, int width, double *tile)
+{
+    for (int e = 0; e < n * n; e++) {
+        if (width == MBATCH_TILE) {
+            memcpy(&tile[e * MBATCH_TILE], &src[e * stride + k], MBATCH_TILE * sizeof(double));
+        } else {
+            memcpy(&tile[e * MBATCH_TILE], &src[e * stride + k], width * sizeof(double));
+        }
+    }
+}
+
+ALWAYS_INLINE void scatter_tile(int n, const double *tile, int width, double *dst, size_t stride, size_t k)
+{
+    for (int e = 0; e < n * n; e++) {
+        if (width == MBATCH_TILE) {
+            memcpy(&dst[e * stride + k], &tile[e * MBATCH_TILE], MBATCH_TILE * sizeof(double));
+        } else {
+            memcpy(&dst[e * stride + k], &tile[e * MBATCH_TILE], width * sizeof(double));
+        }
+    }
+}
+
+// Determinants of the MBATCH_LANES matrices starting at a (one per lane)
+ALWAYS_INLINE void det_lanes(int n, const double *a, size_t stride, double *det)
+{
+    vec4 m[MBATCH_MAX_SIZE][MBATCH_MAX_SIZE];
+#pragma GCC unroll 6
+    for (int i = 0; i < n; i++) {
+#pragma GCC unroll 6
+        for (int j = 0; j < n; j++) memcpy(&m[i][j], &a[(size_t)(i * n + j) * stride], sizeof(vec4));
+    }
+
+    if (n == 2) {
+        vec4 d = m[0][0] * m[1][1] - m[0][1] * m[1][0];
+        memcpy(det, &d, sizeof(d));
+        return;
+    }
+    if (n == 3) {
+        vec4 d = m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1])
+               - m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0])
+               + m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+        memcpy(det, &d, sizeof(d));
+        return;
+    }
+
+    // Gaussian elimination with partial pivoting. Lanes pick different pivot rows, so the
+    // largest entry is moved up by compare-and-swap blends rather than by row exchanges.
+    const vec4 one = { 1.0, 1.0, 1.0, 1.0 };
+    vec4 d = one;
+#pragma GCC unroll 6
+    for (int k = 0; k < n; k++) {
+#pragma GCC unroll 6
+        for (int r = k + 1; r < n; r++) {
+            vec4i swap = ABS4(m[r][k]) > ABS4(m[k][k]);
+#pragma GCC unroll 6
+            for (int j = k; j < n; j++) {
+                vec4 t = m[k][j];
+                m[k][j] = SELECT4(swap, m[r][j], t);
+                m[r][j] = SELECT4(swap, t, m[r][j]);
+            }
+            d = SELECT4(swap, -d, d);
+        }
+        vec4 pivot = m[k][k];
+        d *= pivot;
+        // A zero pivot means the whole column is zero: det is 0 and nothing needs eliminating
+        vec4 inv = one / SELECT4(pivot == 0, one, pivot);
+#pragma GCC unroll 6
+        for (int r = k + 1; r < n; r++) {
+            vec4 f = m[r][k] * inv;
+#pragma GCC unroll 6
+            for (int j = k + 1; j < n; j++) m[r][j] -= f * m[k][j];
+        }
+    }
+    memcpy(det, &d, sizeof(d));
+}
+
+// C = A * B for the MBATCH_LANES matrices at a, b and c; c may be a or b
+ALWAYS_INLINE void mul_lanes(int n, const double *a, const double *b, size_t stride, double *c)
+{
+    vec4 x[MBATCH_MAX_SIZE][MBATCH_MAX_SIZE], y[MBATCH_MAX_SIZE][MBATCH_MAX_SIZE];
+#pragma GCC unroll 6
+    for (int i = 0; i < n; i++) {
+#pragma GCC unroll 6
+        for (int j = 0; j < n; j++) {
+            memcpy(&x[i][j], &a[(size_t)(i * n + j) * stride], sizeof(vec4));
+            memcpy(&y[i][j], &b[(size_t)(i * n + j) * stride], sizeof(vec4));
+        }
+    }
+#pragma GCC unroll 6
+    for (int i = 0; i < n; i++) {
+#pragma GCC unroll 6
+        for (int j = 0; j < n; j++) {
+            vec4 sum = x[i][0] * y[0][j];
+#pragma GCC unroll 6
+            for (int p = 1; p < n; p++) sum += x[i][p] * y[p][j];
+            memcpy(&c[(size_t)(i * n + j) * stride], &sum, sizeof(sum));
+        }
+    }
+}
+
+// One det and one product kernel per size and ISA, over matrices [first, last) (whole lane groups)
+#define MBATCH_KERNELS(N, SUFFIX, TARGET)                                                      \
+    TARGET static void det##N##_##SUFFIX(const double *a, size_t stride, size_t first,       \
+                                          size_t last, double *det)                            \
+    {                                                                                          \
+        double ta[N * N * MBATCH_TILE];                                                        \
+        for (size_t k = first; k < last; k += MBATCH_TILE) {                                   \
+            int width = last - k < MBATCH_TILE ? (int)(last - k) : MBATCH_TILE;                \
+            gather_tile(N, a, stride, k, width, ta);                                           \
+            for (int g = 0; g < width; g += MBATCH_LANES) {                                    \
+                det_lanes(N, ta + g, MBATCH_TILE, det + k + g);                                \
+            }                                                                                  \
+        }                                                                                      \
+    }                                                                                          \
+    TARGET static void mul##N##_##SUFFIX(const double *a, const double *b, size_t stride,      \
+                                          size_t first, size_t last, double *c)                \
+    {                                                                                          \
+        double ta[N * N * MBATCH_TILE], tb[N * N * MBATCH_TILE];                               \
+        for (size_t k = first; k < last; k += MBATCH_TILE) {                                   \
+            int width = last - k < MBATCH_TILE ? (int)(last - k) : MBATCH_TILE;                \
+            gather_tile(N, a, stride, k, width, ta);                                           \
+            gather_tile(N, b, stride, k, width, tb);                                           \
+            for (int g = 0; g < width; g += MBATCH_LANES) {                                    \
+                mul_lanes(N, ta + g, tb + g, MBATCH_TILE, ta + g);                             \
+            }                                                                                  \
+            scatter_tile(N, ta, width, c, stride, k);                                          \
+        }                                                                                      \
+    }
+
+#define MBATCH_ALL_SIZES(SUFFIX, TARGET) \
+    MBATCH_KERNELS(2, SUFFIX, TARGET)    \
+    MBATCH_KERNELS(3, SUFFIX, TARGET)    \
+    MBATCH_KERNELS(4, SUFFIX, TARGET)    \
+    MBATCH_KERNELS(5, SUFFIX, TARGET)    \
+    MBATCH_KERNELS(6, SUFFIX, TARGET)
+
+MBATCH_ALL_SIZES(generic, )
+#ifdef MBATCH_HAVE_X86
+MBATCH_ALL_SIZES(avx2, __attribute__((target("avx2,fma"))))
+#endif
+
+#define MBATCH_TABLE(SUFFIX)                                                          \
+    do {                                                                              \
+        det_kernels[2] = det2_##SUFFIX; det_kernels[3] = det3_##SUFFIX;               \
+        det_kernels[4] = det4_##SUFFIX; det_kernels[5] = det5_##SUFFIX;               \
+        det_kernels[6] = det6_##SUFFIX;                                               \
+        mul_kernels[2] = mul2_##SUFFIX; mul_kernels[3] = mul3_##SUFFIX;               \
+        mul_kernels[4] = mul4_##SUFFIX; mul_kernels[5] = mul5_##SUFFIX;               \
+        mul_kernels[6] = mul6_##SUFFIX;                                               \
+    } while (0)
+
+static void select_mbatch_kernels(void)
+{
+    MBATCH_TABLE(generic);
+    mbatch_label = "generic";
+#ifdef MBATCH_HAVE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        MBATCH_TABLE(avx2);
+        mbatch_label = "avx2-fma";
+    }
+#endif
+}
+
+const char *mbatch_kernel_name(void)
+{
+    pthread_once(&mbatch_once, select_mbatch_kernels);
+    return mbatch_label;
+}
+
+typedef struct {
+    int n;
+    int multiply;           // 1 for products, 0 for determinants
+    const double *a, *b;
+    size_t stride;
+    double *out;
+} MBatchArgs;
+
+static void run_kernel(const MBatchArgs *g, size_t first, size_t last)
+{
+    if (g->multiply) {
+        mul_kernels[g->n](g->a, g->b, g->stride, first, last, g->out);
+    } else {
+        det_kernels[g->n](g->a, g->stride, first, last, g->out);
+    }
+}
+
+// Pool task: chunk i covers matrices [i * MBATCH_PAR_MATRICES, (i + 1) * MBATCH_PAR_MATRICES)
+static void mbatch_chunks(int first, int last, void *arg)
+{
+    run_kernel(arg, (size_t)first * MBATCH_PAR_MATRICES, (size_t)last * MBATCH_PAR_MATRICES);
+}
+
+// Run the kernel over all full lane groups below count, spread over the pool for large
+// batches; returns where the remainder starts
+static size_t run_groups(const MBatchArgs *g, size_t count)
+{
+    size_t chunks = count / MBATCH_PAR_MATRICES, done = 0;
+    if (chunks > 1) {
+        parallel_for(0, (int)chunks, 1, mbatch_chunks, (void *)g);
+        done = chunks * MBATCH_PAR_MATRICES;
+    }
+    size_t full = count - count % MBATCH_LANES;
+    if (full > done) {
+        run_kernel(g, done, full);
+    }
+    return full;
+}
+
+// Copy matrices [first, count) of a batch into lanes of a MBATCH_LANES-wide batch, the unused
+// lanes set to the identity
+static void pad_tail(int n, const double *src, size_t stride, size_t first, size_t count, double *dst)
+{
+    for (int e = 0; e < n * n; e++) {
+        for (int l = 0; l < MBATCH_LANES; l++) {
+            size_t k = first + l;
+            dst[e * MBATCH_LANES + l] = k < count ? src[e * stride + k] : (e % (n + 1) == 0);
+        }
+    }
+}
+
+// det[b] = determinant of matrix b, for count n x n matrices in interleaved storage
+// (stride >= count). Returns 0, or -1 if n is outside 2..MBATCH_MAX_SIZE or stride < count.
+int mbatch_determinant(int n, const double *a, size_t stride, size_t count, double *det)
+{
+    if (n < 2 || n > MBATCH_MAX_SIZE || stride < count) {
+        return -1;
+    }
+    pthread_once(&mbatch_once, select_mbatch_kernels);
+
+    MBatchArgs args = { n, 0, a, NULL, stride, det };
+    size_t first = run_groups(&args, count);
+    if (first < count) {
+        double tail[MBATCH_MAX_SIZE * MBATCH_MAX_SIZE * MBATCH_LANES], out[MBATCH_LANES];
+        pad_tail(n, a, stride, first, count, tail);
+        det_kernels[n](tail, MBATCH_LANES, 0, MBATCH_LANES, out);
+        memcpy(det + first, out, (count - first) * sizeof(double));
+    }
+    return 0;
+}
+
+// C[b] = A[b] * B[b] for count n x n matrices, all three in interleaved storage with the same
+// stride. C may be A or B. Returns 0, or -1 if n is outside 2..MBATCH_MAX_SIZE or stride < count.
+int mbatch_multiply(int n, const double *a, const double *b, size_t stride, size_t count, double *c)
+{
+    if (n < 2 || n > MBATCH_MAX_SIZE || stride < count) {
+        return -1;
+    }
+    pthread_once(&mbatch_once, select_mbatch_kernels);
+
+    MBatchArgs args = { n, 1, a, b, stride, c };
+    size_t first = run_groups(&args, count);
+    if (first < count) {
+        double ta[MBATCH_MAX_SIZE * MBATCH_MAX_SIZE * MBATCH_LANES];
+        double tb[MBATCH_MAX_SIZE * MBATCH_MAX_SIZE * MBATCH_LANES];
+        pad_tail(n, a, stride, first, count, ta);
+        pad_tail(n, b, stride, first, count, tb);
+        mul_kernels[n](ta, tb, MBATCH_LANES, 0, MBATCH_LANES, ta);
+        for (int e = 0; e < n * n; e++) {
+            memcpy(&c[e * stride + first], &ta[e * MBATCH_LANES], (count - first) * sizeof(double));
+        }
+    }
+    return 0;
+}
+
+// Interleave count square Matrix values of one size into batch storage.
+// Returns their size, or -1 if they are not all square and the same size within 2..MBATCH_MAX_SIZE.
+int mbatch_pack(const Matrix mats[], size_t count, double *data, size_t stride)
+{
+    if (count == 0 || stride < count) {
+        return -1;
+    }
+    int n = mats[0].rows;
+    if (n < 2 || n > MBATCH_MAX_SIZE) {
+        return -1;
+    }
+    for (size_t k = 0; k < count; k++) {
+        if (mats[k].rows != n || mats[k].cols != n) {
+            return -1;
+        }
+    }
+    for (size_t k = 0; k < count; k++) {
+        for (int i = 0; i < n; i++) {
+            for (int j = 0; j < n; j++) data[(size_t)(i * n + j) * stride + k] = mats[k].data[i][j];
+        }
+    }
+    return n;
+}
+
+// The reverse of mbatch_pack
+void mbatch_unpack(int n, const double *data, size_t stride, size_t count, Matrix mats[])
+{
+    for (size_t k = 0; k < count; k++) {
+        mats[k].rows = n;
+        mats[k].cols = n;
+        for (int i = 0; i < n; i++) {
+            for (int j = 0; j < n; j++) mats[k].data[i][j] = data[(size_t)(i * n + j) * stride + k];
+        }
+    }
+}
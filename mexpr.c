@@ -0,0 +1,471 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "funcs.h"
+
+// Elementwise matrix expressions such as "2*A + B - C/4" or "A .* (B + 1)", evaluated lazily.
+//
+//   expr  := term ( ('+' | '-') term )*
+//   term  := unary ( ('*' | '/' | '.*' | './') unary )*     '*' and '/' need a scalar side;
+//   unary := ('-' | '+') unary | primary                     '.*' and './' are elementwise
+//   primary := '(' expr ')' | A..Z | number                  A is operands[0], B operands[1], ...
+//
+// The text compiles into postorder bytecode like the resistor expressions (rexpr.c). Scalar
+// subexpressions are folded while parsing, scalings are merged into the loads, and a load that
+// is added or subtracted becomes one axpy step, so "alpha*A + beta*B + C" is three instructions.
+// Evaluation runs the whole program over one cache-sized block of a row at a time: every operand
+// is read once and the output written once, with no temporaries, whatever the chain length.
+
+#define MEXPR_PAR_ELEMENTS 16384    // Minimum elements per parallel chunk of rows
+
+typedef double vec4 __attribute__((vector_size(4 * sizeof(double))));
+
+typedef struct {
+    const char *text;
+    const char *p;
+    MExpr *expr;
+    int depth;              // stack depth after the code emitted so far
+    int nesting;            // open brackets and signs, which the parser recurses on
+    char *error;
+    size_t error_len;
+} MExprParser;
+
+// A parsed subexpression: a folded scalar, or a matrix whose code starts at start
+typedef struct {
+    int is_matrix;
+    double scalar;
+    int start;
+} MValue;
+
+static int parse_error(MExprParser *ps, const char *message)
+{
+    if (ps->error && ps->error_len > 0) {
+        snprintf(ps->error, ps->error_len, "%s at position %d", message, (int)(ps->p - ps->text) + 1);
+    }
+    return -1;
+}
+
+static int emit(MExprParser *ps, int op, int arg, double scalar)
+{
+    MExpr *e = ps->expr;
+    if (e->length == MEXPR_MAX_CODE) {
+        return parse_error(ps, "expression too long");
+    }
+    e->code[e->length].op = op;
+    e->code[e->length].arg = arg;
+    e->code[e->length].scalar = scalar;
+    e->length++;
+
+    if (op == MEXPR_LOAD) {
+        ps->depth++;
+    } else if (op == MEXPR_ADD || op == MEXPR_SUB || op == MEXPR_MUL || op == MEXPR_DIV) {
+        ps->depth--;
+    }
+    if (ps->depth > MEXPR_MAX_STACK) {
+        return parse_error(ps, "expression nested too deeply");
+    }
+    if (ps->depth > e->max_stack) {
+        e->max_stack = ps->depth;
+    }
+    return 0;
+}
+
+// Multiply a matrix value by s: folded into its load or trailing scaling when there is one
+static int scale_value(MExprParser *ps, const MValue *m, double s)
+{
+    MExpr *e = ps->expr;
+    MExprInstr *last = &e->code[e->length - 1];
+    if (m->start == e->length - 1 || last->op == MEXPR_SCALE) {
+        last->scalar *= s;      // a single LOAD, or code already ending in SCALE
+        return 0;
+    }
+    return emit(ps, MEXPR_SCALE, 0, s);
+}
+
+static void skip_blanks(MExprParser *ps)
+{
+    while (*ps->p == ' ' || *ps->p == '\t' || *ps->p == '\r' || *ps->p == '\n') ps->p++;
+}
+
+static int parse_expr(MExprParser *ps, MValue *out);
+static int parse_unary(MExprParser *ps, MValue *out);
+
+static int parse_primary(MExprParser *ps, MValue *out)
+{
+    skip_blanks(ps);
+    MExpr *e = ps->expr;
+
+    if (*ps->p == '(') {
+        ps->p++;
+        if (parse_expr(ps, out) != 0) {
+            return -1;
+        }
+        skip_blanks(ps);
+        if (*ps->p != ')') {
+            return parse_error(ps, "expected ')'");
+        }
+        ps->p++;
+        return 0;
+    }
+
+    char c = *ps->p;
+    if ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z')) {
+        int index = (c >= 'a' ? c - 'a' : c - 'A');
+        char after = ps->p[1];
+        if ((after >= 'A' && after <= 'Z') || (after >= 'a' && after <= 'z') || (after >= '0' && after <= '9')) {
+            return parse_error(ps, "matrices are single letters A to Z");
+        }
+        if (index >= e->operand_count) {
+            return parse_error(ps, "no such matrix");
+        }
+        const DMatrix *m = e->operands[index];
+        if (e->rows == 0) {
+            e->rows = m->rows;
+            e->cols = m->cols;
+        } else if (m->rows != e->rows || m->cols != e->cols) {
+            return parse_error(ps, "matrix dimensions differ");
+        }
+        out->is_matrix = 1;
+        out->start = e->length;
+        if (emit(ps, MEXPR_LOAD, index, 1.0) != 0) {
+            return -1;
+        }
+        ps->p++;
+        return 0;
+    }
+
+    char *end;
+    double value = strtod(ps->p, &end);
+    if (end == ps->p) {
+        return parse_error(ps, "expected a matrix, a number or '('");
+    }
+    ps->p = end;
+    out->is_matrix = 0;
+    out->scalar = value;
+    return 0;
+}
+
+static int parse_signed(MExprParser *ps, MValue *out)
+{
+    int negate = *ps->p == '-';
+    ps->p++;
+    if (parse_unary(ps, out) != 0) {
+        return -1;
+    }
+    if (!negate) {
+        return 0;
+    }
+    if (!out->is_matrix) {
+        out->scalar = -out->scalar;
+        return 0;
+    }
+    return scale_value(ps, out, -1.0);
+}
+
+// Every '(' and sign recurses through here, so this is where the nesting is limited
+static int parse_unary(MExprParser *ps, MValue *out)
+{
+    skip_blanks(ps);
+    if (++ps->nesting > MEXPR_MAX_NESTING) {
+        return parse_error(ps, "brackets or signs nested too deeply");
+    }
+    int status = (*ps->p == '-' || *ps->p == '+') ? parse_signed(ps, out) : parse_primary(ps, out);
+    ps->nesting--;
+    return status;
+}
+
+static int parse_term(MExprParser *ps, MValue *out)
+{
+    if (parse_unary(ps, out) != 0) {
+        return -1;
+    }
+    while (1) {
+        skip_blanks(ps);
+        int elementwise = ps->p[0] == '.' && (ps->p[1] == '*' || ps->p[1] == '/');
+        char op = elementwise ? ps->p[1] : ps->p[0];
+        if (op != '*' && op != '/') {
+            return 0;
+        }
+        const char *at = ps->p;
+        ps->p += elementwise ? 2 : 1;
+
+        MValue right;
+        if (parse_unary(ps, &right) != 0) {
+            return -1;
+        }
+
+        if (!out->is_matrix && !right.is_matrix) {
+            out->scalar = op == '*' ? out->scalar * right.scalar : out->scalar / right.scalar;
+        } else if (out->is_matrix && !right.is_matrix) {
+            if (scale_value(ps, out, op == '*' ? right.scalar : 1.0 / right.scalar) != 0) {
+                return -1;
+            }
+        } else if (!out->is_matrix && op == '*') {
+            double s = out->scalar;
+            *out = right;
+            if (scale_value(ps, out, s) != 0) {
+                return -1;
+            }
+        } else if (!out->is_matrix) {
+            double s = out->scalar;     // s / M, elementwise reciprocal
+            *out = right;
+            if (emit(ps, MEXPR_RDIV, 0, s) != 0) {
+                return -1;
+            }
+        } else if (!elementwise) {
+            ps->p = at;
+            return parse_error(ps, "use .* or ./ between two matrices (products here are elementwise)");
+        } else if (emit(ps, op == '*' ? MEXPR_MUL : MEXPR_DIV, 0, 0.0) != 0) {
+            return -1;
+        }
+    }
+}
+
+static int parse_expr(MExprParser *ps, MValue *out)
+{
+    MExpr *e = ps->expr;
+    if (parse_term(ps, out) != 0) {
+        return -1;
+    }
+    while (1) {
+        skip_blanks(ps);
+        if (*ps->p != '+' && *ps->p != '-') {
+            return 0;
+        }
+        double sign = *ps->p == '-' ? -1.0 : 1.0;
+        ps->p++;
+
+        MValue right;
+        if (parse_term(ps, &right) != 0) {
+            return -1;
+        }
+
+        if (!out->is_matrix && !right.is_matrix) {
+            out->scalar += sign * right.scalar;
+        } else if (!right.is_matrix) {
+            if (emit(ps, MEXPR_OFFSET, 0, sign * right.scalar) != 0) {
+                return -1;
+            }
+        } else if (!out->is_matrix) {
+            double s = out->scalar;     // s +- M
+            *out = right;
+            if ((sign < 0 && scale_value(ps, out, -1.0) != 0) || emit(ps, MEXPR_OFFSET, 0, s) != 0) {
+                return -1;
+            }
+        } else if (right.start == e->length - 1) {
+            // Right side is a single (scaled) load: accumulate it straight from the operand
+            MExprInstr *load = &e->code[e->length - 1];
+            load->op = MEXPR_AXPY;
+            load->scalar *= sign;
+            ps->depth--;
+        } else if (emit(ps, sign > 0 ? MEXPR_ADD : MEXPR_SUB, 0, 0.0) != 0) {
+            return -1;
+        }
+    }
+}
+
+// Compile text over operands[0..count) (named A, B, ...), which must all have the same shape.
+// The program keeps pointers to the operands, so it can be re-run after their contents change.
+// Returns 0, or -1 with a message in error.
+int mexpr_compile(const char *text, const DMatrix *const operands[], int count, MExpr *expr,
+                  char *error, size_t error_len)
+{
+    MExprParser ps;
+    memset(expr, 0, sizeof(*expr));
+    memset(&ps, 0, sizeof(ps));
+    ps.text = text;
+    ps.p = text;
+    ps.expr = expr;
+    ps.error = error;
+    ps.error_len = error_len;
+    expr->operand_count = count < MEXPR_MAX_OPERANDS ? count : MEXPR_MAX_OPERANDS;
+    for (int i = 0; i < expr->operand_count; i++) {
+        expr->operands[i] = operands[i];
+    }
+
+    MValue result;
+    if (parse_expr(&ps, &result) != 0) {
+        return -1;
+    }
+    skip_blanks(&ps);
+    if (*ps.p != '\0') {
+        return parse_error(&ps, "unexpected character");
+    }
+    if (!result.is_matrix) {
+        return parse_error(&ps, "expression has no matrix in it");
+    }
+    return 0;
+}
+
+// ---- evaluation ----
+// Each step works on block-long rows of the stack, four lanes at a time with GCC vector
+// extensions and a scalar tail. memcpy keeps the operand loads and stores unaligned-safe.
+
+static void block_load(double *dst, const double *src, int len, double s)
+{
+    int j = 0;
+    if (s == 1.0) {
+        memcpy(dst, src, sizeof(double) * len);
+        return;
+    }
+    for (; j + 4 <= len; j += 4) {
+        vec4 a;
+        memcpy(&a, &src[j], sizeof(a));
+        a *= s;
+        memcpy(&dst[j], &a, sizeof(a));
+    }
+    for (; j < len; j++) dst[j] = src[j] * s;
+}
+
+static void block_axpy(double *dst, const double *src, int len, double s)
+{
+    int j = 0;
+    for (; j + 4 <= len; j += 4) {
+        vec4 a, b;
+        memcpy(&a, &dst[j], sizeof(a));
+        memcpy(&b, &src[j], sizeof(b));
+        a += s * b;
+        memcpy(&dst[j], &a, sizeof(a));
+    }
+    for (; j < len; j++) dst[j] += s * src[j];
+}
+
+// Always inlined and called with a constant op, so the switch folds away inside the loops
+static inline __attribute__((always_inline)) void block_binary(int op, double *dst, const double *src, int len)
+{
+    int j = 0;
+    for (; j + 4 <= len; j += 4) {
+        vec4 a, b;
+        memcpy(&a, &dst[j], sizeof(a));
+        memcpy(&b, &src[j], sizeof(b));
+        switch (op) {
+            case MEXPR_ADD: a += b; break;
+            case MEXPR_SUB: a -= b; break;
+            case MEXPR_MUL: a *= b; break;
+            default:        a /= b; break;
+        }
+        memcpy(&dst[j], &a, sizeof(a));
+    }
+    for (; j < len; j++) {
+        switch (op) {
+            case MEXPR_ADD: dst[j] += src[j]; break;
+            case MEXPR_SUB: dst[j] -= src[j]; break;
+            case MEXPR_MUL: dst[j] *= src[j]; break;
+            default:        dst[j] /= src[j]; break;
+        }
+    }
+}
+
+static inline __attribute__((always_inline)) void block_scalar(int op, double *dst, int len, double s)
+{
+    int j = 0;
+    for (; j + 4 <= len; j += 4) {
+        vec4 a;
+        memcpy(&a, &dst[j], sizeof(a));
+        switch (op) {
+            case MEXPR_SCALE:  a *= s; break;
+            case MEXPR_OFFSET: a += s; break;
+            default:           a = s / a; break;
+        }
+        memcpy(&dst[j], &a, sizeof(a));
+    }
+    for (; j < len; j++) {
+        switch (op) {
+            case MEXPR_SCALE:  dst[j] *= s; break;
+            case MEXPR_OFFSET: dst[j] += s; break;
+            default:           dst[j] = s / dst[j]; break;
+        }
+    }
+}
+
+typedef struct {
+    const MExpr *expr;
+    DMatrix *out;
+} MExprArgs;
+
+// Pool task: run the program over rows [first, last), one block of each row at a time
+static void mexpr_rows(int first, int last, void *arg)
+{
+    static _Thread_local double stack[MEXPR_MAX_STACK][MEXPR_BLOCK];
+    MExprArgs *t = arg;
+    const MExpr *e = t->expr;
+    const MExprInstr *code = e->code;
+
+    for (int i = first; i < last; i++) {
+        for (int col = 0; col < e->cols; col += MEXPR_BLOCK) {
+            int len = e->cols - col < MEXPR_BLOCK ? e->cols - col : MEXPR_BLOCK;
+            int sp = 0;
+            for (int k = 0; k < e->length; k++) {
+                const MExprInstr *in = &code[k];
+                switch (in->op) {
+                    case MEXPR_LOAD:
+                        block_load(stack[sp++], &DMAT(e->operands[in->arg], i, col), len, in->scalar);
+                        break;
+                    case MEXPR_AXPY:
+                        block_axpy(stack[sp - 1], &DMAT(e->operands[in->arg], i, col), len, in->scalar);
+                        break;
+                    case MEXPR_ADD:
+                        sp--;
+                        block_binary(MEXPR_ADD, stack[sp - 1], stack[sp], len);
+                        break;
+                    case MEXPR_SUB:
+                        sp--;
+                        block_binary(MEXPR_SUB, stack[sp - 1], stack[sp], len);
+                        break;
+                    case MEXPR_MUL:
+                        sp--;
+                        block_binary(MEXPR_MUL, stack[sp - 1], stack[sp], len);
+                        break;
+                    case MEXPR_DIV:
+                        sp--;
+                        block_binary(MEXPR_DIV, stack[sp - 1], stack[sp], len);
+                        break;
+                    case MEXPR_SCALE:
+                        block_scalar(MEXPR_SCALE, stack[sp - 1], len, in->scalar);
+                        break;
+                    case MEXPR_OFFSET:
+                        block_scalar(MEXPR_OFFSET, stack[sp - 1], len, in->scalar);
+                        break;
+                    default:
+                        block_scalar(MEXPR_RDIV, stack[sp - 1], len, in->scalar);
+                        break;
+                }
+            }
+            memcpy(&DMAT(t->out, i, col), stack[0], sizeof(double) * len);
+        }
+    }
+}
+
+// out = expr, in one pass over the output; allocates nothing. out must have the expression's
+// shape and may be one of its operands (each element only depends on the same position),
+// but not a view overlapping one at an offset. Returns 0, or -1 on a shape mismatch.
+int mexpr_eval(const MExpr *expr, DMatrix *out)
+{
+    if (expr->length == 0 || out->rows != expr->rows || out->cols != expr->cols) {
+        return -1;
+    }
+    MExprArgs args = { expr, out };
+    int grain = MEXPR_PAR_ELEMENTS / expr->cols + 1;
+    parallel_for(0, expr->rows, grain, mexpr_rows, &args);
+    return 0;
+}
+
+// Y = alpha * X + beta * Y in place, without compiling any text
+int dmatrix_axpby(double alpha, const DMatrix *X, double beta, DMatrix *Y)
+{
+    if (X->rows != Y->rows || X->cols != Y->cols) {
+        return -1;
+    }
+    MExpr e;
+    memset(&e, 0, sizeof(e));
+    e.operands[0] = Y;
+    e.operands[1] = X;
+    e.operand_count = 2;
+    e.rows = Y->rows;
+    e.cols = Y->cols;
+    e.code[0] = (MExprInstr){ MEXPR_LOAD, 0, beta };
+    e.code[1] = (MExprInstr){ MEXPR_AXPY, 1, alpha };
+    e.length = 2;
+    e.max_stack = 1;
+    return mexpr_eval(&e, Y);
+}
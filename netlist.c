@@ -0,0 +1,466 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "funcs.h"
+
+// SPICE-style netlist reader for the resistor module.
+//
+//   * comment                 (also blank lines, and ';' starts a trailing comment)
+//   R1   in   mid   4k7
+//   Rload mid 0     1M        (M is mega, as on resistor markings; "meg" works too, m is milli)
+//   .end                      (dot directives and other element types are skipped)
+//
+// Values are a number with an optional scale letter (f p n u m k M meg g t) and any trailing
+// letters (e.g. "10kohm"); the letter may also stand for the decimal point as in 4k7 or 2R2.
+// The file is mapped (or read whole) and parsed in one pass straight into flat arrays, with
+// node names interned into integer IDs by an open-addressing hash table.
+
+#define NETLIST_MAX_TOKENS 4
+#define NETLIST_BATCH 64        // resistor lines whose node lookups are prefetched together
+
+void netlist_init(Netlist *nl)
+{
+    memset(nl, 0, sizeof(*nl));
+}
+
+void netlist_free(Netlist *nl)
+{
+    free(nl->node_a);
+    free(nl->node_b);
+    free(nl->ohms);
+    free(nl->name_pool);
+    free(nl->name_offset);
+    free(nl->hash);
+    netlist_init(nl);
+}
+
+static unsigned char fold(char c)
+{
+    return (c >= 'A' && c <= 'Z') ? (unsigned char)(c + ('a' - 'A')) : (unsigned char)c;
+}
+
+// FNV-1a over the case-folded name, with a final mix so that names differing only in their
+// last digits (n1, n2, ...) spread over the whole table
+static unsigned node_hash(const char *name, size_t len)
+{
+    unsigned h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h ^= fold(name[i]);
+        h *= 16777619u;
+    }
+    h ^= h >> 16;
+    h *= 0x7feb352du;
+    h ^= h >> 15;
+    return h;
+}
+
+// Case-folded name packed into 8 bytes for names that fit, 0 otherwise
+static unsigned long long node_key(const char *name, size_t len)
+{
+    unsigned long long key = 0;
+    if (len == 0 || len > 8) {
+        return 0;
+    }
+    for (size_t i = 0; i < len; i++) {
+        key |= (unsigned long long)fold(name[i]) << (8 * i);
+    }
+    return key;
+}
+
+static int same_name(const char *a, const char *b, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        if (fold(a[i]) != fold(b[i])) return 0;
+    }
+    return b[len] == '\0';
+}
+
+// Grow the hash table to at least min_size slots (kept at most half full), reinserting every node
+static int grow_hash(Netlist *nl, int min_size)
+{
+    int size = nl->hash_size ? nl->hash_size * 2 : 1024;
+    while (size < min_size) size *= 2;
+    NodeSlot *hash = malloc(sizeof(NodeSlot) * size);
+    if (!hash) {
+        return -1;
+    }
+    for (int i = 0; i < size; i++) hash[i].id = -1;
+    for (int i = 0; i < nl->hash_size; i++) {
+        if (nl->hash[i].id < 0) continue;
+        unsigned slot = nl->hash[i].hash & (size - 1);
+        while (hash[slot].id >= 0) slot = (slot + 1) & (size - 1);
+        hash[slot] = nl->hash[i];
+    }
+    free(nl->hash);
+    nl->hash = hash;
+    nl->hash_size = size;
+    return 0;
+}
+
+// Look a node name (with hash h) up; with add set an unknown name gets the next ID.
+// Returns -1 if unknown (or out of memory). Short names are compared in the slot itself,
+// so a hit costs one cache miss at most.
+static int intern_node(Netlist *nl, const char *name, size_t len, unsigned h, int add)
+{
+    if (nl->hash_size == 0 || (add && 2 * (nl->node_count + 1) > nl->hash_size)) {
+        if (!add || grow_hash(nl, 0) != 0) {
+            return -1;
+        }
+    }
+    unsigned long long key = node_key(name, len);
+    unsigned slot = h & (nl->hash_size - 1);
+    while (nl->hash[slot].id >= 0) {
+        const NodeSlot *entry = &nl->hash[slot];
+        if (entry->hash == h && entry->key == key &&
+            (key != 0 || same_name(name, nl->name_pool + nl->name_offset[entry->id], len))) {
+            return entry->id;
+        }
+        slot = (slot + 1) & (nl->hash_size - 1);
+    }
+    if (!add) {
+        return -1;
+    }
+
+    if (nl->node_count == nl->node_capacity) {
+        int capacity = nl->node_capacity ? nl->node_capacity * 2 : 256;
+        size_t *offsets = realloc(nl->name_offset, sizeof(size_t) * capacity);
+        if (!offsets) return -1;
+        nl->name_offset = offsets;
+        nl->node_capacity = capacity;
+    }
+    if (nl->name_used + len + 1 > nl->name_capacity) {
+        size_t capacity = nl->name_capacity ? nl->name_capacity * 2 : 4096;
+        while (capacity < nl->name_used + len + 1) capacity *= 2;
+        char *pool = realloc(nl->name_pool, capacity);
+        if (!pool) return -1;
+        nl->name_pool = pool;
+        nl->name_capacity = capacity;
+    }
+    memcpy(nl->name_pool + nl->name_used, name, len);
+    nl->name_pool[nl->name_used + len] = '\0';
+    nl->name_offset[nl->node_count] = nl->name_used;
+    nl->name_used += len + 1;
+    nl->hash[slot].hash = h;
+    nl->hash[slot].id = nl->node_count;
+    nl->hash[slot].key = key;
+    return nl->node_count++;
+}
+
+// Node ID by name (case-insensitive), or -1
+int netlist_node(const Netlist *nl, const char *name)
+{
+    size_t len = strlen(name);
+    return intern_node((Netlist *)nl, name, len, node_hash(name, len), 0);
+}
+
+const char *netlist_node_name(const Netlist *nl, int id)
+{
+    return (id >= 0 && id < nl->node_count) ? nl->name_pool + nl->name_offset[id] : NULL;
+}
+
+static int is_digit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+// Scale letter at s (len characters available); *used receives its length, 0 if none
+static double value_scale(const char *s, size_t len, size_t *used)
+{
+    *used = 1;
+    if (len >= 3 && fold(s[0]) == 'm' && fold(s[1]) == 'e' && fold(s[2]) == 'g') {
+        *used = 3;
+        return 1e6;
+    }
+    switch (s[0]) {
+        case 'f': case 'F': return 1e-15;
+        case 'p': case 'P': return 1e-12;
+        case 'n': case 'N': return 1e-9;
+        case 'u': case 'U': return 1e-6;
+        case 'm':           return 1e-3;
+        case 'M':           return 1e6;
+        case 'k': case 'K': return 1e3;
+        case 'g': case 'G': return 1e9;
+        case 't': case 'T': return 1e12;
+        case 'r': case 'R': return 1.0;
+        default: *used = 0; return 1.0;
+    }
+}
+
+// Parse a component value such as 470, 4.7k, 4k7, 1M, 2R2, 1e3 or 10kohm; returns 0 on success
+int parse_spice_value(const char *token, size_t len, double *value)
+{
+    size_t n = 0;
+    while (n < len && (is_digit(token[n]) || token[n] == '.' || token[n] == '+' || token[n] == '-' ||
+                       ((token[n] == 'e' || token[n] == 'E') && n > 0 && n + 1 < len &&
+                        (is_digit(token[n + 1]) || token[n + 1] == '+' || token[n + 1] == '-')))) {
+        n++;
+    }
+    if (n == 0) {
+        return -1;
+    }
+
+    size_t used;
+    double scale = value_scale(token + n, len - n, &used);
+    size_t rest = n + used;
+
+    // Letter as decimal point: 4k7 = 4.7k (only after a plain integer)
+    if (used > 0 && rest < len && is_digit(token[rest]) && memchr(token, '.', n) == NULL) {
+        size_t frac = rest;
+        while (frac < len && is_digit(token[frac])) frac++;
+        char buf[64];
+        if (n + 1 + (frac - rest) >= sizeof(buf)) {
+            return -1;
+        }
+        memcpy(buf, token, n);
+        buf[n] = '.';
+        memcpy(buf + n + 1, token + rest, frac - rest);
+        if (parse_double_token(buf, n + 1 + (frac - rest), value) != 0) {
+            return -1;
+        }
+        rest = frac;
+    } else if (parse_double_token(token, n, value) != 0) {
+        return -1;
+    }
+
+    // Anything left must be letters, e.g. "ohm"
+    for (; rest < len; rest++) {
+        if (!((token[rest] >= 'a' && token[rest] <= 'z') || (token[rest] >= 'A' && token[rest] <= 'Z'))) {
+            return -1;
+        }
+    }
+    *value *= scale;
+    return 0;
+}
+
+static int add_resistor(Netlist *nl, int a, int b, double ohms)
+{
+    if (nl->count == nl->capacity) {
+        int capacity = nl->capacity ? nl->capacity * 2 : 1024;
+        int *na = realloc(nl->node_a, sizeof(int) * capacity);
+        if (!na) return -1;
+        nl->node_a = na;
+        int *nb = realloc(nl->node_b, sizeof(int) * capacity);
+        if (!nb) return -1;
+        nl->node_b = nb;
+        double *v = realloc(nl->ohms, sizeof(double) * capacity);
+        if (!v) return -1;
+        nl->ohms = v;
+        nl->capacity = capacity;
+    }
+    nl->node_a[nl->count] = a;
+    nl->node_b[nl->count] = b;
+    nl->ohms[nl->count] = ohms;
+    nl->count++;
+    return 0;
+}
+
+static int netlist_error(char *error, size_t error_len, long line, const char *message)
+{
+    if (error && error_len > 0) {
+        snprintf(error, error_len, "line %ld: %s", line, message);
+    }
+    return -1;
+}
+
+// Character classes for the tokenizer: separators and the comment start end a token
+enum { CHAR_TOKEN, CHAR_SPACE, CHAR_COMMENT };
+
+static const unsigned char char_class[256] = {
+    [' '] = CHAR_SPACE, ['\t'] = CHAR_SPACE, ['\r'] = CHAR_SPACE, [','] = CHAR_SPACE,
+    [';'] = CHAR_COMMENT
+};
+
+// Resistor lines parsed but not yet interned
+typedef struct {
+    const char *node[2];
+    size_t node_len[2];
+    unsigned hash[2];
+    double ohms;
+    long line;
+} PendingResistor;
+
+// Intern the nodes of a batch of resistors. Their hash slots were prefetched when the lines
+// were parsed, so the table misses overlap instead of being paid one after another.
+static int flush_pending(Netlist *nl, PendingResistor *pending, int count, char *error, size_t error_len)
+{
+    for (int i = 0; i < count; i++) {
+        int a = intern_node(nl, pending[i].node[0], pending[i].node_len[0], pending[i].hash[0], 1);
+        int b = intern_node(nl, pending[i].node[1], pending[i].node_len[1], pending[i].hash[1], 1);
+        if (a < 0 || b < 0 || add_resistor(nl, a, b, pending[i].ohms) != 0) {
+            return netlist_error(error, error_len, pending[i].line, "out of memory");
+        }
+    }
+    return 0;
+}
+
+// Parse netlist text into nl (appending). Returns 0, or -1 with a message in error.
+int netlist_parse(const char *data, size_t len, Netlist *nl, char *error, size_t error_len)
+{
+    const char *p = data;
+    const char *end = data + len;
+    long line = 0;
+    PendingResistor pending[NETLIST_BATCH];
+    int pending_count = 0;
+
+    // Size the table for one node per two lines, typical of real circuits, instead of
+    // doubling up to it: every rehash of a large table costs a cache miss per node
+    long lines = 0;
+    for (const char *at = data; (at = memchr(at, '\n', (size_t)(end - at))) != NULL; at++) {
+        lines++;
+    }
+    if (lines > nl->hash_size && lines < (1L << 28) && grow_hash(nl, (int)lines) != 0) {
+        return netlist_error(error, error_len, 0, "out of memory");
+    }
+
+    while (p < end) {
+        const char *eol = memchr(p, '\n', (size_t)(end - p));
+        if (!eol) eol = end;
+        line++;
+
+        const char *tok[NETLIST_MAX_TOKENS];
+        size_t tok_len[NETLIST_MAX_TOKENS];
+        int count = 0;
+        int extra = 0;
+        const char *q = p;
+        while (q < eol) {
+            while (q < eol && char_class[(unsigned char)*q] == CHAR_SPACE) q++;
+            if (q == eol || *q == ';') break;
+            const char *start = q;
+            while (q < eol && char_class[(unsigned char)*q] == CHAR_TOKEN) q++;
+            if (count < NETLIST_MAX_TOKENS) {
+                tok[count] = start;
+                tok_len[count] = (size_t)(q - start);
+                count++;
+            } else {
+                extra = 1;
+            }
+        }
+        p = eol + 1;
+
+        if (count == 0 || tok[0][0] == '*' || tok[0][0] == '.') {
+            continue;
+        }
+        if (tok[0][0] == '+') {
+            flush_pending(nl, pending, pending_count, NULL, 0);
+            return netlist_error(error, error_len, line, "continuation lines are not supported");
+        }
+        if (tok[0][0] != 'R' && tok[0][0] != 'r') {
+            nl->skipped++;   // Some other element (C, L, V, ...)
+            continue;
+        }
+        if (count < 4 || extra) {
+            flush_pending(nl, pending, pending_count, NULL, 0);
+            return netlist_error(error, error_len, line, "expected: R<name> node node value");
+        }
+
+        double ohms;
+        if (parse_spice_value(tok[3], tok_len[3], &ohms) != 0 || !(ohms > 0) || isinf(ohms)) {
+            flush_pending(nl, pending, pending_count, NULL, 0);
+            return netlist_error(error, error_len, line, "resistance must be a positive value such as 470, 4k7 or 1M");
+        }
+
+        PendingResistor *r = &pending[pending_count++];
+        for (int k = 0; k < 2; k++) {
+            r->node[k] = tok[k + 1];
+            r->node_len[k] = tok_len[k + 1];
+            r->hash[k] = node_hash(tok[k + 1], tok_len[k + 1]);
+            if (nl->hash_size > 0) {
+                __builtin_prefetch(&nl->hash[r->hash[k] & (nl->hash_size - 1)]);
+            }
+        }
+        r->ohms = ohms;
+        r->line = line;
+        if (pending_count == NETLIST_BATCH) {
+            if (flush_pending(nl, pending, pending_count, error, error_len) != 0) {
+                return -1;
+            }
+            pending_count = 0;
+        }
+    }
+    return flush_pending(nl, pending, pending_count, error, error_len);
+}
+
+// Map a whole file (or read it, for pipes and devices) and hand its text to parse.
+// Returns parse's result, or -1 with a message in error if the file cannot be read.
+int parse_text_file(const char *path, text_parse_fn parse, void *arg, char *error, size_t error_len)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        snprintf(error, error_len, "cannot open '%s'", path);
+        return -1;
+    }
+
+    struct stat st;
+    int status;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+        if (st.st_size == 0) {
+            close(fd);
+            return parse("", 0, arg, error, error_len);
+        }
+        char *data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+        if (data == MAP_FAILED) {
+            snprintf(error, error_len, "cannot read '%s'", path);
+            close(fd);
+            return -1;
+        }
+        madvise(data, (size_t)st.st_size, MADV_SEQUENTIAL);
+        status = parse(data, (size_t)st.st_size, arg, error, error_len);
+        munmap(data, (size_t)st.st_size);
+    } else {
+        // Pipes and devices: read it all, then parse
+        size_t used = 0, capacity = 1 << 20;
+        char *data = malloc(capacity);
+        ssize_t n = 0;
+        while (data && (n = read(fd, data + used, capacity - used)) > 0) {
+            used += (size_t)n;
+            if (used == capacity) {
+                char *grown = realloc(data, capacity * 2);
+                if (!grown) {
+                    free(data);
+                    data = NULL;
+                    break;
+                }
+                data = grown;
+                capacity *= 2;
+            }
+        }
+        if (!data || n < 0) {
+            snprintf(error, error_len, "cannot read '%s'", path);
+            status = -1;
+        } else {
+            status = parse(data, used, arg, error, error_len);
+        }
+        free(data);
+    }
+    close(fd);
+    return status;
+}
+
+static int parse_netlist_text(const char *data, size_t len, void *arg, char *error, size_t error_len)
+{
+    return netlist_parse(data, len, arg, error, error_len);
+}
+
+// Load a netlist file. Returns 0, or -1 with a message in error.
+int netlist_load(const char *path, Netlist *nl, char *error, size_t error_len)
+{
+    return parse_text_file(path, parse_netlist_text, nl, error, error_len);
+}
+
+// Copy the netlist into a nodal-analysis network (node IDs are kept)
+int netlist_to_network(const Netlist *nl, ResistorNetwork *net)
+{
+    network_init(net);
+    for (int i = 0; i < nl->count; i++) {
+        if (network_add_resistor(net, nl->node_a[i], nl->node_b[i], nl->ohms[i]) != 0) {
+            network_free(net);
+            return -1;
+        }
+    }
+    return 0;
+}
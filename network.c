@@ -0,0 +1,830 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "funcs.h"
+
+// Equivalent resistance of an arbitrary resistor network by nodal analysis.
+// To measure between nodes a and b, node b is grounded and 1 A is injected at a, so the
+// resistance is the voltage at a. Only the part of the network connected to a takes part:
+// its reduced conductance (Laplacian) matrix is symmetric positive definite, stored in CSR,
+// and solved with conjugate gradients preconditioned by aggregation multigrid. The sparse
+// products and reductions of CG run on the thread pool in fixed row chunks, so results do
+// not depend on the thread count.
+
+#define NETWORK_CHUNK 4096          // rows per parallel chunk (and per partial sum)
+#define NETWORK_TOLERANCE 1e-12     // relative residual at which CG stops
+
+void network_init(ResistorNetwork *net)
+{
+    memset(net, 0, sizeof(*net));
+}
+
+void network_free(ResistorNetwork *net)
+{
+    free(net->node_a);
+    free(net->node_b);
+    free(net->conductance);
+    network_init(net);
+}
+
+// Add a resistor between two nodes (numbered from 0); returns 0 on success
+int network_add_resistor(ResistorNetwork *net, int a, int b, double ohms)
+{
+    if (a < 0 || b < 0 || !(ohms > 0) || isinf(ohms)) {
+        return -1;
+    }
+    if (net->count == net->capacity) {
+        int capacity = net->capacity ? net->capacity * 2 : 64;
+        int *na = realloc(net->node_a, sizeof(int) * capacity);
+        if (!na) return -1;
+        net->node_a = na;
+        int *nb = realloc(net->node_b, sizeof(int) * capacity);
+        if (!nb) return -1;
+        net->node_b = nb;
+        double *g = realloc(net->conductance, sizeof(double) * capacity);
+        if (!g) return -1;
+        net->conductance = g;
+        net->capacity = capacity;
+    }
+    net->node_a[net->count] = a;
+    net->node_b[net->count] = b;
+    net->conductance[net->count] = 1.0 / ohms;
+    net->count++;
+    if (a >= net->node_count) net->node_count = a + 1;
+    if (b >= net->node_count) net->node_count = b + 1;
+    return 0;
+}
+
+static int find_root(int *parent, int x)
+{
+    while (parent[x] != x) {
+        parent[x] = parent[parent[x]];   // path halving
+        x = parent[x];
+    }
+    return x;
+}
+
+// Reduced conductance matrix: diagonal kept apart, off-diagonal entries in CSR
+typedef struct {
+    int n;
+    int *row_start;     // n + 1
+    int *col;
+    double *val;
+    double *diag;
+} NodalMatrix;
+
+static void nodal_free(NodalMatrix *m)
+{
+    free(m->row_start);
+    free(m->col);
+    free(m->val);
+    free(m->diag);
+}
+
+// Number the nodes connected to a (except b) and assemble their conductance matrix.
+// index[] receives each node's row or -1. Returns 1 if b is not connected to a,
+// -1 on allocation failure.
+static int nodal_build(const ResistorNetwork *net, int a, int b, int *index, NodalMatrix *m)
+{
+    int *parent = malloc(sizeof(int) * net->node_count);
+    if (!parent) {
+        return -1;
+    }
+    for (int i = 0; i < net->node_count; i++) parent[i] = i;
+    for (int e = 0; e < net->count; e++) {
+        int ra = find_root(parent, net->node_a[e]);
+        int rb = find_root(parent, net->node_b[e]);
+        if (ra != rb) parent[ra] = rb;
+    }
+
+    int component = find_root(parent, a);
+    if (find_root(parent, b) != component) {
+        free(parent);
+        return 1;
+    }
+    m->n = 0;
+    for (int i = 0; i < net->node_count; i++) {
+        index[i] = (i != b && find_root(parent, i) == component) ? m->n++ : -1;
+    }
+    free(parent);
+
+    m->row_start = calloc((size_t)m->n + 1, sizeof(int));
+    m->diag = calloc((size_t)m->n + 1, sizeof(double));
+    if (!m->row_start || !m->diag) {
+        return -1;
+    }
+
+    // Count, then fill; parallel resistors simply leave two entries for the same pair
+    for (int e = 0; e < net->count; e++) {
+        int u = index[net->node_a[e]], v = index[net->node_b[e]];
+        if (u >= 0 && v >= 0 && u != v) {
+            m->row_start[u + 1]++;
+            m->row_start[v + 1]++;
+        }
+    }
+    for (int i = 0; i < m->n; i++) {
+        m->row_start[i + 1] += m->row_start[i];
+    }
+    int nnz = m->row_start[m->n];
+    m->col = malloc(sizeof(int) * (nnz + 1));
+    m->val = malloc(sizeof(double) * (nnz + 1));
+    int *fill = malloc(sizeof(int) * (m->n + 1));
+    if (!m->col || !m->val || !fill) {
+        free(fill);
+        return -1;
+    }
+    memcpy(fill, m->row_start, sizeof(int) * m->n);
+
+    for (int e = 0; e < net->count; e++) {
+        int u = index[net->node_a[e]], v = index[net->node_b[e]];
+        double g = net->conductance[e];
+        if (u == v) {
+            continue;   // Shorted onto itself (or both ends grounded)
+        }
+        if (u >= 0) m->diag[u] += g;
+        if (v >= 0) m->diag[v] += g;
+        if (u >= 0 && v >= 0) {
+            m->col[fill[u]] = v;
+            m->val[fill[u]++] = -g;
+            m->col[fill[v]] = u;
+            m->val[fill[v]++] = -g;
+        }
+    }
+    free(fill);
+    return 0;
+}
+
+// ---- aggregation multigrid preconditioner ----
+// Nodes are grouped into small aggregates of strongly connected neighbours; summing the
+// conductances between aggregates gives the next, coarser network (the Galerkin product
+// with a piecewise-constant prolongation). One V-cycle with symmetric Gauss-Seidel smoothing
+// is the preconditioner, which keeps CG iteration counts nearly flat as the network grows.
+
+#define AMG_MAX_LEVELS 24
+#define AMG_COARSEST 400            // solved directly by dense Cholesky below this size
+#define AMG_STRENGTH 0.25           // neighbour is strong if its conductance >= this * row max
+#define AMG_COARSE_SCALE 1.8        // over-correction that offsets the piecewise-constant
+                                    // prolongation's low energy (must stay below 2)
+
+typedef struct {
+    NodalMatrix a;
+    int *aggregate;     // row -> row of the next level
+    double *inv_diag;
+    double *x, *b;
+} AmgLevel;
+
+typedef struct {
+    AmgLevel level[AMG_MAX_LEVELS];
+    int levels;
+    double *cholesky;   // dense factor of the coarsest level (or NULL: smooth only)
+} Amg;
+
+// Group rows into aggregates; returns the number of aggregates or -1
+static int amg_aggregate(const NodalMatrix *m, int *aggregate)
+{
+    int count = 0;
+    for (int i = 0; i < m->n; i++) aggregate[i] = -1;
+
+    // Pass 1: a row whose strong neighbours are all free starts an aggregate with them
+    for (int i = 0; i < m->n; i++) {
+        if (aggregate[i] >= 0) continue;
+        double strongest = 0;
+        for (int k = m->row_start[i]; k < m->row_start[i + 1]; k++) {
+            if (-m->val[k] > strongest) strongest = -m->val[k];
+        }
+        int free_row = 1;
+        for (int k = m->row_start[i]; k < m->row_start[i + 1] && free_row; k++) {
+            if (-m->val[k] >= AMG_STRENGTH * strongest && aggregate[m->col[k]] >= 0) free_row = 0;
+        }
+        if (!free_row) continue;
+        aggregate[i] = count;
+        for (int k = m->row_start[i]; k < m->row_start[i + 1]; k++) {
+            if (-m->val[k] >= AMG_STRENGTH * strongest) aggregate[m->col[k]] = count;
+        }
+        count++;
+    }
+
+    // Pass 2: leftovers join the aggregate of their strongest neighbour
+    for (int i = 0; i < m->n; i++) {
+        if (aggregate[i] >= 0) continue;
+        int best = -1;
+        double strongest = 0;
+        for (int k = m->row_start[i]; k < m->row_start[i + 1]; k++) {
+            if (aggregate[m->col[k]] >= 0 && -m->val[k] > strongest) {
+                strongest = -m->val[k];
+                best = aggregate[m->col[k]];
+            }
+        }
+        aggregate[i] = best >= 0 ? best : count++;
+    }
+    return count;
+}
+
+// Coarse matrix: conductances summed between aggregates, internal ones folded into the diagonal
+static int amg_coarsen(const NodalMatrix *m, const int *aggregate, int nc, NodalMatrix *c)
+{
+    memset(c, 0, sizeof(*c));
+    c->n = nc;
+    int nnz = m->row_start[m->n];
+    int *members = malloc(sizeof(int) * m->n);
+    int *first = calloc((size_t)nc + 1, sizeof(int));
+    int *slot = malloc(sizeof(int) * nc);
+    c->row_start = calloc((size_t)nc + 1, sizeof(int));
+    c->diag = calloc((size_t)nc + 1, sizeof(double));
+    c->col = malloc(sizeof(int) * (nnz + 1));
+    c->val = malloc(sizeof(double) * (nnz + 1));
+    if (!members || !first || !slot || !c->row_start || !c->diag || !c->col || !c->val) {
+        free(members); free(first); free(slot);
+        return -1;
+    }
+
+    // Rows of each aggregate, by counting sort
+    for (int i = 0; i < m->n; i++) first[aggregate[i] + 1]++;
+    for (int I = 0; I < nc; I++) first[I + 1] += first[I];
+    for (int i = 0; i < m->n; i++) members[first[aggregate[i]]++] = i;
+    for (int I = nc; I > 0; I--) first[I] = first[I - 1];
+    first[0] = 0;
+
+    for (int J = 0; J < nc; J++) slot[J] = -1;
+    int fill = 0;
+    for (int I = 0; I < nc; I++) {
+        int row_begin = fill;
+        for (int s = first[I]; s < first[I + 1]; s++) {
+            int i = members[s];
+            c->diag[I] += m->diag[i];
+            for (int k = m->row_start[i]; k < m->row_start[i + 1]; k++) {
+                int J = aggregate[m->col[k]];
+                if (J == I) {
+                    c->diag[I] += m->val[k];
+                } else if (slot[J] >= row_begin) {
+                    c->val[slot[J]] += m->val[k];
+                } else {
+                    slot[J] = fill;
+                    c->col[fill] = J;
+                    c->val[fill++] = m->val[k];
+                }
+            }
+        }
+        c->row_start[I + 1] = fill;
+    }
+
+    free(members);
+    free(first);
+    free(slot);
+    return 0;
+}
+
+// In-place dense Cholesky of the coarsest matrix (lower triangle, row-major)
+static double *amg_dense_factor(const NodalMatrix *m)
+{
+    int n = m->n;
+    double *l = calloc((size_t)n * n, sizeof(double));
+    if (!l) return NULL;
+    for (int i = 0; i < n; i++) {
+        l[(size_t)i * n + i] = m->diag[i];
+        for (int k = m->row_start[i]; k < m->row_start[i + 1]; k++) {
+            l[(size_t)i * n + m->col[k]] += m->val[k];
+        }
+    }
+    for (int j = 0; j < n; j++) {
+        double d = l[(size_t)j * n + j];
+        for (int k = 0; k < j; k++) d -= l[(size_t)j * n + k] * l[(size_t)j * n + k];
+        if (!(d > 0)) {
+            free(l);
+            return NULL;
+        }
+        d = sqrt(d);
+        l[(size_t)j * n + j] = d;
+        for (int i = j + 1; i < n; i++) {
+            double s = l[(size_t)i * n + j];
+            for (int k = 0; k < j; k++) s -= l[(size_t)i * n + k] * l[(size_t)j * n + k];
+            l[(size_t)i * n + j] = s / d;
+        }
+    }
+    return l;
+}
+
+static void amg_dense_solve(const double *l, int n, const double *b, double *x)
+{
+    for (int i = 0; i < n; i++) {
+        double s = b[i];
+        for (int k = 0; k < i; k++) s -= l[(size_t)i * n + k] * x[k];
+        x[i] = s / l[(size_t)i * n + i];
+    }
+    for (int i = n - 1; i >= 0; i--) {
+        double s = x[i];
+        for (int k = i + 1; k < n; k++) s -= l[(size_t)k * n + i] * x[k];
+        x[i] = s / l[(size_t)i * n + i];
+    }
+}
+
+static void amg_free(Amg *amg)
+{
+    for (int l = 0; l < amg->levels; l++) {
+        if (l > 0) nodal_free(&amg->level[l].a);
+        free(amg->level[l].aggregate);
+        free(amg->level[l].inv_diag);
+        free(amg->level[l].x);
+        free(amg->level[l].b);
+    }
+    free(amg->cholesky);
+}
+
+static int amg_setup(const NodalMatrix *m, Amg *amg)
+{
+    memset(amg, 0, sizeof(*amg));
+    amg->level[0].a = *m;   // borrowed, not freed
+    amg->levels = 1;
+
+    while (1) {
+        AmgLevel *fine = &amg->level[amg->levels - 1];
+        int n = fine->a.n;
+        fine->x = malloc(sizeof(double) * n);
+        fine->b = malloc(sizeof(double) * n);
+        fine->inv_diag = malloc(sizeof(double) * n);
+        if (!fine->x || !fine->b || !fine->inv_diag) return -1;
+        for (int i = 0; i < n; i++) fine->inv_diag[i] = 1.0 / fine->a.diag[i];
+        if (n <= AMG_COARSEST || amg->levels == AMG_MAX_LEVELS) break;
+
+        fine->aggregate = malloc(sizeof(int) * n);
+        if (!fine->aggregate) return -1;
+        int nc = amg_aggregate(&fine->a, fine->aggregate);
+        if (nc < 0 || nc > n * 3 / 4) {
+            free(fine->aggregate);  // coarsening stalled: stop here and just smooth
+            fine->aggregate = NULL;
+            break;
+        }
+        AmgLevel *coarse = &amg->level[amg->levels];
+        if (amg_coarsen(&fine->a, fine->aggregate, nc, &coarse->a) != 0) {
+            nodal_free(&coarse->a);
+            return -1;
+        }
+        amg->levels++;
+    }
+
+    const NodalMatrix *last = &amg->level[amg->levels - 1].a;
+    if (last->n <= AMG_COARSEST) {
+        amg->cholesky = amg_dense_factor(last);
+    }
+    return 0;
+}
+
+// One Gauss-Seidel sweep over the rows, forwards or backwards
+static void amg_smooth(const AmgLevel *lv, double *x, int backward)
+{
+    const NodalMatrix *m = &lv->a;
+    const double *b = lv->b;
+    for (int s = 0; s < m->n; s++) {
+        int i = backward ? m->n - 1 - s : s;
+        double sum = b[i];
+        for (int k = m->row_start[i]; k < m->row_start[i + 1]; k++) {
+            sum -= m->val[k] * x[m->col[k]];
+        }
+        x[i] = sum * lv->inv_diag[i];
+    }
+}
+
+// level[l].x = V-cycle approximation of A^-1 level[l].b
+static void amg_cycle(Amg *amg, int l)
+{
+    AmgLevel *lv = &amg->level[l];
+    const NodalMatrix *m = &lv->a;
+
+    if (l == amg->levels - 1) {
+        if (amg->cholesky) {
+            amg_dense_solve(amg->cholesky, m->n, lv->b, lv->x);
+        } else {
+            memset(lv->x, 0, sizeof(double) * m->n);
+            for (int sweep = 0; sweep < 4; sweep++) amg_smooth(lv, lv->x, 0);
+            for (int sweep = 0; sweep < 4; sweep++) amg_smooth(lv, lv->x, 1);
+        }
+        return;
+    }
+
+    AmgLevel *next = &amg->level[l + 1];
+    memset(lv->x, 0, sizeof(double) * m->n);
+    amg_smooth(lv, lv->x, 0);
+
+    // Restrict the residual: sum over each aggregate
+    memset(next->b, 0, sizeof(double) * next->a.n);
+    for (int i = 0; i < m->n; i++) {
+        double r = lv->b[i] - m->diag[i] * lv->x[i];
+        for (int k = m->row_start[i]; k < m->row_start[i + 1]; k++) {
+            r -= m->val[k] * lv->x[m->col[k]];
+        }
+        next->b[lv->aggregate[i]] += r;
+    }
+    amg_cycle(amg, l + 1);
+    for (int i = 0; i < m->n; i++) {
+        lv->x[i] += AMG_COARSE_SCALE * next->x[lv->aggregate[i]];
+    }
+
+    amg_smooth(lv, lv->x, 1);
+}
+
+// ---- conjugate gradients ----
+typedef struct {
+    const NodalMatrix *m;
+    double *x, *r, *z, *p, *q;
+    double alpha, beta;
+    double *partial;        // one per chunk
+    double *partial_rr;
+} CGArgs;
+
+// q = A p and the chunk's share of p.q
+static void cg_multiply(int first, int last, void *arg)
+{
+    CGArgs *t = arg;
+    const NodalMatrix *m = t->m;
+    for (int c = first; c < last; c++) {
+        int end = (c + 1) * NETWORK_CHUNK < m->n ? (c + 1) * NETWORK_CHUNK : m->n;
+        double pq = 0;
+        for (int i = c * NETWORK_CHUNK; i < end; i++) {
+            double sum = m->diag[i] * t->p[i];
+            for (int k = m->row_start[i]; k < m->row_start[i + 1]; k++) {
+                sum += m->val[k] * t->p[m->col[k]];
+            }
+            t->q[i] = sum;
+            pq += t->p[i] * sum;
+        }
+        t->partial[c] = pq;
+    }
+}
+
+// x += alpha p, r -= alpha q, with the chunk's share of r.r
+static void cg_update(int first, int last, void *arg)
+{
+    CGArgs *t = arg;
+    for (int c = first; c < last; c++) {
+        int end = (c + 1) * NETWORK_CHUNK < t->m->n ? (c + 1) * NETWORK_CHUNK : t->m->n;
+        double rr = 0;
+        for (int i = c * NETWORK_CHUNK; i < end; i++) {
+            t->x[i] += t->alpha * t->p[i];
+            t->r[i] -= t->alpha * t->q[i];
+            rr += t->r[i] * t->r[i];
+        }
+        t->partial_rr[c] = rr;
+    }
+}
+
+// Chunk's share of r.z
+static void cg_dot_rz(int first, int last, void *arg)
+{
+    CGArgs *t = arg;
+    for (int c = first; c < last; c++) {
+        int end = (c + 1) * NETWORK_CHUNK < t->m->n ? (c + 1) * NETWORK_CHUNK : t->m->n;
+        double rz = 0;
+        for (int i = c * NETWORK_CHUNK; i < end; i++) {
+            rz += t->r[i] * t->z[i];
+        }
+        t->partial[c] = rz;
+    }
+}
+
+// p = z + beta p
+static void cg_direction(int first, int last, void *arg)
+{
+    CGArgs *t = arg;
+    int end = last * NETWORK_CHUNK < t->m->n ? last * NETWORK_CHUNK : t->m->n;
+    for (int i = first * NETWORK_CHUNK; i < end; i++) {
+        t->p[i] = t->z[i] + t->beta * t->p[i];
+    }
+}
+
+static double sum_partials(const double *partial, int chunks)
+{
+    double sum = 0;
+    for (int c = 0; c < chunks; c++) sum += partial[c];
+    return sum;
+}
+
+// Solve m x = rhs by CG preconditioned with a ready hierarchy; returns the iteration count or -1
+static int nodal_cg(const NodalMatrix *m, Amg *amg, const double *rhs, double *x)
+{
+    int n = m->n;
+    int chunks = (n + NETWORK_CHUNK - 1) / NETWORK_CHUNK;
+    double *work = calloc((size_t)3 * n + 2 * (size_t)chunks, sizeof(double));
+    if (!work) {
+        return -1;
+    }
+
+    CGArgs t;
+    t.m = m;
+    t.x = x;
+    t.r = work;
+    t.p = work + n;
+    t.q = work + 2 * (size_t)n;
+    t.z = amg->level[0].x;  // the preconditioner writes z in place
+    t.partial = work + 3 * (size_t)n;
+    t.partial_rr = t.partial + chunks;
+
+    double norm = 0;
+    for (int i = 0; i < n; i++) norm += rhs[i] * rhs[i];
+    double tolerance = NETWORK_TOLERANCE * sqrt(norm);
+    memset(x, 0, sizeof(double) * n);
+    memcpy(t.r, rhs, sizeof(double) * n);
+    memcpy(amg->level[0].b, t.r, sizeof(double) * n);
+    amg_cycle(amg, 0);
+    memcpy(t.p, t.z, sizeof(double) * n);
+    parallel_for(0, chunks, 1, cg_dot_rz, &t);
+    double rz = sum_partials(t.partial, chunks);
+
+    int max_iterations = 1000 + n / 10;
+    int iteration = 0;
+    int converged = norm == 0;
+    while (!converged && iteration < max_iterations) {
+        iteration++;
+        parallel_for(0, chunks, 1, cg_multiply, &t);
+        double pq = sum_partials(t.partial, chunks);
+        if (!(pq > 0)) {
+            break;  // Breakdown: the matrix is not positive definite
+        }
+        t.alpha = rz / pq;
+        parallel_for(0, chunks, 1, cg_update, &t);
+        if (sqrt(sum_partials(t.partial_rr, chunks)) <= tolerance) {
+            converged = 1;
+            break;
+        }
+        memcpy(amg->level[0].b, t.r, sizeof(double) * n);
+        amg_cycle(amg, 0);
+        parallel_for(0, chunks, 1, cg_dot_rz, &t);
+        double rz_next = sum_partials(t.partial, chunks);
+        t.beta = rz_next / rz;
+        rz = rz_next;
+        parallel_for(0, chunks, 1, cg_direction, &t);
+    }
+
+    free(work);
+    return converged ? iteration : -1;
+}
+
+// Solve m x = e_source (unit current into one node); returns the iteration count or -1
+static int nodal_solve(const NodalMatrix *m, int source, double *x)
+{
+    double *rhs = calloc((size_t)m->n, sizeof(double));
+    Amg amg;
+    memset(&amg, 0, sizeof(amg));
+    if (!rhs || amg_setup(m, &amg) != 0) {
+        free(rhs);
+        amg_free(&amg);
+        return -1;
+    }
+    rhs[source] = 1.0;
+    int iterations = nodal_cg(m, &amg, rhs, x);
+    free(rhs);
+    amg_free(&amg);
+    return iterations;
+}
+
+// Equivalent resistance between nodes a and b in ohms.
+// Returns INFINITY when they are not connected, 0 for a == b and NAN for invalid nodes or
+// if the solver fails.
+double network_equivalent_resistance(const ResistorNetwork *net, int a, int b)
+{
+    if (a < 0 || b < 0 || a >= net->node_count || b >= net->node_count) {
+        return NAN;
+    }
+    if (a == b) {
+        return 0.0;
+    }
+
+    int *index = malloc(sizeof(int) * net->node_count);
+    NodalMatrix m;
+    memset(&m, 0, sizeof(m));
+    double result = NAN;
+
+    int status = index ? nodal_build(net, a, b, index, &m) : -1;
+    if (status == 1) {
+        result = INFINITY;
+    } else if (status == 0) {
+        double *x = malloc(sizeof(double) * m.n);
+        if (x && nodal_solve(&m, index[a], x) >= 0) {
+            result = x[index[a]];
+        }
+        free(x);
+    }
+
+    nodal_free(&m);
+    free(index);
+    return result;
+}
+
+// ---- incremental updates ----
+// Changing the conductance of one resistor between rows p and q changes the matrix by
+// delta * u u^T with u = e_p - e_q. With up to NETWORK_MAX_RANK changed resistors
+// L' = L + U D U^T, and by the Woodbury identity (in the form that allows D to be singular)
+//   L'^-1 = L^-1 - L^-1 U (I + D U^T L^-1 U)^-1 D U^T L^-1.
+// The base solution x = L^-1 e_a is kept from the last full solve, so with c = U^T x
+// (which is also U^T L^-1 e_a, L being symmetric) and M = U^T L^-1 U,
+//   R' = x_a - c^T (I + D M)^-1 D c.
+// A resistor's first change costs one solve for its column of M; after that, changing any
+// tracked resistor is a rank x rank solve. When all slots are taken the base is rebuilt
+// from the current values with a full solve.
+
+struct NetworkBase {
+    NodalMatrix m;
+    Amg amg;
+    int *index;         // node -> row, or -1 (grounded b, or not connected to a)
+    double *x;          // L^-1 e_a
+    double *rhs;        // scratch for the column solves
+    double *y;
+};
+
+static void base_free(NetworkBase *base)
+{
+    if (!base) {
+        return;
+    }
+    nodal_free(&base->m);
+    amg_free(&base->amg);
+    free(base->index);
+    free(base->x);
+    free(base->rhs);
+    free(base->y);
+    free(base);
+}
+
+static int rebase_failed(NetworkIncremental *inc, NetworkBase *base)
+{
+    base_free(base);
+    inc->failed = 1;
+    inc->base_resistance = inc->resistance = NAN;
+    return -1;
+}
+
+// Full solve with the current conductances; clears the tracked changes. On failure the
+// resistance reads NAN and stays so until a later rebase succeeds.
+static int rebase(NetworkIncremental *inc)
+{
+    base_free(inc->base);
+    inc->base = NULL;
+    inc->rank = 0;
+    inc->rebases++;
+    inc->failed = 0;
+
+    NetworkBase *base = calloc(1, sizeof(NetworkBase));
+    if (!base) {
+        return rebase_failed(inc, NULL);
+    }
+    base->index = malloc(sizeof(int) * inc->net->node_count);
+    int status = base->index ? nodal_build(inc->net, inc->a, inc->b, base->index, &base->m) : -1;
+    if (status == 1) {
+        base_free(base);
+        inc->base_resistance = inc->resistance = INFINITY;
+        return 0;
+    }
+    int n = base->m.n;
+    if (status == 0) {
+        base->x = malloc(sizeof(double) * n);
+        base->rhs = calloc((size_t)n, sizeof(double));
+        base->y = malloc(sizeof(double) * n);
+    }
+    if (status != 0 || !base->x || !base->rhs || !base->y || amg_setup(&base->m, &base->amg) != 0) {
+        return rebase_failed(inc, base);
+    }
+    base->rhs[base->index[inc->a]] = 1.0;
+    if (nodal_cg(&base->m, &base->amg, base->rhs, base->x) < 0) {
+        return rebase_failed(inc, base);
+    }
+    base->rhs[base->index[inc->a]] = 0.0;
+    inc->base = base;
+    inc->base_resistance = inc->resistance = base->x[base->index[inc->a]];
+    return 0;
+}
+
+// u^T v for u = e_p - e_q, rows of -1 being grounded or outside
+static inline double edge_dot(int p, int q, const double *v)
+{
+    return (p >= 0 ? v[p] : 0.0) - (q >= 0 ? v[q] : 0.0);
+}
+
+// R' = x_a - c^T (I + D M)^-1 D c, by Gaussian elimination with partial pivoting
+static double woodbury_resistance(const NetworkIncremental *inc)
+{
+    int k = inc->rank;
+    double a[NETWORK_MAX_RANK][NETWORK_MAX_RANK + 1];
+    for (int i = 0; i < k; i++) {
+        for (int j = 0; j < k; j++) {
+            a[i][j] = (i == j ? 1.0 : 0.0) + inc->delta[i] * inc->coupling[i][j];
+        }
+        a[i][k] = inc->delta[i] * inc->c[i];
+    }
+    for (int col = 0; col < k; col++) {
+        int pivot = col;
+        for (int i = col + 1; i < k; i++) {
+            if (fabs(a[i][col]) > fabs(a[pivot][col])) pivot = i;
+        }
+        if (a[pivot][col] == 0) {
+            return NAN;
+        }
+        if (pivot != col) {
+            for (int j = col; j <= k; j++) {
+                double tmp = a[col][j];
+                a[col][j] = a[pivot][j];
+                a[pivot][j] = tmp;
+            }
+        }
+        for (int i = col + 1; i < k; i++) {
+            double f = a[i][col] / a[col][col];
+            for (int j = col; j <= k; j++) a[i][j] -= f * a[col][j];
+        }
+    }
+    double correction = 0;
+    double z[NETWORK_MAX_RANK];
+    for (int i = k - 1; i >= 0; i--) {
+        double sum = a[i][k];
+        for (int j = i + 1; j < k; j++) sum -= a[i][j] * z[j];
+        z[i] = sum / a[i][i];
+        correction += inc->c[i] * z[i];
+    }
+    return inc->base_resistance - correction;
+}
+
+// Track the resistance between a and b while resistor values change. net is kept and its
+// conductances are updated in place by network_inc_update. Returns 0, or -1 for invalid
+// nodes or if the solver fails.
+int network_inc_init(NetworkIncremental *inc, ResistorNetwork *net, int a, int b)
+{
+    memset(inc, 0, sizeof(*inc));
+    inc->net = net;
+    inc->a = a;
+    inc->b = b;
+    if (a < 0 || b < 0 || a >= net->node_count || b >= net->node_count) {
+        return -1;
+    }
+    if (a == b) {
+        inc->resistance = inc->base_resistance = 0.0;
+        return 0;
+    }
+    return rebase(inc);
+}
+
+void network_inc_free(NetworkIncremental *inc)
+{
+    base_free(inc->base);
+    inc->base = NULL;
+    inc->rank = 0;
+}
+
+// Set resistor number `resistor` (in order of network_add_resistor) to ohms and return the
+// new resistance between a and b, or NAN for a bad resistor or value or a solver failure.
+// After a failed full solve every update retries it, returning NAN until one succeeds.
+double network_inc_update(NetworkIncremental *inc, int resistor, double ohms)
+{
+    ResistorNetwork *net = inc->net;
+    if (resistor < 0 || resistor >= net->count || !(ohms > 0) || isinf(ohms)) {
+        return NAN;
+    }
+    double old_g = net->conductance[resistor];
+    net->conductance[resistor] = 1.0 / ohms;
+
+    if (inc->failed) {
+        return rebase(inc) == 0 ? inc->resistance : NAN;
+    }
+    NetworkBase *base = inc->base;
+    if (!base) {
+        return inc->resistance;     // a == b, or not connected: values do not matter
+    }
+    int p = base->index[net->node_a[resistor]], q = base->index[net->node_b[resistor]];
+    if (p == q) {
+        return inc->resistance;     // outside the measured part, or shorted onto itself
+    }
+
+    int j = 0;
+    while (j < inc->rank && inc->resistor[j] != resistor) j++;
+    if (j == inc->rank) {
+        if (inc->rank == NETWORK_MAX_RANK) {
+            return rebase(inc) == 0 ? inc->resistance : NAN;
+        }
+        // New column of M: y = L^-1 u
+        if (p >= 0) base->rhs[p] = 1.0;
+        if (q >= 0) base->rhs[q] = -1.0;
+        int status = nodal_cg(&base->m, &base->amg, base->rhs, base->y);
+        if (p >= 0) base->rhs[p] = 0.0;
+        if (q >= 0) base->rhs[q] = 0.0;
+        if (status < 0) {
+            net->conductance[resistor] = old_g;
+            return NAN;
+        }
+        inc->resistor[j] = resistor;
+        inc->row_p[j] = p;
+        inc->row_q[j] = q;
+        inc->base_conductance[j] = old_g;
+        inc->c[j] = edge_dot(p, q, base->x);
+        for (int i = 0; i <= j; i++) {
+            double m = edge_dot(inc->row_p[i], inc->row_q[i], base->y);
+            inc->coupling[i][j] = m;
+            inc->coupling[j][i] = m;
+        }
+        inc->rank++;
+    }
+    inc->delta[j] = net->conductance[resistor] - inc->base_conductance[j];
+    inc->resistance = woodbury_resistance(inc);
+    return inc->resistance;
+}
+
+double network_inc_resistance(const NetworkIncremental *inc)
+{
+    return inc->resistance;
+}
@@ -0,0 +1,248 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include "funcs.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define RBATCH_HAVE_X86 1
+#endif
+
+// Batched series/parallel/mixed evaluation of many same-shape configurations.
+// Inputs are structure-of-arrays: resistor i of configuration k is values[i * stride + k], so
+// one vector load picks up the same resistor of 8 configurations and every lane works on its own
+// configuration. Each kernel forms, per configuration, the sum of the values or of their
+// reciprocals over a run of rows; series, parallel and mixed totals are built from those sums.
+//
+// Precision:
+//   RBATCH_FLOAT        float sums; reciprocals from the hardware estimate plus one Newton step
+//                       (within 2 ulp), the fastest mode
+//   RBATCH_DOUBLE       values widened to double, exact reciprocals, double sums
+//   RBATCH_COMPENSATED  float lanes with correctly rounded reciprocals and Neumaier compensated
+//                       summation, so small terms next to large ones are not lost; the sum and
+//                       its carried error are added in double at the end. Series totals come out
+//                       near double accuracy; parallel ones are limited by the float reciprocals.
+
+#define RBATCH_BLOCK 1024       // configurations per step of the mixed evaluator
+
+typedef void (*rsum_kernel_fn)(const float *values, size_t stride, int rows, size_t count,
+                               int reciprocal, double *out);
+
+static rsum_kernel_fn rsum_kernels[3];
+static const char *rbatch_label = "scalar";
+static pthread_once_t rbatch_once = PTHREAD_ONCE_INIT;
+
+// ---- scalar kernels ----
+
+static void rsum_float_scalar(const float *values, size_t stride, int rows, size_t count,
+                              int reciprocal, double *out)
+{
+    for (size_t k = 0; k < count; k++) {
+        float sum = 0;
+        for (int i = 0; i < rows; i++) {
+            float x = values[(size_t)i * stride + k];
+            sum += reciprocal ? 1.0f / x : x;
+        }
+        out[k] = sum;
+    }
+}
+
+static void rsum_double_scalar(const float *values, size_t stride, int rows, size_t count,
+                               int reciprocal, double *out)
+{
+    for (size_t k = 0; k < count; k++) {
+        double sum = 0;
+        for (int i = 0; i < rows; i++) {
+            double x = values[(size_t)i * stride + k];
+            sum += reciprocal ? 1.0 / x : x;
+        }
+        out[k] = sum;
+    }
+}
+
+static void rsum_compensated_scalar(const float *values, size_t stride, int rows, size_t count,
+                                    int reciprocal, double *out)
+{
+    for (size_t k = 0; k < count; k++) {
+        float sum = 0, carry = 0;
+        for (int i = 0; i < rows; i++) {
+            float x = values[(size_t)i * stride + k];
+            x = reciprocal ? 1.0f / x : x;
+            float t = sum + x;
+            carry += fabsf(sum) >= fabsf(x) ? (sum - t) + x : (x - t) + sum;
+            sum = t;
+        }
+        out[k] = (double)sum + (double)carry;
+    }
+}
+
+// ---- AVX2 kernels: 8 configurations per vector ----
+
+#ifdef RBATCH_HAVE_X86
+// 1/x from the 12-bit estimate refined once; 0 and inf keep the exact answer (inf and 0)
+__attribute__((target("avx2,fma")))
+static inline __m256 fast_reciprocal(__m256 x)
+{
+    __m256 r = _mm256_rcp_ps(x);
+    __m256 refined = _mm256_mul_ps(r, _mm256_fnmadd_ps(x, r, _mm256_set1_ps(2.0f)));
+    return _mm256_blendv_ps(refined, r, _mm256_cmp_ps(refined, refined, _CMP_UNORD_Q));
+}
+
+__attribute__((target("avx2,fma")))
+static void rsum_float_avx2(const float *values, size_t stride, int rows, size_t count,
+                            int reciprocal, double *out)
+{
+    size_t k = 0;
+    for (; k + 16 <= count; k += 16) {
+        __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+        const float *p = values + k;
+        for (int i = 0; i < rows; i++, p += stride) {
+            __m256 x0 = _mm256_loadu_ps(p), x1 = _mm256_loadu_ps(p + 8);
+            if (reciprocal) {
+                x0 = fast_reciprocal(x0);
+                x1 = fast_reciprocal(x1);
+            }
+            s0 = _mm256_add_ps(s0, x0);
+            s1 = _mm256_add_ps(s1, x1);
+        }
+        _mm256_storeu_pd(out + k, _mm256_cvtps_pd(_mm256_castps256_ps128(s0)));
+        _mm256_storeu_pd(out + k + 4, _mm256_cvtps_pd(_mm256_extractf128_ps(s0, 1)));
+        _mm256_storeu_pd(out + k + 8, _mm256_cvtps_pd(_mm256_castps256_ps128(s1)));
+        _mm256_storeu_pd(out + k + 12, _mm256_cvtps_pd(_mm256_extractf128_ps(s1, 1)));
+    }
+    rsum_float_scalar(values + k, stride, rows, count - k, reciprocal, out + k);
+}
+
+__attribute__((target("avx2,fma")))
+static void rsum_double_avx2(const float *values, size_t stride, int rows, size_t count,
+                             int reciprocal, double *out)
+{
+    const __m256d one = _mm256_set1_pd(1.0);
+    size_t k = 0;
+    for (; k + 8 <= count; k += 8) {
+        __m256d s0 = _mm256_setzero_pd(), s1 = _mm256_setzero_pd();
+        const float *p = values + k;
+        for (int i = 0; i < rows; i++, p += stride) {
+            __m256 x = _mm256_loadu_ps(p);
+            __m256d x0 = _mm256_cvtps_pd(_mm256_castps256_ps128(x));
+            __m256d x1 = _mm256_cvtps_pd(_mm256_extractf128_ps(x, 1));
+            if (reciprocal) {
+                x0 = _mm256_div_pd(one, x0);
+                x1 = _mm256_div_pd(one, x1);
+            }
+            s0 = _mm256_add_pd(s0, x0);
+            s1 = _mm256_add_pd(s1, x1);
+        }
+        _mm256_storeu_pd(out + k, s0);
+        _mm256_storeu_pd(out + k + 4, s1);
+    }
+    rsum_double_scalar(values + k, stride, rows, count - k, reciprocal, out + k);
+}
+
+__attribute__((target("avx2,fma")))
+static void rsum_compensated_avx2(const float *values, size_t stride, int rows, size_t count,
+                                  int reciprocal, double *out)
+{
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+    size_t k = 0;
+    for (; k + 8 <= count; k += 8) {
+        __m256 sum = _mm256_setzero_ps(), carry = _mm256_setzero_ps();
+        const float *p = values + k;
+        for (int i = 0; i < rows; i++, p += stride) {
+            __m256 x = _mm256_loadu_ps(p);
+            if (reciprocal) {
+                x = _mm256_div_ps(one, x);
+            }
+            // Neumaier: the rounding error of sum + x, taken from whichever operand is larger
+            __m256 t = _mm256_add_ps(sum, x);
+            __m256 big = _mm256_cmp_ps(_mm256_and_ps(sum, abs_mask), _mm256_and_ps(x, abs_mask), _CMP_GE_OQ);
+            __m256 hi = _mm256_blendv_ps(x, sum, big);
+            __m256 lo = _mm256_blendv_ps(sum, x, big);
+            carry = _mm256_add_ps(carry, _mm256_add_ps(_mm256_sub_ps(hi, t), lo));
+            sum = t;
+        }
+        __m256d s0 = _mm256_cvtps_pd(_mm256_castps256_ps128(sum));
+        __m256d s1 = _mm256_cvtps_pd(_mm256_extractf128_ps(sum, 1));
+        __m256d c0 = _mm256_cvtps_pd(_mm256_castps256_ps128(carry));
+        __m256d c1 = _mm256_cvtps_pd(_mm256_extractf128_ps(carry, 1));
+        _mm256_storeu_pd(out + k, _mm256_add_pd(s0, c0));
+        _mm256_storeu_pd(out + k + 4, _mm256_add_pd(s1, c1));
+    }
+    rsum_compensated_scalar(values + k, stride, rows, count - k, reciprocal, out + k);
+}
+#endif
+
+static void select_rbatch_kernels(void)
+{
+    rsum_kernels[RBATCH_FLOAT] = rsum_float_scalar;
+    rsum_kernels[RBATCH_DOUBLE] = rsum_double_scalar;
+    rsum_kernels[RBATCH_COMPENSATED] = rsum_compensated_scalar;
+    rbatch_label = "scalar";
+#ifdef RBATCH_HAVE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        rsum_kernels[RBATCH_FLOAT] = rsum_float_avx2;
+        rsum_kernels[RBATCH_DOUBLE] = rsum_double_avx2;
+        rsum_kernels[RBATCH_COMPENSATED] = rsum_compensated_avx2;
+        rbatch_label = "avx2-fma";
+    }
+#endif
+}
+
+const char *batch_kernel_name(void)
+{
+    pthread_once(&rbatch_once, select_rbatch_kernels);
+    return rbatch_label;
+}
+
+// out[k] = total of resistor_count resistors in series, for count configurations
+void batch_series(const float *values, size_t stride, int resistor_count, size_t count,
+                  RBatchPrecision precision, double *out)
+{
+    pthread_once(&rbatch_once, select_rbatch_kernels);
+    rsum_kernels[precision](values, stride, resistor_count, count, 0, out);
+}
+
+// out[k] = total of resistor_count resistors in parallel, for count configurations
+void batch_parallel(const float *values, size_t stride, int resistor_count, size_t count,
+                    RBatchPrecision precision, double *out)
+{
+    pthread_once(&rbatch_once, select_rbatch_kernels);
+    rsum_kernels[precision](values, stride, resistor_count, count, 1, out);
+    for (size_t k = 0; k < count; k++) out[k] = 1.0 / out[k];
+}
+
+// Groups as in calc_mixed_resistance (type 1 series, 2 parallel), the groups themselves in
+// series. Returns 0, or -1 if the group sizes do not add up to resistor_count.
+int batch_mixed(const float *values, size_t stride, int resistor_count, const int group_sizes[],
+                const int connection_types[], int group_count, size_t count,
+                RBatchPrecision precision, double *out)
+{
+    int used = 0;
+    for (int g = 0; g < group_count; g++) {
+        if (group_sizes[g] < 1) return -1;
+        used += group_sizes[g];
+    }
+    if (used != resistor_count) {
+        return -1;
+    }
+    pthread_once(&rbatch_once, select_rbatch_kernels);
+
+    double group[RBATCH_BLOCK];
+    for (size_t base = 0; base < count; base += RBATCH_BLOCK) {
+        size_t lanes = count - base < RBATCH_BLOCK ? count - base : RBATCH_BLOCK;
+        double *total = out + base;
+        memset(total, 0, sizeof(double) * lanes);
+        int row = 0;
+        for (int g = 0; g < group_count; g++) {
+            int parallel = connection_types[g] != 1;
+            rsum_kernels[precision](values + (size_t)row * stride + base, stride, group_sizes[g],
+                                    lanes, parallel, group);
+            for (size_t k = 0; k < lanes; k++) total[k] += parallel ? 1.0 / group[k] : group[k];
+            row += group_sizes[g];
+        }
+    }
+    return 0;
+}
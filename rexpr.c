@@ -0,0 +1,353 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "funcs.h"
+
+// Nested series/parallel resistor expressions, e.g. "(R1 + (R2 || R3)) || R4".
+//
+//   expr     := parallel ( '+' parallel )*        series, lowest precedence
+//   parallel := primary ( '||' primary )*
+//   primary  := '(' expr ')' | R<n> | value        R<n> is the n-th entry of the values array,
+//                                                  value is a constant such as 470, 4k7 or 1M
+//
+// The text is compiled once into postorder bytecode over a small stack. Runs of the same
+// operator are flattened into one n-ary instruction (R1 + (R2 + R3) is a single SERIES 3),
+// and the evaluator is a tight loop whose n-ary steps are calc_series and calc_parallel
+// applied to the top of the stack. A flat chain keeps all its operands on the stack, so the
+// depth grows with chain length as well as nesting: brackets are limited to REXPR_MAX_NESTING,
+// and expressions deeper than REXPR_MAX_STACK are evaluated on a heap stack.
+
+typedef struct {
+    const char *text;
+    const char *p;
+    RExpr *expr;
+    int capacity;
+    int constant_capacity;
+    int depth;              // stack depth after the code emitted so far
+    int nesting;            // brackets currently open
+    char *error;
+    size_t error_len;
+} RExprParser;
+
+static int parse_error(RExprParser *ps, const char *message)
+{
+    if (ps->error && ps->error_len > 0) {
+        snprintf(ps->error, ps->error_len, "%s at position %d", message, (int)(ps->p - ps->text) + 1);
+    }
+    return -1;
+}
+
+static int emit(RExprParser *ps, int op, int arg)
+{
+    RExpr *e = ps->expr;
+    if (e->length == ps->capacity) {
+        int capacity = ps->capacity ? ps->capacity * 2 : 32;
+        RExprInstr *code = realloc(e->code, sizeof(RExprInstr) * capacity);
+        if (!code) {
+            return parse_error(ps, "out of memory");
+        }
+        e->code = code;
+        ps->capacity = capacity;
+    }
+    e->code[e->length].op = op;
+    e->code[e->length].arg = arg;
+    e->length++;
+
+    ps->depth += (op == REXPR_VALUE || op == REXPR_CONST) ? 1 : 1 - arg;
+    if (ps->depth > e->max_stack) {
+        e->max_stack = ps->depth;
+    }
+    return 0;
+}
+
+static void skip_blanks(RExprParser *ps)
+{
+    while (*ps->p == ' ' || *ps->p == '\t' || *ps->p == '\r' || *ps->p == '\n') ps->p++;
+}
+
+static int parse_series(RExprParser *ps);
+
+static int parse_primary(RExprParser *ps)
+{
+    skip_blanks(ps);
+    const char *start = ps->p;
+
+    if (*ps->p == '(') {
+        if (++ps->nesting > REXPR_MAX_NESTING) {
+            return parse_error(ps, "brackets nested too deeply");
+        }
+        ps->p++;
+        if (parse_series(ps) != 0) {
+            return -1;
+        }
+        skip_blanks(ps);
+        if (*ps->p != ')') {
+            return parse_error(ps, "expected ')'");
+        }
+        ps->p++;
+        ps->nesting--;
+        return 0;
+    }
+
+    // Operand token: letters, digits and '.', up to the next operator, bracket or blank
+    while (*ps->p && strchr(" \t\r\n()+|", *ps->p) == NULL) ps->p++;
+    size_t len = (size_t)(ps->p - start);
+    if (len == 0) {
+        ps->p = start;
+        return parse_error(ps, "expected a resistor or value");
+    }
+
+    if ((start[0] == 'R' || start[0] == 'r') && len > 1 && start[1] >= '0' && start[1] <= '9') {
+        char *end;
+        long index = strtol(start + 1, &end, 10);
+        if (end == ps->p && index >= 1 && index <= 1000000) {
+            if (index > ps->expr->value_count) {
+                ps->expr->value_count = (int)index;
+            }
+            return emit(ps, REXPR_VALUE, (int)index - 1);
+        }
+    }
+
+    double value;
+    if (parse_spice_value(start, len, &value) != 0 || !(value >= 0)) {
+        ps->p = start;
+        return parse_error(ps, "expected R<n> or a resistance value");
+    }
+    RExpr *e = ps->expr;
+    if (e->constant_count == ps->constant_capacity) {
+        int capacity = ps->constant_capacity ? ps->constant_capacity * 2 : 8;
+        float *constants = realloc(e->constants, sizeof(float) * capacity);
+        if (!constants) {
+            return parse_error(ps, "out of memory");
+        }
+        e->constants = constants;
+        ps->constant_capacity = capacity;
+    }
+    e->constants[e->constant_count] = (float)value;
+    return emit(ps, REXPR_CONST, e->constant_count++);
+}
+
+// Parse operands joined by op ("+" or "||"), emitting one n-ary instruction for the run.
+// An operand that itself ends in the same n-ary instruction is merged into it.
+static int parse_chain(RExprParser *ps, int op, const char *token, int (*operand)(RExprParser *))
+{
+    size_t token_len = strlen(token);
+    int count = 0;
+    RExpr *e = ps->expr;
+
+    while (1) {
+        int first = e->length;
+        if (operand(ps) != 0) {
+            return -1;
+        }
+        RExprInstr *last = &e->code[e->length - 1];
+        if (e->length - 1 > first && last->op == op) {
+            count += last->arg;     // (a + b) + c -> a + b + c
+            ps->depth += last->arg - 1;
+            e->length--;
+        } else {
+            count++;
+        }
+
+        skip_blanks(ps);
+        if (strncmp(ps->p, token, token_len) != 0) {
+            break;
+        }
+        ps->p += token_len;
+    }
+    return count > 1 ? emit(ps, op, count) : 0;
+}
+
+static int parse_parallel(RExprParser *ps)
+{
+    return parse_chain(ps, REXPR_PARALLEL, "||", parse_primary);
+}
+
+static int parse_series(RExprParser *ps)
+{
+    return parse_chain(ps, REXPR_SERIES, "+", parse_parallel);
+}
+
+// Compile an expression. Returns 0, or -1 with a message in error.
+int rexpr_compile(const char *text, RExpr *expr, char *error, size_t error_len)
+{
+    RExprParser ps;
+    memset(expr, 0, sizeof(*expr));
+    memset(&ps, 0, sizeof(ps));
+    ps.text = text;
+    ps.p = text;
+    ps.expr = expr;
+    ps.error = error;
+    ps.error_len = error_len;
+
+    if (parse_series(&ps) != 0) {
+        rexpr_free(expr);
+        return -1;
+    }
+    skip_blanks(&ps);
+    if (*ps.p != '\0') {
+        parse_error(&ps, *ps.p == '|' ? "expected '||'" : "unexpected character");
+        rexpr_free(expr);
+        return -1;
+    }
+    return 0;
+}
+
+// Build the expression for groups as in calc_mixed_resistance (type 1 series, any other parallel),
+// the groups themselves in series. Returns 0, or -1 for no groups, a bad group or out of memory.
+int rexpr_from_groups(const int group_sizes[], const int connection_types[], int group_count, RExpr *expr)
+{
+    RExprParser ps;
+    memset(expr, 0, sizeof(*expr));
+    if (group_count < 1) {
+        return -1;
+    }
+    memset(&ps, 0, sizeof(ps));
+    ps.text = ps.p = "";
+    ps.expr = expr;
+
+    int next = 0, operands = 0;
+    for (int g = 0; g < group_count; g++) {
+        if (group_sizes[g] < 1) {
+            rexpr_free(expr);
+            return -1;
+        }
+        int parallel = connection_types[g] != 1 && group_sizes[g] > 1;
+        for (int i = 0; i < group_sizes[g]; i++) {
+            if (emit(&ps, REXPR_VALUE, next++) != 0) {
+                rexpr_free(expr);
+                return -1;
+            }
+        }
+        if (parallel && emit(&ps, REXPR_PARALLEL, group_sizes[g]) != 0) {
+            rexpr_free(expr);
+            return -1;
+        }
+        operands += parallel ? 1 : group_sizes[g];
+    }
+    if (operands > 1 && emit(&ps, REXPR_SERIES, operands) != 0) {
+        rexpr_free(expr);
+        return -1;
+    }
+    expr->value_count = next;
+    return 0;
+}
+
+void rexpr_free(RExpr *expr)
+{
+    free(expr->code);
+    free(expr->constants);
+    memset(expr, 0, sizeof(*expr));
+}
+
+// Evaluate with values[0] standing for R1; values must hold expr->value_count entries.
+// Returns NAN for an empty program, or if a stack deeper than REXPR_MAX_STACK could not be
+// allocated.
+float rexpr_eval(const RExpr *expr, const float values[])
+{
+    if (expr->length == 0) {
+        return NAN;
+    }
+    float local[REXPR_MAX_STACK];
+    float *stack = local;
+    if (expr->max_stack > REXPR_MAX_STACK) {
+        stack = malloc(sizeof(float) * expr->max_stack);
+        if (!stack) {
+            return NAN;
+        }
+    }
+    stack[0] = NAN;     // the result if the program leaves nothing on the stack
+    int sp = 0;
+    const RExprInstr *code = expr->code;
+
+    for (int i = 0; i < expr->length; i++) {
+        int arg = code[i].arg;
+        switch (code[i].op) {
+            case REXPR_VALUE:
+                stack[sp++] = values[arg];
+                break;
+            case REXPR_CONST:
+                stack[sp++] = expr->constants[arg];
+                break;
+            case REXPR_SERIES:
+                sp -= arg;
+                stack[sp] = calc_series(&stack[sp], arg);
+                sp++;
+                break;
+            default:
+                sp -= arg;
+                stack[sp] = calc_parallel(&stack[sp], arg);
+                sp++;
+                break;
+        }
+    }
+    float result = stack[0];
+    if (stack != local) {
+        free(stack);
+    }
+    return result;
+}
+
+// Evaluate count configurations at once, laid out structure-of-arrays: values[i * stride + k]
+// is R(i+1) of configuration k. Each instruction runs across a block of lanes, so the dispatch
+// is paid once per block and the per-lane loops vectorize. Expressions deeper than
+// REXPR_MAX_STACK get a heap stack; if that fails, or the program is empty, every result is NAN.
+void rexpr_eval_block(const RExpr *expr, const float *values, size_t stride, int count, float *out)
+{
+    static _Thread_local float local[REXPR_MAX_STACK][REXPR_BLOCK];
+    float (*stack)[REXPR_BLOCK] = local;
+    if (expr->max_stack > REXPR_MAX_STACK) {
+        stack = malloc(sizeof(*stack) * expr->max_stack);
+    }
+    if (!stack || expr->length == 0) {
+        for (int k = 0; k < count; k++) out[k] = NAN;
+        if (stack != local) {
+            free(stack);
+        }
+        return;
+    }
+    const RExprInstr *code = expr->code;
+
+    for (int base = 0; base < count; base += REXPR_BLOCK) {
+        int lanes = count - base < REXPR_BLOCK ? count - base : REXPR_BLOCK;
+        int sp = 0;
+
+        for (int i = 0; i < expr->length; i++) {
+            int arg = code[i].arg;
+            float *top = stack[sp];
+            switch (code[i].op) {
+                case REXPR_VALUE:
+                    memcpy(top, values + (size_t)arg * stride + base, sizeof(float) * lanes);
+                    sp++;
+                    break;
+                case REXPR_CONST:
+                    for (int l = 0; l < lanes; l++) top[l] = expr->constants[arg];
+                    sp++;
+                    break;
+                case REXPR_SERIES:
+                    sp -= arg;
+                    for (int k = 1; k < arg; k++) {
+                        const float *row = stack[sp + k];
+                        for (int l = 0; l < lanes; l++) stack[sp][l] += row[l];
+                    }
+                    sp++;
+                    break;
+                default:
+                    sp -= arg;
+                    for (int l = 0; l < lanes; l++) stack[sp][l] = 1.0f / stack[sp][l];
+                    for (int k = 1; k < arg; k++) {
+                        const float *row = stack[sp + k];
+                        for (int l = 0; l < lanes; l++) stack[sp][l] += 1.0f / row[l];
+                    }
+                    for (int l = 0; l < lanes; l++) stack[sp][l] = 1.0f / stack[sp][l];
+                    sp++;
+                    break;
+            }
+        }
+        memcpy(out + base, stack[0], sizeof(float) * lanes);
+    }
+    if (stack != local) {
+        free(stack);
+    }
+}
@@ -0,0 +1,554 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include "funcs.h"
+
+// Dense solvers on top of the blocked factorisations: linear systems and inverses through LU,
+// least squares through Householder QR. Every right-hand side is carried through one blocked
+// sweep together, so a block of the factor is read once for all of them and the bulk of the
+// work is GEMM updates rather than vector operations.
+
+#define SOLVE_BLOCK 64          // Diagonal block size of the triangular solves
+#define SOLVE_RHS_GRAIN 16      // Right-hand sides per parallel chunk of a diagonal-block solve
+#define SOLVE_NARROW 4          // Up to this many right-hand sides the updates skip GEMM's packing
+#define SOLVE_ROW_GRAIN 256     // Rows per parallel chunk of a narrow update
+#define QR_BLOCK 32             // Householder panel width
+
+typedef struct {
+    const double *a;
+    int lda;
+    int k0;
+    int kb;
+    double *b;
+    int ldb;
+} BlockSolveArgs;
+
+// Pool task: solve the unit lower triangular diagonal block for right-hand sides [first, last)
+static void lower_block_columns(int first, int last, void *arg)
+{
+    BlockSolveArgs *t = arg;
+    for (int i = t->k0 + 1; i < t->k0 + t->kb; i++) {
+        const double *row = &t->a[(size_t)i * t->lda];
+        double *bi = &t->b[(size_t)i * t->ldb];
+        for (int p = t->k0; p < i; p++) {
+            const double *bp = &t->b[(size_t)p * t->ldb];
+            double f = row[p];
+            for (int j = first; j < last; j++) {
+                bi[j] -= f * bp[j];
+            }
+        }
+    }
+}
+
+// Pool task: solve the upper triangular diagonal block for right-hand sides [first, last)
+static void upper_block_columns(int first, int last, void *arg)
+{
+    BlockSolveArgs *t = arg;
+    for (int i = t->k0 + t->kb - 1; i >= t->k0; i--) {
+        const double *row = &t->a[(size_t)i * t->lda];
+        double *bi = &t->b[(size_t)i * t->ldb];
+        for (int p = i + 1; p < t->k0 + t->kb; p++) {
+            const double *bp = &t->b[(size_t)p * t->ldb];
+            double f = row[p];
+            for (int j = first; j < last; j++) {
+                bi[j] -= f * bp[j];
+            }
+        }
+        double inv = 1.0 / row[i];
+        for (int j = first; j < last; j++) {
+            bi[j] *= inv;
+        }
+    }
+}
+
+typedef struct {
+    const double *a;
+    int lda;
+    int k;
+    const double *x;
+    int ldx;
+    double *b;
+    int ldb;
+    int nrhs;
+} NarrowUpdateArgs;
+
+// Pool task: B -= A X for rows [first, last), one dot product per row and right-hand side.
+// With few right-hand sides this is bound by reading A once, which packing would triple.
+static void narrow_update_rows(int first, int last, void *arg)
+{
+    NarrowUpdateArgs *t = arg;
+    double x[SOLVE_BLOCK];
+    for (int j = 0; j < t->nrhs; j++) {
+        for (int p = 0; p < t->k; p++) {
+            x[p] = t->x[(size_t)p * t->ldx + j];
+        }
+        for (int i = first; i < last; i++) {
+            const double *row = &t->a[(size_t)i * t->lda];
+            double s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+            int p = 0;
+            for (; p + 4 <= t->k; p += 4) {
+                s0 += row[p] * x[p];
+                s1 += row[p + 1] * x[p + 1];
+                s2 += row[p + 2] * x[p + 2];
+                s3 += row[p + 3] * x[p + 3];
+            }
+            for (; p < t->k; p++) {
+                s0 += row[p] * x[p];
+            }
+            t->b[(size_t)i * t->ldb + j] -= (s0 + s1) + (s2 + s3);
+        }
+    }
+}
+
+// B (m x nrhs) -= A (m x k) * X (k x nrhs), for the off-diagonal updates of the block solves
+static void update_block(int m, int nrhs, int k, const double *a, int lda, const double *x, int ldx,
+                         double *b, int ldb)
+{
+    if (nrhs > SOLVE_NARROW) {
+        dgemm(m, nrhs, k, -1.0, a, lda, x, ldx, 1.0, b, ldb);
+        return;
+    }
+    NarrowUpdateArgs args = { a, lda, k, x, ldx, b, ldb, nrhs };
+    parallel_for(0, m, SOLVE_ROW_GRAIN, narrow_update_rows, &args);
+}
+
+// B = L^-1 B for the unit lower triangle of the n x n buffer a; B is n x nrhs
+static void solve_lower(const double *a, int lda, int n, double *b, int ldb, int nrhs)
+{
+    for (int k0 = 0; k0 < n; k0 += SOLVE_BLOCK) {
+        int kb = n - k0 < SOLVE_BLOCK ? n - k0 : SOLVE_BLOCK;
+        int rest = n - k0 - kb;
+
+        BlockSolveArgs args = { a, lda, k0, kb, b, ldb };
+        parallel_for(0, nrhs, SOLVE_RHS_GRAIN, lower_block_columns, &args);
+
+        // B2 -= L21 * X1
+        if (rest > 0) {
+            update_block(rest, nrhs, kb, &a[(size_t)(k0 + kb) * lda + k0], lda,
+                         &b[(size_t)k0 * ldb], ldb, &b[(size_t)(k0 + kb) * ldb], ldb);
+        }
+    }
+}
+
+// B = U^-1 B for the upper triangle of the n x n buffer a; B is n x nrhs
+static void solve_upper(const double *a, int lda, int n, double *b, int ldb, int nrhs)
+{
+    for (int k0 = (n - 1) / SOLVE_BLOCK * SOLVE_BLOCK; k0 >= 0; k0 -= SOLVE_BLOCK) {
+        int kb = n - k0 < SOLVE_BLOCK ? n - k0 : SOLVE_BLOCK;
+
+        BlockSolveArgs args = { a, lda, k0, kb, b, ldb };
+        parallel_for(0, nrhs, SOLVE_RHS_GRAIN, upper_block_columns, &args);
+
+        // B1 -= U12 * X2
+        if (k0 > 0) {
+            update_block(k0, nrhs, kb, &a[k0], lda, &b[(size_t)k0 * ldb], ldb, b, ldb);
+        }
+    }
+}
+
+// Reorder rows so that new row i is old row perm[i], following the permutation's cycles
+// with a single spare row instead of a second copy of B
+static int permute_rows(double *b, int ldb, int n, int nrhs, const int *perm)
+{
+    if (n <= 0) {
+        return 0;
+    }
+    unsigned char *done = calloc(n, 1);
+    double *spare = malloc(sizeof(double) * nrhs);
+    if (!done || !spare) {
+        free(done);
+        free(spare);
+        return -1;
+    }
+
+    size_t bytes = sizeof(double) * nrhs;
+    for (int start = 0; start < n; start++) {
+        if (done[start] || perm[start] == start) {
+            continue;
+        }
+        memcpy(spare, &b[(size_t)start * ldb], bytes);
+        int i = start;
+        while (perm[i] != start) {
+            memcpy(&b[(size_t)i * ldb], &b[(size_t)perm[i] * ldb], bytes);
+            done[i] = 1;
+            i = perm[i];
+        }
+        memcpy(&b[(size_t)i * ldb], spare, bytes);
+        done[i] = 1;
+    }
+
+    free(done);
+    free(spare);
+    return 0;
+}
+
+static void copy_rows(DMatrix *dst, const DMatrix *src)
+{
+    if (dst->data == src->data) {
+        return;
+    }
+    for (int i = 0; i < src->rows; i++) {
+        memcpy(&DMAT(dst, i, 0), &DMAT(src, i, 0), (size_t)src->cols * sizeof(double));
+    }
+}
+
+// Singular to working precision: a pivot at rounding level, below n * eps * max|U|.
+// (An exactly zero pivot only catches exactly singular input; [[1,2,3],[4,5,6],[7,8,9]]
+// factorises with a last pivot around 1e-16 and would otherwise "invert" to entries of 1e16.)
+static int lu_numerically_singular(const LUDecomp *lu)
+{
+    const DMatrix *u = &lu->factors;
+    int n = u->rows;
+    if (lu->singular) {
+        return 1;
+    }
+    double largest = 0;
+    for (int i = 0; i < n; i++) {
+        for (int j = i; j < n; j++) {
+            double v = fabs(DMAT(u, i, j));
+            if (v > largest) largest = v;
+        }
+    }
+    double tolerance = n * DBL_EPSILON * largest;
+    for (int i = 0; i < n; i++) {
+        if (fabs(DMAT(u, i, i)) <= tolerance) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Overwrite B (n x nrhs) with the solution X of A X = B for a factorised A.
+// Returns 0, 1 if A is singular to working precision (B left untouched) or -1 on bad
+// dimensions or out of memory.
+int lu_solve(const LUDecomp *lu, DMatrix *B)
+{
+    int n = lu->factors.rows;
+    if (B->rows != n) {
+        return -1;
+    }
+    if (lu_numerically_singular(lu)) {
+        return 1;
+    }
+    if (permute_rows(B->data, B->stride, n, B->cols, lu->perm) != 0) {
+        return -1;
+    }
+    solve_lower(lu->factors.data, lu->factors.stride, n, B->data, B->stride, B->cols);
+    solve_upper(lu->factors.data, lu->factors.stride, n, B->data, B->stride, B->cols);
+    return 0;
+}
+
+// X = A^-1 B for square A; X must have B's shape and may alias B.
+// Returns 0, 1 if A is singular to working precision or -1 on bad dimensions or out of memory.
+int dmatrix_solve(const DMatrix *A, const DMatrix *B, DMatrix *X)
+{
+    if (A->rows != A->cols || B->rows != A->rows || X->rows != B->rows || X->cols != B->cols) {
+        return -1;
+    }
+
+    LUDecomp lu;
+    if (lu_decompose(A, &lu) != 0) {
+        return -1;
+    }
+    copy_rows(X, B);
+    int status = lu_solve(&lu, X);
+    lu_free(&lu);
+    return status;
+}
+
+// Ainv = A^-1, solved against the identity in one pass; Ainv must be n x n and may alias A.
+// Returns 0, 1 if A is singular to working precision or -1 on bad dimensions or out of memory.
+int dmatrix_inverse(const DMatrix *A, DMatrix *Ainv)
+{
+    if (A->rows != A->cols || Ainv->rows != A->rows || Ainv->cols != A->cols) {
+        return -1;
+    }
+
+    LUDecomp lu;
+    if (lu_decompose(A, &lu) != 0) {
+        return -1;
+    }
+    dmatrix_fill(Ainv, 0.0);
+    for (int i = 0; i < A->rows; i++) {
+        DMAT(Ainv, i, i) = 1.0;
+    }
+    int status = lu_solve(&lu, Ainv);
+    lu_free(&lu);
+    return status;
+}
+
+// Unblocked Householder QR of the panel columns [k0, k0+kb) over rows k0..m-1.
+// Each reflector H = I - tau v v^T is applied to the rest of the panel only; its vector is
+// stored below the diagonal with v[0] = 1 implied. w needs room for the panel's columns.
+static void qr_factor_panel(double *a, int m, int lda, int k0, int kb, double *tau, double *w)
+{
+    int end = k0 + kb;
+
+    for (int k = k0; k < end; k++) {
+        double *row_k = &a[(size_t)k * lda];
+        double alpha = row_k[k];
+        double sigma = 0;
+        for (int i = k + 1; i < m; i++) {
+            double x = a[(size_t)i * lda + k];
+            sigma += x * x;
+        }
+        if (sigma == 0) {
+            tau[k] = 0;     // Column already zero below the diagonal, H = I
+            continue;
+        }
+
+        double beta = -copysign(sqrt(alpha * alpha + sigma), alpha);
+        double scale = 1.0 / (alpha - beta);
+        tau[k] = (beta - alpha) / beta;
+        for (int i = k + 1; i < m; i++) {
+            a[(size_t)i * lda + k] *= scale;
+        }
+        row_k[k] = beta;
+
+        // w = tau * v^T A(k:m, k+1:end), accumulated a row at a time, then A -= v w
+        if (k + 1 == end) {
+            continue;
+        }
+        for (int j = k + 1; j < end; j++) {
+            w[j] = row_k[j];
+        }
+        for (int i = k + 1; i < m; i++) {
+            const double *row_i = &a[(size_t)i * lda];
+            double v = row_i[k];
+            for (int j = k + 1; j < end; j++) {
+                w[j] += v * row_i[j];
+            }
+        }
+        for (int j = k + 1; j < end; j++) {
+            w[j] *= tau[k];
+            row_k[j] -= w[j];
+        }
+        for (int i = k + 1; i < m; i++) {
+            double *row_i = &a[(size_t)i * lda];
+            double v = row_i[k];
+            for (int j = k + 1; j < end; j++) {
+                row_i[j] -= v * w[j];
+            }
+        }
+    }
+}
+
+// Compact WY form of one panel's reflectors: H1 H2 ... Hkb = I - V T V^T
+typedef struct {
+    double *v;      // (m - k0) x kb, unit diagonal and zeros above written out
+    double *vt;     // V transposed, so both products below are plain row-major GEMMs
+    double *t;      // kb x kb upper triangular
+    double *w;      // kb x (widest block the reflector is applied to)
+} QRReflector;
+
+static int qr_reflector_alloc(QRReflector *r, int m, int width)
+{
+    r->v = malloc(sizeof(double) * (size_t)m * QR_BLOCK);
+    r->vt = malloc(sizeof(double) * (size_t)m * QR_BLOCK);
+    r->t = malloc(sizeof(double) * QR_BLOCK * QR_BLOCK);
+    r->w = malloc(sizeof(double) * (size_t)QR_BLOCK * width);
+    if (!r->v || !r->vt || !r->t || !r->w) {
+        free(r->v);
+        free(r->vt);
+        free(r->t);
+        free(r->w);
+        return -1;
+    }
+    return 0;
+}
+
+static void qr_reflector_free(QRReflector *r)
+{
+    free(r->v);
+    free(r->vt);
+    free(r->t);
+    free(r->w);
+}
+
+// Gather V and form T for the panel at k0 (T(0:c, c) = -tau_c T(0:c, 0:c) V(:, 0:c)^T v_c)
+static void qr_build_reflector(const double *a, int lda, int m, int k0, int kb, const double *tau,
+                               QRReflector *r)
+{
+    int mk = m - k0;
+    for (int i = 0; i < mk; i++) {
+        const double *row = &a[(size_t)(k0 + i) * lda + k0];
+        for (int c = 0; c < kb; c++) {
+            double x = i < c ? 0.0 : i == c ? 1.0 : row[c];
+            r->v[(size_t)i * kb + c] = x;
+            r->vt[(size_t)c * mk + i] = x;
+        }
+    }
+
+    double z[QR_BLOCK];
+    for (int c = 0; c < kb; c++) {
+        const double *vc = &r->vt[(size_t)c * mk];
+        for (int p = 0; p < c; p++) {
+            const double *vp = &r->vt[(size_t)p * mk];
+            double s = 0;
+            for (int i = c; i < mk; i++) {  // v_c is zero above row c
+                s += vp[i] * vc[i];
+            }
+            z[p] = s;
+        }
+        for (int row = 0; row < c; row++) {
+            double s = 0;
+            for (int p = row; p < c; p++) {
+                s += r->t[row * kb + p] * z[p];
+            }
+            r->t[row * kb + c] = -tau[k0 + c] * s;
+        }
+        r->t[c * kb + c] = tau[k0 + c];
+        for (int row = c + 1; row < kb; row++) {
+            r->t[row * kb + c] = 0.0;
+        }
+    }
+}
+
+// C = (I - V T V^T)^T C for the mk x ncols block C: two GEMMs around a small triangular product
+static void qr_apply_reflector(QRReflector *r, int mk, int kb, double *c, int ldc, int ncols)
+{
+    double *w = r->w;
+    dgemm(kb, ncols, mk, 1.0, r->vt, mk, c, ldc, 0.0, w, ncols);
+
+    // W = T^T W, bottom row first so the rows still needed are unchanged
+    for (int i = kb - 1; i >= 0; i--) {
+        double *wi = &w[(size_t)i * ncols];
+        double tii = r->t[i * kb + i];
+        for (int j = 0; j < ncols; j++) {
+            wi[j] *= tii;
+        }
+        for (int p = 0; p < i; p++) {
+            const double *wp = &w[(size_t)p * ncols];
+            double f = r->t[p * kb + i];
+            for (int j = 0; j < ncols; j++) {
+                wi[j] += f * wp[j];
+            }
+        }
+    }
+
+    dgemm(mk, ncols, kb, -1.0, r->v, kb, w, ncols, 1.0, c, ldc);
+}
+
+// Householder QR of an m x n matrix with m >= n into qr (a private copy). Blocked: each
+// QR_BLOCK-wide panel is factorised on its own, then applied to the trailing columns in
+// compact WY form, so the trailing update runs through dgemm.
+// Returns 0, or -1 if m < n or memory ran out. Release with qr_free().
+int qr_decompose(const DMatrix *A, QRDecomp *qr)
+{
+    int m = A->rows, n = A->cols;
+    qr->tau = NULL;
+    if (m < n || dmatrix_copy(&qr->factors, A) != 0) {
+        return -1;
+    }
+
+    QRReflector r;
+    qr->tau = malloc(sizeof(double) * n);
+    if (!qr->tau || qr_reflector_alloc(&r, m, n) != 0) {
+        qr_free(qr);
+        return -1;
+    }
+
+    double *a = qr->factors.data;
+    int lda = qr->factors.stride;
+    for (int k0 = 0; k0 < n; k0 += QR_BLOCK) {
+        int kb = n - k0 < QR_BLOCK ? n - k0 : QR_BLOCK;
+        int rest = n - k0 - kb;
+
+        qr_factor_panel(a, m, lda, k0, kb, qr->tau, r.w);
+        if (rest > 0) {
+            qr_build_reflector(a, lda, m, k0, kb, qr->tau, &r);
+            qr_apply_reflector(&r, m - k0, kb, &a[(size_t)k0 * lda + k0 + kb], lda, rest);
+        }
+    }
+    qr_reflector_free(&r);
+
+    // Rank deficient if a diagonal entry of R is at rounding level: below max(m, n) * eps * ||A||,
+    // with ||A||_F taken from R (Q is orthogonal)
+    double norm2 = 0;
+    for (int i = 0; i < n; i++) {
+        for (int j = i; j < n; j++) {
+            norm2 += a[(size_t)i * lda + j] * a[(size_t)i * lda + j];
+        }
+    }
+    double tolerance = m * DBL_EPSILON * sqrt(norm2);
+    qr->rank_deficient = 0;
+    for (int i = 0; i < n; i++) {
+        if (fabs(a[(size_t)i * lda + i]) <= tolerance) {
+            qr->rank_deficient = 1;
+        }
+    }
+    return 0;
+}
+
+void qr_free(QRDecomp *qr)
+{
+    dmatrix_free(&qr->factors);
+    free(qr->tau);
+    qr->tau = NULL;
+}
+
+// Least-squares solution X (n x nrhs) of min ||A X - B|| for a factorised A and B (m x nrhs).
+// If residual is not NULL it receives ||A X - B|| summed over all right-hand sides.
+// Returns 0, 1 if A is rank deficient or -1 on bad dimensions or out of memory.
+int qr_solve(const QRDecomp *qr, const DMatrix *B, DMatrix *X, double *residual)
+{
+    int m = qr->factors.rows, n = qr->factors.cols;
+    if (B->rows != m || X->rows != n || X->cols != B->cols) {
+        return -1;
+    }
+    if (qr->rank_deficient) {
+        return 1;
+    }
+
+    DMatrix work;
+    QRReflector r;
+    if (dmatrix_copy(&work, B) != 0) {
+        return -1;
+    }
+    if (qr_reflector_alloc(&r, m, B->cols) != 0) {
+        dmatrix_free(&work);
+        return -1;
+    }
+
+    // work = Q^T B, one panel of reflectors at a time
+    const double *a = qr->factors.data;
+    int lda = qr->factors.stride;
+    for (int k0 = 0; k0 < n; k0 += QR_BLOCK) {
+        int kb = n - k0 < QR_BLOCK ? n - k0 : QR_BLOCK;
+        qr_build_reflector(a, lda, m, k0, kb, qr->tau, &r);
+        qr_apply_reflector(&r, m - k0, kb, &DMAT(&work, k0, 0), work.stride, B->cols);
+    }
+    qr_reflector_free(&r);
+
+    // The rows below n of Q^T B are exactly the part R X cannot reach
+    if (residual) {
+        double sum = 0;
+        for (int i = n; i < m; i++) {
+            for (int j = 0; j < B->cols; j++) {
+                sum += DMAT(&work, i, j) * DMAT(&work, i, j);
+            }
+        }
+        *residual = sqrt(sum);
+    }
+
+    solve_upper(a, lda, n, work.data, work.stride, B->cols);
+    DMatrix top = dmatrix_view(&work, 0, 0, n, B->cols);
+    copy_rows(X, &top);
+    dmatrix_free(&work);
+    return 0;
+}
+
+// Least-squares solution X = argmin ||A X - B|| for m x n A with m >= n (exact solve when
+// square). X must be n x nrhs. Returns as qr_solve().
+int dmatrix_least_squares(const DMatrix *A, const DMatrix *B, DMatrix *X, double *residual)
+{
+    QRDecomp qr;
+    if (B->rows != A->rows || qr_decompose(A, &qr) != 0) {
+        return -1;
+    }
+    int status = qr_solve(&qr, B, X, residual);
+    qr_free(&qr);
+    return status;
+}
@@ -0,0 +1,1047 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <limits.h>
+#include <math.h>
+#include "funcs.h"
+
+// Compressed sparse matrices for the mostly-zero systems of circuit and thermal networks.
+//
+// CSR keeps each row's column indices and values together (ptr[i] .. ptr[i+1]); CSC is the same
+// with rows and columns swapped, so most routines work on "outer" slices and only decide at the
+// end which of the two indices is the row. Indices within a slice are kept sorted and unique.
+//
+// Determinant and solve reorder the matrix with reverse Cuthill-McKee, which gathers the entries
+// into a narrow band around the diagonal, then factorise that band with partial pivoting. All
+// fill-in stays inside the band, so the cost is O(n * bandwidth^2) rather than O(n^3).
+
+#define SPARSE_ROW_GRAIN 4096       // Rows per parallel chunk of a matrix-vector product
+#define SPARSE_CHUNKS_PER_THREAD 4  // Fixed work split of the sparse product
+#define SPARSE_SHORT_SLICE 32       // Slices up to this length are insertion-sorted
+
+static int sparse_error(char *error, size_t error_len, long line, const char *message)
+{
+    if (error && error_len > 0) {
+        snprintf(error, error_len, "line %ld: %s", line, message);
+    }
+    return -1;
+}
+
+static int outer_count(const SparseMatrix *S)
+{
+    return S->format == SPARSE_CSR ? S->rows : S->cols;
+}
+
+static int inner_count(const SparseMatrix *S)
+{
+    return S->format == SPARSE_CSR ? S->cols : S->rows;
+}
+
+// Allocate a rows x cols matrix with room for nnz entries; ptr is zeroed.
+// Returns 0, or -1 on bad dimensions or out of memory.
+int sparse_create(SparseMatrix *S, SparseFormat format, int rows, int cols, int nnz)
+{
+    memset(S, 0, sizeof(*S));
+    if (rows < 1 || cols < 1 || nnz < 0) {
+        return -1;
+    }
+    S->format = format;
+    S->rows = rows;
+    S->cols = cols;
+    S->nnz = nnz;
+    S->ptr = calloc((size_t)outer_count(S) + 1, sizeof(int));
+    S->idx = malloc(sizeof(int) * ((size_t)nnz + 1));
+    S->val = malloc(sizeof(double) * ((size_t)nnz + 1));
+    if (!S->ptr || !S->idx || !S->val) {
+        sparse_free(S);
+        return -1;
+    }
+    return 0;
+}
+
+void sparse_free(SparseMatrix *S)
+{
+    free(S->ptr);
+    free(S->idx);
+    free(S->val);
+    memset(S, 0, sizeof(*S));
+}
+
+// Store S in the other format (or copy it). The scatter visits the source slices in order,
+// so the indices of every target slice come out sorted.
+int sparse_convert(const SparseMatrix *S, SparseFormat format, SparseMatrix *T)
+{
+    if (sparse_create(T, format, S->rows, S->cols, S->nnz) != 0) {
+        return -1;
+    }
+    if (format == S->format) {
+        memcpy(T->ptr, S->ptr, sizeof(int) * ((size_t)outer_count(S) + 1));
+        memcpy(T->idx, S->idx, sizeof(int) * S->nnz);
+        memcpy(T->val, S->val, sizeof(double) * S->nnz);
+        return 0;
+    }
+
+    int outer = outer_count(T);
+    for (int p = 0; p < S->nnz; p++) {
+        T->ptr[S->idx[p] + 1]++;
+    }
+    for (int i = 0; i < outer; i++) {
+        T->ptr[i + 1] += T->ptr[i];
+    }
+    int *fill = malloc(sizeof(int) * ((size_t)outer + 1));
+    if (!fill) {
+        sparse_free(T);
+        return -1;
+    }
+    memcpy(fill, T->ptr, sizeof(int) * outer);
+    for (int j = 0; j < outer_count(S); j++) {
+        for (int p = S->ptr[j]; p < S->ptr[j + 1]; p++) {
+            int q = fill[S->idx[p]]++;
+            T->idx[q] = j;
+            T->val[q] = S->val[p];
+        }
+    }
+    free(fill);
+    return 0;
+}
+
+typedef struct {
+    int idx;
+    double val;
+} SparseEntry;
+
+static int compare_entry(const void *a, const void *b)
+{
+    int x = ((const SparseEntry *)a)->idx, y = ((const SparseEntry *)b)->idx;
+    return (x > y) - (x < y);
+}
+
+// Sort one slice's entries by index, keeping each value with its index
+static int sort_entries(int *idx, double *val, int len)
+{
+    if (len <= SPARSE_SHORT_SLICE) {
+        for (int i = 1; i < len; i++) {
+            int k = idx[i], j = i - 1;
+            double v = val[i];
+            while (j >= 0 && idx[j] > k) {
+                idx[j + 1] = idx[j];
+                val[j + 1] = val[j];
+                j--;
+            }
+            idx[j + 1] = k;
+            val[j + 1] = v;
+        }
+        return 0;
+    }
+    SparseEntry *tmp = malloc(sizeof(SparseEntry) * len);
+    if (!tmp) {
+        return -1;
+    }
+    for (int i = 0; i < len; i++) {
+        tmp[i].idx = idx[i];
+        tmp[i].val = val[i];
+    }
+    qsort(tmp, len, sizeof(SparseEntry), compare_entry);
+    for (int i = 0; i < len; i++) {
+        idx[i] = tmp[i].idx;
+        val[i] = tmp[i].val;
+    }
+    free(tmp);
+    return 0;
+}
+
+// Build from count (row, col, value) triplets, 0-based, in any order; duplicates are summed.
+// One stable counting sort buckets them by slice. Input already ordered by the other index
+// (column-major for CSR, as Matrix Market files usually are) comes out sorted; other slices
+// are sorted on their own, which stays cheap while slices are short.
+// Returns 0, or -1 on an out-of-range index or out of memory.
+int sparse_from_triplets(SparseMatrix *S, SparseFormat format, int rows, int cols, int count,
+                         const int *row, const int *col, const double *val)
+{
+    const int *key = format == SPARSE_CSR ? row : col;
+    const int *rest = format == SPARSE_CSR ? col : row;
+    if (sparse_create(S, format, rows, cols, count) != 0) {
+        return -1;
+    }
+    int outer = outer_count(S);
+    for (int k = 0; k < count; k++) {
+        if (row[k] < 0 || row[k] >= rows || col[k] < 0 || col[k] >= cols) {
+            sparse_free(S);
+            return -1;
+        }
+        S->ptr[key[k] + 1]++;
+    }
+    for (int i = 0; i < outer; i++) {
+        S->ptr[i + 1] += S->ptr[i];
+    }
+    int *fill = malloc(sizeof(int) * ((size_t)outer + 1));
+    if (!fill) {
+        sparse_free(S);
+        return -1;
+    }
+    memcpy(fill, S->ptr, sizeof(int) * outer);
+    for (int k = 0; k < count; k++) {
+        int q = fill[key[k]]++;
+        S->idx[q] = rest[k];
+        S->val[q] = val[k];
+    }
+    free(fill);
+
+    // Sort where needed, then merge duplicates (now adjacent) in place
+    int used = 0;
+    for (int i = 0, start = 0; i < outer; i++) {
+        int end = S->ptr[i + 1];
+        for (int p = start + 1; p < end; p++) {
+            if (S->idx[p] < S->idx[p - 1]) {
+                if (sort_entries(&S->idx[start], &S->val[start], end - start) != 0) {
+                    sparse_free(S);
+                    return -1;
+                }
+                break;
+            }
+        }
+        for (int p = start; p < end; p++) {
+            if (used > S->ptr[i] && S->idx[used - 1] == S->idx[p]) {
+                S->val[used - 1] += S->val[p];
+            } else {
+                S->idx[used] = S->idx[p];
+                S->val[used++] = S->val[p];
+            }
+        }
+        start = end;
+        S->ptr[i + 1] = used;
+    }
+    S->nnz = used;
+    return 0;
+}
+
+// Keep the nonzero entries of a dense matrix
+int sparse_from_dense(SparseMatrix *S, SparseFormat format, const DMatrix *A)
+{
+    int nnz = 0;
+    for (int i = 0; i < A->rows; i++) {
+        for (int j = 0; j < A->cols; j++) {
+            nnz += DMAT(A, i, j) != 0.0;
+        }
+    }
+    if (sparse_create(S, format, A->rows, A->cols, nnz) != 0) {
+        return -1;
+    }
+
+    int outer = outer_count(S), inner = inner_count(S), used = 0;
+    for (int o = 0; o < outer; o++) {
+        for (int k = 0; k < inner; k++) {
+            double v = format == SPARSE_CSR ? DMAT(A, o, k) : DMAT(A, k, o);
+            if (v != 0.0) {
+                S->idx[used] = k;
+                S->val[used++] = v;
+            }
+        }
+        S->ptr[o + 1] = used;
+    }
+    return 0;
+}
+
+// Expand into a newly created dense matrix
+int sparse_to_dense(const SparseMatrix *S, DMatrix *A)
+{
+    if (dmatrix_create(A, S->rows, S->cols) != 0) {
+        return -1;
+    }
+    dmatrix_fill(A, 0.0);
+    for (int o = 0; o < outer_count(S); o++) {
+        for (int p = S->ptr[o]; p < S->ptr[o + 1]; p++) {
+            if (S->format == SPARSE_CSR) {
+                DMAT(A, o, S->idx[p]) += S->val[p];
+            } else {
+                DMAT(A, S->idx[p], o) += S->val[p];
+            }
+        }
+    }
+    return 0;
+}
+
+typedef struct {
+    const SparseMatrix *S;
+    const double *x;
+    double *y;
+} MatvecArgs;
+
+// Pool task: y = S x for CSR rows [first, last)
+static void matvec_rows(int first, int last, void *arg)
+{
+    MatvecArgs *t = arg;
+    const int *ptr = t->S->ptr, *idx = t->S->idx;
+    const double *val = t->S->val, *x = t->x;
+    for (int i = first; i < last; i++) {
+        double sum = 0;
+        for (int p = ptr[i]; p < ptr[i + 1]; p++) {
+            sum += val[p] * x[idx[p]];
+        }
+        t->y[i] = sum;
+    }
+}
+
+// y = S x (x has S->cols entries, y has S->rows and must not alias x)
+void sparse_matvec(const SparseMatrix *S, const double *x, double *y)
+{
+    if (S->format == SPARSE_CSR) {
+        MatvecArgs args = { S, x, y };
+        parallel_for(0, S->rows, SPARSE_ROW_GRAIN, matvec_rows, &args);
+        return;
+    }
+
+    // CSC scatters into y, so columns cannot be split between threads without private copies
+    memset(y, 0, sizeof(double) * S->rows);
+    for (int j = 0; j < S->cols; j++) {
+        double xj = x[j];
+        for (int p = S->ptr[j]; p < S->ptr[j + 1]; p++) {
+            y[S->idx[p]] += S->val[p] * xj;
+        }
+    }
+}
+
+static int compare_int(const void *a, const void *b)
+{
+    int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+static void sort_slice(int *idx, int len)
+{
+    if (len > SPARSE_SHORT_SLICE) {
+        qsort(idx, len, sizeof(int), compare_int);
+        return;
+    }
+    for (int i = 1; i < len; i++) {
+        int v = idx[i], j = i - 1;
+        while (j >= 0 && idx[j] > v) {
+            idx[j + 1] = idx[j];
+            j--;
+        }
+        idx[j + 1] = v;
+    }
+}
+
+// Gustavson's product on outer slices: slice i of C = sum over entries (i, k) of L of
+// L(i, k) * slice k of R. For CSR that is C = L R; for CSC, pass L = B and R = A.
+typedef struct {
+    const SparseMatrix *L;
+    const SparseMatrix *R;
+    SparseMatrix *C;
+    int outer;
+    int inner;
+    int chunks;
+    int failed;
+} ProductArgs;
+
+static void chunk_range(const ProductArgs *t, int chunk, int *first, int *last)
+{
+    *first = (int)((long long)t->outer * chunk / t->chunks);
+    *last = (int)((long long)t->outer * (chunk + 1) / t->chunks);
+}
+
+// Pool task, first pass: count the entries of each output slice
+static void product_count(int chunk_first, int chunk_last, void *arg)
+{
+    ProductArgs *t = arg;
+    int *mark = malloc(sizeof(int) * t->inner);
+    if (!mark) {
+        t->failed = 1;
+        return;
+    }
+    for (int k = 0; k < t->inner; k++) mark[k] = -1;
+
+    for (int chunk = chunk_first; chunk < chunk_last; chunk++) {
+        int first, last;
+        chunk_range(t, chunk, &first, &last);
+        for (int i = first; i < last; i++) {
+            int count = 0;
+            for (int p = t->L->ptr[i]; p < t->L->ptr[i + 1]; p++) {
+                int k = t->L->idx[p];
+                for (int q = t->R->ptr[k]; q < t->R->ptr[k + 1]; q++) {
+                    int j = t->R->idx[q];
+                    if (mark[j] != i) {
+                        mark[j] = i;
+                        count++;
+                    }
+                }
+            }
+            t->C->ptr[i + 1] = count;
+        }
+    }
+    free(mark);
+}
+
+// Pool task, second pass: accumulate each output slice densely, then emit it sorted
+static void product_fill(int chunk_first, int chunk_last, void *arg)
+{
+    ProductArgs *t = arg;
+    int *mark = malloc(sizeof(int) * t->inner);
+    double *acc = malloc(sizeof(double) * t->inner);
+    if (!mark || !acc) {
+        free(mark);
+        free(acc);
+        t->failed = 1;
+        return;
+    }
+    for (int k = 0; k < t->inner; k++) mark[k] = -1;
+
+    for (int chunk = chunk_first; chunk < chunk_last; chunk++) {
+        int first, last;
+        chunk_range(t, chunk, &first, &last);
+        for (int i = first; i < last; i++) {
+            int start = t->C->ptr[i], used = start;
+            for (int p = t->L->ptr[i]; p < t->L->ptr[i + 1]; p++) {
+                int k = t->L->idx[p];
+                double v = t->L->val[p];
+                for (int q = t->R->ptr[k]; q < t->R->ptr[k + 1]; q++) {
+                    int j = t->R->idx[q];
+                    if (mark[j] != i) {
+                        mark[j] = i;
+                        acc[j] = v * t->R->val[q];
+                        t->C->idx[used++] = j;
+                    } else {
+                        acc[j] += v * t->R->val[q];
+                    }
+                }
+            }
+            sort_slice(&t->C->idx[start], used - start);
+            for (int p = start; p < used; p++) {
+                t->C->val[p] = acc[t->C->idx[p]];
+            }
+        }
+    }
+    free(mark);
+    free(acc);
+}
+
+// C = A * B in A's format (B is converted if stored the other way). Entries that cancel to
+// zero are kept. Returns 0, or -1 on mismatched dimensions or out of memory.
+int sparse_multiply(const SparseMatrix *A, const SparseMatrix *B, SparseMatrix *C)
+{
+    if (A->cols != B->rows) {
+        return -1;
+    }
+    SparseMatrix converted;
+    const SparseMatrix *Bf = B;
+    if (B->format != A->format) {
+        if (sparse_convert(B, A->format, &converted) != 0) {
+            return -1;
+        }
+        Bf = &converted;
+    }
+
+    int status = -1;
+    ProductArgs t;
+    t.L = A->format == SPARSE_CSR ? A : Bf;
+    t.R = A->format == SPARSE_CSR ? Bf : A;
+    t.failed = 0;
+    if (sparse_create(C, A->format, A->rows, B->cols, 0) == 0) {
+        t.C = C;
+        t.outer = outer_count(C);
+        t.inner = inner_count(C);
+        t.chunks = threadpool_size() * SPARSE_CHUNKS_PER_THREAD;
+        if (t.chunks > t.outer) t.chunks = t.outer;
+
+        parallel_for(0, t.chunks, 1, product_count, &t);
+        for (int i = 0; i < t.outer && !t.failed; i++) {
+            if (C->ptr[i + 1] > INT_MAX - C->ptr[i]) {
+                t.failed = 1;   // More entries than an int index can address
+                break;
+            }
+            C->ptr[i + 1] += C->ptr[i];
+        }
+        if (!t.failed) {
+            C->nnz = C->ptr[t.outer];
+            free(C->idx);
+            free(C->val);
+            C->idx = malloc(sizeof(int) * ((size_t)C->nnz + 1));
+            C->val = malloc(sizeof(double) * ((size_t)C->nnz + 1));
+            if (C->idx && C->val) {
+                parallel_for(0, t.chunks, 1, product_fill, &t);
+                status = t.failed ? -1 : 0;
+            }
+        }
+        if (status != 0) {
+            sparse_free(C);
+        }
+    }
+    if (Bf == &converted) {
+        sparse_free(&converted);
+    }
+    return status;
+}
+
+// Pattern of S + S^T without the diagonal, as adjacency lists (square S only)
+static int symmetric_pattern(const SparseMatrix *S, int **start_out, int **adj_out)
+{
+    int n = S->rows;
+    int *start = calloc((size_t)n + 1, sizeof(int));
+    int *adj = malloc(sizeof(int) * (2 * (size_t)S->nnz + 1));
+    int *mark = malloc(sizeof(int) * ((size_t)n + 1));
+    if (!start || !adj || !mark) {
+        free(start);
+        free(adj);
+        free(mark);
+        return -1;
+    }
+
+    for (int o = 0; o < n; o++) {
+        for (int p = S->ptr[o]; p < S->ptr[o + 1]; p++) {
+            if (S->idx[p] != o) {
+                start[o + 1]++;
+                start[S->idx[p] + 1]++;
+            }
+        }
+    }
+    for (int i = 0; i < n; i++) {
+        start[i + 1] += start[i];
+    }
+    memcpy(mark, start, sizeof(int) * n);
+    for (int o = 0; o < n; o++) {
+        for (int p = S->ptr[o]; p < S->ptr[o + 1]; p++) {
+            int k = S->idx[p];
+            if (k != o) {
+                adj[mark[o]++] = k;
+                adj[mark[k]++] = o;
+            }
+        }
+    }
+
+    // An entry stored on both sides of the diagonal shows up twice: drop the repeats
+    for (int i = 0; i < n; i++) mark[i] = -1;
+    int used = 0;
+    for (int i = 0, begin = 0; i < n; i++) {
+        int end = start[i + 1];
+        for (int p = begin; p < end; p++) {
+            if (mark[adj[p]] != i) {
+                mark[adj[p]] = i;
+                adj[used++] = adj[p];
+            }
+        }
+        begin = end;
+        start[i + 1] = used;
+    }
+    free(mark);
+    *start_out = start;
+    *adj_out = adj;
+    return 0;
+}
+
+// Breadth-first levels from root; level[] must be -1 on entry for every node it reaches and
+// is left set. queue receives the nodes in visiting order. Returns the number reached, with
+// the index in queue where the last level starts in *last_level.
+static int bfs_levels(const int *start, const int *adj, int root, int *level, int *queue, int *last_level)
+{
+    int head = 0, tail = 0;
+    queue[tail++] = root;
+    level[root] = 0;
+    *last_level = 0;
+    while (head < tail) {
+        int v = queue[head++];
+        for (int p = start[v]; p < start[v + 1]; p++) {
+            int w = adj[p];
+            if (level[w] < 0) {
+                level[w] = level[v] + 1;
+                if (level[w] > level[queue[*last_level]]) {
+                    *last_level = tail;
+                }
+                queue[tail++] = w;
+            }
+        }
+    }
+    return tail;
+}
+
+// Reverse Cuthill-McKee ordering of a square matrix: perm[new] = original index.
+// Every connected part starts from a pseudo-peripheral node (George-Liu) and is walked
+// breadth first, neighbours by increasing degree; reversing the result narrows the profile.
+// Returns 0, or -1 if S is not square or memory ran out.
+int sparse_rcm(const SparseMatrix *S, int *perm)
+{
+    if (S->rows != S->cols) {
+        return -1;
+    }
+    int n = S->rows;
+    int *start, *adj;
+    if (symmetric_pattern(S, &start, &adj) != 0) {
+        return -1;
+    }
+    int *level = malloc(sizeof(int) * n);
+    int *queue = malloc(sizeof(int) * n);
+    if (!level || !queue) {
+        free(level);
+        free(queue);
+        free(start);
+        free(adj);
+        return -1;
+    }
+    for (int i = 0; i < n; i++) level[i] = -1;
+
+    int placed = 0;
+    for (int seed = 0; seed < n; seed++) {
+        if (level[seed] >= 0) {
+            continue;
+        }
+
+        // Pseudo-peripheral root: hop to a low-degree node of the last level while that
+        // increases the eccentricity. Levels are reset after each trial.
+        int root = seed, last, reached = bfs_levels(start, adj, root, level, queue, &last);
+        for (int i = 0; i < reached; i++) {
+            int v = queue[i];
+            if (start[v + 1] - start[v] < start[root + 1] - start[root]) root = v;
+        }
+        int depth = -1;
+        while (1) {
+            for (int i = 0; i < reached; i++) level[queue[i]] = -1;
+            reached = bfs_levels(start, adj, root, level, queue, &last);
+            int ecc = level[queue[reached - 1]];
+            if (ecc <= depth) {
+                break;
+            }
+            depth = ecc;
+            int next = queue[last];
+            for (int i = last; i < reached; i++) {
+                int v = queue[i];
+                if (start[v + 1] - start[v] < start[next + 1] - start[next]) next = v;
+            }
+            if (next == root) {
+                break;
+            }
+            root = next;
+        }
+        for (int i = 0; i < reached; i++) level[queue[i]] = -1;
+
+        // Cuthill-McKee walk, writing into perm; level[] doubles as the visited flag
+        int head = placed;
+        perm[placed++] = root;
+        level[root] = 0;
+        while (head < placed) {
+            int v = perm[head++];
+            int first = placed;
+            for (int p = start[v]; p < start[v + 1]; p++) {
+                int w = adj[p];
+                if (level[w] < 0) {
+                    level[w] = 0;
+                    perm[placed++] = w;
+                }
+            }
+            // Newly queued neighbours by increasing degree (insertion sort, lists are short)
+            for (int i = first + 1; i < placed; i++) {
+                int w = perm[i], d = start[w + 1] - start[w], j = i - 1;
+                while (j >= first && start[perm[j] + 1] - start[perm[j]] > d) {
+                    perm[j + 1] = perm[j];
+                    j--;
+                }
+                perm[j + 1] = w;
+            }
+        }
+    }
+
+    for (int i = 0, j = n - 1; i < j; i++, j--) {
+        int tmp = perm[i];
+        perm[i] = perm[j];
+        perm[j] = tmp;
+    }
+    free(level);
+    free(queue);
+    free(start);
+    free(adj);
+    return 0;
+}
+
+// Lower and upper bandwidth of a square S, after the symmetric reordering perm (NULL = none)
+int sparse_bandwidth(const SparseMatrix *S, const int *perm, int *lower, int *upper)
+{
+    int n = S->rows;
+    int *inverse = NULL;
+    *lower = *upper = 0;
+    if (perm) {
+        inverse = malloc(sizeof(int) * n);
+        if (!inverse) {
+            return -1;
+        }
+        for (int i = 0; i < n; i++) inverse[perm[i]] = i;
+    }
+    for (int o = 0; o < outer_count(S); o++) {
+        for (int p = S->ptr[o]; p < S->ptr[o + 1]; p++) {
+            int r = S->format == SPARSE_CSR ? o : S->idx[p];
+            int c = S->format == SPARSE_CSR ? S->idx[p] : o;
+            if (inverse) {
+                r = inverse[r];
+                c = inverse[c];
+            }
+            if (r - c > *lower) *lower = r - c;
+            if (c - r > *upper) *upper = c - r;
+        }
+    }
+    free(inverse);
+    return 0;
+}
+
+// y -= factor * x over len entries, four at a time with GCC vector extensions
+static void row_axpy(double *y, const double *x, int len, double factor)
+{
+    typedef double vec4 __attribute__((vector_size(4 * sizeof(double))));
+    int j = 0;
+    for (; j + 4 <= len; j += 4) {
+        vec4 a, b;
+        memcpy(&a, &y[j], sizeof(a));
+        memcpy(&b, &x[j], sizeof(b));
+        a -= factor * b;
+        memcpy(&y[j], &a, sizeof(a));
+    }
+    for (; j < len; j++) {
+        y[j] -= factor * x[j];
+    }
+}
+
+#define BAND(lu, i, j) ((lu)->band[(size_t)(i) * (lu)->width + (j) - (i) + (lu)->kl])
+
+// Band LU with partial pivoting of the RCM-reordered matrix. Row i of the band holds columns
+// i - kl .. i + ku + kl: pivoting can only pull a row up by kl, adding at most kl to the upper
+// bandwidth. Multipliers are kept per column apart from the band, with the row swaps applied
+// as they happened (as LAPACK's gbtrf does), so earlier columns are never touched again.
+// Each row's last possibly nonzero column is tracked, so rows that are never pulled up by a
+// pivot (the usual case for diagonally dominant network matrices) skip the extra kl zeros.
+// Returns 0, or -1 if S is not square or the band does not fit in memory. Release with
+// sparse_lu_free().
+int sparse_lu_factor(const SparseMatrix *S, SparseLU *lu)
+{
+    memset(lu, 0, sizeof(*lu));
+    if (S->rows != S->cols) {
+        return -1;
+    }
+    int n = S->rows;
+    lu->n = n;
+    lu->perm = malloc(sizeof(int) * n);
+    lu->pivot = malloc(sizeof(int) * n);
+    lu->reach = malloc(sizeof(int) * n);
+    int *inverse = malloc(sizeof(int) * n);
+    if (!lu->perm || !lu->pivot || !lu->reach || !inverse || sparse_rcm(S, lu->perm) != 0 ||
+        sparse_bandwidth(S, lu->perm, &lu->kl, &lu->ku) != 0) {
+        free(inverse);
+        sparse_lu_free(lu);
+        return -1;
+    }
+    int kl = lu->kl, ku = lu->ku;
+    lu->width = 2 * kl + ku + 1;
+    lu->band = calloc((size_t)n * lu->width, sizeof(double));
+    lu->lower = calloc((size_t)n * kl + 1, sizeof(double));
+    if (!lu->band || !lu->lower) {
+        free(inverse);
+        sparse_lu_free(lu);
+        return -1;
+    }
+
+    for (int i = 0; i < n; i++) {
+        inverse[lu->perm[i]] = i;
+        lu->reach[i] = i;
+    }
+    for (int o = 0; o < outer_count(S); o++) {
+        for (int p = S->ptr[o]; p < S->ptr[o + 1]; p++) {
+            int r = inverse[S->format == SPARSE_CSR ? o : S->idx[p]];
+            int c = inverse[S->format == SPARSE_CSR ? S->idx[p] : o];
+            BAND(lu, r, c) += S->val[p];
+            if (c > lu->reach[r]) lu->reach[r] = c;
+        }
+    }
+    free(inverse);
+
+    lu->sign = 1;
+    for (int k = 0; k < n; k++) {
+        int last = k + kl < n - 1 ? k + kl : n - 1;
+
+        int pivot = k;
+        double best = fabs(BAND(lu, k, k));
+        for (int i = k + 1; i <= last; i++) {
+            if (fabs(BAND(lu, i, k)) > best) {
+                best = fabs(BAND(lu, i, k));
+                pivot = i;
+            }
+        }
+        lu->pivot[k] = pivot;
+        if (best == 0.0) {
+            lu->singular = 1;   // Nothing to eliminate with in this column
+            continue;
+        }
+        if (pivot != k) {
+            int right = lu->reach[k] > lu->reach[pivot] ? lu->reach[k] : lu->reach[pivot];
+            for (int j = k; j <= right; j++) {
+                double tmp = BAND(lu, k, j);
+                BAND(lu, k, j) = BAND(lu, pivot, j);
+                BAND(lu, pivot, j) = tmp;
+            }
+            int tmp = lu->reach[k];
+            lu->reach[k] = lu->reach[pivot];
+            lu->reach[pivot] = tmp;
+            lu->sign = -lu->sign;
+        }
+
+        const double *row_k = &BAND(lu, k, k);
+        double inv_pivot = 1.0 / row_k[0];
+        int len = lu->reach[k] - k;
+        for (int i = k + 1; i <= last; i++) {
+            double *row_i = &BAND(lu, i, k);
+            double factor = row_i[0] * inv_pivot;
+            lu->lower[(size_t)k * kl + (i - k - 1)] = factor;
+            if (factor != 0.0) {
+                row_axpy(row_i + 1, row_k + 1, len, factor);
+                if (lu->reach[k] > lu->reach[i]) lu->reach[i] = lu->reach[k];
+            }
+        }
+    }
+    return 0;
+}
+
+void sparse_lu_free(SparseLU *lu)
+{
+    free(lu->perm);
+    free(lu->pivot);
+    free(lu->reach);
+    free(lu->band);
+    free(lu->lower);
+    memset(lu, 0, sizeof(*lu));
+}
+
+// Reordering is symmetric, so it leaves the determinant unchanged
+double sparse_lu_determinant(const SparseLU *lu)
+{
+    if (lu->singular) {
+        return 0.0;
+    }
+    double det = lu->sign;
+    for (int i = 0; i < lu->n; i++) {
+        det *= BAND(lu, i, i);
+    }
+    return det;
+}
+
+// Overwrite b with the solution of S x = b. Returns 0, 1 if S is singular (b untouched),
+// or -1 out of memory.
+int sparse_lu_solve(const SparseLU *lu, double *b)
+{
+    if (lu->singular) {
+        return 1;
+    }
+    int n = lu->n, kl = lu->kl;
+    double *y = malloc(sizeof(double) * n);
+    if (!y) {
+        return -1;
+    }
+    for (int i = 0; i < n; i++) {
+        y[i] = b[lu->perm[i]];
+    }
+
+    for (int k = 0; k < n; k++) {
+        int p = lu->pivot[k];
+        if (p != k) {
+            double tmp = y[k];
+            y[k] = y[p];
+            y[p] = tmp;
+        }
+        int last = k + kl < n - 1 ? k + kl : n - 1;
+        const double *l = &lu->lower[(size_t)k * kl];
+        for (int i = k + 1; i <= last; i++) {
+            y[i] -= l[i - k - 1] * y[k];
+        }
+    }
+    for (int i = n - 1; i >= 0; i--) {
+        const double *row = &BAND(lu, i, i);
+        double sum = y[i];
+        for (int j = i + 1; j <= lu->reach[i]; j++) {
+            sum -= row[j - i] * y[j];
+        }
+        y[i] = sum / row[0];
+    }
+
+    for (int i = 0; i < n; i++) {
+        b[lu->perm[i]] = y[i];
+    }
+    free(y);
+    return 0;
+}
+
+// Determinant of a square sparse matrix; NAN if it is not square or memory ran out
+double sparse_determinant(const SparseMatrix *S)
+{
+    SparseLU lu;
+    if (sparse_lu_factor(S, &lu) != 0) {
+        return NAN;
+    }
+    double det = sparse_lu_determinant(&lu);
+    sparse_lu_free(&lu);
+    return det;
+}
+
+// x = S^-1 b (x may alias b). Returns 0, 1 if S is singular, -1 if not square or out of memory.
+int sparse_solve(const SparseMatrix *S, const double *b, double *x)
+{
+    SparseLU lu;
+    if (sparse_lu_factor(S, &lu) != 0) {
+        return -1;
+    }
+    if (x != b) {
+        memcpy(x, b, sizeof(double) * S->rows);
+    }
+    int status = sparse_lu_solve(&lu, x);
+    sparse_lu_free(&lu);
+    return status;
+}
+
+// ---- Matrix Market loader ----
+//
+//   %%MatrixMarket matrix coordinate real general      (banner optional; field real, integer or
+//   % comments                                          pattern; symmetry general, symmetric or
+//   rows cols entries                                   skew-symmetric)
+//   i j value                                          (1-based, one entry per line)
+
+// Unsigned decimal integer after optional blanks; NULL if there is none
+static const char *parse_index(const char *p, const char *end, long *value)
+{
+    while (p < end && (*p == ' ' || *p == '\t')) p++;
+    if (p == end || *p < '0' || *p > '9') {
+        return NULL;
+    }
+    long v = 0;
+    while (p < end && *p >= '0' && *p <= '9' && v < 1L << 40) {
+        v = v * 10 + (*p++ - '0');
+    }
+    *value = v;
+    return p;
+}
+
+static const char *parse_value(const char *p, const char *end, double *value)
+{
+    while (p < end && (*p == ' ' || *p == '\t')) p++;
+    const char *start = p;
+    while (p < end && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n') p++;
+    if (p == start || parse_double_token(start, (size_t)(p - start), value) != 0) {
+        return NULL;
+    }
+    return p;
+}
+
+static int banner_has(const char *line, size_t len, const char *word)
+{
+    size_t w = strlen(word);
+    for (size_t i = 0; i + w <= len; i++) {
+        if (strncasecmp(line + i, word, w) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Parse Matrix Market coordinate text into a CSR matrix. Returns 0, or -1 with a message.
+int sparse_parse(const char *data, size_t len, SparseMatrix *S, char *error, size_t error_len)
+{
+    const char *p = data, *end = data + len;
+    long line = 0;
+    int pattern = 0, symmetric = 0, skew = 0;
+    memset(S, 0, sizeof(*S));
+
+    if (len >= 14 && strncmp(data, "%%MatrixMarket", 14) == 0) {
+        const char *eol = memchr(p, '\n', (size_t)(end - p));
+        size_t n = (size_t)((eol ? eol : end) - p);
+        if (!banner_has(p, n, "coordinate")) {
+            return sparse_error(error, error_len, 1, "only the coordinate (sparse) format is supported");
+        }
+        if (banner_has(p, n, "complex")) {
+            return sparse_error(error, error_len, 1, "complex matrices are not supported");
+        }
+        pattern = banner_has(p, n, "pattern");
+        skew = banner_has(p, n, "skew-symmetric");
+        symmetric = skew || banner_has(p, n, "symmetric") || banner_has(p, n, "hermitian");
+    }
+
+    // Size line: the first one that is neither a comment nor blank
+    long rows = 0, cols = 0, entries = -1;
+    while (p < end && entries < 0) {
+        const char *eol = memchr(p, '\n', (size_t)(end - p));
+        if (!eol) eol = end;
+        line++;
+        const char *q = p;
+        while (q < eol && (*q == ' ' || *q == '\t' || *q == '\r')) q++;
+        if (q < eol && *q != '%') {
+            if (!(q = parse_index(q, eol, &rows)) || !(q = parse_index(q, eol, &cols)) ||
+                !parse_index(q, eol, &entries) || rows < 1 || cols < 1 || rows > INT_MAX ||
+                cols > INT_MAX || entries > INT_MAX / 2) {
+                return sparse_error(error, error_len, line, "expected: rows columns entries");
+            }
+        }
+        p = eol < end ? eol + 1 : end;
+    }
+    if (entries < 0) {
+        return sparse_error(error, error_len, line, "missing the size line");
+    }
+
+    size_t capacity = (size_t)entries * (symmetric ? 2 : 1) + 1;
+    int *ri = malloc(sizeof(int) * capacity);
+    int *ci = malloc(sizeof(int) * capacity);
+    double *v = malloc(sizeof(double) * capacity);
+    if (!ri || !ci || !v) {
+        free(ri);
+        free(ci);
+        free(v);
+        return sparse_error(error, error_len, line, "out of memory");
+    }
+
+    int count = 0;
+    long read = 0;
+    int status = 0;
+    while (p < end && status == 0) {
+        const char *eol = memchr(p, '\n', (size_t)(end - p));
+        if (!eol) eol = end;
+        line++;
+        long i, j;
+        double value = 1.0;
+        const char *q = p;
+        while (q < eol && (*q == ' ' || *q == '\t' || *q == '\r')) q++;
+        p = eol < end ? eol + 1 : end;
+        if (q == eol || *q == '%') {
+            continue;
+        }
+
+        if (!(q = parse_index(q, eol, &i)) || !(q = parse_index(q, eol, &j)) ||
+            (!pattern && !parse_value(q, eol, &value))) {
+            status = sparse_error(error, error_len, line, pattern ? "expected: row column" : "expected: row column value");
+        } else if (i < 1 || i > rows || j < 1 || j > cols) {
+            status = sparse_error(error, error_len, line, "index outside the matrix");
+        } else if (++read > entries) {
+            status = sparse_error(error, error_len, line, "more entries than the size line declares");
+        } else {
+            ri[count] = (int)i - 1;
+            ci[count] = (int)j - 1;
+            v[count++] = value;
+            if (symmetric && i != j) {
+                ri[count] = (int)j - 1;
+                ci[count] = (int)i - 1;
+                v[count++] = skew ? -value : value;
+            }
+        }
+    }
+    if (status == 0 && read < entries) {
+        status = sparse_error(error, error_len, line, "fewer entries than the size line declares");
+    }
+    if (status == 0 && sparse_from_triplets(S, SPARSE_CSR, (int)rows, (int)cols, count, ri, ci, v) != 0) {
+        status = sparse_error(error, error_len, line, "out of memory");
+    }
+    free(ri);
+    free(ci);
+    free(v);
+    return status;
+}
+
+static int parse_sparse_text(const char *data, size_t len, void *arg, char *error, size_t error_len)
+{
+    return sparse_parse(data, len, arg, error, error_len);
+}
+
+// Load a Matrix Market file. Returns 0, or -1 with a message in error.
+int sparse_load(const char *path, SparseMatrix *S, char *error, size_t error_len)
+{
+    return parse_text_file(path, parse_sparse_text, S, error, error_len);
+}
@@ -0,0 +1,268 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "funcs.h"
+
+// Strassen-Winograd multiplication for large products: 7 half-size products and 15 block
+// additions per level instead of 8 products, so O(n^2.81) flops. Each half-size product
+// recurses until a side drops to the crossover, where the blocked dgemm takes over.
+// Odd sizes are handled by peeling the last row / column / inner index off and fixing
+// them up with dgemm afterwards.
+//
+// The temporaries for all levels come from one arena sized up front: each level takes three
+// blocks (an A-sized sum, a B-sized sum and one product) and hands the rest to the level below.
+// Schedule after Douglas et al. (DGEFMM), using the quadrants of C as extra workspace.
+
+#define STRASSEN_DEFAULT_CROSSOVER 1024    // found with "./bench.out strassen" on the dev machine
+#define STRASSEN_MIN_CROSSOVER 64
+
+typedef double vec4 __attribute__((vector_size(4 * sizeof(double))));
+
+typedef struct {
+    double *base;
+    size_t size, used;          // in doubles
+} StrassenArena;
+
+static _Atomic int strassen_cutoff;    // LAC_STRASSEN_CROSSOVER, else the default; set once
+static pthread_once_t strassen_cutoff_once = PTHREAD_ONCE_INIT;
+
+static void strassen_cutoff_init(void)
+{
+    const char *env = getenv("LAC_STRASSEN_CROSSOVER");
+    int n = env && atoi(env) > 0 ? atoi(env) : STRASSEN_DEFAULT_CROSSOVER;
+    atomic_store(&strassen_cutoff, n < STRASSEN_MIN_CROSSOVER ? STRASSEN_MIN_CROSSOVER : n);
+}
+
+// Products with every side at or below this size go straight to dgemm
+int strassen_crossover(void)
+{
+    pthread_once(&strassen_cutoff_once, strassen_cutoff_init);
+    return atomic_load(&strassen_cutoff);
+}
+
+// Change the crossover (n <= 0 restores the default); sizes below 64 are raised to 64.
+// Safe to call from any thread; products already running keep the crossover they started with.
+void strassen_set_crossover(int n)
+{
+    pthread_once(&strassen_cutoff_once, strassen_cutoff_init);
+    if (n <= 0) {
+        n = STRASSEN_DEFAULT_CROSSOVER;
+    }
+    atomic_store(&strassen_cutoff, n < STRASSEN_MIN_CROSSOVER ? STRASSEN_MIN_CROSSOVER : n);
+}
+
+static inline size_t padded(int cols)
+{
+    return ((size_t)cols + 7) & ~(size_t)7;
+}
+
+static int recurses(int m, int n, int k, int cutoff)
+{
+    return m > cutoff && n > cutoff && k > cutoff;
+}
+
+// Arena doubles needed for an m x k by k x n product, all levels included
+static size_t workspace(int m, int n, int k, int cutoff)
+{
+    size_t total = 0;
+    while (recurses(m, n, k, cutoff)) {
+        m /= 2;
+        n /= 2;
+        k /= 2;
+        total += (size_t)m * padded(k) + (size_t)k * padded(n) + (size_t)m * padded(n);
+    }
+    return total;
+}
+
+static double *arena_take(StrassenArena *arena, int rows, int cols)
+{
+    double *p = arena->base + arena->used;
+    arena->used += (size_t)rows * padded(cols);
+    return p;
+}
+
+// dst = x + sign * y over a rows x cols block; dst may alias x or y
+static void block_combine(int rows, int cols, double *dst, int ldd, const double *x, int ldx,
+                          const double *y, int ldy, double sign)
+{
+    for (int i = 0; i < rows; i++) {
+        double *d = &dst[(size_t)i * ldd];
+        const double *a = &x[(size_t)i * ldx];
+        const double *b = &y[(size_t)i * ldy];
+        int j = 0;
+        for (; j + 4 <= cols; j += 4) {
+            vec4 va, vb;
+            memcpy(&va, a + j, sizeof(va));
+            memcpy(&vb, b + j, sizeof(vb));
+            va += sign * vb;
+            memcpy(d + j, &va, sizeof(va));
+        }
+        for (; j < cols; j++) {
+            d[j] = a[j] + sign * b[j];
+        }
+    }
+}
+
+// C = A * B for row-major A (m x k), B (k x n), C (m x n)
+static int strassen_rec(int m, int n, int k, const double *A, int lda, const double *B, int ldb,
+                        double *C, int ldc, StrassenArena *arena, int cutoff)
+{
+    if (!recurses(m, n, k, cutoff)) {
+        return dgemm(m, n, k, 1.0, A, lda, B, ldb, 0.0, C, ldc);
+    }
+
+    int m2 = m / 2, n2 = n / 2, k2 = k / 2;
+    const double *A11 = A, *A12 = A + k2, *A21 = A + (size_t)m2 * lda, *A22 = A21 + k2;
+    const double *B11 = B, *B12 = B + n2, *B21 = B + (size_t)k2 * ldb, *B22 = B21 + n2;
+    double *C11 = C, *C12 = C + n2, *C21 = C + (size_t)m2 * ldc, *C22 = C21 + n2;
+
+    size_t mark = arena->used;
+    int ldx = (int)padded(k2), ldy = (int)padded(n2), ldz = ldy;
+    double *X = arena_take(arena, m2, k2);
+    double *Y = arena_take(arena, k2, n2);
+    double *Z = arena_take(arena, m2, n2);
+    int status = 0;
+
+    // P7 = (A11 - A21)(B22 - B12) into C21
+    block_combine(m2, k2, X, ldx, A11, lda, A21, lda, -1.0);
+    block_combine(k2, n2, Y, ldy, B22, ldb, B12, ldb, -1.0);
+    status |= strassen_rec(m2, n2, k2, X, ldx, Y, ldy, C21, ldc, arena, cutoff);
+
+    // P5 = (A21 + A22)(B12 - B11) into C22
+    block_combine(m2, k2, X, ldx, A21, lda, A22, lda, 1.0);
+    block_combine(k2, n2, Y, ldy, B12, ldb, B11, ldb, -1.0);
+    status |= strassen_rec(m2, n2, k2, X, ldx, Y, ldy, C22, ldc, arena, cutoff);
+
+    // P6 = (A21 + A22 - A11)(B22 - B12 + B11) into C12
+    block_combine(m2, k2, X, ldx, X, ldx, A11, lda, -1.0);
+    block_combine(k2, n2, Y, ldy, B22, ldb, Y, ldy, -1.0);
+    status |= strassen_rec(m2, n2, k2, X, ldx, Y, ldy, C12, ldc, arena, cutoff);
+
+    // P3 = (A12 - S2) B22 into C11
+    block_combine(m2, k2, X, ldx, A12, lda, X, ldx, -1.0);
+    status |= strassen_rec(m2, n2, k2, X, ldx, B22, ldb, C11, ldc, arena, cutoff);
+
+    // P1 = A11 B11 into Z
+    status |= strassen_rec(m2, n2, k2, A11, lda, B11, ldb, Z, ldz, arena, cutoff);
+
+    block_combine(m2, n2, C12, ldc, Z, ldz, C12, ldc, 1.0);      // U2 = P1 + P6
+    block_combine(m2, n2, C21, ldc, C12, ldc, C21, ldc, 1.0);    // U3 = U2 + P7
+    block_combine(m2, n2, C12, ldc, C12, ldc, C22, ldc, 1.0);    // U4 = U2 + P5
+    block_combine(m2, n2, C22, ldc, C21, ldc, C22, ldc, 1.0);    // U7 = U3 + P5 = C22
+    block_combine(m2, n2, C12, ldc, C12, ldc, C11, ldc, 1.0);    // U5 = U4 + P3 = C12
+
+    // P4 = A22 (T2 - B21) into C11, then C21 = U3 - P4
+    block_combine(k2, n2, Y, ldy, Y, ldy, B21, ldb, -1.0);
+    status |= strassen_rec(m2, n2, k2, A22, lda, Y, ldy, C11, ldc, arena, cutoff);
+    block_combine(m2, n2, C21, ldc, C21, ldc, C11, ldc, -1.0);
+
+    // P2 = A12 B21 into C11, then C11 = P1 + P2
+    status |= strassen_rec(m2, n2, k2, A12, lda, B21, ldb, C11, ldc, arena, cutoff);
+    block_combine(m2, n2, C11, ldc, Z, ldz, C11, ldc, 1.0);
+
+    arena->used = mark;
+
+    // Peel the odd edges: last inner index, last column, last row
+    int me = 2 * m2, ne = 2 * n2, ke = 2 * k2;
+    if (k > ke) {
+        status |= dgemm(me, ne, 1, 1.0, A + ke, lda, B + (size_t)ke * ldb, ldb, 1.0, C, ldc);
+    }
+    if (n > ne) {
+        status |= dgemm(m, 1, k, 1.0, A, lda, B + ne, ldb, 0.0, C + ne, ldc);
+    }
+    if (m > me) {
+        status |= dgemm(1, ne, k, 1.0, A + (size_t)me * lda, lda, B, ldb, 0.0, C + (size_t)me * ldc, ldc);
+    }
+    return status ? -1 : 0;
+}
+
+// C = A * B for row-major A (m x k), B (k x n), C (m x n), by Strassen-Winograd above the
+// crossover and dgemm below it. C must not overlap A or B.
+// Returns 0 on success, -1 if the workspace could not be allocated.
+int dgemm_strassen(int m, int n, int k, const double *A, int lda, const double *B, int ldb,
+                   double *C, int ldc)
+{
+    int cutoff = strassen_crossover();
+    if (m <= 0 || n <= 0 || k <= 0 || !recurses(m, n, k, cutoff)) {
+        return dgemm(m, n, k, 1.0, A, lda, B, ldb, 0.0, C, ldc);
+    }
+
+    StrassenArena arena;
+    arena.size = workspace(m, n, k, cutoff);
+    arena.used = 0;
+    arena.base = aligned_alloc(64, sizeof(double) * arena.size);
+    if (!arena.base) {
+        return -1;
+    }
+    int status = strassen_rec(m, n, k, A, lda, B, ldb, C, ldc, &arena, cutoff);
+    free(arena.base);
+    return status;
+}
+
+// Number of Strassen levels dgemm_strassen uses for an m x k by k x n product
+int strassen_levels(int m, int n, int k)
+{
+    int cutoff = strassen_crossover(), levels = 0;
+    while (recurses(m, n, k, cutoff)) {
+        m /= 2;
+        n /= 2;
+        k /= 2;
+        levels++;
+    }
+    return levels;
+}
+
+static double max_abs(const DMatrix *M)
+{
+    double best = 0;
+    for (int i = 0; i < M->rows; i++) {
+        for (int j = 0; j < M->cols; j++) {
+            double v = fabs(DMAT(M, i, j));
+            if (v > best) best = v;
+        }
+    }
+    return best;
+}
+
+// Check a Strassen product C of A and B against the classic dgemm product.
+// The first-order bound for Winograd's variant with l levels over base size n0 (Higham,
+// "Accuracy and Stability of Numerical Algorithms", 23.2.2) in the max-element norm is
+//     |C - AB| <= ((n0^2 + 6 n0) 18^l - 6n) u max|A| max|B|
+// with n the inner dimension. *error gets the largest elementwise difference and *bound
+// the bound. Returns 0 if within the bound, 1 if not, -1 on bad dimensions or allocation failure.
+int strassen_check(const DMatrix *A, const DMatrix *B, const DMatrix *C, double *error, double *bound)
+{
+    if (A->cols != B->rows || C->rows != A->rows || C->cols != B->cols) {
+        return -1;
+    }
+    DMatrix ref;
+    if (dmatrix_create(&ref, A->rows, B->cols) != 0) {
+        return -1;
+    }
+    if (dgemm(A->rows, B->cols, A->cols, 1.0, A->data, A->stride, B->data, B->stride,
+              0.0, ref.data, ref.stride) != 0) {
+        dmatrix_free(&ref);
+        return -1;
+    }
+
+    double worst = 0;
+    for (int i = 0; i < C->rows; i++) {
+        for (int j = 0; j < C->cols; j++) {
+            double d = fabs(DMAT(C, i, j) - DMAT(&ref, i, j));
+            if (d > worst || isnan(d)) worst = d;
+        }
+    }
+    dmatrix_free(&ref);
+
+    int levels = strassen_levels(A->rows, B->cols, A->cols);
+    double k = A->cols, n0 = ldexp(k, -levels);
+    double limit = ((n0 * n0 + 6 * n0) * pow(18.0, levels) - 6 * k) * (DBL_EPSILON / 2)
+                   * max_abs(A) * max_abs(B);
+    if (error) *error = worst;
+    if (bound) *bound = limit;
+    return worst <= limit ? 0 : 1;
+}
@@ -0,0 +1,330 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include "funcs.h"
+
+// Shared work-stealing thread pool.
+// Every worker owns a deque: it pushes and pops at the bottom (LIFO, cache friendly) while
+// idle workers steal from the top of other deques (FIFO, takes the biggest/oldest work).
+// Slot 0 belongs to threads outside the pool, so the caller of parallel_for() works too.
+
+#define TP_MAX_THREADS 256
+#define TP_INITIAL_CAPACITY 64
+#define TP_CHUNKS_PER_THREAD 4   // over-decomposition so stealing can balance uneven chunks
+
+typedef struct {
+    atomic_int remaining;        // chunks not yet finished
+} ParallelJob;
+
+typedef struct {
+    parallel_fn fn;
+    void *arg;
+    int begin;
+    int end;
+    ParallelJob *job;
+} Task;
+
+typedef struct {
+    pthread_mutex_t lock;
+    Task *tasks;                 // ring buffer
+    int capacity;
+    int top;                     // steal end
+    int bottom;                  // owner end
+} TaskDeque;
+
+typedef struct {
+    int size;                    // threads including slot 0 (the caller)
+    TaskDeque deques[TP_MAX_THREADS];
+    pthread_t threads[TP_MAX_THREADS];
+    pthread_mutex_t sleep_lock;
+    pthread_cond_t wake;
+    atomic_int pending;          // queued tasks across all deques
+    atomic_int shutting_down;
+} ThreadPool;
+
+static ThreadPool pool;
+static atomic_int pool_ready = 0;
+static pthread_mutex_t pool_init_lock = PTHREAD_MUTEX_INITIALIZER;
+static _Thread_local int tp_worker_id = 0;   // 0 for threads that are not pool workers
+
+static int deque_init(TaskDeque *d)
+{
+    d->tasks = malloc(sizeof(Task) * TP_INITIAL_CAPACITY);
+    if (!d->tasks) {
+        return -1;
+    }
+    d->capacity = TP_INITIAL_CAPACITY;
+    d->top = d->bottom = 0;
+    pthread_mutex_init(&d->lock, NULL);
+    return 0;
+}
+
+static void deque_destroy(TaskDeque *d)
+{
+    pthread_mutex_destroy(&d->lock);
+    free(d->tasks);
+    d->tasks = NULL;
+}
+
+// Push at the bottom; grows the ring when full. Returns -1 if memory ran out.
+static int deque_push(TaskDeque *d, const Task *t)
+{
+    pthread_mutex_lock(&d->lock);
+    if (d->bottom - d->top == d->capacity) {
+        Task *grown = malloc(sizeof(Task) * d->capacity * 2);
+        if (!grown) {
+            pthread_mutex_unlock(&d->lock);
+            return -1;
+        }
+        for (int i = d->top; i < d->bottom; i++) {
+            grown[i - d->top] = d->tasks[i % d->capacity];
+        }
+        free(d->tasks);
+        d->tasks = grown;
+        d->bottom -= d->top;
+        d->top = 0;
+        d->capacity *= 2;
+    }
+    d->tasks[d->bottom % d->capacity] = *t;
+    d->bottom++;
+    pthread_mutex_unlock(&d->lock);
+    return 0;
+}
+
+// Owner side: newest task first
+static int deque_pop(TaskDeque *d, Task *out)
+{
+    int found = 0;
+    pthread_mutex_lock(&d->lock);
+    if (d->bottom > d->top) {
+        d->bottom--;
+        *out = d->tasks[d->bottom % d->capacity];
+        found = 1;
+    }
+    pthread_mutex_unlock(&d->lock);
+    return found;
+}
+
+// Thief side: oldest task first
+static int deque_steal(TaskDeque *d, Task *out)
+{
+    int found = 0;
+    if (pthread_mutex_trylock(&d->lock) != 0) {
+        return 0;   // busy; try another victim rather than queueing on the lock
+    }
+    if (d->bottom > d->top) {
+        *out = d->tasks[d->top % d->capacity];
+        d->top++;
+        found = 1;
+    }
+    pthread_mutex_unlock(&d->lock);
+    return found;
+}
+
+// Take one task: own deque first, then sweep the others starting at a rotating victim
+static int find_task(int self, unsigned *seed, Task *out)
+{
+    if (deque_pop(&pool.deques[self], out)) {
+        atomic_fetch_sub(&pool.pending, 1);
+        return 1;
+    }
+
+    *seed = *seed * 1103515245u + 12345u;
+    int start = (int)((*seed >> 16) % (unsigned)pool.size);
+    for (int i = 0; i < pool.size; i++) {
+        int victim = (start + i) % pool.size;
+        if (victim != self && deque_steal(&pool.deques[victim], out)) {
+            atomic_fetch_sub(&pool.pending, 1);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void run_task(const Task *t)
+{
+    t->fn(t->begin, t->end, t->arg);
+    atomic_fetch_sub_explicit(&t->job->remaining, 1, memory_order_release);
+}
+
+static void *worker_main(void *arg)
+{
+    int self = (int)(size_t)arg;
+    unsigned seed = (unsigned)self * 2654435761u;
+    Task t;
+
+    tp_worker_id = self;
+    while (!atomic_load(&pool.shutting_down)) {
+        if (find_task(self, &seed, &t)) {
+            run_task(&t);
+            continue;
+        }
+
+        // Nothing anywhere: sleep until new work is published
+        pthread_mutex_lock(&pool.sleep_lock);
+        while (atomic_load(&pool.pending) == 0 && !atomic_load(&pool.shutting_down)) {
+            pthread_cond_wait(&pool.wake, &pool.sleep_lock);
+        }
+        pthread_mutex_unlock(&pool.sleep_lock);
+    }
+    return NULL;
+}
+
+// Number of threads to use when the caller does not say: LAC_THREADS, else one per online core
+static int default_thread_count(void)
+{
+    const char *env = getenv("LAC_THREADS");
+    if (env && atoi(env) > 0) {
+        return atoi(env);
+    }
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    return cores > 0 ? (int)cores : 1;
+}
+
+// Start the shared pool with num_threads threads in total (the caller counts as one).
+// num_threads <= 0 picks the default. Returns 0 on success, -1 if already running or on failure.
+int threadpool_init(int num_threads)
+{
+    pthread_mutex_lock(&pool_init_lock);
+    if (pool_ready) {
+        pthread_mutex_unlock(&pool_init_lock);
+        return -1;
+    }
+
+    if (num_threads <= 0) {
+        num_threads = default_thread_count();
+    }
+    if (num_threads > TP_MAX_THREADS) {
+        num_threads = TP_MAX_THREADS;
+    }
+
+    pool.size = num_threads;
+    atomic_store(&pool.pending, 0);
+    atomic_store(&pool.shutting_down, 0);
+    pthread_mutex_init(&pool.sleep_lock, NULL);
+    pthread_cond_init(&pool.wake, NULL);
+
+    for (int i = 0; i < num_threads; i++) {
+        if (deque_init(&pool.deques[i]) != 0) {
+            for (int j = 0; j < i; j++) deque_destroy(&pool.deques[j]);
+            pthread_cond_destroy(&pool.wake);
+            pthread_mutex_destroy(&pool.sleep_lock);
+            pool.size = 1;      // not ready: parallel_for runs serially
+            pthread_mutex_unlock(&pool_init_lock);
+            return -1;
+        }
+    }
+
+    for (int i = 1; i < num_threads; i++) {
+        if (pthread_create(&pool.threads[i], NULL, worker_main, (void *)(size_t)i) != 0) {
+            for (int j = i; j < num_threads; j++) deque_destroy(&pool.deques[j]);
+            pool.size = i;   // run with the threads we managed to start
+            break;
+        }
+    }
+
+    pool_ready = 1;
+    pthread_mutex_unlock(&pool_init_lock);
+    return 0;
+}
+
+// Stop all workers; the next parallel_for() restarts the pool with default settings
+void threadpool_shutdown(void)
+{
+    pthread_mutex_lock(&pool_init_lock);
+    if (!pool_ready) {
+        pthread_mutex_unlock(&pool_init_lock);
+        return;
+    }
+
+    pthread_mutex_lock(&pool.sleep_lock);
+    atomic_store(&pool.shutting_down, 1);
+    pthread_cond_broadcast(&pool.wake);
+    pthread_mutex_unlock(&pool.sleep_lock);
+
+    for (int i = 1; i < pool.size; i++) {
+        pthread_join(pool.threads[i], NULL);
+    }
+    for (int i = 0; i < pool.size; i++) {
+        deque_destroy(&pool.deques[i]);
+    }
+    pthread_cond_destroy(&pool.wake);
+    pthread_mutex_destroy(&pool.sleep_lock);
+
+    pool_ready = 0;
+    pthread_mutex_unlock(&pool_init_lock);
+}
+
+// Threads parallel_for() spreads work over; 1 if the pool could not be started
+int threadpool_size(void)
+{
+    if (!pool_ready) {
+        threadpool_init(0);
+    }
+    return pool_ready ? pool.size : 1;
+}
+
+// Run fn over [begin, end) split into chunks of at least grain items, and wait for all of them.
+// Chunks are spread over the pool; the calling thread executes chunks while it waits,
+// so nested calls from inside a chunk are fine.
+void parallel_for(int begin, int end, int grain, parallel_fn fn, void *arg)
+{
+    int count = end - begin;
+    if (count <= 0) {
+        return;
+    }
+    if (grain < 1) {
+        grain = 1;
+    }
+
+    int threads = threadpool_size();
+    if (threads == 1 || count <= grain) {
+        fn(begin, end, arg);
+        return;
+    }
+
+    int chunk = (count + threads * TP_CHUNKS_PER_THREAD - 1) / (threads * TP_CHUNKS_PER_THREAD);
+    if (chunk < grain) {
+        chunk = grain;
+    }
+    int chunks = (count + chunk - 1) / chunk;
+
+    ParallelJob job;
+    atomic_init(&job.remaining, chunks);
+
+    int self = tp_worker_id;
+    TaskDeque *own = &pool.deques[self];
+
+    // Push in reverse so the owner pops the first chunk first and thieves take the far end
+    for (int c = chunks - 1; c >= 0; c--) {
+        Task t;
+        t.fn = fn;
+        t.arg = arg;
+        t.begin = begin + c * chunk;
+        t.end = t.begin + chunk < end ? t.begin + chunk : end;
+        t.job = &job;
+        atomic_fetch_add(&pool.pending, 1);
+        if (deque_push(own, &t) != 0) {
+            atomic_fetch_sub(&pool.pending, 1);
+            run_task(&t);   // out of memory: do it here instead
+        }
+    }
+
+    pthread_mutex_lock(&pool.sleep_lock);
+    pthread_cond_broadcast(&pool.wake);
+    pthread_mutex_unlock(&pool.sleep_lock);
+
+    // Help out until every chunk of this job is done
+    unsigned seed = (unsigned)(size_t)&job;
+    Task t;
+    while (atomic_load_explicit(&job.remaining, memory_order_acquire) > 0) {
+        if (find_task(self, &seed, &t)) {
+            run_task(&t);
+        } else {
+            sched_yield();
+        }
+    }
+}
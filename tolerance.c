@@ -0,0 +1,336 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "funcs.h"
+
+// Monte Carlo tolerance analysis of a series/parallel expression.
+// Every trial draws each resistor as nominal * (1 + d): d is uniform in [-tol, +tol], or
+// Gaussian with the tolerance taken as 3 sigma and cut off at 6 sigma. Trials run in fixed
+// chunks on the thread pool; each chunk has its own RNG stream seeded from the chunk index, so
+// results depend only on the seed, never on the thread count. Samples are laid out
+// structure-of-arrays and evaluated a block at a time by rexpr_eval_block.
+//
+// The equivalent resistance only grows when a part grows, so evaluating with every part at its
+// lowest and highest possible value bounds every trial. Results are binned on that range into
+// a fine histogram, giving percentiles in bounded memory for any number of trials.
+
+#define TOLERANCE_CHUNK 16384       // trials per chunk and per RNG stream
+#define TOLERANCE_FINE_BINS 16384
+#define GAUSSIAN_CUTOFF 6.0         // in sigma; tolerance = 3 sigma
+#define DB_TO_LN 0.23025850929940456840     // ln(10) / 10
+
+typedef struct {
+    uint64_t s[4];
+} Xoshiro256;
+
+static uint64_t splitmix64(uint64_t *x)
+{
+    uint64_t z = (*x += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static void rng_seed(Xoshiro256 *rng, uint64_t seed, uint64_t stream)
+{
+    uint64_t x = seed ^ (stream * 0xd1342543de82ef95ULL);
+    for (int i = 0; i < 4; i++) rng->s[i] = splitmix64(&x);
+}
+
+static inline uint64_t rotl(uint64_t x, int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+// xoshiro256+ : the top bits are all we use
+static inline uint64_t rng_next(Xoshiro256 *rng)
+{
+    uint64_t *s = rng->s;
+    uint64_t result = s[0] + s[3];
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+    return result;
+}
+
+// Uniform in [0, 1) with 24 bits
+static inline float rng_float(Xoshiro256 *rng)
+{
+    return (float)(rng_next(rng) >> 40) * (1.0f / 16777216.0f);
+}
+
+// sin and cos of 2 pi u for u in [0, 1): quadrant from the top bits, then short Taylor series
+// on [0, pi/2) (error below 1e-6, ample for float samples). The quadrant is applied by
+// multiplying with table entries rather than branching, since u is random.
+static const float quadrant_sin[4][2] = { { 1, 0 }, { 0, 1 }, { -1, 0 }, { 0, -1 } };
+static const float quadrant_cos[4][2] = { { 0, 1 }, { -1, 0 }, { 0, -1 }, { 1, 0 } };
+
+static inline void sincos_turn(float u, float *s, float *c)
+{
+    float x = u * 4.0f;
+    int q = (int)x;
+    float t = (x - (float)q) * 1.5707963f;
+    float t2 = t * t;
+    float sn = t * (1.0f + t2 * (-1.0f / 6 + t2 * (1.0f / 120 + t2 * (-1.0f / 5040 + t2 * (1.0f / 362880 + t2 * (-1.0f / 39916800))))));
+    float cs = 1.0f + t2 * (-0.5f + t2 * (1.0f / 24 + t2 * (-1.0f / 720 + t2 * (1.0f / 40320 + t2 * (-1.0f / 3628800 + t2 * (1.0f / 479001600))))));
+    *s = quadrant_sin[q][0] * sn + quadrant_sin[q][1] * cs;
+    *c = quadrant_cos[q][0] * sn + quadrant_cos[q][1] * cs;
+}
+
+// Fill count relative deviations in units of the tolerance (count <= REXPR_BLOCK)
+static void draw_deviations(Xoshiro256 *rng, ToleranceDistribution dist, float *d, int count)
+{
+    if (dist == TOLERANCE_UNIFORM) {
+        for (int i = 0; i < count; i++) d[i] = 2.0f * rng_float(rng) - 1.0f;
+        return;
+    }
+    if (count <= 0) {
+        return;
+    }
+
+    // Box-Muller, two normals per pair of uniforms, scaled so 3 sigma = 1. The logarithms go
+    // through the vectorized dB kernel.
+    double u1[REXPR_BLOCK / 2], db[REXPR_BLOCK / 2];
+    float u2[REXPR_BLOCK / 2];
+    int pairs = (count + 1) / 2;
+    for (int i = 0; i < pairs; i++) {
+        u1[i] = 1.0 - (double)(rng_next(rng) >> 11) * (1.0 / 9007199254740992.0);    // (0, 1]
+        u2[i] = rng_float(rng);
+    }
+    fast_log10_db(u1, db, pairs, 1.0);     // 10 log10(u1)
+
+    const float cut = GAUSSIAN_CUTOFF / 3.0;
+    float z[REXPR_BLOCK];
+    for (int i = 0; i < pairs; i++) {
+        float r = sqrtf((float)(-2.0 * DB_TO_LN * db[i])) * (1.0f / 3.0f);
+        float s, c;
+        sincos_turn(u2[i], &s, &c);
+        z[2 * i] = r * c;
+        z[2 * i + 1] = r * s;
+    }
+    for (int i = 0; i < count; i++) {
+        d[i] = z[i] > cut ? cut : (z[i] < -cut ? -cut : z[i]);
+    }
+}
+
+typedef struct {
+    const RExpr *expr;
+    const float *nominal;
+    const float *tolerance;     // fraction, e.g. 0.05
+    ToleranceDistribution dist;
+    long trials;
+    uint64_t seed;
+    double center;              // nominal equivalent resistance, sums are taken about it
+    double lo, hi;              // bounds of every trial
+    double *partial_sum;        // per chunk
+    double *partial_sq;
+    float *partial_min;
+    float *partial_max;
+    unsigned long *fine;        // TOLERANCE_FINE_BINS, merged under lock
+    pthread_mutex_t lock;
+} ToleranceJob;
+
+static void tolerance_chunks(int first, int last, void *arg)
+{
+    ToleranceJob *job = arg;
+    int n = job->expr->value_count;
+    float *values = malloc(sizeof(float) * (size_t)(n + 1) * REXPR_BLOCK);
+    unsigned *bins = calloc(TOLERANCE_FINE_BINS, sizeof(unsigned));
+    if (!values || !bins) {
+        free(values);
+        free(bins);
+        return;     // chunk left unmarked, caught by the caller
+    }
+    float *out = values + (size_t)n * REXPR_BLOCK;
+    double scale = TOLERANCE_FINE_BINS / (job->hi - job->lo > 0 ? job->hi - job->lo : 1);
+
+    for (int c = first; c < last; c++) {
+        Xoshiro256 rng;
+        rng_seed(&rng, job->seed, (uint64_t)c);
+        long begin = (long)c * TOLERANCE_CHUNK;
+        long end = begin + TOLERANCE_CHUNK < job->trials ? begin + TOLERANCE_CHUNK : job->trials;
+        double sum = 0, sq = 0;
+        float lo = INFINITY, hi = -INFINITY;
+
+        for (long t = begin; t < end; t += REXPR_BLOCK) {
+            int lanes = end - t < REXPR_BLOCK ? (int)(end - t) : REXPR_BLOCK;
+            for (int i = 0; i < n; i++) {
+                float *row = values + (size_t)i * REXPR_BLOCK;
+                float nominal = job->nominal[i], tol = job->tolerance[i];
+                draw_deviations(&rng, job->dist, row, lanes);
+                for (int l = 0; l < lanes; l++) row[l] = nominal * (1.0f + tol * row[l]);
+            }
+            rexpr_eval_block(job->expr, values, REXPR_BLOCK, lanes, out);
+
+            for (int l = 0; l < lanes; l++) {
+                double x = out[l];
+                double d = x - job->center;
+                sum += d;
+                sq += d * d;
+                lo = out[l] < lo ? out[l] : lo;
+                hi = out[l] > hi ? out[l] : hi;
+                long b = (long)((x - job->lo) * scale);
+                bins[b < 0 ? 0 : (b >= TOLERANCE_FINE_BINS ? TOLERANCE_FINE_BINS - 1 : b)]++;
+            }
+        }
+        job->partial_sum[c] = sum;
+        job->partial_sq[c] = sq;
+        job->partial_min[c] = lo;
+        job->partial_max[c] = hi;
+    }
+
+    pthread_mutex_lock(&job->lock);
+    for (int b = 0; b < TOLERANCE_FINE_BINS; b++) job->fine[b] += bins[b];
+    pthread_mutex_unlock(&job->lock);
+    free(values);
+    free(bins);
+}
+
+// Value below which a fraction q of the trials fall, interpolated within the fine bin
+static double fine_percentile(const ToleranceJob *job, double q)
+{
+    double target = q * job->trials;
+    double width = (job->hi - job->lo) / TOLERANCE_FINE_BINS;
+    double seen = 0;
+    for (int b = 0; b < TOLERANCE_FINE_BINS; b++) {
+        if (seen + job->fine[b] >= target && job->fine[b] > 0) {
+            return job->lo + width * (b + (target - seen) / job->fine[b]);
+        }
+        seen += job->fine[b];
+    }
+    return job->hi;
+}
+
+// Run trials of expr with each R(i+1) drawn around nominal[i] with tolerance_pct[i] percent.
+// Returns 0, or -1 for bad arguments or when memory runs out.
+int tolerance_analysis(const RExpr *expr, const float nominal[], const float tolerance_pct[],
+                       ToleranceDistribution dist, long trials, unsigned long long seed,
+                       ToleranceResult *result)
+{
+    int n = expr->value_count;
+    memset(result, 0, sizeof(*result));
+    if (trials < 1 || trials > (long)TOLERANCE_CHUNK * 0x7fffffffL / 2) {
+        return -1;
+    }
+
+    float *tolerance = malloc(sizeof(float) * (size_t)(n > 0 ? n : 1) * 3);
+    if (!tolerance) {
+        return -1;
+    }
+    float *low = tolerance + n, *high = low + n;
+    double reach = dist == TOLERANCE_GAUSSIAN ? GAUSSIAN_CUTOFF / 3.0 : 1.0;
+    for (int i = 0; i < n; i++) {
+        tolerance[i] = tolerance_pct[i] / 100.0f;
+        if (!(nominal[i] >= 0) || !(tolerance[i] >= 0) || tolerance[i] * reach >= 1) {
+            free(tolerance);
+            return -1;      // parts must stay positive at the extremes
+        }
+        low[i] = nominal[i] * (float)(1 - tolerance[i] * reach);
+        high[i] = nominal[i] * (float)(1 + tolerance[i] * reach);
+    }
+
+    int chunks = (int)((trials + TOLERANCE_CHUNK - 1) / TOLERANCE_CHUNK);
+    ToleranceJob job;
+    job.expr = expr;
+    job.nominal = nominal;
+    job.tolerance = tolerance;
+    job.dist = dist;
+    job.trials = trials;
+    job.seed = seed;
+    job.center = rexpr_eval(expr, nominal);
+    job.lo = rexpr_eval(expr, low);
+    job.hi = rexpr_eval(expr, high);
+    job.partial_sum = malloc(sizeof(double) * chunks * 2);
+    job.partial_min = malloc(sizeof(float) * chunks * 2);
+    job.fine = calloc(TOLERANCE_FINE_BINS, sizeof(unsigned long));
+    if (!job.partial_sum || !job.partial_min || !job.fine) {
+        free(job.partial_sum);
+        free(job.partial_min);
+        free(job.fine);
+        free(tolerance);
+        return -1;
+    }
+    job.partial_sq = job.partial_sum + chunks;
+    job.partial_max = job.partial_min + chunks;
+    for (int c = 0; c < chunks; c++) job.partial_min[c] = NAN;
+    pthread_mutex_init(&job.lock, NULL);
+
+    parallel_for(0, chunks, 1, tolerance_chunks, &job);
+
+    int status = 0;
+    double sum = 0, sq = 0;
+    result->min = INFINITY;
+    result->max = -INFINITY;
+    for (int c = 0; c < chunks; c++) {
+        if (isnan(job.partial_min[c])) {
+            status = -1;
+            break;
+        }
+        sum += job.partial_sum[c];
+        sq += job.partial_sq[c];
+        result->min = job.partial_min[c] < result->min ? job.partial_min[c] : result->min;
+        result->max = job.partial_max[c] > result->max ? job.partial_max[c] : result->max;
+    }
+
+    if (status == 0) {
+        result->trials = trials;
+        result->nominal = job.center;
+        result->mean = job.center + sum / trials;
+        result->std = trials > 1 ? sqrt(fmax(0, (sq - sum * sum / trials) / (trials - 1))) : 0;
+        static const double q[TOLERANCE_PERCENTILES] = { 0.001, 0.01, 0.05, 0.5, 0.95, 0.99, 0.999 };
+        for (int i = 0; i < TOLERANCE_PERCENTILES; i++) {
+            result->quantile[i] = q[i];
+            result->percentile[i] = fine_percentile(&job, q[i]);
+        }
+
+        // Display histogram over the observed range, rebuilt from the fine bins
+        double width = (job.hi - job.lo) / TOLERANCE_FINE_BINS;
+        double span = result->max - result->min;
+        result->hist_lo = result->min;
+        result->hist_hi = result->max;
+        for (int b = 0; b < TOLERANCE_FINE_BINS; b++) {
+            if (job.fine[b] == 0) continue;
+            double center = job.lo + width * (b + 0.5);
+            long k = span > 0 ? (long)((center - result->min) / span * TOLERANCE_BINS) : 0;
+            k = k < 0 ? 0 : (k >= TOLERANCE_BINS ? TOLERANCE_BINS - 1 : k);
+            result->histogram[k] += (long)job.fine[b];
+        }
+    }
+
+    pthread_mutex_destroy(&job.lock);
+    free(job.partial_sum);
+    free(job.partial_min);
+    free(job.fine);
+    free(tolerance);
+    return status;
+}
+
+// Print the statistics and a text histogram of a tolerance run
+void print_tolerance_result(const ToleranceResult *r)
+{
+    printf("\nTrials:             %ld\n", r->trials);
+    printf("Nominal:            %f ohms\n", r->nominal);
+    printf("Mean:               %f ohms\n", r->mean);
+    printf("Standard deviation: %f ohms (%.3f%%)\n", r->std, r->mean != 0 ? 100 * r->std / r->mean : 0);
+    printf("Range:              %f to %f ohms\n", r->min, r->max);
+    for (int i = 0; i < TOLERANCE_PERCENTILES; i++) {
+        printf("  %5.1f%% percentile: %f ohms\n", 100 * r->quantile[i], r->percentile[i]);
+    }
+
+    long peak = 1;
+    for (int k = 0; k < TOLERANCE_BINS; k++) peak = r->histogram[k] > peak ? r->histogram[k] : peak;
+    double width = (r->hist_hi - r->hist_lo) / TOLERANCE_BINS;
+    printf("\n");
+    for (int k = 0; k < TOLERANCE_BINS; k++) {
+        int bar = (int)(50.0 * r->histogram[k] / peak);
+        printf("%12.3f | %-50.*s %ld\n", r->hist_lo + width * k, bar,
+               "##################################################", r->histogram[k]);
+    }
+}
@@ -0,0 +1,371 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "funcs.h"
+
+// Streaming tokenizer for "value from_unit [to] to_unit" requests.
+// Input is taken straight from a file descriptor: regular files are mapped, anything else
+// (pipes, terminals) is read in 1 MiB blocks. Lines are tokenized in place, numbers go through
+// a short fast-path parser, and records are converted in chunks through the bulk kernels, so
+// nothing is allocated or copied per line. Lines may be any length.
+
+#define STREAM_BLOCK (1 << 20)
+#define STREAM_CHUNK 1024
+#define STREAM_MAX_TOKENS 4
+#define SLOW_NUMBER_LEN 128     // longest number token handed to strtod
+
+// Powers of ten that are exact doubles
+static const double exact_pow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// Token separators, as a table so the tokenizer does one load per byte
+static const unsigned char blank_table[256] = {
+    [' '] = 1, ['\t'] = 1, ['\r'] = 1, ['\n'] = 1
+};
+
+static inline int is_blank(char c)
+{
+    return blank_table[(unsigned char)c];
+}
+
+// Parse a whole token as a double; returns 0 on success, -1 if it is not a number.
+// Plain decimals with up to 19 significant digits, a mantissa below 2^53 and a
+// power of ten within 1e+-22 are exact with one multiply or divide (Clinger's fast path).
+// Everything else (long mantissas, large exponents, hex, inf, nan) falls back to strtod.
+int parse_double_token(const char *token, size_t len, double *value)
+{
+    const char *p = token;
+    const char *end = token + len;
+    int negative = 0;
+
+    if (p < end && (*p == '+' || *p == '-')) {
+        negative = (*p == '-');
+        p++;
+    }
+
+    uint64_t mantissa = 0;
+    int digits = 0;         // significant digits in mantissa
+    int any_digits = 0;
+    int exp10 = 0;
+    int exact = 1;
+
+    for (; p < end && *p >= '0' && *p <= '9'; p++) {
+        any_digits = 1;
+        if (digits < 19) {
+            mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+            digits += (mantissa != 0);
+        } else {
+            exp10++;
+            exact &= (*p == '0');
+        }
+    }
+    if (p < end && *p == '.') {
+        for (p++; p < end && *p >= '0' && *p <= '9'; p++) {
+            any_digits = 1;
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+                digits += (mantissa != 0);
+                exp10--;
+            } else {
+                exact &= (*p == '0');
+            }
+        }
+    }
+    if (any_digits && p < end && (*p == 'e' || *p == 'E')) {
+        const char *q = p + 1;
+        int exp_negative = 0;
+        int e = 0;
+        if (q < end && (*q == '+' || *q == '-')) {
+            exp_negative = (*q == '-');
+            q++;
+        }
+        if (q < end && *q >= '0' && *q <= '9') {
+            for (; q < end && *q >= '0' && *q <= '9'; q++) {
+                if (e < 100000) e = e * 10 + (*q - '0');
+            }
+            exp10 += exp_negative ? -e : e;
+            p = q;
+        }
+    }
+
+    if (any_digits && p == end && exact) {
+        if (mantissa == 0) {
+            *value = negative ? -0.0 : 0.0;
+            return 0;
+        }
+        if (mantissa <= (UINT64_C(1) << 53) && exp10 >= -22 && exp10 <= 22) {
+            double m = (double)mantissa;
+            m = exp10 < 0 ? m / exact_pow10[-exp10] : m * exact_pow10[exp10];
+            *value = negative ? -m : m;
+            return 0;
+        }
+    }
+
+    // Slow path: strtod on a NUL-terminated copy of the token
+    char buf[SLOW_NUMBER_LEN];
+    if (len == 0 || len >= sizeof(buf)) {
+        return -1;
+    }
+    memcpy(buf, token, len);
+    buf[len] = '\0';
+    char *stop;
+    *value = strtod(buf, &stop);
+    return (stop == buf + len && !is_blank(buf[0])) ? 0 : -1;
+}
+
+// Split a line into "value from_unit [to] to_unit".
+// Returns 0 on success, 1 for blank and comment ('#') lines, -1 for malformed lines.
+int parse_unit_request(const char *line, size_t len, UnitRequest *req)
+{
+    const char *start[STREAM_MAX_TOKENS];
+    int length[STREAM_MAX_TOKENS];
+    int count = 0;
+    const char *p = line;
+    const char *end = line + len;
+
+    while (1) {
+        while (p < end && is_blank(*p)) p++;
+        if (p == end) {
+            break;
+        }
+        if (count == 0 && *p == '#') {
+            return 1;   // Comment, however many words follow
+        }
+        if (count == STREAM_MAX_TOKENS) {
+            return -1;  // Too many tokens
+        }
+        const char *tok = p;
+        while (p < end && !is_blank(*p)) p++;
+        start[count] = tok;
+        length[count] = (int)(p - tok);
+        count++;
+    }
+
+    if (count == 0) {
+        return 1;
+    }
+    // Accept both "10 dbm mw" and "10 dbm to mw"
+    int has_to = (count == 4 && length[2] == 2 && memcmp(start[2], "to", 2) == 0);
+    if (count != 3 && !has_to) {
+        return -1;
+    }
+    if (parse_double_token(start[0], length[0], &req->value) != 0) {
+        return -1;
+    }
+    req->from = start[1];
+    req->from_len = length[1];
+    req->to = start[has_to ? 3 : 2];
+    req->to_len = length[has_to ? 3 : 2];
+    return 0;
+}
+
+#define UNIT_CACHE_LEN 16
+
+// Last unit name seen in one column and its ID; requests usually come in runs of one pair
+typedef struct {
+    char name[UNIT_CACHE_LEN];
+    int len;
+    int id;
+} UnitCache;
+
+typedef struct {
+    unit_stream_fn emit;
+    void *arg;
+    UnitCache from_cache;
+    UnitCache to_cache;
+    long line_no;
+    long emitted;
+    size_t count;
+    UnitRecord records[STREAM_CHUNK];
+    int from_id[STREAM_CHUNK];
+    int to_id[STREAM_CHUNK];
+    double values[STREAM_CHUNK];
+    double results[STREAM_CHUNK];
+} UnitStream;
+
+// Convert the pending records, one bulk call per run of identical unit pairs, and hand them out
+static void stream_flush(UnitStream *s)
+{
+    size_t i = 0;
+    while (i < s->count) {
+        if (s->records[i].error) {
+            i++;
+            continue;
+        }
+        size_t run = i;
+        while (run < s->count && !s->records[run].error &&
+               s->from_id[run] == s->from_id[i] && s->to_id[run] == s->to_id[i]) {
+            s->values[run - i] = s->records[run].request.value;
+            run++;
+        }
+
+        UnitConversion conv;
+        if (resolve_conversion_ids(s->from_id[i], s->to_id[i], &conv) != 0) {
+            for (size_t k = i; k < run; k++) {
+                s->records[k].error = "unsupported unit conversion";
+            }
+        } else {
+            convert_with(&conv, s->values, s->results, run - i);
+            for (size_t k = i; k < run; k++) {
+                s->records[k].result = s->results[k - i];
+            }
+        }
+        i = run;
+    }
+
+    if (s->count > 0) {
+        s->emit(s->records, s->count, s->arg);
+        s->emitted += (long)s->count;
+        s->count = 0;
+    }
+}
+
+static int cached_unit_id(UnitCache *cache, const char *name, int len)
+{
+    if (len == cache->len && memcmp(name, cache->name, len) == 0) {
+        return cache->id;
+    }
+    int id = unit_id_n(name, len);
+    if (len < UNIT_CACHE_LEN) {
+        memcpy(cache->name, name, len);
+        cache->len = len;
+        cache->id = id;
+    }
+    return id;
+}
+
+static void stream_line(UnitStream *s, const char *line, size_t len)
+{
+    s->line_no++;
+
+    UnitRecord *r = &s->records[s->count];
+    int status = parse_unit_request(line, len, &r->request);
+    if (status == 1) {
+        return;
+    }
+    r->line = s->line_no;
+    r->result = NAN;
+    r->error = NULL;
+    if (status != 0) {
+        r->error = "expected: value from_unit [to] to_unit";
+    } else {
+        s->from_id[s->count] = cached_unit_id(&s->from_cache, r->request.from, r->request.from_len);
+        s->to_id[s->count] = cached_unit_id(&s->to_cache, r->request.to, r->request.to_len);
+    }
+
+    if (++s->count == STREAM_CHUNK) {
+        stream_flush(s);
+    }
+}
+
+// Feed every complete line of [data, data + len); returns the number of bytes consumed.
+// With final set the trailing unterminated line is taken as well.
+static size_t stream_lines(UnitStream *s, const char *data, size_t len, int final)
+{
+    const char *p = data;
+    const char *end = data + len;
+    const char *nl;
+
+    while (p < end && (nl = memchr(p, '\n', (size_t)(end - p))) != NULL) {
+        stream_line(s, p, (size_t)(nl - p));
+        p = nl + 1;
+    }
+    if (final && p < end) {
+        stream_line(s, p, (size_t)(end - p));
+        p = end;
+    }
+    return (size_t)(p - data);
+}
+
+static long stream_mapped(UnitStream *s, int fd, size_t size)
+{
+    char *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    if (data == MAP_FAILED) {
+        return -1;
+    }
+    madvise(data, size, MADV_SEQUENTIAL);
+    stream_lines(s, data, size, 1);
+    stream_flush(s);    // records point into the mapping
+    munmap(data, size);
+    return s->emitted;
+}
+
+static long stream_read(UnitStream *s, int fd)
+{
+    size_t capacity = STREAM_BLOCK;
+    size_t have = 0;
+    char *buf = malloc(capacity);
+    if (!buf) {
+        return -1;
+    }
+
+    while (1) {
+        if (have == capacity) {
+            // A single line longer than the buffer: grow it
+            char *grown = realloc(buf, capacity * 2);
+            if (!grown) {
+                free(buf);
+                return -1;
+            }
+            buf = grown;
+            capacity *= 2;
+        }
+        ssize_t n = read(fd, buf + have, capacity - have);
+        if (n < 0) {
+            free(buf);
+            return -1;
+        }
+        if (n == 0) {
+            stream_lines(s, buf, have, 1);
+            stream_flush(s);
+            break;
+        }
+        have += (size_t)n;
+
+        size_t used = stream_lines(s, buf, have, 0);
+        if (used > 0) {
+            stream_flush(s);    // records point into buf, hand them out before it moves
+            memmove(buf, buf + used, have - used);
+            have -= used;
+        }
+    }
+
+    free(buf);
+    return s->emitted;
+}
+
+// Parse and convert every request read from fd, passing records to emit in chunks.
+// Blank and comment lines are skipped (but counted for line numbers).
+// Returns the number of records emitted, or -1 on a read or allocation error.
+long convert_units_stream(int fd, unit_stream_fn emit, void *arg)
+{
+    UnitStream *s = calloc(1, sizeof(UnitStream));
+    if (!s) {
+        return -1;
+    }
+    s->emit = emit;
+    s->arg = arg;
+    s->from_cache.len = -1;
+    s->to_cache.len = -1;
+
+    long result;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 && lseek(fd, 0, SEEK_CUR) == 0) {
+        result = stream_mapped(s, fd, (size_t)st.st_size);
+        if (result < 0 && s->emitted == 0) {
+            result = stream_read(s, fd);    // mapping refused, read it instead
+        }
+    } else {
+        result = stream_read(s, fd);
+    }
+
+    free(s);
+    return result;
+}